@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../src/Utilities/Barrier.h"
+
+// Measures the round-trip cost of Barrier::wait() at different thread counts. A round trip
+// is every thread arriving at the barrier and being released. A plain mutex and condition
+// variable barrier (like the one the software renderer used before) is measured too for
+// comparison.
+
+// Usage: BarrierBenchmark [iterations]
+
+namespace
+{
+	// Barrier that always sleeps until the last thread arrives.
+	class CondVarBarrier
+	{
+	private:
+		std::mutex mutex;
+		std::condition_variable condVar;
+		int threadCount, remaining, generation;
+	public:
+		CondVarBarrier(int threadCount)
+		{
+			this->threadCount = threadCount;
+			this->remaining = threadCount;
+			this->generation = 0;
+		}
+
+		void wait()
+		{
+			std::unique_lock<std::mutex> lk(this->mutex);
+			const int currentGeneration = this->generation;
+			this->remaining--;
+
+			if (this->remaining == 0)
+			{
+				this->remaining = this->threadCount;
+				this->generation++;
+				lk.unlock();
+				this->condVar.notify_all();
+			}
+			else
+			{
+				this->condVar.wait(lk, [this, currentGeneration]()
+				{
+					return this->generation != currentGeneration;
+				});
+			}
+		}
+	};
+
+	// Gets the average nanoseconds per round trip for the given barrier and thread count.
+	template <typename T>
+	double measure(int threadCount, int iterations)
+	{
+		T barrier(threadCount);
+
+		auto threadFunc = [&barrier, iterations]()
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				barrier.wait();
+			}
+		};
+
+		// All threads are started before timing so thread creation isn't measured.
+		T startBarrier(threadCount + 1);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < threadCount; i++)
+		{
+			threads.push_back(std::thread([&startBarrier, &threadFunc]()
+			{
+				startBarrier.wait();
+				threadFunc();
+			}));
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		startBarrier.wait();
+
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+
+		const auto end = std::chrono::high_resolution_clock::now();
+		const double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+		return nanoseconds / static_cast<double>(iterations);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const int iterations = (argc > 1) ? std::max(std::atoi(argv[1]), 1) : 20000;
+	const std::vector<int> threadCounts = { 1, 2, 4, 8, 16 };
+
+	std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << '\n';
+	std::cout << "Iterations: " << iterations << '\n';
+	std::cout << "threads,barrier_ns,condvar_ns" << '\n';
+
+	for (const int threadCount : threadCounts)
+	{
+		const double barrierTime = measure<Barrier>(threadCount, iterations);
+		const double condVarTime = measure<CondVarBarrier>(threadCount, iterations);
+		std::cout << threadCount << ',' << std::fixed << std::setprecision(1) <<
+			barrierTime << ',' << condVarTime << '\n';
+	}
+
+	return 0;
+}
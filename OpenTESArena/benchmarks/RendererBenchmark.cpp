@@ -0,0 +1,815 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/Math/Constants.h"
+#include "../src/Math/Vector3.h"
+#include "../src/Rendering/Renderer.h"
+#include "../src/Rendering/SoftwareRenderer.h"
+#include "../src/Rendering/Surface.h"
+#include "../src/Utilities/Platform.h"
+#include "../src/World/DistantSky.h"
+#include "../src/World/LevelData.h"
+#include "../src/World/VoxelData.h"
+#include "../src/World/VoxelGrid.h"
+
+// Renders a synthetic scene with the software renderer along scripted camera paths and
+// reports performance as CSV on stdout. It doesn't need a display, a GPU, or Arena's game
+// data, so it can run on build machines.
+
+// Usage: RendererBenchmark [options]
+// --width <n>: frame buffer width (default 640).
+// --height <n>: frame buffer height (default 400).
+// --threads <n,n,...>: render thread counts to test (default 1 and all hardware threads).
+// --frames <n>: timed frames per camera path (default 120).
+// --flat-spacing <n>: voxels between flats along each axis (default 5). Lower is more flats.
+// --light-spacing <n>: voxels between point lights along each axis, like torches, plus one
+//   light that moves with the camera (default 0, no lights).
+// --static-lights: bake the torches into a lightmap instead of drawing them as point lights.
+//   The light that moves with the camera is still a point light.
+// --scene <name>: voxel grid to render. "mixed" (default) has every voxel type in a 64x64
+//   grid, "wilderness" is open ground with a few ruins in a 128x128 grid, "city" is
+//   blocks of buildings in a 128x128 grid, and "dungeon" is rooms joined by doors in a
+//   128x128 grid, like an interior.
+// --palette: use palette shading.
+// --mipmaps: sample distant textures from smaller mip levels.
+// --interleaved: draw every other column each frame.
+// --no-visibility: don't cull with a potentially visible set in interior scenes.
+
+// Each row has the average frames per second, milliseconds per frame and per phase, and the
+// percent of each frame that each render thread spent drawing (separated by semicolons).
+
+namespace
+{
+	const double CEILING_HEIGHT = 1.0;
+	const double FOG_DISTANCE = 20.0;
+	const double VERTICAL_FOV = 60.0;
+	const int WARMUP_FRAMES = 5;
+	const double LIGHT_INTENSITY = 4.0;
+
+	// Voxel texture IDs used by the synthetic scene.
+	const int FLOOR_TEXTURE = 0;
+	const int CEILING_TEXTURE = 1;
+	const int WALL_TEXTURE = 2;
+	const int RAISED_TEXTURE = 3;
+	const int DIAGONAL_TEXTURE = 4;
+	const int TRANSPARENT_TEXTURE = 5;
+	const int EDGE_TEXTURE = 6;
+	const int DRY_CHASM_TEXTURE = 7;
+	const int WET_CHASM_TEXTURE = 8;
+	const int DOOR_TEXTURE = 9;
+	const int SOLID_DOOR_TEXTURE = 10;
+	const int VOXEL_TEXTURE_COUNT = 11;
+	const int FLAT_TEXTURE_COUNT = 8;
+
+	struct Settings
+	{
+		std::string scene;
+		int width, height, frames, flatSpacing, lightSpacing;
+		std::vector<int> threadCounts;
+		bool staticLights, paletteShading, mipmapping, interleavedColumns, visibility;
+	};
+
+	// A scene is a voxel grid for the camera paths to go through. Grids are square in the XZ
+	// plane, and their middle row and column are kept clear for the camera.
+	struct Scene
+	{
+		const char *name;
+		int gridSize, gridHeight;
+		void(*fillVoxelGrid)(VoxelGrid &voxelGrid, std::vector<Int2> *doorVoxels);
+		bool interior; // Uses a potentially visible set like the game's interiors.
+	};
+
+	// A camera path gives the eye and direction at some percent along the path.
+	struct CameraPath
+	{
+		const char *name;
+		void(*getCamera)(double percent, int gridSize, Double3 *eye, Double3 *direction);
+		double daytimePercent;
+	};
+
+	// Walks down the middle row, looking ahead with a slight sway.
+	void getWalkCamera(double percent, int gridSize, Double3 *eye, Double3 *direction)
+	{
+		const double x = 2.0 + (percent * static_cast<double>(gridSize - 4));
+		const double angle = std::sin(percent * Constants::TwoPi * 2.0) * 0.35;
+		*eye = Double3(x, 1.60, static_cast<double>(gridSize / 2) + 0.50);
+		*direction = Double3(std::cos(angle), 0.0, std::sin(angle)).normalized();
+	}
+
+	// Turns in place in the middle of the grid.
+	void getTurnCamera(double percent, int gridSize, Double3 *eye, Double3 *direction)
+	{
+		const double center = static_cast<double>(gridSize / 2) + 0.50;
+		const double angle = percent * Constants::TwoPi;
+		*eye = Double3(center, 1.60, center);
+		*direction = Double3(std::cos(angle), 0.0, std::sin(angle)).normalized();
+	}
+
+	// Turns in place while looking up at the sky and down at the floor.
+	void getLookCamera(double percent, int gridSize, Double3 *eye, Double3 *direction)
+	{
+		const double center = static_cast<double>(gridSize / 2) + 0.50;
+		const double angle = percent * Constants::TwoPi;
+		const double pitch = std::sin(percent * Constants::TwoPi * 3.0) * 0.80;
+		*eye = Double3(center, 1.60, center);
+		*direction = Double3(std::cos(angle), pitch, std::sin(angle)).normalized();
+	}
+
+	const std::vector<CameraPath> CameraPaths =
+	{
+		{ "walk", getWalkCamera, 0.50 },
+		{ "turn", getTurnCamera, 0.50 },
+		{ "look", getLookCamera, 0.30 }
+	};
+
+	// Makes a checkered texture. Transparent textures have a see-through hole in the middle.
+	Surface makeTexture(int width, int height, int seed, bool transparent)
+	{
+		Surface surface = Surface::createWithFormat(width, height,
+			Renderer::DEFAULT_BPP, Renderer::DEFAULT_PIXELFORMAT);
+		uint32_t *pixels = static_cast<uint32_t*>(surface.getPixels());
+
+		const uint32_t color = (static_cast<uint32_t>(seed + 1) * 2654435761u) | 0x00303030;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const bool checker = (((x / 8) + (y / 8)) % 2) == 0;
+				const int dx = x - (width / 2);
+				const int dy = y - (height / 2);
+				const bool hole = transparent && (((dx * dx) + (dy * dy)) < ((width * width) / 12));
+				const uint32_t texel = checker ? color : ((color >> 1) & 0x007F7F7F);
+				pixels[x + (y * width)] = hole ? 0 : (0xFF000000 | texel);
+			}
+		}
+
+		return surface;
+	}
+
+	// Gets a number from voxel coordinates that's the same every run.
+	uint32_t getVoxelHash(int x, int z)
+	{
+		return (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(z) * 19349663u);
+	}
+
+	// Fills a grid with every kind of voxel the renderer draws, with pillars for occlusion.
+	void fillMixedGrid(VoxelGrid &voxelGrid, std::vector<Int2> *doorVoxels)
+	{
+		const int gridSize = voxelGrid.getWidth();
+		const int gridCenter = gridSize / 2;
+		const uint16_t floorID = voxelGrid.addVoxelData(VoxelData::makeFloor(FLOOR_TEXTURE));
+		const uint16_t ceilingID = voxelGrid.addVoxelData(VoxelData::makeCeiling(CEILING_TEXTURE));
+		const uint16_t wallID = voxelGrid.addVoxelData(VoxelData::makeWall(WALL_TEXTURE,
+			WALL_TEXTURE, WALL_TEXTURE, nullptr, VoxelData::WallData::Type::Solid));
+		const uint16_t raisedID = voxelGrid.addVoxelData(VoxelData::makeRaised(RAISED_TEXTURE,
+			RAISED_TEXTURE, RAISED_TEXTURE, 0.25, 0.35, 0.20, 0.60));
+		const uint16_t diagonal1ID = voxelGrid.addVoxelData(
+			VoxelData::makeDiagonal(DIAGONAL_TEXTURE, true));
+		const uint16_t diagonal2ID = voxelGrid.addVoxelData(
+			VoxelData::makeDiagonal(DIAGONAL_TEXTURE, false));
+		const uint16_t transparentID = voxelGrid.addVoxelData(
+			VoxelData::makeTransparentWall(TRANSPARENT_TEXTURE, true));
+		const uint16_t edgeID = voxelGrid.addVoxelData(VoxelData::makeEdge(EDGE_TEXTURE, 0.40,
+			true, false, VoxelData::Facing::PositiveX));
+		const uint16_t dryChasmID = voxelGrid.addVoxelData(VoxelData::makeChasm(
+			DRY_CHASM_TEXTURE, true, true, true, true, VoxelData::ChasmData::Type::Dry));
+		const uint16_t wetChasmID = voxelGrid.addVoxelData(VoxelData::makeChasm(
+			WET_CHASM_TEXTURE, true, false, true, false, VoxelData::ChasmData::Type::Wet));
+		const std::vector<uint16_t> doorIDs =
+		{
+			voxelGrid.addVoxelData(VoxelData::makeDoor(DOOR_TEXTURE, VoxelData::DoorData::Type::Swinging)),
+			voxelGrid.addVoxelData(VoxelData::makeDoor(DOOR_TEXTURE, VoxelData::DoorData::Type::Sliding)),
+			voxelGrid.addVoxelData(VoxelData::makeDoor(DOOR_TEXTURE, VoxelData::DoorData::Type::Raising)),
+			voxelGrid.addVoxelData(VoxelData::makeDoor(DOOR_TEXTURE, VoxelData::DoorData::Type::Splitting))
+		};
+
+		for (int z = 0; z < gridSize; z++)
+		{
+			for (int x = 0; x < gridSize; x++)
+			{
+				voxelGrid.setVoxel(x, 0, z, floorID);
+
+				// Ceiling in a checkerboard of large blocks so the sky is visible in between.
+				if ((((x / 12) + (z / 12)) % 2) == 0)
+				{
+					voxelGrid.setVoxel(x, 2, z, ceilingID);
+				}
+
+				const bool isBorder = (x == 0) || (z == 0) ||
+					(x == (gridSize - 1)) || (z == (gridSize - 1));
+				const bool isClear = (x == gridCenter) || (z == gridCenter);
+				if (isBorder)
+				{
+					voxelGrid.setVoxel(x, 1, z, wallID);
+					continue;
+				}
+				else if (isClear)
+				{
+					continue;
+				}
+				else if (((x % 6) == 0) && ((z % 6) == 0))
+				{
+					voxelGrid.setVoxel(x, 1, z, wallID);
+					continue;
+				}
+
+				// Scatter the other voxel types with a fixed hash so every run is the same.
+				const int choice = static_cast<int>(getVoxelHash(x, z) % 41);
+				if (choice == 0)
+				{
+					voxelGrid.setVoxel(x, 1, z, raisedID);
+				}
+				else if (choice == 1)
+				{
+					voxelGrid.setVoxel(x, 1, z, diagonal1ID);
+				}
+				else if (choice == 2)
+				{
+					voxelGrid.setVoxel(x, 1, z, diagonal2ID);
+				}
+				else if (choice == 3)
+				{
+					voxelGrid.setVoxel(x, 1, z, transparentID);
+				}
+				else if (choice == 4)
+				{
+					voxelGrid.setVoxel(x, 1, z, edgeID);
+				}
+				else if (choice == 5)
+				{
+					voxelGrid.setVoxel(x, 0, z, dryChasmID);
+				}
+				else if (choice == 6)
+				{
+					voxelGrid.setVoxel(x, 0, z, wetChasmID);
+				}
+				else if ((choice >= 7) && (choice <= 10))
+				{
+					voxelGrid.setVoxel(x, 1, z, doorIDs.at(choice - 7));
+					doorVoxels->push_back(Int2(x, z));
+				}
+			}
+		}
+	}
+
+	// Fills a grid with open ground and a few ruins and towers, like the wilderness. Most of
+	// the space above the ground is empty.
+	void fillWildernessGrid(VoxelGrid &voxelGrid, std::vector<Int2> *doorVoxels)
+	{
+		const int gridSize = voxelGrid.getWidth();
+		const int gridCenter = gridSize / 2;
+		voxelGrid.addVoxelData(VoxelData());
+		const uint16_t floorID = voxelGrid.addVoxelData(VoxelData::makeFloor(FLOOR_TEXTURE));
+		const uint16_t wallID = voxelGrid.addVoxelData(VoxelData::makeWall(WALL_TEXTURE,
+			WALL_TEXTURE, WALL_TEXTURE, nullptr, VoxelData::WallData::Type::Solid));
+		const uint16_t raisedID = voxelGrid.addVoxelData(VoxelData::makeRaised(RAISED_TEXTURE,
+			RAISED_TEXTURE, RAISED_TEXTURE, 0.25, 0.35, 0.20, 0.60));
+
+		for (int z = 0; z < gridSize; z++)
+		{
+			for (int x = 0; x < gridSize; x++)
+			{
+				voxelGrid.setVoxel(x, 0, z, floorID);
+
+				const bool isClear = (x == gridCenter) || (z == gridCenter);
+				if (isClear)
+				{
+					continue;
+				}
+
+				const int choice = static_cast<int>(getVoxelHash(x, z) % 211);
+				if (choice < 3)
+				{
+					voxelGrid.setVoxel(x, 1, z, wallID);
+				}
+				else if (choice == 3)
+				{
+					voxelGrid.setVoxel(x, 1, z, raisedID);
+				}
+				else if (choice == 4)
+				{
+					for (int y = 1; y < voxelGrid.getHeight(); y++)
+					{
+						voxelGrid.setVoxel(x, y, z, wallID);
+					}
+				}
+			}
+		}
+	}
+
+	// Fills a grid with blocks of buildings of different heights separated by streets, with
+	// a wall around the edge, like a city.
+	void fillCityGrid(VoxelGrid &voxelGrid, std::vector<Int2> *doorVoxels)
+	{
+		const int gridSize = voxelGrid.getWidth();
+		const int gridCenter = gridSize / 2;
+		const int blockSize = 12; // Buildings and the street on two sides of them.
+		const int streetWidth = 3;
+		voxelGrid.addVoxelData(VoxelData());
+		const uint16_t floorID = voxelGrid.addVoxelData(VoxelData::makeFloor(FLOOR_TEXTURE));
+		const uint16_t wallID = voxelGrid.addVoxelData(VoxelData::makeWall(WALL_TEXTURE,
+			WALL_TEXTURE, WALL_TEXTURE, nullptr, VoxelData::WallData::Type::Solid));
+		const uint16_t ceilingID = voxelGrid.addVoxelData(VoxelData::makeCeiling(CEILING_TEXTURE));
+
+		for (int z = 0; z < gridSize; z++)
+		{
+			for (int x = 0; x < gridSize; x++)
+			{
+				voxelGrid.setVoxel(x, 0, z, floorID);
+
+				const bool isBorder = (x == 0) || (z == 0) ||
+					(x == (gridSize - 1)) || (z == (gridSize - 1));
+				const bool isClear = (x == gridCenter) || (z == gridCenter);
+				const bool isStreet = ((x % blockSize) < streetWidth) ||
+					((z % blockSize) < streetWidth);
+				if (isBorder)
+				{
+					voxelGrid.setVoxel(x, 1, z, wallID);
+					voxelGrid.setVoxel(x, 2, z, wallID);
+					continue;
+				}
+				else if (isClear || isStreet)
+				{
+					continue;
+				}
+
+				// Buildings in the same block have the same height, with a roof on top.
+				const int buildingHeight = 1 + static_cast<int>(
+					getVoxelHash(x / blockSize, z / blockSize) % 3);
+				for (int y = 1; y <= buildingHeight; y++)
+				{
+					voxelGrid.setVoxel(x, y, z, wallID);
+				}
+
+				if ((buildingHeight + 1) < voxelGrid.getHeight())
+				{
+					voxelGrid.setVoxel(x, buildingHeight + 1, z, ceilingID);
+				}
+			}
+		}
+	}
+
+	// Fills a grid with square rooms separated by walls, with a door in the middle of each
+	// wall and a ceiling over everything, like an interior. Only some doors open and close;
+	// the rest stay closed.
+	void fillDungeonGrid(VoxelGrid &voxelGrid, std::vector<Int2> *doorVoxels)
+	{
+		const int gridSize = voxelGrid.getWidth();
+		const int gridCenter = gridSize / 2;
+		const int roomSize = 8; // Room and the wall on one side of it.
+		voxelGrid.addVoxelData(VoxelData());
+		const uint16_t floorID = voxelGrid.addVoxelData(VoxelData::makeFloor(FLOOR_TEXTURE));
+		const uint16_t ceilingID = voxelGrid.addVoxelData(VoxelData::makeCeiling(CEILING_TEXTURE));
+		const uint16_t wallID = voxelGrid.addVoxelData(VoxelData::makeWall(WALL_TEXTURE,
+			WALL_TEXTURE, WALL_TEXTURE, nullptr, VoxelData::WallData::Type::Solid));
+		const uint16_t raisedID = voxelGrid.addVoxelData(VoxelData::makeRaised(RAISED_TEXTURE,
+			RAISED_TEXTURE, RAISED_TEXTURE, 0.25, 0.35, 0.20, 0.60));
+		const uint16_t doorID = voxelGrid.addVoxelData(VoxelData::makeDoor(SOLID_DOOR_TEXTURE,
+			VoxelData::DoorData::Type::Swinging));
+
+		for (int z = 0; z < gridSize; z++)
+		{
+			for (int x = 0; x < gridSize; x++)
+			{
+				voxelGrid.setVoxel(x, 0, z, floorID);
+				voxelGrid.setVoxel(x, 2, z, ceilingID);
+
+				const bool isBorder = (x == 0) || (z == 0) ||
+					(x == (gridSize - 1)) || (z == (gridSize - 1));
+				const bool isClear = (x == gridCenter) || (z == gridCenter);
+				const bool isWallX = (x % roomSize) == 0;
+				const bool isWallZ = (z % roomSize) == 0;
+				if (isBorder)
+				{
+					voxelGrid.setVoxel(x, 1, z, wallID);
+					continue;
+				}
+				else if (isClear)
+				{
+					continue;
+				}
+				else if (isWallX != isWallZ)
+				{
+					const int wallOffset = isWallX ? (z % roomSize) : (x % roomSize);
+					if (wallOffset == (roomSize / 2))
+					{
+						voxelGrid.setVoxel(x, 1, z, doorID);
+						if ((getVoxelHash(x, z) % 4) == 0)
+						{
+							doorVoxels->push_back(Int2(x, z));
+						}
+					}
+					else
+					{
+						voxelGrid.setVoxel(x, 1, z, wallID);
+					}
+				}
+				else if (isWallX && isWallZ)
+				{
+					voxelGrid.setVoxel(x, 1, z, wallID);
+				}
+				else if ((getVoxelHash(x, z) % 23) == 0)
+				{
+					voxelGrid.setVoxel(x, 1, z, raisedID);
+				}
+			}
+		}
+	}
+
+	const std::vector<Scene> Scenes =
+	{
+		{ "mixed", 64, 3, fillMixedGrid, false },
+		{ "wilderness", 128, 6, fillWildernessGrid, false },
+		{ "city", 128, 6, fillCityGrid, false },
+		{ "dungeon", 128, 3, fillDungeonGrid, true }
+	};
+
+	// Gives textures, flats, and distant sky objects to the renderer. The surfaces must
+	// outlive the distant sky.
+	void initScene(int gridSize, int flatSpacing, SoftwareRenderer &renderer,
+		std::vector<Surface> &skySurfaces, DistantSky &distantSky)
+	{
+		for (int i = 0; i < VOXEL_TEXTURE_COUNT; i++)
+		{
+			const bool transparent = (i == TRANSPARENT_TEXTURE) || (i == EDGE_TEXTURE) ||
+				(i == DOOR_TEXTURE);
+			const Surface surface = makeTexture(64, 64, i, transparent);
+			renderer.setVoxelTexture(i, static_cast<const uint32_t*>(surface.getPixels()));
+		}
+
+		for (int i = 0; i < FLAT_TEXTURE_COUNT; i++)
+		{
+			const Surface surface = makeTexture(32 + (i * 8), 48 + (i * 4), 100 + i, true);
+			renderer.setFlatTexture(i, static_cast<const uint32_t*>(surface.getPixels()),
+				surface.getWidth(), surface.getHeight());
+		}
+
+		// Flats in a regular pattern, away from the camera's row and column.
+		int flatID = 0;
+		for (int z = 2; z < (gridSize - 2); z += flatSpacing)
+		{
+			for (int x = 2; x < (gridSize - 2); x += flatSpacing)
+			{
+				const Double3 position(static_cast<double>(x) + 0.50, 1.0,
+					static_cast<double>(z) + 0.50);
+				renderer.addFlat(flatID, position, 0.60, 0.80, flatID % FLAT_TEXTURE_COUNT);
+				flatID++;
+			}
+		}
+
+		// Sky gradient from dark to light and back over the day.
+		std::vector<uint32_t> skyColors(64);
+		for (size_t i = 0; i < skyColors.size(); i++)
+		{
+			const double percent = static_cast<double>(i) / static_cast<double>(skyColors.size());
+			const uint32_t brightness = static_cast<uint32_t>(std::sin(percent * Constants::Pi) * 200.0);
+			skyColors[i] = 0xFF000000 | ((brightness / 2) << 16) | ((brightness * 3 / 4) << 8) |
+				std::min(brightness + 40u, 255u);
+		}
+
+		renderer.setSkyPalette(skyColors.data(), static_cast<int>(skyColors.size()));
+
+		// Mountains, an animated volcano, clouds, and a sun. Space objects aren't drawn yet.
+		for (int i = 0; i < 12; i++)
+		{
+			skySurfaces.push_back(makeTexture(40 + (i * 3), 20 + i, 200 + i, true));
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			const double angle = static_cast<double>(i) * (Constants::TwoPi / 6.0);
+			distantSky.addLandObject(DistantSky::LandObject(skySurfaces.at(i), angle));
+		}
+
+		DistantSky::AnimatedLandObject animLandObject(2.0);
+		animLandObject.addSurface(skySurfaces.at(6));
+		animLandObject.addSurface(skySurfaces.at(7));
+		distantSky.addAnimatedLandObject(std::move(animLandObject));
+
+		for (int i = 8; i < 11; i++)
+		{
+			const double angle = static_cast<double>(i) * 0.70;
+			distantSky.addAirObject(DistantSky::AirObject(skySurfaces.at(i), angle, 0.30));
+		}
+
+		distantSky.setSunSurface(skySurfaces.at(11));
+		renderer.setDistantSky(distantSky);
+		renderer.setFogDistance(FOG_DISTANCE);
+	}
+
+	// Parses a comma-separated list of positive integers.
+	std::vector<int> parseIntList(const std::string &str)
+	{
+		std::vector<int> values;
+		std::stringstream ss(str);
+		std::string token;
+		while (std::getline(ss, token, ','))
+		{
+			const int value = std::atoi(token.c_str());
+			if (value > 0)
+			{
+				values.push_back(value);
+			}
+		}
+
+		return values;
+	}
+
+	// Adds torches in a regular pattern, if any, with flickering colors. Static torches are
+	// baked into a lightmap, which is waited for so it's used in every timed frame. Static
+	// lights belong to the voxel grid, so this must be done after it's given to the renderer.
+	void addTorches(int gridSize, int lightSpacing, bool staticLights,
+		SoftwareRenderer &renderer)
+	{
+		if (lightSpacing <= 0)
+		{
+			return;
+		}
+
+		int lightID = 0;
+		for (int z = 3; z < (gridSize - 3); z += lightSpacing)
+		{
+			for (int x = 3; x < (gridSize - 3); x += lightSpacing)
+			{
+				const Double3 point(static_cast<double>(x) + 0.50, 1.60,
+					static_cast<double>(z) + 0.50);
+				const double flicker = static_cast<double>(getVoxelHash(x, z) % 32) / 160.0;
+				const Double3 color(0.80 + flicker, 0.50, 0.20);
+
+				if (staticLights)
+				{
+					renderer.addStaticLight(point, color, LIGHT_INTENSITY);
+				}
+				else
+				{
+					renderer.addLight(lightID, point, color, LIGHT_INTENSITY);
+					lightID++;
+				}
+			}
+		}
+
+		if (staticLights)
+		{
+			const auto bakeStart = std::chrono::high_resolution_clock::now();
+			renderer.bakeLightmap(CEILING_HEIGHT);
+			renderer.waitForLightmap();
+			const double bakeSeconds = std::chrono::duration<double>(
+				std::chrono::high_resolution_clock::now() - bakeStart).count();
+			std::cerr << "Lightmap bake: " << std::fixed << std::setprecision(1) <<
+				(bakeSeconds * 1000.0) << " ms" << '\n';
+		}
+	}
+
+	bool parseSettings(int argc, char *argv[], Settings *settings)
+	{
+		settings->scene = "mixed";
+		settings->width = 640;
+		settings->height = 400;
+		settings->frames = 120;
+		settings->flatSpacing = 5;
+		settings->lightSpacing = 0;
+		settings->staticLights = false;
+		settings->paletteShading = false;
+		settings->mipmapping = false;
+		settings->interleavedColumns = false;
+		settings->visibility = true;
+
+		const int hardwareThreads = Platform::getThreadCount();
+		settings->threadCounts = { 1 };
+		if (hardwareThreads > 1)
+		{
+			settings->threadCounts.push_back(hardwareThreads);
+		}
+
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg(argv[i]);
+			const bool hasValue = (i + 1) < argc;
+			if ((arg == "--scene") && hasValue)
+			{
+				settings->scene = argv[++i];
+			}
+			else if ((arg == "--width") && hasValue)
+			{
+				settings->width = std::atoi(argv[++i]);
+			}
+			else if ((arg == "--height") && hasValue)
+			{
+				settings->height = std::atoi(argv[++i]);
+			}
+			else if ((arg == "--threads") && hasValue)
+			{
+				settings->threadCounts = parseIntList(argv[++i]);
+			}
+			else if ((arg == "--frames") && hasValue)
+			{
+				settings->frames = std::atoi(argv[++i]);
+			}
+			else if ((arg == "--flat-spacing") && hasValue)
+			{
+				settings->flatSpacing = std::atoi(argv[++i]);
+			}
+			else if ((arg == "--light-spacing") && hasValue)
+			{
+				settings->lightSpacing = std::atoi(argv[++i]);
+			}
+			else if (arg == "--static-lights")
+			{
+				settings->staticLights = true;
+			}
+			else if (arg == "--palette")
+			{
+				settings->paletteShading = true;
+			}
+			else if (arg == "--mipmaps")
+			{
+				settings->mipmapping = true;
+			}
+			else if (arg == "--interleaved")
+			{
+				settings->interleavedColumns = true;
+			}
+			else if (arg == "--no-visibility")
+			{
+				settings->visibility = false;
+			}
+			else
+			{
+				std::cerr << "Unrecognized argument \"" << arg << "\"." << '\n';
+				return false;
+			}
+		}
+
+		return (settings->width > 0) && (settings->height > 0) && (settings->frames > 0) &&
+			(settings->flatSpacing > 0) && (settings->lightSpacing >= 0) &&
+			(settings->threadCounts.size() > 0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Settings settings;
+	if (!parseSettings(argc, argv, &settings))
+	{
+		std::cerr << "Usage: RendererBenchmark [--scene mixed|wilderness|city|dungeon] " <<
+			"[--width n] [--height n] " <<
+			"[--threads n,n,...] [--frames n] [--flat-spacing n] [--light-spacing n] " <<
+			"[--static-lights] [--palette] [--mipmaps] [--interleaved] [--no-visibility]" << '\n';
+		return 1;
+	}
+
+	const auto sceneIter = std::find_if(Scenes.begin(), Scenes.end(),
+		[&settings](const Scene &scene)
+	{
+		return settings.scene == scene.name;
+	});
+
+	if (sceneIter == Scenes.end())
+	{
+		std::cerr << "Unrecognized scene \"" << settings.scene << "\"." << '\n';
+		return 1;
+	}
+
+	const Scene &scene = *sceneIter;
+	VoxelGrid voxelGrid(scene.gridSize, scene.gridHeight, scene.gridSize);
+	std::vector<Int2> doorVoxels;
+	scene.fillVoxelGrid(voxelGrid, &doorVoxels);
+
+	SoftwareRenderer renderer;
+	renderer.init(settings.width, settings.height, 0);
+
+	std::vector<Surface> skySurfaces;
+	DistantSky distantSky;
+	initScene(scene.gridSize, settings.flatSpacing, renderer, skySurfaces, distantSky);
+	renderer.setVoxelGrid(voxelGrid);
+	addTorches(scene.gridSize, settings.lightSpacing, settings.staticLights, renderer);
+
+	// A light ahead of the camera, like a spell, so the light grid is updated every frame.
+	const int movingLightID = -1;
+	if (settings.lightSpacing > 0)
+	{
+		renderer.addLight(movingLightID, Double3::Zero, Double3(0.30, 0.40, 0.90),
+			LIGHT_INTENSITY);
+	}
+
+	// Build the visible set up front so it's used in every timed frame.
+	if (scene.interior && settings.visibility)
+	{
+		const auto visibilityStart = std::chrono::high_resolution_clock::now();
+		renderer.buildVisibility();
+		renderer.waitForVisibility();
+		const double visibilitySeconds = std::chrono::duration<double>(
+			std::chrono::high_resolution_clock::now() - visibilityStart).count();
+		std::cerr << "Visibility build: " << std::fixed << std::setprecision(1) <<
+			(visibilitySeconds * 1000.0) << " ms" << '\n';
+	}
+
+	std::vector<uint32_t> colorBuffer(settings.width * settings.height);
+	LevelData::OpenDoors openDoors(scene.gridSize, scene.gridSize);
+
+	std::cout << "scene,path,width,height,threads,frames,fps,ms_per_frame,sky_gradient_ms," <<
+		"distant_sky_ms,voxels_ms,flats_ms,visible_flats_ms,thread_busy_percent" << '\n';
+
+	for (const int threadCount : settings.threadCounts)
+	{
+		renderer.setRenderThreadCount(threadCount);
+
+		for (const CameraPath &path : CameraPaths)
+		{
+			SoftwareRenderer::PhaseTimings totalTimings;
+			std::vector<double> totalBusyPercents(threadCount, 0.0);
+			double totalSeconds = 0.0;
+
+			const int totalFrames = WARMUP_FRAMES + settings.frames;
+			for (int frame = 0; frame < totalFrames; frame++)
+			{
+				const double percent = static_cast<double>(frame) /
+					static_cast<double>(totalFrames);
+				Double3 eye, direction;
+				path.getCamera(percent, scene.gridSize, &eye, &direction);
+
+				if (settings.lightSpacing > 0)
+				{
+					const Double3 lightPoint = eye + (direction.normalized() * 1.50);
+					renderer.updateLight(movingLightID, &lightPoint, nullptr, nullptr);
+				}
+
+				// Doors open and close over the path.
+				openDoors.clear();
+				const double percentOpen = 0.50 + (0.45 * std::sin(percent * Constants::TwoPi * 4.0));
+				for (const Int2 &voxel : doorVoxels)
+				{
+					openDoors.add(LevelData::DoorState(voxel, percentOpen,
+						LevelData::DoorState::Direction::Opening));
+				}
+
+				const auto frameStart = std::chrono::high_resolution_clock::now();
+				renderer.render(eye, direction, VERTICAL_FOV, 0.80, path.daytimePercent,
+					true, settings.paletteShading, settings.mipmapping, settings.interleavedColumns,
+					CEILING_HEIGHT, openDoors, voxelGrid, colorBuffer.data());
+				const double frameSeconds = std::chrono::duration<double>(
+					std::chrono::high_resolution_clock::now() - frameStart).count();
+
+				if (frame < WARMUP_FRAMES)
+				{
+					continue;
+				}
+
+				totalSeconds += frameSeconds;
+
+				const SoftwareRenderer::PhaseTimings &timings = renderer.getPhaseTimings();
+				totalTimings.skyGradient += timings.skyGradient;
+				totalTimings.distantSky += timings.distantSky;
+				totalTimings.voxels += timings.voxels;
+				totalTimings.flats += timings.flats;
+				totalTimings.visibleFlats += timings.visibleFlats;
+
+				const auto &threadStats = renderer.getRenderThreadStats();
+				for (size_t i = 0; i < threadStats.size(); i++)
+				{
+					const double threadSeconds = threadStats[i].busySeconds + threadStats[i].idleSeconds;
+					if (threadSeconds > 0.0)
+					{
+						totalBusyPercents[i] += (threadStats[i].busySeconds / threadSeconds) * 100.0;
+					}
+				}
+			}
+
+			const double frameCount = static_cast<double>(settings.frames);
+			auto toAverageMs = [frameCount](double seconds)
+			{
+				return (seconds / frameCount) * 1000.0;
+			};
+
+			std::string busyPercents;
+			for (const double totalBusyPercent : totalBusyPercents)
+			{
+				std::stringstream ss;
+				ss << std::fixed << std::setprecision(1) << (totalBusyPercent / frameCount);
+				busyPercents += (busyPercents.empty() ? "" : ";") + ss.str();
+			}
+
+			std::cout << std::fixed << std::setprecision(3) << scene.name << ',' <<
+				path.name << ',' << settings.width << ',' << settings.height << ',' <<
+				threadCount << ',' << settings.frames << ',' <<
+				(frameCount / totalSeconds) << ',' << toAverageMs(totalSeconds) << ',' <<
+				toAverageMs(totalTimings.skyGradient) << ',' <<
+				toAverageMs(totalTimings.distantSky) << ',' <<
+				toAverageMs(totalTimings.voxels) << ',' <<
+				toAverageMs(totalTimings.flats) << ',' <<
+				toAverageMs(totalTimings.visibleFlats) << ',' << busyPercents << '\n';
+		}
+	}
+
+	return 0;
+}
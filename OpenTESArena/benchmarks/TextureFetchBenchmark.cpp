@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Measures fetching texels down single texel columns of 64x64 textures, the way the software
+// renderer draws walls and flats, with row-major and column-major texel storage. Each drawn
+// column picks a random texture and texel column. Taller columns are like nearby walls
+// (several pixels per texel) and shorter ones are like distant walls (several texels per pixel).
+
+// Usage: TextureFetchBenchmark [columns] [textures]
+
+namespace
+{
+	const int TEXTURE_WIDTH = 64;
+	const int TEXTURE_HEIGHT = TEXTURE_WIDTH;
+	const int TEXEL_COUNT = TEXTURE_WIDTH * TEXTURE_HEIGHT;
+
+	// A column of pixels to draw with one texel column of a texture.
+	struct Column
+	{
+		int textureID, textureX, height;
+	};
+
+	// Gets the average nanoseconds per texel fetched. Texels are summed so the fetches
+	// can't be optimized away.
+	template <bool ColumnMajor>
+	double measure(const std::vector<uint32_t> &texels, const std::vector<Column> &columns,
+		uint32_t *checksum)
+	{
+		uint32_t sum = 0;
+		int64_t texelCount = 0;
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		for (const Column &column : columns)
+		{
+			const uint32_t *texture = texels.data() + (column.textureID * TEXEL_COUNT);
+			const double heightReal = static_cast<double>(column.height);
+
+			for (int y = 0; y < column.height; y++)
+			{
+				const double v = (static_cast<double>(y) + 0.50) / heightReal;
+				const int textureY = static_cast<int>(v * static_cast<double>(TEXTURE_HEIGHT));
+				const int textureIndex = ColumnMajor ?
+					(textureY + (column.textureX * TEXTURE_HEIGHT)) :
+					(column.textureX + (textureY * TEXTURE_WIDTH));
+				sum += texture[textureIndex];
+			}
+
+			texelCount += column.height;
+		}
+
+		const auto end = std::chrono::high_resolution_clock::now();
+		*checksum += sum;
+
+		const double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+		return nanoseconds / static_cast<double>(texelCount);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const int columnCount = (argc > 1) ? std::max(std::atoi(argv[1]), 1) : 200000;
+
+	// By default, enough textures that they don't all fit in a typical L2 cache, like a
+	// level's walls, floors, and flats together.
+	const int textureCount = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 256;
+	const std::vector<int> heights = { 8, 32, 64, 128, 400 };
+
+	std::mt19937 random(12345);
+
+	// Same texels in both layouts.
+	std::vector<uint32_t> rowMajorTexels(textureCount * TEXEL_COUNT);
+	std::vector<uint32_t> columnMajorTexels(rowMajorTexels.size());
+	for (int i = 0; i < textureCount; i++)
+	{
+		for (int y = 0; y < TEXTURE_HEIGHT; y++)
+		{
+			for (int x = 0; x < TEXTURE_WIDTH; x++)
+			{
+				const uint32_t texel = random();
+				rowMajorTexels[(i * TEXEL_COUNT) + x + (y * TEXTURE_WIDTH)] = texel;
+				columnMajorTexels[(i * TEXEL_COUNT) + y + (x * TEXTURE_HEIGHT)] = texel;
+			}
+		}
+	}
+
+	std::cout << "Columns: " << columnCount << '\n';
+	std::cout << "Textures: " << textureCount << '\n';
+	std::cout << "column_height,row_major_ns,column_major_ns" << '\n';
+
+	uint32_t checksum = 0;
+	for (const int height : heights)
+	{
+		std::vector<Column> columns(columnCount);
+		for (Column &column : columns)
+		{
+			column.textureID = static_cast<int>(random() % textureCount);
+			column.textureX = static_cast<int>(random() % TEXTURE_WIDTH);
+			column.height = height;
+		}
+
+		const double rowMajorTime = measure<false>(rowMajorTexels, columns, &checksum);
+		const double columnMajorTime = measure<true>(columnMajorTexels, columns, &checksum);
+		std::cout << height << ',' << std::fixed << std::setprecision(2) <<
+			rowMajorTime << ',' << columnMajorTime << '\n';
+	}
+
+	// Printed so the sums are used.
+	std::cout << "Checksum: " << checksum << '\n';
+
+	return 0;
+}
@@ -1036,6 +1036,11 @@ int INFFile::getMenuIndex(int textureID) const
 		static_cast<int>(std::distance(this->menus.begin(), iter)) : -1;
 }
 
+int INFFile::getFlatCount() const
+{
+	return static_cast<int>(this->flats.size());
+}
+
 const INFFile::FlatData &INFFile::getFlat(int index) const
 {
 	return this->flats.at(index);
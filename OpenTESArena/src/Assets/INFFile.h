@@ -154,6 +154,7 @@ public:
 	const int *getBoxSide(int index) const;
 	const int *getMenu(int index) const;
 	int getMenuIndex(int textureID) const; // Temporary hack?
+	int getFlatCount() const;
 	const FlatData &getFlat(int index) const;
 	const FlatData &getItem(int index) const;
 	const std::string &getSound(int index) const;
@@ -273,17 +273,7 @@ void Player::handleCollision(const WorldData &worldData, double dt)
 					const VoxelData::DoorData &doorData = voxelData.door;
 
 					// Only collide with a door voxel if the door is closed.
-					const bool isClosed = [&voxel, &openDoors]()
-					{
-						const Int2 voxelXZ(voxel.x, voxel.z);
-						const auto iter = std::find_if(openDoors.begin(), openDoors.end(),
-							[&voxelXZ](const LevelData::DoorState &openDoor)
-						{
-							return openDoor.getVoxel() == voxelXZ;
-						});
-
-						return iter == openDoors.end();
-					}();
+					const bool isClosed = openDoors.find(Int2(voxel.x, voxel.z)) == nullptr;
 
 					return !isClosed;
 				}
@@ -22,8 +22,15 @@ namespace
 		{ "Fullscreen", OptionType::Bool },
 		{ "TargetFPS", OptionType::Int },
 		{ "ResolutionScale", OptionType::Double },
+		{ "DynamicResolution", OptionType::Bool },
+		{ "MinResolutionScale", OptionType::Double },
+		{ "MaxResolutionScale", OptionType::Double },
 		{ "VerticalFOV", OptionType::Double },
 		{ "ParallaxSky", OptionType::Bool },
+		{ "PaletteShading", OptionType::Bool },
+		{ "Mipmapping", OptionType::Bool },
+		{ "InterleavedColumns", OptionType::Bool },
+		{ "PipelinedRendering", OptionType::Bool },
 		{ "LetterboxMode", OptionType::Int },
 		{ "CursorScale", OptionType::Double },
 		{ "ModernInterface", OptionType::Bool },
@@ -53,6 +60,7 @@ namespace
 		{ "Collision", OptionType::Bool },
 		{ "SkipIntro", OptionType::Bool },
 		{ "ShowDebug", OptionType::Bool },
+		{ "LogRenderTimings", OptionType::Bool },
 		{ "ShowCompass", OptionType::Bool },
 		{ "TimeScale", OptionType::Double }
 	};
@@ -464,6 +472,26 @@ void Options::checkGraphics_ResolutionScale(double value) const
 		String::fixedPrecision(Options::MAX_RESOLUTION_SCALE, 2) + ".");
 }
 
+void Options::checkGraphics_MinResolutionScale(double value) const
+{
+	DebugAssertMsg(value >= Options::MIN_RESOLUTION_SCALE,
+		"Min resolution scale cannot be less than " +
+		String::fixedPrecision(Options::MIN_RESOLUTION_SCALE, 2) + ".");
+	DebugAssertMsg(value <= Options::MAX_RESOLUTION_SCALE,
+		"Min resolution scale cannot be greater than " +
+		String::fixedPrecision(Options::MAX_RESOLUTION_SCALE, 2) + ".");
+}
+
+void Options::checkGraphics_MaxResolutionScale(double value) const
+{
+	DebugAssertMsg(value >= Options::MIN_RESOLUTION_SCALE,
+		"Max resolution scale cannot be less than " +
+		String::fixedPrecision(Options::MIN_RESOLUTION_SCALE, 2) + ".");
+	DebugAssertMsg(value <= Options::MAX_RESOLUTION_SCALE,
+		"Max resolution scale cannot be greater than " +
+		String::fixedPrecision(Options::MAX_RESOLUTION_SCALE, 2) + ".");
+}
+
 void Options::checkGraphics_VerticalFOV(double value) const
 {
 	DebugAssertMsg(value >= Options::MIN_VERTICAL_FOV, "Vertical FOV cannot be less than " +
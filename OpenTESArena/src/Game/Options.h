@@ -135,8 +135,15 @@ void set##section##_##name(const std::string &value) \
 	OPTION_BOOL(Graphics, Fullscreen)
 	OPTION_INT(Graphics, TargetFPS)
 	OPTION_DOUBLE(Graphics, ResolutionScale)
+	OPTION_BOOL(Graphics, DynamicResolution)
+	OPTION_DOUBLE(Graphics, MinResolutionScale)
+	OPTION_DOUBLE(Graphics, MaxResolutionScale)
 	OPTION_DOUBLE(Graphics, VerticalFOV)
 	OPTION_BOOL(Graphics, ParallaxSky)
+	OPTION_BOOL(Graphics, PaletteShading)
+	OPTION_BOOL(Graphics, Mipmapping)
+	OPTION_BOOL(Graphics, InterleavedColumns)
+	OPTION_BOOL(Graphics, PipelinedRendering)
 	OPTION_INT(Graphics, LetterboxMode)
 	OPTION_DOUBLE(Graphics, CursorScale)
 	OPTION_BOOL(Graphics, ModernInterface)
@@ -157,6 +164,7 @@ void set##section##_##name(const std::string &value) \
 	OPTION_BOOL(Misc, Collision)
 	OPTION_BOOL(Misc, SkipIntro)
 	OPTION_BOOL(Misc, ShowDebug)
+	OPTION_BOOL(Misc, LogRenderTimings)
 	OPTION_BOOL(Misc, ShowCompass)
 	OPTION_DOUBLE(Misc, TimeScale)
 
@@ -1433,21 +1433,12 @@ void GameWorldPanel::handleClickInWorld(const Int2 &nativePoint, bool primaryCli
 
 					// If the door is closed, then open it.
 					auto &openDoors = level.getOpenDoors();
-					const bool isClosed = [&openDoors, &voxelXZ]()
-					{
-						const auto iter = std::find_if(openDoors.begin(), openDoors.end(),
-							[&voxelXZ](const LevelData::DoorState &openDoor)
-						{
-							return openDoor.getVoxel() == voxelXZ;
-						});
-
-						return iter == openDoors.end();
-					}();
+					const bool isClosed = openDoors.find(voxelXZ) == nullptr;
 
 					if (isClosed)
 					{
 						// Add the door to the open doors list.
-						openDoors.push_back(LevelData::DoorState(voxelXZ));
+						openDoors.add(LevelData::DoorState(voxelXZ));
 
 						// Get the door's opening sound index and play it.
 						const int soundIndex = doorData.getOpenSoundIndex();
@@ -1628,11 +1619,11 @@ void GameWorldPanel::handleDoors(double dt, const Double2 &playerPos)
 		}
 	};
 
-	// Update each open door and remove ones that become closed. A reverse iterator loop
-	// was causing increment issues after erasing.
-	for (int i = static_cast<int>(openDoors.size()) - 1; i >= 0; i--)
+	// Update each open door and remove ones that become closed. Removing moves the last
+	// door into the removed one's place, which has already been updated.
+	for (int i = openDoors.getCount() - 1; i >= 0; i--)
 	{
-		auto &door = openDoors.at(i);
+		auto &door = openDoors.get(i);
 		door.update(dt);
 
 		// Get the door's voxel data and its close sound data for determining how it plays
@@ -1649,7 +1640,7 @@ void GameWorldPanel::handleDoors(double dt, const Double2 &playerPos)
 			playSoundIfType(closeSoundData, VoxelData::DoorData::CloseSoundType::OnClosed);
 
 			// Erase closed door.
-			openDoors.erase(openDoors.begin() + i);
+			openDoors.remove(i);
 		}
 		else if (!door.isClosing())
 		{
@@ -2025,7 +2016,7 @@ void GameWorldPanel::drawDebugText(Renderer &renderer)
 	const Int2 windowDims = renderer.getWindowDimensions();
 
 	auto &game = this->getGame();
-	const double resolutionScale = game.getOptions().getGraphics_ResolutionScale();
+	const double resolutionScale = renderer.getResolutionScale();
 
 	auto &gameData = game.getGameData();
 	const auto &player = gameData.getPlayer();
@@ -2035,10 +2026,37 @@ void GameWorldPanel::drawDebugText(Renderer &renderer)
 	const auto &worldData = gameData.getWorldData();
 	const auto &level = worldData.getActiveLevel();
 
+	// Percent of the last frame each render thread spent drawing instead of waiting.
+	std::string threadLoads;
+	for (const auto &stats : renderer.getRenderThreadStats())
+	{
+		const double totalSeconds = stats.busySeconds + stats.idleSeconds;
+		const double busyPercent = (totalSeconds > 0.0) ?
+			((stats.busySeconds / totalSeconds) * 100.0) : 0.0;
+		threadLoads += (threadLoads.empty() ? "" : " ") +
+			std::to_string(static_cast<int>(std::round(busyPercent))) + "%";
+	}
+
+	// Average and max milliseconds of each game world stage over recent frames.
+	const RenderTimings &renderTimings = renderer.getRenderTimings();
+	std::string stageTimings;
+	for (int i = 0; i < RenderTimings::STAGE_COUNT; i++)
+	{
+		const RenderTimings::Stage stage = static_cast<RenderTimings::Stage>(i);
+		stageTimings += std::string(RenderTimings::getStageName(stage)) + ": " +
+			String::fixedPrecision(renderTimings.getAverage(stage) * 1000.0, 2) + " / " +
+			String::fixedPrecision(renderTimings.getMax(stage) * 1000.0, 2) + " ms\n";
+	}
+
 	const std::string text =
 		"Screen: " + std::to_string(windowDims.x) + "x" + std::to_string(windowDims.y) + "\n" +
 		"Resolution scale: " + String::fixedPrecision(resolutionScale, 2) + "\n" +
 		"FPS: " + String::fixedPrecision(game.getFPSCounter().getFPS(), 1) + "\n" +
+		"Render threads busy: " + threadLoads + "\n" +
+		"World frame latency: " + String::fixedPrecision(
+			renderer.getWorldFrameLatency() * 1000.0, 1) + " ms\n" +
+		"Skipped world frames: " + std::to_string(renderer.getSkippedWorldFrameCount()) + "\n" +
+		"Stage timings (avg / max):\n" + stageTimings +
 		"Map: " + worldData.getMifName() + "\n" +
 		"Info: " + level.getInfFile().getName() + "\n" +
 		"X: " + String::fixedPrecision(position.x, 5) + "\n" +
@@ -2243,9 +2261,17 @@ void GameWorldPanel::render(Renderer &renderer)
 		}
 	}();
 
+	renderer.setRenderTimingsLogging(options.getMisc_LogRenderTimings());
+	renderer.setDynamicResolution(options.getGraphics_DynamicResolution(),
+		options.getGraphics_MinResolutionScale(), options.getGraphics_MaxResolutionScale(),
+		options.getGraphics_TargetFPS());
 	renderer.renderWorld(player.getPosition(), player.getDirection(),
 		options.getGraphics_VerticalFOV(), ambientPercent, gameData.getDaytimePercent(), 
-		options.getGraphics_ParallaxSky(), level.getCeilingHeight(), level.getOpenDoors(), level.getVoxelGrid());
+		options.getGraphics_ParallaxSky(), options.getGraphics_PaletteShading(),
+		options.getGraphics_Mipmapping(), options.getGraphics_InterleavedColumns(),
+		options.getGraphics_PipelinedRendering(),
+		level.getCeilingHeight(),
+		level.getOpenDoors(), level.getVoxelGrid());
 
 	auto &textureManager = this->getGame().getTextureManager();
 	textureManager.setPalette(PaletteFile::fromName(PaletteName::Default));
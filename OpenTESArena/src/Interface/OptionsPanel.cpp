@@ -220,11 +220,16 @@ const std::string OptionsPanel::DEV_TAB_NAME = "Dev";
 
 // Graphics.
 const std::string OptionsPanel::CURSOR_SCALE_NAME = "Cursor Scale";
+const std::string OptionsPanel::DYNAMIC_RESOLUTION_NAME = "Dynamic Resolution";
 const std::string OptionsPanel::FPS_LIMIT_NAME = "FPS Limit";
 const std::string OptionsPanel::FULLSCREEN_NAME = "Fullscreen";
+const std::string OptionsPanel::INTERLEAVED_COLUMNS_NAME = "Interleaved Columns";
 const std::string OptionsPanel::LETTERBOX_MODE_NAME = "Letterbox Mode";
+const std::string OptionsPanel::MIPMAPPING_NAME = "Mipmapping";
 const std::string OptionsPanel::MODERN_INTERFACE_NAME = "Modern Interface";
+const std::string OptionsPanel::PALETTE_SHADING_NAME = "Palette Shading";
 const std::string OptionsPanel::PARALLAX_SKY_NAME = "Parallax Sky";
+const std::string OptionsPanel::PIPELINED_RENDERING_NAME = "Pipelined Rendering";
 const std::string OptionsPanel::RENDER_THREADS_MODE_NAME = "Render Threads Mode";
 const std::string OptionsPanel::RESOLUTION_SCALE_NAME = "Resolution Scale";
 const std::string OptionsPanel::VERTICAL_FOV_NAME = "Vertical FOV";
@@ -246,6 +251,7 @@ const std::string OptionsPanel::TIME_SCALE_NAME = "Time Scale";
 // Dev.
 const std::string OptionsPanel::COLLISION_NAME = "Collision";
 const std::string OptionsPanel::SHOW_DEBUG_NAME = "Show Debug";
+const std::string OptionsPanel::LOG_RENDER_TIMINGS_NAME = "Log Render Timings";
 
 OptionsPanel::OptionsPanel(Game &game)
 	: Panel(game)
@@ -393,6 +399,17 @@ OptionsPanel::OptionsPanel(Game &game)
 			value, fullGameWindow);
 	}));
 
+	this->graphicsOptions.push_back(std::make_unique<BoolOption>(
+		OptionsPanel::DYNAMIC_RESOLUTION_NAME,
+		"Raises and lowers the resolution scale automatically to stay near\nthe FPS limit. The scale starts at the one chosen above.",
+		options.getGraphics_DynamicResolution(),
+		[this](bool value)
+	{
+		auto &game = this->getGame();
+		auto &options = game.getOptions();
+		options.setGraphics_DynamicResolution(value);
+	}));
+
 	this->graphicsOptions.push_back(std::make_unique<DoubleOption>(
 		OptionsPanel::VERTICAL_FOV_NAME,
 		"Recommended 60.0 for classic mode.",
@@ -419,6 +436,50 @@ OptionsPanel::OptionsPanel(Game &game)
 		options.setGraphics_ParallaxSky(value);
 	}));
 
+	this->graphicsOptions.push_back(std::make_unique<BoolOption>(
+		OptionsPanel::PALETTE_SHADING_NAME,
+		"Shades the game world with precomputed palette colors. This is\nfaster, but light and fog have slight banding.",
+		options.getGraphics_PaletteShading(),
+		[this](bool value)
+	{
+		auto &game = this->getGame();
+		auto &options = game.getOptions();
+		options.setGraphics_PaletteShading(value);
+	}));
+
+	this->graphicsOptions.push_back(std::make_unique<BoolOption>(
+		OptionsPanel::MIPMAPPING_NAME,
+		"Draws distant walls, floors, and flats with smaller copies of their\ntextures. This shimmers less and can be faster, but looks blurrier.",
+		options.getGraphics_Mipmapping(),
+		[this](bool value)
+	{
+		auto &game = this->getGame();
+		auto &options = game.getOptions();
+		options.setGraphics_Mipmapping(value);
+	}));
+
+	this->graphicsOptions.push_back(std::make_unique<BoolOption>(
+		OptionsPanel::INTERLEAVED_COLUMNS_NAME,
+		"Draws every other column of the game world each frame and fills\nin the rest. This is faster, but looks softer in motion.",
+		options.getGraphics_InterleavedColumns(),
+		[this](bool value)
+	{
+		auto &game = this->getGame();
+		auto &options = game.getOptions();
+		options.setGraphics_InterleavedColumns(value);
+	}));
+
+	this->graphicsOptions.push_back(std::make_unique<BoolOption>(
+		OptionsPanel::PIPELINED_RENDERING_NAME,
+		"Draws the next game world frame while the current one is shown.\nThis raises the frame rate but adds one frame of input lag.",
+		options.getGraphics_PipelinedRendering(),
+		[this](bool value)
+	{
+		auto &game = this->getGame();
+		auto &options = game.getOptions();
+		options.setGraphics_PipelinedRendering(value);
+	}));
+
 	auto letterboxModeOption = std::make_unique<IntOption>(
 		OptionsPanel::LETTERBOX_MODE_NAME,
 		"Determines the aspect ratio of the game UI. The weapon animation\nin modern mode is unaffected by this.",
@@ -652,6 +713,17 @@ OptionsPanel::OptionsPanel(Game &game)
 		options.setMisc_ShowDebug(value);
 	}));
 
+	this->devOptions.push_back(std::make_unique<BoolOption>(
+		OptionsPanel::LOG_RENDER_TIMINGS_NAME,
+		"Writes the game world render timings of every frame to\nrender-timings.csv in the log folder.",
+		options.getMisc_LogRenderTimings(),
+		[this](bool value)
+	{
+		auto &game = this->getGame();
+		auto &options = game.getOptions();
+		options.setMisc_LogRenderTimings(value);
+	}));
+
 	// Set initial tab.
 	this->tab = OptionsPanel::Tab::Graphics;
 
@@ -136,11 +136,16 @@ private:
 
 	// Graphics.
 	static const std::string CURSOR_SCALE_NAME;
+	static const std::string DYNAMIC_RESOLUTION_NAME;
 	static const std::string FPS_LIMIT_NAME;
 	static const std::string FULLSCREEN_NAME;
+	static const std::string INTERLEAVED_COLUMNS_NAME;
 	static const std::string LETTERBOX_MODE_NAME;
+	static const std::string MIPMAPPING_NAME;
 	static const std::string MODERN_INTERFACE_NAME;
+	static const std::string PALETTE_SHADING_NAME;
 	static const std::string PARALLAX_SKY_NAME;
+	static const std::string PIPELINED_RENDERING_NAME;
 	static const std::string RENDER_THREADS_MODE_NAME;
 	static const std::string RESOLUTION_SCALE_NAME;
 	static const std::string VERTICAL_FOV_NAME;
@@ -162,6 +167,7 @@ private:
 	// Dev.
 	static const std::string COLLISION_NAME;
 	static const std::string SHOW_DEBUG_NAME;
+	static const std::string LOG_RENDER_TIMINGS_NAME;
 
 	std::unique_ptr<TextBox> titleTextBox, backToPauseMenuTextBox, graphicsTextBox, audioTextBox,
 		inputTextBox, miscTextBox, devTextBox;
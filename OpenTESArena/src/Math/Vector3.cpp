@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 
 #include "Constants.h"
@@ -237,15 +238,19 @@ double Vector3f<T>::getYAngleRadians() const
 	// Get the length of the direction vector's projection onto the XZ plane.
 	const double xzProjection = std::sqrt((this->x * this->x) + (this->z * this->z));
 
+	// Rounding can make the projection slightly longer than 1 when Y is nearly zero, which
+	// acos() doesn't accept.
+	const double clampedXZProjection = std::min(xzProjection, 1.0);
+
 	if (this->y > 0.0)
 	{
 		// Above the horizon.
-		return std::acos(xzProjection);
+		return std::acos(clampedXZProjection);
 	}
 	else if (this->y < 0.0)
 	{
 		// Below the horizon.
-		return -std::acos(xzProjection);
+		return -std::acos(clampedXZProjection);
 	}
 	else
 	{
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+
+#include "DynamicResolution.h"
+
+const int DynamicResolution::SAMPLE_COUNT = 20;
+const double DynamicResolution::SCALE_STEP = 0.05;
+const double DynamicResolution::BUDGET_PERCENT = 0.75;
+const double DynamicResolution::RAISE_PERCENT = 0.85;
+
+DynamicResolution::DynamicResolution()
+{
+	this->scale = 1.0;
+	this->minScale = DynamicResolution::SCALE_STEP;
+	this->maxScale = 1.0;
+	this->budgetSeconds = DynamicResolution::BUDGET_PERCENT / 60.0;
+	this->sampleSeconds = 0.0;
+	this->sampleCount = 0;
+	this->enabled = false;
+}
+
+void DynamicResolution::setScale(double scale)
+{
+	// Round to the nearest step, then keep it within the bounds even if they aren't
+	// on a step themselves.
+	const double steppedScale = std::round(scale / DynamicResolution::SCALE_STEP) *
+		DynamicResolution::SCALE_STEP;
+	this->scale = std::max(std::min(steppedScale, this->maxScale), this->minScale);
+}
+
+void DynamicResolution::resetSamples()
+{
+	this->sampleSeconds = 0.0;
+	this->sampleCount = 0;
+}
+
+bool DynamicResolution::isEnabled() const
+{
+	return this->enabled;
+}
+
+double DynamicResolution::getScale() const
+{
+	return this->scale;
+}
+
+void DynamicResolution::enable(double startScale)
+{
+	this->setScale(startScale);
+	this->resetSamples();
+	this->enabled = true;
+}
+
+void DynamicResolution::disable()
+{
+	this->enabled = false;
+}
+
+void DynamicResolution::setBounds(double minScale, double maxScale)
+{
+	this->minScale = minScale;
+	this->maxScale = std::max(maxScale, minScale);
+
+	if ((this->scale < this->minScale) || (this->scale > this->maxScale))
+	{
+		this->setScale(this->scale);
+		this->resetSamples();
+	}
+}
+
+void DynamicResolution::setTargetFPS(int targetFPS)
+{
+	this->budgetSeconds = DynamicResolution::BUDGET_PERCENT / static_cast<double>(targetFPS);
+}
+
+bool DynamicResolution::update(double renderSeconds)
+{
+	if (!this->enabled)
+	{
+		return false;
+	}
+
+	this->sampleSeconds += renderSeconds;
+	this->sampleCount++;
+
+	if (this->sampleCount < DynamicResolution::SAMPLE_COUNT)
+	{
+		return false;
+	}
+
+	const double averageSeconds = this->sampleSeconds / static_cast<double>(this->sampleCount);
+	this->resetSamples();
+
+	// Render time is mostly proportional to the pixel count, which goes with the square
+	// of the scale.
+	const double oldScale = this->scale;
+	if (averageSeconds > this->budgetSeconds)
+	{
+		// Drop straight to the scale that should fit, at least one step down.
+		const double fitScale = oldScale * std::sqrt(this->budgetSeconds / averageSeconds);
+		this->setScale(std::min(fitScale, oldScale - DynamicResolution::SCALE_STEP));
+	}
+	else
+	{
+		// Go up one step if that frame would still be comfortably in budget.
+		const double raisedScale = oldScale + DynamicResolution::SCALE_STEP;
+		const double raisedRatio = raisedScale / oldScale;
+		const double raisedSeconds = averageSeconds * raisedRatio * raisedRatio;
+		if (raisedSeconds < (this->budgetSeconds * DynamicResolution::RAISE_PERCENT))
+		{
+			this->setScale(raisedScale);
+		}
+	}
+
+	return this->scale != oldScale;
+}
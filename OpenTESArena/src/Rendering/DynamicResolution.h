@@ -0,0 +1,64 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Chooses the resolution scale of the game world from how long recent frames took to
+// render, so the frame rate stays near the target in both quiet interiors and busy
+// exteriors. The scale only changes after several frames agree, and it is only raised
+// when the larger frame is expected to fit well inside the budget, so it doesn't bounce
+// between two sizes.
+
+class DynamicResolution
+{
+private:
+	// Frames averaged before deciding whether to change the scale.
+	static const int SAMPLE_COUNT;
+
+	// Amount the scale changes by. Scales are kept on multiples of this so small changes
+	// in frame time don't cause a resize every time.
+	static const double SCALE_STEP;
+
+	// Percent of the frame time at the target frame rate that game world rendering may
+	// use. The rest is left for the interface, texture upload, and presenting.
+	static const double BUDGET_PERCENT;
+
+	// Percent of the budget a raised scale's expected render time must be under.
+	static const double RAISE_PERCENT;
+
+	double scale, minScale, maxScale;
+	double budgetSeconds; // Render time allowed per frame.
+	double sampleSeconds; // Sum of render times since the last decision.
+	int sampleCount; // Number of render times since the last decision.
+	bool enabled;
+
+	// Sets the scale to a step within the bounds.
+	void setScale(double scale);
+
+	// Forgets render times since the last decision.
+	void resetSamples();
+public:
+	DynamicResolution();
+
+	// Returns whether the scale is being chosen automatically.
+	bool isEnabled() const;
+
+	// Gets the current resolution scale.
+	double getScale() const;
+
+	// Starts choosing the scale automatically, beginning at the given scale.
+	void enable(double startScale);
+
+	// Stops choosing the scale automatically.
+	void disable();
+
+	// Sets the lowest and highest scales allowed. The current scale is clamped to them.
+	void setBounds(double minScale, double maxScale);
+
+	// Sets the frame rate the scale is chosen for.
+	void setTargetFPS(int targetFPS);
+
+	// Adds the time a game world frame took to render. Returns whether the scale changed,
+	// in which case the game world buffers need to be resized.
+	bool update(double renderSeconds);
+};
+
+#endif
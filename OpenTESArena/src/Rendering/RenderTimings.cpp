@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "RenderTimings.h"
+
+#include "../Utilities/Debug.h"
+
+namespace
+{
+	// Display names for the debug overlay, in stage order.
+	const std::array<const char*, RenderTimings::STAGE_COUNT> StageNames =
+	{
+		"Sky gradient",
+		"Distant objects",
+		"Distant sky",
+		"Voxels",
+		"Visible flats",
+		"Flats",
+		"Texture upload",
+		"Present"
+	};
+
+	// CSV column names, in stage order. Values are in milliseconds.
+	const std::array<const char*, RenderTimings::STAGE_COUNT> StageColumns =
+	{
+		"sky_gradient_ms",
+		"visible_distant_objects_ms",
+		"distant_sky_ms",
+		"voxels_ms",
+		"visible_flats_ms",
+		"flats_ms",
+		"texture_upload_ms",
+		"present_ms"
+	};
+}
+
+RenderTimings::RenderTimings()
+{
+	for (auto &frame : this->history)
+	{
+		frame.fill(0.0);
+	}
+
+	this->currentFrame.fill(0.0);
+	this->historyIndex = 0;
+	this->historyCount = 0;
+	this->frameNumber = 0;
+	this->frameStarted = false;
+}
+
+const char *RenderTimings::getStageName(Stage stage)
+{
+	return StageNames.at(static_cast<int>(stage));
+}
+
+double RenderTimings::getAverage(Stage stage) const
+{
+	if (this->historyCount == 0)
+	{
+		return 0.0;
+	}
+
+	const int stageIndex = static_cast<int>(stage);
+	double sum = 0.0;
+	for (int i = 0; i < this->historyCount; i++)
+	{
+		sum += this->history[i][stageIndex];
+	}
+
+	return sum / static_cast<double>(this->historyCount);
+}
+
+double RenderTimings::getMax(Stage stage) const
+{
+	const int stageIndex = static_cast<int>(stage);
+	double maxSeconds = 0.0;
+	for (int i = 0; i < this->historyCount; i++)
+	{
+		maxSeconds = std::max(maxSeconds, this->history[i][stageIndex]);
+	}
+
+	return maxSeconds;
+}
+
+bool RenderTimings::isLogging() const
+{
+	return this->csvStream.is_open();
+}
+
+void RenderTimings::beginFrame()
+{
+	this->currentFrame.fill(0.0);
+	this->frameStarted = true;
+}
+
+void RenderTimings::setStageTime(Stage stage, double seconds)
+{
+	this->currentFrame.at(static_cast<int>(stage)) = seconds;
+}
+
+void RenderTimings::endFrame()
+{
+	if (!this->frameStarted)
+	{
+		return;
+	}
+
+	this->history[this->historyIndex] = this->currentFrame;
+	this->historyIndex = (this->historyIndex + 1) % RenderTimings::HISTORY_COUNT;
+
+	if (this->historyCount < RenderTimings::HISTORY_COUNT)
+	{
+		this->historyCount++;
+	}
+
+	if (this->csvStream.is_open())
+	{
+		this->csvStream << this->frameNumber;
+		for (const double seconds : this->currentFrame)
+		{
+			this->csvStream << ',' << (seconds * 1000.0);
+		}
+
+		this->csvStream << '\n';
+		this->frameNumber++;
+	}
+
+	this->frameStarted = false;
+}
+
+void RenderTimings::startLogging(const std::string &filename)
+{
+	this->stopLogging();
+
+	this->csvStream.open(filename, std::ios::trunc);
+	if (!this->csvStream.is_open())
+	{
+		DebugWarning("Couldn't open \"" + filename + "\" for render timings.");
+		return;
+	}
+
+	this->csvStream << std::fixed << std::setprecision(3) << "frame";
+	for (const char *column : StageColumns)
+	{
+		this->csvStream << ',' << column;
+	}
+
+	this->csvStream << '\n';
+	this->frameNumber = 0;
+
+	DebugMention("Logging render timings to \"" + filename + "\".");
+}
+
+void RenderTimings::stopLogging()
+{
+	if (this->csvStream.is_open())
+	{
+		this->csvStream.close();
+	}
+}
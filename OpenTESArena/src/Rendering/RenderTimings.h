@@ -0,0 +1,71 @@
+#ifndef RENDER_TIMINGS_H
+#define RENDER_TIMINGS_H
+
+#include <array>
+#include <fstream>
+#include <string>
+
+// Keeps the duration of each stage of drawing the game world over recent frames, so the
+// debug overlay can show where frame time goes. Every frame can also be written to a CSV
+// file for looking at spikes or comparing changes afterwards.
+
+class RenderTimings
+{
+public:
+	// Stages of a game world frame, in the order they happen.
+	enum class Stage
+	{
+		SkyGradient,
+		VisibleDistantObjects,
+		DistantSky,
+		Voxels,
+		VisibleFlats,
+		Flats,
+		TextureUpload,
+		Present
+	};
+
+	static const int STAGE_COUNT = 8;
+
+	// Number of frames the averages and maximums are taken over.
+	static const int HISTORY_COUNT = 60;
+private:
+	// Seconds per stage of recent frames. The oldest frame is overwritten first.
+	std::array<std::array<double, STAGE_COUNT>, HISTORY_COUNT> history;
+	std::array<double, STAGE_COUNT> currentFrame; // Stage seconds of the frame being recorded.
+	std::ofstream csvStream;
+	int historyIndex; // Index of the next frame to overwrite.
+	int historyCount; // Number of frames recorded so far, up to the history size.
+	int frameNumber; // Frames recorded since the CSV file was opened.
+	bool frameStarted; // Whether a game world frame is being recorded.
+public:
+	RenderTimings();
+
+	// Gets the display name of a stage.
+	static const char *getStageName(Stage stage);
+
+	// Gets the average and maximum seconds a stage took over recent frames.
+	double getAverage(Stage stage) const;
+	double getMax(Stage stage) const;
+
+	// Returns whether frames are being written to a CSV file.
+	bool isLogging() const;
+
+	// Starts recording a frame with the game world in it, with every stage at zero.
+	void beginFrame();
+
+	// Sets how long a stage of the current frame took.
+	void setStageTime(Stage stage, double seconds);
+
+	// Adds the current frame to the history (and the CSV file, if open). Does nothing if
+	// beginFrame() wasn't called, so frames without the game world aren't recorded.
+	void endFrame();
+
+	// Starts writing every frame to the given CSV file, replacing its contents.
+	void startLogging(const std::string &filename);
+
+	// Stops writing frames to the CSV file and closes it.
+	void stopLogging();
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 
 #include "SDL.h"
 
@@ -11,6 +13,7 @@
 #include "../Math/Rect.h"
 #include "../Media/Color.h"
 #include "../Utilities/Debug.h"
+#include "../Utilities/Platform.h"
 #include "../World/VoxelGrid.h"
 
 const char *Renderer::DEFAULT_RENDER_SCALE_QUALITY = "nearest";
@@ -26,6 +29,7 @@ Renderer::Renderer()
 	this->renderer = nullptr;
 	this->nativeTexture = nullptr;
 	this->gameWorldTexture = nullptr;
+	this->resolutionScale = 1.0;
 	this->letterboxMode = 0;
 	this->fullGameWindow = false;
 }
@@ -135,6 +139,32 @@ int Renderer::getViewHeight() const
 	return viewHeight;
 }
 
+const std::vector<SoftwareRenderer::RenderThreadStats> &Renderer::getRenderThreadStats() const
+{
+	return this->softwareRenderer.getRenderThreadStats();
+}
+
+double Renderer::getWorldFrameLatency() const
+{
+	return this->softwareRenderer.getFrameLatency();
+}
+
+int Renderer::getSkippedWorldFrameCount() const
+{
+	return this->softwareRenderer.getSkippedFrameCount();
+}
+
+double Renderer::getResolutionScale() const
+{
+	return this->dynamicResolution.isEnabled() ?
+		this->dynamicResolution.getScale() : this->resolutionScale;
+}
+
+const RenderTimings &Renderer::getRenderTimings() const
+{
+	return this->renderTimings;
+}
+
 SDL_Rect Renderer::getLetterboxDimensions() const
 {
 	const auto *nativeSurface = this->getWindowSurface();
@@ -346,29 +376,37 @@ void Renderer::resize(int width, int height, double resolutionScale, bool fullGa
 	DebugAssertMsg(this->nativeTexture != nullptr,
 		"Couldn't recreate native frame buffer, " + std::string(SDL_GetError()));
 
+	this->resolutionScale = resolutionScale;
 	this->fullGameWindow = fullGameWindow;
 
 	// Rebuild the 3D renderer if initialized.
 	if (this->softwareRenderer.isInited())
 	{
-		// Height of the game world view in pixels. Determined by whether the game 
-		// interface is visible or not.
-		const int viewHeight = this->getViewHeight();
+		this->resizeGameWorld();
+	}
+}
 
-		// Make sure render dimensions are at least 1x1.
-		const int renderWidth = std::max(static_cast<int>(width * resolutionScale), 1);
-		const int renderHeight = std::max(static_cast<int>(viewHeight * resolutionScale), 1);
+void Renderer::resizeGameWorld()
+{
+	// Height of the game world view in pixels. Determined by whether the game 
+	// interface is visible or not.
+	const int screenWidth = this->getWindowDimensions().x;
+	const int viewHeight = this->getViewHeight();
 
-		// Reinitialize the game world frame buffer.
-		SDL_DestroyTexture(this->gameWorldTexture);
-		this->gameWorldTexture = this->createTexture(Renderer::DEFAULT_PIXELFORMAT,
-			SDL_TEXTUREACCESS_STREAMING, renderWidth, renderHeight);
-		DebugAssertMsg(this->gameWorldTexture != nullptr,
-			"Couldn't recreate game world texture, " + std::string(SDL_GetError()));
+	// Make sure render dimensions are at least 1x1.
+	const double resolutionScale = this->getResolutionScale();
+	const int renderWidth = std::max(static_cast<int>(screenWidth * resolutionScale), 1);
+	const int renderHeight = std::max(static_cast<int>(viewHeight * resolutionScale), 1);
 
-		// Resize 3D renderer.
-		this->softwareRenderer.resize(renderWidth, renderHeight);
-	}
+	// Reinitialize the game world frame buffer.
+	SDL_DestroyTexture(this->gameWorldTexture);
+	this->gameWorldTexture = this->createTexture(Renderer::DEFAULT_PIXELFORMAT,
+		SDL_TEXTUREACCESS_STREAMING, renderWidth, renderHeight);
+	DebugAssertMsg(this->gameWorldTexture != nullptr,
+		"Couldn't recreate game world texture, " + std::string(SDL_GetError()));
+
+	// Resize 3D renderer.
+	this->softwareRenderer.resize(renderWidth, renderHeight);
 }
 
 void Renderer::setLetterboxMode(int letterboxMode)
@@ -410,6 +448,7 @@ void Renderer::setClipRect(const SDL_Rect *rect)
 void Renderer::initializeWorldRendering(double resolutionScale, bool fullGameWindow,
 	int renderThreadsMode)
 {
+	this->resolutionScale = resolutionScale;
 	this->fullGameWindow = fullGameWindow;
 
 	const int screenWidth = this->getWindowDimensions().x;
@@ -419,8 +458,9 @@ void Renderer::initializeWorldRendering(double resolutionScale, bool fullGameWin
 	const int viewHeight = this->getViewHeight();
 
 	// Make sure render dimensions are at least 1x1.
-	const int renderWidth = std::max(static_cast<int>(screenWidth * resolutionScale), 1);
-	const int renderHeight = std::max(static_cast<int>(viewHeight * resolutionScale), 1);
+	const double renderScale = this->getResolutionScale();
+	const int renderWidth = std::max(static_cast<int>(screenWidth * renderScale), 1);
+	const int renderHeight = std::max(static_cast<int>(viewHeight * renderScale), 1);
 
 	// Remove any previous game world frame buffer.
 	if (this->softwareRenderer.isInited())
@@ -444,6 +484,54 @@ void Renderer::setRenderThreadsMode(int mode)
 	this->softwareRenderer.setRenderThreadsMode(mode);
 }
 
+void Renderer::setRenderTimingsLogging(bool enabled)
+{
+	if (enabled == this->renderTimings.isLogging())
+	{
+		return;
+	}
+
+	if (enabled)
+	{
+		const std::string logPath = Platform::getLogPath();
+		if (!Platform::directoryExists(logPath))
+		{
+			Platform::createDirectoryRecursively(logPath);
+		}
+
+		this->renderTimings.startLogging(logPath + "render-timings.csv");
+	}
+	else
+	{
+		this->renderTimings.stopLogging();
+	}
+}
+
+void Renderer::setDynamicResolution(bool enabled, double minScale, double maxScale,
+	int targetFPS)
+{
+	const double oldScale = this->getResolutionScale();
+
+	DynamicResolution &dynamicResolution = this->dynamicResolution;
+	if (enabled && !dynamicResolution.isEnabled())
+	{
+		// Start from the fixed scale so turning it on doesn't jump right away.
+		dynamicResolution.enable(this->resolutionScale);
+	}
+	else if (!enabled && dynamicResolution.isEnabled())
+	{
+		dynamicResolution.disable();
+	}
+
+	dynamicResolution.setBounds(minScale, maxScale);
+	dynamicResolution.setTargetFPS(targetFPS);
+
+	if (this->softwareRenderer.isInited() && (this->getResolutionScale() != oldScale))
+	{
+		this->resizeGameWorld();
+	}
+}
+
 void Renderer::addFlat(int id, const Double3 &position, double width, 
 	double height, int textureID)
 {
@@ -457,6 +545,12 @@ void Renderer::addLight(int id, const Double3 &point, const Double3 &color, doub
 	this->softwareRenderer.addLight(id, point, color, intensity);
 }
 
+void Renderer::addStaticLight(const Double3 &point, const Double3 &color, double intensity)
+{
+	assert(this->softwareRenderer.isInited());
+	this->softwareRenderer.addStaticLight(point, color, intensity);
+}
+
 void Renderer::updateFlat(int id, const Double3 *position, const double *width, 
 	const double *height, const int *textureID, const bool *flipped)
 {
@@ -477,6 +571,30 @@ void Renderer::setFogDistance(double fogDistance)
 	this->softwareRenderer.setFogDistance(fogDistance);
 }
 
+void Renderer::setVoxelGrid(const VoxelGrid &voxelGrid)
+{
+	assert(this->softwareRenderer.isInited());
+	this->softwareRenderer.setVoxelGrid(voxelGrid);
+}
+
+void Renderer::updateVoxel(int x, int y, int z, const VoxelGrid &voxelGrid)
+{
+	assert(this->softwareRenderer.isInited());
+	this->softwareRenderer.updateVoxel(x, y, z, voxelGrid);
+}
+
+void Renderer::buildVisibility()
+{
+	assert(this->softwareRenderer.isInited());
+	this->softwareRenderer.buildVisibility();
+}
+
+void Renderer::bakeLightmap(double ceilingHeight)
+{
+	assert(this->softwareRenderer.isInited());
+	this->softwareRenderer.bakeLightmap(ceilingHeight);
+}
+
 void Renderer::setVoxelTexture(int id, const uint32_t *srcTexels)
 {
 	assert(this->softwareRenderer.isInited());
@@ -609,33 +727,131 @@ void Renderer::fillOriginalRect(const Color &color, int x, int y, int w, int h)
 }
 
 void Renderer::renderWorld(const Double3 &eye, const Double3 &forward, double fovY,
-	double ambient, double daytimePercent, bool parallaxSky, double ceilingHeight,
-	const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid)
+	double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, bool pipelined, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid)
 {
 	// The 3D renderer must be initialized.
 	assert(this->softwareRenderer.isInited());
+
+	// Time spent locking, filling, and unlocking the game world texture, apart from the
+	// software renderer drawing straight into it.
+	std::chrono::high_resolution_clock::duration uploadTime(0);
+
+	// If nothing in the world changed enough to show, the game world texture already has the
+	// frame, unless it's a pipelined one that hasn't been taken yet.
+	const bool frameReused = this->softwareRenderer.reuseFrame(eye, forward, fovY, ambient,
+		daytimePercent, parallaxSky, paletteShading, mipmapping, interleavedColumns,
+		ceilingHeight, openDoors, voxelGrid);
+	const bool updateTexture = !frameReused || this->softwareRenderer.isFramePending();
 	
 	// Lock the game world texture and give the pixel pointer to the software renderer.
 	// - Supposedly this is faster than SDL_UpdateTexture(). In any case, there's one
 	//   less frame buffer to take care of.
-	uint32_t *gameWorldPixels;
-	int gameWorldPitch;
-	int status = SDL_LockTexture(this->gameWorldTexture, nullptr, 
-		reinterpret_cast<void**>(&gameWorldPixels), &gameWorldPitch);
-	DebugAssertMsg(status == 0, "Couldn't lock game world texture, " +
-		std::string(SDL_GetError()));
+	uint32_t *gameWorldPixels = nullptr;
+	int gameWorldPitch = 0;
+	if (updateTexture)
+	{
+		const auto lockStart = std::chrono::high_resolution_clock::now();
+		int status = SDL_LockTexture(this->gameWorldTexture, nullptr, 
+			reinterpret_cast<void**>(&gameWorldPixels), &gameWorldPitch);
+		DebugAssertMsg(status == 0, "Couldn't lock game world texture, " +
+			std::string(SDL_GetError()));
+		uploadTime += std::chrono::high_resolution_clock::now() - lockStart;
+	}
 
-	// Render the game world to the game world frame buffer.
-	this->softwareRenderer.render(eye, forward, fovY, ambient, daytimePercent, parallaxSky,
-		ceilingHeight, openDoors, voxelGrid, gameWorldPixels);
+	if (!updateTexture)
+	{
+		// The last frame is shown again.
+	}
+	else if (pipelined)
+	{
+		// If there is no frame from last time (i.e., the first frame or after a resize),
+		// start one with the current state so there's something to show.
+		if (!this->softwareRenderer.isFramePending())
+		{
+			this->softwareRenderer.beginFrame(eye, forward, fovY, ambient, daytimePercent,
+				parallaxSky, paletteShading, mipmapping, interleavedColumns, ceilingHeight,
+				openDoors, voxelGrid);
+		}
+
+		// Copy the finished frame into the game world texture, one row at a time since the
+		// texture's pitch might be wider than the frame.
+		const uint32_t *framePixels = this->softwareRenderer.finishFrame();
+		const auto copyStart = std::chrono::high_resolution_clock::now();
+
+		int frameWidth, frameHeight;
+		SDL_QueryTexture(this->gameWorldTexture, nullptr, nullptr, &frameWidth, &frameHeight);
+
+		for (int y = 0; y < frameHeight; y++)
+		{
+			uint8_t *dstRow = reinterpret_cast<uint8_t*>(gameWorldPixels) + (y * gameWorldPitch);
+			const uint32_t *srcRow = framePixels + (y * frameWidth);
+			std::memcpy(dstRow, srcRow, frameWidth * sizeof(uint32_t));
+		}
+
+		uploadTime += std::chrono::high_resolution_clock::now() - copyStart;
+	}
+	else
+	{
+		// Render the game world to the game world frame buffer.
+		this->softwareRenderer.render(eye, forward, fovY, ambient, daytimePercent, parallaxSky,
+			paletteShading, mipmapping, interleavedColumns, ceilingHeight, openDoors, voxelGrid,
+			gameWorldPixels);
+	}
 
 	// Update the game world texture with the new ARGB8888 pixels.
-	SDL_UnlockTexture(this->gameWorldTexture);
+	if (updateTexture)
+	{
+		const auto unlockStart = std::chrono::high_resolution_clock::now();
+		SDL_UnlockTexture(this->gameWorldTexture);
+		uploadTime += std::chrono::high_resolution_clock::now() - unlockStart;
+	}
 
 	// Now copy to the native frame buffer (stretching if needed).
 	const int screenWidth = this->getWindowDimensions().x;
 	const int viewHeight = this->getViewHeight();
 	this->draw(this->gameWorldTexture, 0, 0, screenWidth, viewHeight);
+
+	// A frame shown again wasn't drawn, so it isn't recorded. Otherwise, record the stages
+	// of the frame that was shown. The frame ends once it is presented.
+	if (!updateTexture)
+	{
+		return;
+	}
+
+	const SoftwareRenderer::PhaseTimings &phaseTimings = this->softwareRenderer.getPhaseTimings();
+	RenderTimings &timings = this->renderTimings;
+	timings.beginFrame();
+	timings.setStageTime(RenderTimings::Stage::SkyGradient, phaseTimings.skyGradient);
+	timings.setStageTime(RenderTimings::Stage::VisibleDistantObjects,
+		phaseTimings.visibleDistantObjects);
+	timings.setStageTime(RenderTimings::Stage::DistantSky, phaseTimings.distantSky);
+	timings.setStageTime(RenderTimings::Stage::Voxels, phaseTimings.voxels);
+	timings.setStageTime(RenderTimings::Stage::VisibleFlats, phaseTimings.visibleFlats);
+	timings.setStageTime(RenderTimings::Stage::Flats, phaseTimings.flats);
+	timings.setStageTime(RenderTimings::Stage::TextureUpload,
+		std::chrono::duration<double>(uploadTime).count());
+
+	// Pick the resolution for the next frame from how long the render threads took. The
+	// new buffers are stretched to the same view, so only the detail changes. This happens
+	// before the next pipelined frame starts, so resizing doesn't wait on that frame and
+	// then throw it away.
+	const double renderSeconds = phaseTimings.skyGradient + phaseTimings.distantSky +
+		phaseTimings.voxels + phaseTimings.flats;
+	if (!frameReused && this->dynamicResolution.update(renderSeconds))
+	{
+		this->resizeGameWorld();
+	}
+
+	// Start the next frame in the background. It is shown on the next call. If the taken
+	// frame is still current, there's no need for another one.
+	if (pipelined && !frameReused)
+	{
+		this->softwareRenderer.beginFrame(eye, forward, fovY, ambient, daytimePercent,
+			parallaxSky, paletteShading, mipmapping, interleavedColumns, ceilingHeight,
+			openDoors, voxelGrid);
+	}
 }
 
 void Renderer::drawCursor(SDL_Texture *cursor, CursorAlignment alignment,
@@ -789,7 +1005,15 @@ void Renderer::fill(SDL_Texture *texture)
 
 void Renderer::present()
 {
+	// Includes waiting for vertical sync, if the driver does it.
+	const auto presentStart = std::chrono::high_resolution_clock::now();
+
 	SDL_SetRenderTarget(this->renderer, nullptr);
 	SDL_RenderCopy(this->renderer, this->nativeTexture, nullptr, nullptr);
 	SDL_RenderPresent(this->renderer);
+
+	const double presentSeconds = std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now() - presentStart).count();
+	this->renderTimings.setStageTime(RenderTimings::Stage::Present, presentSeconds);
+	this->renderTimings.endFrame();
 }
@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "DynamicResolution.h"
+#include "RenderTimings.h"
 #include "SoftwareRenderer.h"
 #include "../Math/Vector2.h"
 #include "../Math/Vector3.h"
@@ -39,6 +41,9 @@ private:
 	SDL_Renderer *renderer;
 	SDL_Texture *nativeTexture, *gameWorldTexture; // Frame buffers.
 	SoftwareRenderer softwareRenderer; // Game world renderer.
+	RenderTimings renderTimings; // Game world stage durations of recent frames.
+	DynamicResolution dynamicResolution; // Chooses the resolution scale from frame times.
+	double resolutionScale; // Resolution scale to use when it isn't chosen automatically.
 	int letterboxMode; // Determines aspect ratio of the original UI (16:10, 4:3, etc.).
 	bool fullGameWindow; // Determines height of 3D frame buffer.
 
@@ -47,6 +52,10 @@ private:
 
 	// For use with window dimensions, etc.. No longer used for rendering.
 	SDL_Surface *getWindowSurface() const;
+
+	// Recreates the game world frame buffer for the current window, view height, and
+	// resolution scale.
+	void resizeGameWorld();
 public:
 	// Only defined so members are initialized for Game ctor exception handling.
 	Renderer();
@@ -73,6 +82,24 @@ public:
 	// the interface. The game interface is 53 pixels tall in 320x200.
 	int getViewHeight() const;
 
+	// Gets the busy and idle time of each game world render thread in the last frame.
+	const std::vector<SoftwareRenderer::RenderThreadStats> &getRenderThreadStats() const;
+
+	// Gets the seconds between the world state being given to renderWorld() and the game
+	// world frame being finished, for the last frame. Pipelined rendering adds a frame.
+	double getWorldFrameLatency() const;
+
+	// Gets how many game world frames were shown again instead of being drawn because
+	// nothing visible changed.
+	int getSkippedWorldFrameCount() const;
+
+	// Gets the percent of the window resolution the game world is drawn at. This is chosen
+	// automatically if dynamic resolution is enabled.
+	double getResolutionScale() const;
+
+	// Gets how long each stage of drawing the game world took in recent frames.
+	const RenderTimings &getRenderTimings() const;
+
 	// This is for the "letterbox" part of the screen, scaled to fit the window 
 	// using the given letterbox aspect.
 	SDL_Rect getLetterboxDimensions() const;
@@ -131,18 +158,34 @@ public:
 	// Sets which mode to use for software render threads (low, medium, high, etc.).
 	void setRenderThreadsMode(int mode);
 
+	// Sets whether the game world render timings of every frame are written to a CSV file
+	// in the log folder.
+	void setRenderTimingsLogging(bool enabled);
+
+	// Sets whether the game world resolution scale is raised and lowered automatically,
+	// between the given bounds, to keep the game world's render time within the frame time
+	// of the target frame rate.
+	void setDynamicResolution(bool enabled, double minScale, double maxScale, int targetFPS);
+
 	// Helper methods for changing data in the 3D renderer. Some data, like the voxel
-	// grid, are passed each frame by reference.
+	// grid, are passed each frame by reference. The voxel grid is also baked into a compact
+	// copy when its level becomes active, so voxels that change afterwards must be updated.
+	// Static lights are baked into a lightmap for the active level by bakeLightmap().
 	// - Some 'add' methods take a unique ID and parameters to create a new object.
 	// - 'update' methods take optional parameters for updating, ignoring null ones.
 	// - 'remove' methods delete an object from renderer memory if it exists.
 	void addFlat(int id, const Double3 &position, double width, double height, int textureID);
 	void addLight(int id, const Double3 &point, const Double3 &color, double intensity);
+	void addStaticLight(const Double3 &point, const Double3 &color, double intensity);
 	void updateFlat(int id, const Double3 *position, const double *width, 
 		const double *height, const int *textureID, const bool *flipped);
 	void updateLight(int id, const Double3 *point, const Double3 *color,
 		const double *intensity);
 	void setFogDistance(double fogDistance);
+	void setVoxelGrid(const VoxelGrid &voxelGrid);
+	void updateVoxel(int x, int y, int z, const VoxelGrid &voxelGrid);
+	void buildVisibility();
+	void bakeLightmap(double ceilingHeight);
 	void setVoxelTexture(int id, const uint32_t *srcTexels);
 	void setFlatTexture(int id, const uint32_t *srcTexels, int width, int height);
 	void setDistantSky(const DistantSky &distantSky);
@@ -169,10 +212,15 @@ public:
 	void fillOriginalRect(const Color &color, int x, int y, int w, int h);
 
 	// Runs the 3D renderer which draws the world onto the native frame buffer.
-	// If the renderer is uninitialized, this causes a crash.
+	// If the renderer is uninitialized, this causes a crash. If pipelined is true, the
+	// previous call's world frame is drawn while the given world state is rendered in the
+	// background, which improves throughput at the cost of a frame of latency. If interleaved
+	// columns is true, only half the columns are ray cast each frame. If mipmapping is true,
+	// distant textures are sampled from smaller mip levels.
 	void renderWorld(const Double3 &eye, const Double3 &forward, double fovY, 
-		double ambient, double daytimePercent, bool parallaxSky, double ceilingHeight, 
-		const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid);
+		double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+		bool mipmapping, bool interleavedColumns, bool pipelined, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid);
 
 	// Draws the given cursor texture to the native frame buffer. The exact position 
 	// of the cursor is modified by the cursor alignment.
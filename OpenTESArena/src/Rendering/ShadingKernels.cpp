@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <string>
+
+#include "ShadingKernels.h"
+
+#include "../Utilities/Debug.h"
+
+// SSE2 is always available on x86-64, and AVX2 kernels are compiled alongside it with
+// per-function target attributes so they can be selected at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAVE_SSE2_KERNEL
+#include <emmintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HAVE_AVX2_KERNEL
+#define AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define HAVE_AVX2_KERNEL
+#define AVX2_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+	// The scalar kernel is the reference implementation. The vector kernels must do the
+	// same operations in the same order (and without fused multiply-adds) so the results
+	// are identical. They divide by 255 instead of using the normalized channel table
+	// since that's faster than gathering, and the division is exact either way.
+	uint32_t shadeTexelScalar(uint32_t texel, double fogPercent, double shadingR,
+		double shadingG, double shadingB, const Double3 &fogColor)
+	{
+		// Texture color with shading.
+		const double shadingMax = 1.0;
+		const double texelEmission = static_cast<double>(texel >> 24);
+		const double texelR = ShadingKernels::NormalizedChannels[texel & 0xFF];
+		const double texelG = ShadingKernels::NormalizedChannels[(texel >> 8) & 0xFF];
+		const double texelB = ShadingKernels::NormalizedChannels[(texel >> 16) & 0xFF];
+		double colorR = texelR * std::min(shadingR + texelEmission, shadingMax);
+		double colorG = texelG * std::min(shadingG + texelEmission, shadingMax);
+		double colorB = texelB * std::min(shadingB + texelEmission, shadingMax);
+
+		// Linearly interpolate with fog.
+		colorR += (fogColor.x - colorR) * fogPercent;
+		colorG += (fogColor.y - colorG) * fogPercent;
+		colorB += (fogColor.z - colorB) * fogPercent;
+
+		// Clamp maximum (don't worry about negative values).
+		const double high = 1.0;
+		colorR = (colorR > high) ? high : colorR;
+		colorG = (colorG > high) ? high : colorG;
+		colorB = (colorB > high) ? high : colorB;
+
+		// Convert floats to integers.
+		return static_cast<uint32_t>(
+			((static_cast<uint8_t>(colorR * 255.0)) << 16) |
+			((static_cast<uint8_t>(colorG * 255.0)) << 8) |
+			((static_cast<uint8_t>(colorB * 255.0))));
+	}
+
+	// Lit kernels add each texel's point light color to the shading first. The lights are
+	// offset by the same amount as the texels.
+	template <bool Lit>
+	void shadeScalar(const uint32_t *texels, const double *fogPercents,
+		const ShadingKernels::TexelLights &lights, int offset, int count,
+		const Double3 &shading, const Double3 &fogColor, uint32_t *dst)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const int lightIndex = offset + i;
+			dst[i] = shadeTexelScalar(texels[i], fogPercents[i],
+				Lit ? (shading.x + lights.r[lightIndex]) : shading.x,
+				Lit ? (shading.y + lights.g[lightIndex]) : shading.y,
+				Lit ? (shading.z + lights.b[lightIndex]) : shading.z, fogColor);
+		}
+	}
+
+#ifdef HAVE_SSE2_KERNEL
+	// Shades one color channel of two pixels and converts it to integers.
+	__m128i shadeChannelSSE2(__m128i channel, __m128d emission, __m128d shading,
+		__m128d fogColor, __m128d fogPercent)
+	{
+		const __m128d one = _mm_set1_pd(1.0);
+		const __m128d channelMax = _mm_set1_pd(255.0);
+		const __m128d texel = _mm_div_pd(_mm_cvtepi32_pd(channel), channelMax);
+
+		__m128d color = _mm_mul_pd(texel, _mm_min_pd(_mm_add_pd(shading, emission), one));
+		color = _mm_add_pd(color, _mm_mul_pd(_mm_sub_pd(fogColor, color), fogPercent));
+		color = _mm_min_pd(color, one);
+		return _mm_cvttpd_epi32(_mm_mul_pd(color, channelMax));
+	}
+
+	template <bool Lit>
+	void shadeSSE2(const uint32_t *texels, const double *fogPercents,
+		const ShadingKernels::TexelLights &lights, int count, const Double3 &shading,
+		const Double3 &fogColor, uint32_t *dst)
+	{
+		const __m128d shadingR = _mm_set1_pd(shading.x);
+		const __m128d shadingG = _mm_set1_pd(shading.y);
+		const __m128d shadingB = _mm_set1_pd(shading.z);
+		const __m128d fogR = _mm_set1_pd(fogColor.x);
+		const __m128d fogG = _mm_set1_pd(fogColor.y);
+		const __m128d fogB = _mm_set1_pd(fogColor.z);
+
+		// Four pixels per iteration, as two halves of two doubles each.
+		const __m128i channelMask = _mm_set1_epi32(0xFF);
+		int i = 0;
+		for (; (i + 4) <= count; i += 4)
+		{
+			const __m128i texel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i));
+			const __m128i channelR = _mm_and_si128(texel, channelMask);
+			const __m128i channelG = _mm_and_si128(_mm_srli_epi32(texel, 8), channelMask);
+			const __m128i channelB = _mm_and_si128(_mm_srli_epi32(texel, 16), channelMask);
+			const __m128i emission = _mm_srli_epi32(texel, 24);
+
+			__m128i halves[2][3];
+			for (int half = 0; half < 2; half++)
+			{
+				// Move the upper two pixels down for the second half.
+				const __m128i r = (half == 0) ? channelR : _mm_srli_si128(channelR, 8);
+				const __m128i g = (half == 0) ? channelG : _mm_srli_si128(channelG, 8);
+				const __m128i b = (half == 0) ? channelB : _mm_srli_si128(channelB, 8);
+				const __m128d e = _mm_cvtepi32_pd(
+					(half == 0) ? emission : _mm_srli_si128(emission, 8));
+				const __m128d fogPercent = _mm_loadu_pd(fogPercents + i + (half * 2));
+				const int lightIndex = i + (half * 2);
+				const __m128d pixelShadingR = Lit ?
+					_mm_add_pd(shadingR, _mm_loadu_pd(lights.r + lightIndex)) : shadingR;
+				const __m128d pixelShadingG = Lit ?
+					_mm_add_pd(shadingG, _mm_loadu_pd(lights.g + lightIndex)) : shadingG;
+				const __m128d pixelShadingB = Lit ?
+					_mm_add_pd(shadingB, _mm_loadu_pd(lights.b + lightIndex)) : shadingB;
+
+				halves[half][0] = shadeChannelSSE2(r, e, pixelShadingR, fogR, fogPercent);
+				halves[half][1] = shadeChannelSSE2(g, e, pixelShadingG, fogG, fogPercent);
+				halves[half][2] = shadeChannelSSE2(b, e, pixelShadingB, fogB, fogPercent);
+			}
+
+			const __m128i colorR = _mm_unpacklo_epi64(halves[0][0], halves[1][0]);
+			const __m128i colorG = _mm_unpacklo_epi64(halves[0][1], halves[1][1]);
+			const __m128i colorB = _mm_unpacklo_epi64(halves[0][2], halves[1][2]);
+			const __m128i colorRGB = _mm_or_si128(
+				_mm_or_si128(_mm_slli_epi32(colorR, 16), _mm_slli_epi32(colorG, 8)), colorB);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), colorRGB);
+		}
+
+		shadeScalar<Lit>(texels + i, fogPercents + i, lights, i, count - i, shading, fogColor,
+			dst + i);
+	}
+#endif
+
+#ifdef HAVE_AVX2_KERNEL
+	// Shades one color channel of four pixels and converts it to integers.
+	AVX2_TARGET __m128i shadeChannelAVX2(__m128i channel, __m256d emission, __m256d shading,
+		__m256d fogColor, __m256d fogPercent)
+	{
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d channelMax = _mm256_set1_pd(255.0);
+		const __m256d texel = _mm256_div_pd(_mm256_cvtepi32_pd(channel), channelMax);
+
+		__m256d color = _mm256_mul_pd(texel,
+			_mm256_min_pd(_mm256_add_pd(shading, emission), one));
+		color = _mm256_add_pd(color,
+			_mm256_mul_pd(_mm256_sub_pd(fogColor, color), fogPercent));
+		color = _mm256_min_pd(color, one);
+		return _mm256_cvttpd_epi32(_mm256_mul_pd(color, channelMax));
+	}
+
+	AVX2_TARGET __m256i combineHalvesAVX2(__m128i low, __m128i high)
+	{
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+	}
+
+	// Adds four pixels' lights to the shading of one channel if they're lit.
+	template <bool Lit>
+	AVX2_TARGET __m256d addLightsAVX2(__m256d shading, const double *lights, int index)
+	{
+		return Lit ? _mm256_add_pd(shading, _mm256_loadu_pd(lights + index)) : shading;
+	}
+
+	template <bool Lit>
+	AVX2_TARGET void shadeAVX2(const uint32_t *texels, const double *fogPercents,
+		const ShadingKernels::TexelLights &lights, int count, const Double3 &shading,
+		const Double3 &fogColor, uint32_t *dst)
+	{
+		const __m256i channelMask = _mm256_set1_epi32(0xFF);
+		const __m256d shadingR = _mm256_set1_pd(shading.x);
+		const __m256d shadingG = _mm256_set1_pd(shading.y);
+		const __m256d shadingB = _mm256_set1_pd(shading.z);
+		const __m256d fogR = _mm256_set1_pd(fogColor.x);
+		const __m256d fogG = _mm256_set1_pd(fogColor.y);
+		const __m256d fogB = _mm256_set1_pd(fogColor.z);
+
+		// Eight pixels per iteration, as two halves of four doubles each.
+		int i = 0;
+		for (; (i + 8) <= count; i += 8)
+		{
+			const __m256i texel = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(texels + i));
+			const __m256i channelR = _mm256_and_si256(texel, channelMask);
+			const __m256i channelG = _mm256_and_si256(_mm256_srli_epi32(texel, 8), channelMask);
+			const __m256i channelB = _mm256_and_si256(_mm256_srli_epi32(texel, 16), channelMask);
+			const __m256i emission = _mm256_srli_epi32(texel, 24);
+
+			const __m256d emissionLow = _mm256_cvtepi32_pd(_mm256_castsi256_si128(emission));
+			const __m256d emissionHigh = _mm256_cvtepi32_pd(_mm256_extracti128_si256(emission, 1));
+			const __m256d fogPercentLow = _mm256_loadu_pd(fogPercents + i);
+			const __m256d fogPercentHigh = _mm256_loadu_pd(fogPercents + i + 4);
+
+			const __m256i colorR = combineHalvesAVX2(
+				shadeChannelAVX2(_mm256_castsi256_si128(channelR), emissionLow,
+					addLightsAVX2<Lit>(shadingR, lights.r, i), fogR, fogPercentLow),
+				shadeChannelAVX2(_mm256_extracti128_si256(channelR, 1), emissionHigh,
+					addLightsAVX2<Lit>(shadingR, lights.r, i + 4), fogR, fogPercentHigh));
+			const __m256i colorG = combineHalvesAVX2(
+				shadeChannelAVX2(_mm256_castsi256_si128(channelG), emissionLow,
+					addLightsAVX2<Lit>(shadingG, lights.g, i), fogG, fogPercentLow),
+				shadeChannelAVX2(_mm256_extracti128_si256(channelG, 1), emissionHigh,
+					addLightsAVX2<Lit>(shadingG, lights.g, i + 4), fogG, fogPercentHigh));
+			const __m256i colorB = combineHalvesAVX2(
+				shadeChannelAVX2(_mm256_castsi256_si128(channelB), emissionLow,
+					addLightsAVX2<Lit>(shadingB, lights.b, i), fogB, fogPercentLow),
+				shadeChannelAVX2(_mm256_extracti128_si256(channelB, 1), emissionHigh,
+					addLightsAVX2<Lit>(shadingB, lights.b, i + 4), fogB, fogPercentHigh));
+
+			const __m256i colorRGB = _mm256_or_si256(
+				_mm256_or_si256(_mm256_slli_epi32(colorR, 16), _mm256_slli_epi32(colorG, 8)), colorB);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), colorRGB);
+		}
+
+		// Clear the upper halves of the AVX registers before running non-AVX code, otherwise
+		// every SSE instruction afterwards pays a transition penalty.
+		_mm256_zeroupper();
+
+		shadeScalar<Lit>(texels + i, fogPercents + i, lights, i, count - i, shading, fogColor,
+			dst + i);
+	}
+
+	bool cpuSupportsAVX2()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// The OS must also save the AVX registers on context switches.
+		__cpuid(info, 1);
+		const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+		const bool hasAVX = (info[2] & (1 << 28)) != 0;
+		if (!hasOSXSAVE || !hasAVX || ((_xgetbv(0) & 0x6) != 0x6))
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+#endif
+
+	ShadingKernels::InstructionSet detectInstructionSet()
+	{
+#if defined(HAVE_AVX2_KERNEL)
+		return cpuSupportsAVX2() ? ShadingKernels::InstructionSet::AVX2 :
+			ShadingKernels::InstructionSet::SSE2;
+#elif defined(HAVE_SSE2_KERNEL)
+		return ShadingKernels::InstructionSet::SSE2;
+#else
+		return ShadingKernels::InstructionSet::Scalar;
+#endif
+	}
+
+	const ShadingKernels::InstructionSet BestInstructionSet = detectInstructionSet();
+
+	template <bool Lit>
+	void shadeWithLights(ShadingKernels::InstructionSet instructionSet, const uint32_t *texels,
+		const double *fogPercents, const ShadingKernels::TexelLights &lights, int count,
+		const Double3 &shading, const Double3 &fogColor, uint32_t *dst)
+	{
+		if (instructionSet == ShadingKernels::InstructionSet::Scalar)
+		{
+			shadeScalar<Lit>(texels, fogPercents, lights, 0, count, shading, fogColor, dst);
+		}
+#ifdef HAVE_SSE2_KERNEL
+		else if (instructionSet == ShadingKernels::InstructionSet::SSE2)
+		{
+			shadeSSE2<Lit>(texels, fogPercents, lights, count, shading, fogColor, dst);
+		}
+#endif
+#ifdef HAVE_AVX2_KERNEL
+		else if (instructionSet == ShadingKernels::InstructionSet::AVX2)
+		{
+			shadeAVX2<Lit>(texels, fogPercents, lights, count, shading, fogColor, dst);
+		}
+#endif
+		else
+		{
+			throw DebugException("Instruction set \"" +
+				std::string(ShadingKernels::getInstructionSetName(instructionSet)) +
+				"\" not available.");
+		}
+	}
+}
+
+const std::array<double, 256> ShadingKernels::NormalizedChannels = []()
+{
+	std::array<double, 256> channels;
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		channels[i] = static_cast<double>(i) / 255.0;
+	}
+
+	return channels;
+}();
+
+ShadingKernels::InstructionSet ShadingKernels::getInstructionSet()
+{
+	return BestInstructionSet;
+}
+
+const char *ShadingKernels::getInstructionSetName(InstructionSet instructionSet)
+{
+	if (instructionSet == InstructionSet::Scalar)
+	{
+		return "Scalar";
+	}
+	else if (instructionSet == InstructionSet::SSE2)
+	{
+		return "SSE2";
+	}
+	else if (instructionSet == InstructionSet::AVX2)
+	{
+		return "AVX2";
+	}
+	else
+	{
+		throw DebugException("Invalid instruction set \"" +
+			std::to_string(static_cast<int>(instructionSet)) + "\".");
+	}
+}
+
+void ShadingKernels::shade(const uint32_t *texels, const double *fogPercents, int count,
+	const Double3 &shading, const Double3 &fogColor, uint32_t *dst)
+{
+	ShadingKernels::shadeWith(BestInstructionSet, texels, fogPercents, count, shading,
+		fogColor, dst);
+}
+
+void ShadingKernels::shadeWith(InstructionSet instructionSet, const uint32_t *texels,
+	const double *fogPercents, int count, const Double3 &shading, const Double3 &fogColor,
+	uint32_t *dst)
+{
+	const TexelLights noLights = { nullptr, nullptr, nullptr };
+	shadeWithLights<false>(instructionSet, texels, fogPercents, noLights, count, shading,
+		fogColor, dst);
+}
+
+void ShadingKernels::shadeLit(const uint32_t *texels, const double *fogPercents,
+	const TexelLights &lights, int count, const Double3 &shading, const Double3 &fogColor,
+	uint32_t *dst)
+{
+	ShadingKernels::shadeLitWith(BestInstructionSet, texels, fogPercents, lights, count,
+		shading, fogColor, dst);
+}
+
+void ShadingKernels::shadeLitWith(InstructionSet instructionSet, const uint32_t *texels,
+	const double *fogPercents, const TexelLights &lights, int count, const Double3 &shading,
+	const Double3 &fogColor, uint32_t *dst)
+{
+	shadeWithLights<true>(instructionSet, texels, fogPercents, lights, count, shading,
+		fogColor, dst);
+}
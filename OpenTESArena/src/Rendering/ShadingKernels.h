@@ -0,0 +1,65 @@
+#ifndef SHADING_KERNELS_H
+#define SHADING_KERNELS_H
+
+#include <array>
+#include <cstdint>
+
+#include "../Math/Vector3.h"
+
+// Kernels for shading, fogging, clamping, and packing several software renderer pixels
+// at a time. The widest instruction set supported by the CPU (AVX2, SSE2, or plain
+// scalar code) is selected at runtime, and each one gives the same output as the scalar
+// kernel bit for bit.
+
+namespace ShadingKernels
+{
+	enum class InstructionSet { Scalar, SSE2, AVX2 };
+
+	// Normalized value of each 8-bit color channel intensity, so packed texels can be
+	// converted to floating-point during shading without a division per channel.
+	extern const std::array<double, 256> NormalizedChannels;
+
+	// Light from point lights to add to the shading of each texel, with one value per texel
+	// in each channel.
+	struct TexelLights
+	{
+		const double *r, *g, *b;
+	};
+
+	// Packs a texel's 8-bit color channels and emission into the format read by the kernels.
+	inline uint32_t packTexel(uint8_t r, uint8_t g, uint8_t b, bool emissive)
+	{
+		return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) |
+			(static_cast<uint32_t>(b) << 16) | (emissive ? (1u << 24) : 0u);
+	}
+
+	// Gets the instruction set used by shade().
+	InstructionSet getInstructionSet();
+
+	// Gets a human-readable name of an instruction set (for logging).
+	const char *getInstructionSetName(InstructionSet instructionSet);
+
+	// Shades the packed texels with the given light (emissive texels are fully lit), blends
+	// each one with the fog color by its fog percent, and writes the resulting RGB values
+	// to the destination.
+	void shade(const uint32_t *texels, const double *fogPercents, int count,
+		const Double3 &shading, const Double3 &fogColor, uint32_t *dst);
+
+	// Same as shade() but with a specific instruction set. The instruction set must be
+	// supported by the CPU.
+	void shadeWith(InstructionSet instructionSet, const uint32_t *texels,
+		const double *fogPercents, int count, const Double3 &shading, const Double3 &fogColor,
+		uint32_t *dst);
+
+	// Same as shade() but with each texel's light from point lights added to the shading.
+	void shadeLit(const uint32_t *texels, const double *fogPercents, const TexelLights &lights,
+		int count, const Double3 &shading, const Double3 &fogColor, uint32_t *dst);
+
+	// Same as shadeLit() but with a specific instruction set. The instruction set must be
+	// supported by the CPU.
+	void shadeLitWith(InstructionSet instructionSet, const uint32_t *texels,
+		const double *fogPercents, const TexelLights &lights, int count, const Double3 &shading,
+		const Double3 &fogColor, uint32_t *dst);
+}
+
+#endif
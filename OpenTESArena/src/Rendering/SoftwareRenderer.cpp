@@ -1,8 +1,11 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <limits>
+#include <new>
 
+#include "ShadingKernels.h"
 #include "SoftwareRenderer.h"
 #include "Surface.h"
 #include "../Math/Constants.h"
@@ -14,28 +17,139 @@
 #include "../World/VoxelGrid.h"
 
 SoftwareRenderer::VoxelTexel::VoxelTexel()
+	: VoxelTexel(0, 0, 0, 0) { }
+
+SoftwareRenderer::VoxelTexel::VoxelTexel(uint8_t r, uint8_t g, uint8_t b, uint8_t flags)
+{
+	this->r = r;
+	this->g = g;
+	this->b = b;
+	this->flags = flags;
+}
+
+bool SoftwareRenderer::VoxelTexel::isEmissive() const
 {
-	this->r = 0.0;
-	this->g = 0.0;
-	this->b = 0.0;
-	this->emission = 0.0;
-	this->transparent = false;
+	return (this->flags & VoxelTexel::FLAG_EMISSIVE) != 0;
+}
+
+bool SoftwareRenderer::VoxelTexel::isTransparent() const
+{
+	return (this->flags & VoxelTexel::FLAG_TRANSPARENT) != 0;
 }
 
 SoftwareRenderer::FlatTexel::FlatTexel()
+	: FlatTexel(0, 0, 0, 0) { }
+
+SoftwareRenderer::FlatTexel::FlatTexel(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
-	this->r = 0.0;
-	this->g = 0.0;
-	this->b = 0.0;
-	this->a = 0.0;
+	this->r = r;
+	this->g = g;
+	this->b = b;
+	this->a = a;
 }
 
 SoftwareRenderer::SkyTexel::SkyTexel()
+	: SkyTexel(0, 0, 0, false) { }
+
+SoftwareRenderer::SkyTexel::SkyTexel(uint8_t r, uint8_t g, uint8_t b, bool transparent)
+{
+	this->r = r;
+	this->g = g;
+	this->b = b;
+	this->transparent = transparent;
+}
+
+int SoftwareRenderer::VoxelTexture::getMipOffset(int level)
+{
+	int offset = 0;
+	int levelTexelCount = VoxelTexture::TEXEL_COUNT;
+	for (int i = 0; i < level; i++)
+	{
+		offset += levelTexelCount;
+		levelTexelCount /= 4;
+	}
+
+	return offset;
+}
+
+void SoftwareRenderer::VoxelTexture::updateMips()
 {
-	this->r = 0.0;
-	this->g = 0.0;
-	this->b = 0.0;
-	this->transparent = false;
+	for (int level = 1; level < VoxelTexture::MIP_LEVEL_COUNT; level++)
+	{
+		const int srcOffset = VoxelTexture::getMipOffset(level - 1);
+		const int dstOffset = VoxelTexture::getMipOffset(level);
+		const int srcSize = VoxelTexture::WIDTH >> (level - 1);
+		const int dstSize = srcSize / 2;
+
+		for (int x = 0; x < dstSize; x++)
+		{
+			for (int y = 0; y < dstSize; y++)
+			{
+				// The 2x2 block of texels in the previous level.
+				const int srcIndex = srcOffset + (y * 2) + ((x * 2) * srcSize);
+				const std::array<int, 4> srcIndices =
+				{
+					srcIndex, srcIndex + 1, srcIndex + srcSize, srcIndex + srcSize + 1
+				};
+
+				int r = 0, g = 0, b = 0;
+				int opaqueCount = 0, emissiveCount = 0;
+				for (const int index : srcIndices)
+				{
+					const VoxelTexel &texel = this->texels[index];
+					if (!texel.isTransparent())
+					{
+						r += texel.r;
+						g += texel.g;
+						b += texel.b;
+						opaqueCount++;
+						emissiveCount += texel.isEmissive() ? 1 : 0;
+					}
+				}
+
+				const int dstIndex = dstOffset + y + (x * dstSize);
+
+				// Mostly transparent blocks stay transparent so alpha-tested edges keep
+				// their shape.
+				if ((opaqueCount * 2) < static_cast<int>(srcIndices.size()))
+				{
+					this->texels[dstIndex] = VoxelTexel(0, 0, 0, VoxelTexel::FLAG_TRANSPARENT);
+					this->indexedTexels[dstIndex] = TexturePalette::TRANSPARENT_INDEX;
+					continue;
+				}
+
+				const VoxelTexel texel(
+					static_cast<uint8_t>(r / opaqueCount),
+					static_cast<uint8_t>(g / opaqueCount),
+					static_cast<uint8_t>(b / opaqueCount),
+					((emissiveCount * 2) >= opaqueCount) ? VoxelTexel::FLAG_EMISSIVE : 0);
+				this->texels[dstIndex] = texel;
+
+				// Averaged colors would fill up the texture palette, so palette shading uses
+				// the opaque texel closest to the average instead.
+				int closestIndex = srcIndex;
+				int closestDistSqr = std::numeric_limits<int>::max();
+				for (const int index : srcIndices)
+				{
+					const VoxelTexel &srcTexel = this->texels[index];
+					if (!srcTexel.isTransparent())
+					{
+						const int diffR = srcTexel.r - texel.r;
+						const int diffG = srcTexel.g - texel.g;
+						const int diffB = srcTexel.b - texel.b;
+						const int distSqr = (diffR * diffR) + (diffG * diffG) + (diffB * diffB);
+						if (distSqr < closestDistSqr)
+						{
+							closestIndex = index;
+							closestDistSqr = distSqr;
+						}
+					}
+				}
+
+				this->indexedTexels[dstIndex] = this->indexedTexels[closestIndex];
+			}
+		}
+	}
 }
 
 SoftwareRenderer::FlatTexture::FlatTexture()
@@ -44,12 +158,292 @@ SoftwareRenderer::FlatTexture::FlatTexture()
 	this->height = 0;
 }
 
+int SoftwareRenderer::FlatTexture::getMipWidth(int level) const
+{
+	return std::max(this->width >> level, 1);
+}
+
+int SoftwareRenderer::FlatTexture::getMipHeight(int level) const
+{
+	return std::max(this->height >> level, 1);
+}
+
+void SoftwareRenderer::FlatTexture::init(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	// Levels go down to 1x1, even if the texture isn't square.
+	this->mipOffsets.clear();
+	int texelCount = 0;
+	int level = 0;
+	do
+	{
+		this->mipOffsets.push_back(texelCount);
+		texelCount += this->getMipWidth(level) * this->getMipHeight(level);
+		level++;
+	} while ((this->getMipWidth(level - 1) > 1) || (this->getMipHeight(level - 1) > 1));
+
+	this->texels = std::vector<FlatTexel>(texelCount);
+	this->indexedTexels = std::vector<uint8_t>(texelCount);
+}
+
+void SoftwareRenderer::FlatTexture::updateMips()
+{
+	for (int level = 1; level < static_cast<int>(this->mipOffsets.size()); level++)
+	{
+		const int srcOffset = this->mipOffsets[level - 1];
+		const int dstOffset = this->mipOffsets[level];
+		const int srcWidth = this->getMipWidth(level - 1);
+		const int srcHeight = this->getMipHeight(level - 1);
+		const int dstWidth = this->getMipWidth(level);
+		const int dstHeight = this->getMipHeight(level);
+
+		for (int x = 0; x < dstWidth; x++)
+		{
+			// Flat textures can have odd dimensions, so a block is two or three texels wide
+			// (or one if that dimension is already down to one texel).
+			const int srcXStart = (x * srcWidth) / dstWidth;
+			const int srcXEnd = ((x + 1) * srcWidth) / dstWidth;
+
+			for (int y = 0; y < dstHeight; y++)
+			{
+				const int srcYStart = (y * srcHeight) / dstHeight;
+				const int srcYEnd = ((y + 1) * srcHeight) / dstHeight;
+
+				int r = 0, g = 0, b = 0, a = 0;
+				int opaqueCount = 0;
+				for (int srcX = srcXStart; srcX < srcXEnd; srcX++)
+				{
+					for (int srcY = srcYStart; srcY < srcYEnd; srcY++)
+					{
+						const FlatTexel &texel = this->texels[srcOffset + srcY + (srcX * srcHeight)];
+						if (texel.a > 0)
+						{
+							r += texel.r;
+							g += texel.g;
+							b += texel.b;
+							a += texel.a;
+							opaqueCount++;
+						}
+					}
+				}
+
+				const int dstIndex = dstOffset + y + (x * dstHeight);
+				const int blockCount = (srcXEnd - srcXStart) * (srcYEnd - srcYStart);
+
+				// Mostly transparent blocks stay transparent so the flat keeps its outline.
+				if ((opaqueCount * 2) < blockCount)
+				{
+					this->texels[dstIndex] = FlatTexel();
+					this->indexedTexels[dstIndex] = TexturePalette::TRANSPARENT_INDEX;
+					continue;
+				}
+
+				const FlatTexel texel(
+					static_cast<uint8_t>(r / opaqueCount),
+					static_cast<uint8_t>(g / opaqueCount),
+					static_cast<uint8_t>(b / opaqueCount),
+					static_cast<uint8_t>(a / opaqueCount));
+				this->texels[dstIndex] = texel;
+
+				// Palette shading uses the opaque texel closest to the average, like voxel
+				// textures.
+				int closestIndex = srcOffset + srcYStart + (srcXStart * srcHeight);
+				int closestDistSqr = std::numeric_limits<int>::max();
+				for (int srcX = srcXStart; srcX < srcXEnd; srcX++)
+				{
+					for (int srcY = srcYStart; srcY < srcYEnd; srcY++)
+					{
+						const int srcIndex = srcOffset + srcY + (srcX * srcHeight);
+						const FlatTexel &srcTexel = this->texels[srcIndex];
+						if (srcTexel.a > 0)
+						{
+							const int diffR = srcTexel.r - texel.r;
+							const int diffG = srcTexel.g - texel.g;
+							const int diffB = srcTexel.b - texel.b;
+							const int distSqr = (diffR * diffR) + (diffG * diffG) + (diffB * diffB);
+							if (distSqr < closestDistSqr)
+							{
+								closestIndex = srcIndex;
+								closestDistSqr = distSqr;
+							}
+						}
+					}
+				}
+
+				this->indexedTexels[dstIndex] = this->indexedTexels[closestIndex];
+			}
+		}
+	}
+}
+
 SoftwareRenderer::SkyTexture::SkyTexture()
 {
 	this->width = 0;
 	this->height = 0;
 }
 
+// Definitions for texture palette indices that are passed by reference (i.e., to std::fill()).
+const uint8_t SoftwareRenderer::TexturePalette::TRANSPARENT_INDEX;
+const uint8_t SoftwareRenderer::TexturePalette::NIGHT_LIGHT_INDEX;
+
+SoftwareRenderer::TexturePalette::TexturePalette()
+{
+	this->version = 0;
+	this->clear();
+}
+
+uint8_t SoftwareRenderer::TexturePalette::getIndex(uint32_t rgb)
+{
+	const auto iter = this->indices.find(rgb);
+	if (iter != this->indices.end())
+	{
+		return iter->second;
+	}
+
+	const Double3 color = Double3::fromRGB(rgb);
+	const uint8_t index = [this, &color]()
+	{
+		if (static_cast<int>(this->colors.size()) < TexturePalette::COLOR_COUNT)
+		{
+			this->colors.push_back(color);
+			this->version++;
+			return static_cast<uint8_t>(this->colors.size() - 1);
+		}
+		else
+		{
+			// The palette is full, so find the closest color, ignoring the reserved ones.
+			int closestIndex = TexturePalette::NIGHT_LIGHT_INDEX + 1;
+			double closestDistSqr = std::numeric_limits<double>::infinity();
+			for (int i = closestIndex; i < static_cast<int>(this->colors.size()); i++)
+			{
+				const Double3 diff = this->colors[i] - color;
+				const double distSqr = diff.lengthSquared();
+				if (distSqr < closestDistSqr)
+				{
+					closestIndex = i;
+					closestDistSqr = distSqr;
+				}
+			}
+
+			return static_cast<uint8_t>(closestIndex);
+		}
+	}();
+
+	this->indices.insert(std::make_pair(rgb, index));
+	return index;
+}
+
+void SoftwareRenderer::TexturePalette::clear()
+{
+	this->colors.clear();
+	this->indices.clear();
+
+	// Reserved colors. These aren't in the look-up table so regular texels never map
+	// to them.
+	this->colors.push_back(Double3::fromRGB(Color::Black.toRGB()));
+	this->colors.push_back(Double3::fromRGB(Color(255, 166, 0).toRGB()));
+	this->version++;
+}
+
+SoftwareRenderer::Colormap::Colormap()
+{
+	this->ambient = 0.0;
+	this->paletteVersion = -1;
+}
+
+int SoftwareRenderer::Colormap::getLightLevel(double lightNormalDot)
+{
+	const int level = static_cast<int>(
+		(lightNormalDot * static_cast<double>(Colormap::LIGHT_LEVELS - 1)) + 0.50);
+	return std::max(std::min(level, Colormap::LIGHT_LEVELS - 1), 0);
+}
+
+int SoftwareRenderer::Colormap::getFogLevel(double fogPercent)
+{
+	const int level = static_cast<int>(
+		(fogPercent * static_cast<double>(Colormap::FOG_LEVELS - 1)) + 0.50);
+	return std::max(std::min(level, Colormap::FOG_LEVELS - 1), 0);
+}
+
+const uint32_t *SoftwareRenderer::Colormap::getColors(int lightLevel, int fogLevel) const
+{
+	const int rowIndex = fogLevel + (lightLevel * Colormap::FOG_LEVELS);
+	return this->colors.data() + (rowIndex * TexturePalette::COLOR_COUNT);
+}
+
+void SoftwareRenderer::Colormap::update(const TexturePalette &palette, double ambient,
+	const Double3 &sunColor, const Double3 &fogColor)
+{
+	const bool isDirty = (palette.version != this->paletteVersion) ||
+		(ambient != this->ambient) || (sunColor != this->sunColor) ||
+		(fogColor != this->fogColor);
+
+	if (!isDirty)
+	{
+		return;
+	}
+
+	this->sunColor = sunColor;
+	this->fogColor = fogColor;
+	this->ambient = ambient;
+	this->paletteVersion = palette.version;
+
+	this->colors.resize(Colormap::LIGHT_LEVELS * Colormap::FOG_LEVELS *
+		TexturePalette::COLOR_COUNT);
+
+	const int paletteCount = static_cast<int>(palette.colors.size());
+	for (int lightLevel = 0; lightLevel < Colormap::LIGHT_LEVELS; lightLevel++)
+	{
+		// Same shading as the true color drawers, but with a quantized sun contribution.
+		const double lightNormalDot = static_cast<double>(lightLevel) /
+			static_cast<double>(Colormap::LIGHT_LEVELS - 1);
+		const Double3 sunComponent = (sunColor * lightNormalDot).clamped(0.0, 1.0 - ambient);
+		const Double3 shading(
+			ambient + sunComponent.x,
+			ambient + sunComponent.y,
+			ambient + sunComponent.z);
+
+		for (int fogLevel = 0; fogLevel < Colormap::FOG_LEVELS; fogLevel++)
+		{
+			const double fogPercent = static_cast<double>(fogLevel) /
+				static_cast<double>(Colormap::FOG_LEVELS - 1);
+			uint32_t *dstColors = this->colors.data() +
+				((fogLevel + (lightLevel * Colormap::FOG_LEVELS)) * TexturePalette::COLOR_COUNT);
+
+			for (int i = 0; i < paletteCount; i++)
+			{
+				const Double3 &texel = palette.colors[i];
+				const double emission = (i == TexturePalette::NIGHT_LIGHT_INDEX) ? 1.0 : 0.0;
+
+				// Texture color with shading.
+				const double shadingMax = 1.0;
+				double colorR = texel.x * std::min(shading.x + emission, shadingMax);
+				double colorG = texel.y * std::min(shading.y + emission, shadingMax);
+				double colorB = texel.z * std::min(shading.z + emission, shadingMax);
+
+				// Linearly interpolate with fog.
+				colorR += (fogColor.x - colorR) * fogPercent;
+				colorG += (fogColor.y - colorG) * fogPercent;
+				colorB += (fogColor.z - colorB) * fogPercent;
+
+				// Clamp maximum (don't worry about negative values).
+				const double high = 1.0;
+				colorR = (colorR > high) ? high : colorR;
+				colorG = (colorG > high) ? high : colorG;
+				colorB = (colorB > high) ? high : colorB;
+
+				// Convert floats to integers.
+				dstColors[i] = static_cast<uint32_t>(
+					((static_cast<uint8_t>(colorR * 255.0)) << 16) |
+					((static_cast<uint8_t>(colorG * 255.0)) << 8) |
+					((static_cast<uint8_t>(colorB * 255.0))));
+			}
+		}
+	}
+}
+
 SoftwareRenderer::Camera::Camera(const Double3 &eye, const Double3 &direction,
 	double fovY, double aspect, double projectionModifier)
 	: eye(eye), direction(direction)
@@ -146,7 +540,9 @@ SoftwareRenderer::Ray::Ray(double dirX, double dirZ)
 	this->dirZ = dirZ;
 }
 
-SoftwareRenderer::DrawRange::DrawRange(double yProjStart, double yProjEnd, int yStart, int yEnd)
+SoftwareRenderer::DrawRange::DrawRange(const Double3 &startPoint, const Double3 &endPoint,
+	double yProjStart, double yProjEnd, int yStart, int yEnd)
+	: startPoint(startPoint), endPoint(endPoint)
 {
 	this->yProjStart = yProjStart;
 	this->yProjEnd = yProjEnd;
@@ -206,106 +602,1494 @@ void SoftwareRenderer::OcclusionData::update(int yStart, int yEnd)
 	}
 }
 
-SoftwareRenderer::ShadingInfo::ShadingInfo(const std::vector<Double3> &skyPalette,
-	double daytimePercent, double ambient, double fogDistance)
+SoftwareRenderer::RenderVoxel::RenderVoxel()
 {
-	// The "sliding window" of sky colors is backwards in the AM (horizon is latest in the palette)
-	// and forwards in the PM (horizon is earliest in the palette).
-	this->isAM = daytimePercent < 0.50;
-	const int slideDirection = this->isAM ? -1 : 1;
+	this->dataType = VoxelDataType::None;
+	this->textureID = 0;
+	this->floorID = 0;
+	this->ceilingID = 0;
+	this->subtype = 0;
+	this->flags = 0;
+	this->shapeIndex = 0;
+}
 
-	// Get the real index (not the integer index) of the color for the current time as a
-	// reference point so each sky color can be interpolated between two samples via 'percent'.
-	const double realIndex = static_cast<double>(skyPalette.size()) * daytimePercent;
-	const double percent = realIndex - std::floor(realIndex);
+SoftwareRenderer::RenderVoxel SoftwareRenderer::RenderVoxel::make(const VoxelData &voxelData,
+	uint16_t voxelID)
+{
+	RenderVoxel renderVoxel;
+	renderVoxel.dataType = voxelData.dataType;
+	renderVoxel.shapeIndex = voxelID;
 
-	// Lambda for keeping the given index within the palette range.
-	auto wrapIndex = [&skyPalette](int index)
+	if (voxelData.dataType == VoxelDataType::Wall)
 	{
-		const int paletteCount = static_cast<int>(skyPalette.size());
-
-		while (index >= paletteCount)
-		{
-			index -= paletteCount;
-		}
-
-		while (index < 0)
-		{
-			index += paletteCount;
-		}
-
-		return index;
-	};
-
-	// Calculate sky colors based on the time of day.
-	for (int i = 0; i < static_cast<int>(this->skyColors.size()); i++)
+		const VoxelData::WallData &wallData = voxelData.wall;
+		renderVoxel.textureID = static_cast<uint8_t>(wallData.sideID);
+		renderVoxel.floorID = static_cast<uint8_t>(wallData.floorID);
+		renderVoxel.ceilingID = static_cast<uint8_t>(wallData.ceilingID);
+	}
+	else if (voxelData.dataType == VoxelDataType::Floor)
 	{
-		const int indexDiff = slideDirection * i;
-		const int index = wrapIndex(static_cast<int>(realIndex) + indexDiff);
-		const int nextIndex = wrapIndex(index + slideDirection);
-		const Double3 &color = skyPalette.at(index);
-		const Double3 &nextColor = skyPalette.at(nextIndex);
-
-		this->skyColors.at(i) = color.lerp(nextColor, this->isAM ? (1.0 - percent) : percent);
+		renderVoxel.textureID = static_cast<uint8_t>(voxelData.floor.id);
 	}
-
-	// The sun rises in the west (-Z) and sets in the east (+Z).
-	this->sunDirection = [daytimePercent]()
+	else if (voxelData.dataType == VoxelDataType::Ceiling)
 	{
-		const double radians = daytimePercent * Constants::TwoPi;
-		return Double3(0.0, -std::cos(radians), -std::sin(radians)).normalized();
-	}();
-	
-	this->sunColor = [this]()
+		renderVoxel.textureID = static_cast<uint8_t>(voxelData.ceiling.id);
+	}
+	else if (voxelData.dataType == VoxelDataType::Raised)
 	{
-		const Double3 baseSunColor(0.90, 0.875, 0.85);
-
-		// Darken the sun color if it's below the horizon so wall faces aren't lit 
-		// as much during the night. This is just an artistic value to compensate
-		// for the lack of shadows.
-		return (this->sunDirection.y >= 0.0) ? baseSunColor :
-			(baseSunColor * (1.0 - (5.0 * std::abs(this->sunDirection.y)))).clamped();
-	}();
-
-	this->ambient = ambient;
-
-	// At their darkest, distant objects are ~1/4 of their intensity.
-	this->distantAmbient = MathUtils::clamp(ambient, 0.25, 1.0);
-
-	this->fogDistance = fogDistance;
-}
+		const VoxelData::RaisedData &raisedData = voxelData.raised;
+		renderVoxel.textureID = static_cast<uint8_t>(raisedData.sideID);
+		renderVoxel.floorID = static_cast<uint8_t>(raisedData.floorID);
+		renderVoxel.ceilingID = static_cast<uint8_t>(raisedData.ceilingID);
+	}
+	else if (voxelData.dataType == VoxelDataType::Diagonal)
+	{
+		const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+		renderVoxel.textureID = static_cast<uint8_t>(diagData.id);
+		renderVoxel.flags = diagData.type1 ? RenderVoxel::FLAG_DIAGONAL_TYPE1 : 0;
+	}
+	else if (voxelData.dataType == VoxelDataType::TransparentWall)
+	{
+		renderVoxel.textureID = static_cast<uint8_t>(voxelData.transparentWall.id);
+	}
+	else if (voxelData.dataType == VoxelDataType::Edge)
+	{
+		const VoxelData::EdgeData &edgeData = voxelData.edge;
+		renderVoxel.textureID = static_cast<uint8_t>(edgeData.id);
+		renderVoxel.subtype = static_cast<uint8_t>(edgeData.facing);
+		renderVoxel.flags = edgeData.flipped ? RenderVoxel::FLAG_EDGE_FLIPPED : 0;
+	}
+	else if (voxelData.dataType == VoxelDataType::Chasm)
+	{
+		const VoxelData::ChasmData &chasmData = voxelData.chasm;
+		renderVoxel.textureID = static_cast<uint8_t>(chasmData.id);
+		renderVoxel.subtype = static_cast<uint8_t>(chasmData.type);
+		renderVoxel.flags =
+			(chasmData.north ? RenderVoxel::FLAG_CHASM_NORTH : 0) |
+			(chasmData.east ? RenderVoxel::FLAG_CHASM_EAST : 0) |
+			(chasmData.south ? RenderVoxel::FLAG_CHASM_SOUTH : 0) |
+			(chasmData.west ? RenderVoxel::FLAG_CHASM_WEST : 0);
+	}
+	else if (voxelData.dataType == VoxelDataType::Door)
+	{
+		const VoxelData::DoorData &doorData = voxelData.door;
+		renderVoxel.textureID = static_cast<uint8_t>(doorData.id);
+		renderVoxel.subtype = static_cast<uint8_t>(doorData.type);
+	}
 
-const Double3 &SoftwareRenderer::ShadingInfo::getFogColor() const
-{
-	// The fog color is the same as the horizon color.
-	return this->skyColors.front();
+	return renderVoxel;
 }
 
-SoftwareRenderer::FrameView::FrameView(uint32_t *colorBuffer, double *depthBuffer, 
-	int width, int height)
+VoxelData::Facing SoftwareRenderer::RenderVoxel::getEdgeFacing() const
 {
-	this->colorBuffer = colorBuffer;
-	this->depthBuffer = depthBuffer;
-	this->width = width;
-	this->height = height;
-	this->widthReal = static_cast<double>(width);
-	this->heightReal = static_cast<double>(height);
+	return static_cast<VoxelData::Facing>(this->subtype);
 }
 
-SoftwareRenderer::VisibleFlat::VisibleFlat(const Flat &flat, Flat::Frame &&frame)
+VoxelData::ChasmData::Type SoftwareRenderer::RenderVoxel::getChasmType() const
 {
-	this->flat = &flat;
-	this->frame = std::move(frame);
+	return static_cast<VoxelData::ChasmData::Type>(this->subtype);
 }
 
-const SoftwareRenderer::Flat &SoftwareRenderer::VisibleFlat::getFlat() const
+VoxelData::DoorData::Type SoftwareRenderer::RenderVoxel::getDoorType() const
 {
-	return *this->flat;
+	return static_cast<VoxelData::DoorData::Type>(this->subtype);
 }
 
-const SoftwareRenderer::Flat::Frame &SoftwareRenderer::VisibleFlat::getFrame() const
+bool SoftwareRenderer::RenderVoxel::chasmFaceIsVisible(VoxelData::Facing facing) const
 {
-	return this->frame;
+	const uint8_t flag = [facing]()
+	{
+		if (facing == VoxelData::Facing::PositiveX)
+		{
+			return RenderVoxel::FLAG_CHASM_NORTH;
+		}
+		else if (facing == VoxelData::Facing::PositiveZ)
+		{
+			return RenderVoxel::FLAG_CHASM_EAST;
+		}
+		else if (facing == VoxelData::Facing::NegativeX)
+		{
+			return RenderVoxel::FLAG_CHASM_SOUTH;
+		}
+		else
+		{
+			return RenderVoxel::FLAG_CHASM_WEST;
+		}
+	}();
+
+	return (this->flags & flag) != 0;
+}
+
+SoftwareRenderer::RenderVoxelShape::RenderVoxelShape()
+{
+	this->yOffset = 0.0;
+	this->ySize = 0.0;
+	this->vTop = 0.0;
+	this->vBottom = 0.0;
+}
+
+SoftwareRenderer::RenderVoxelGrid::RenderVoxelGrid()
+{
+	this->voxelGrid = nullptr;
+	this->width = 0;
+	this->height = 0;
+	this->depth = 0;
+}
+
+void SoftwareRenderer::RenderVoxelGrid::init(const VoxelGrid &voxelGrid)
+{
+	this->voxelGrid = &voxelGrid;
+	this->width = voxelGrid.getWidth();
+	this->height = voxelGrid.getHeight();
+	this->depth = voxelGrid.getDepth();
+	this->voxels = std::vector<RenderVoxel>(this->width * this->height * this->depth);
+
+	// Floor and ceiling planes are numbered by voxel boundary in a byte.
+	DebugAssertMsg(this->height < 255, "Voxel grid is too tall for plane IDs.");
+	this->shapes.clear();
+
+	for (int z = 0; z < this->depth; z++)
+	{
+		for (int x = 0; x < this->width; x++)
+		{
+			for (int y = 0; y < this->height; y++)
+			{
+				this->update(x, y, z, voxelGrid);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::RenderVoxelGrid::update(int x, int y, int z, const VoxelGrid &voxelGrid)
+{
+	const uint16_t voxelID = voxelGrid.getVoxel(x, y, z);
+	const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+	const int index = ((x + (z * this->width)) * this->height) + y;
+	this->voxels[index] = RenderVoxel::make(voxelData, voxelID);
+
+	// Only raised platforms and edges have a shape. Voxels with the same ID share it.
+	if ((voxelData.dataType == VoxelDataType::Raised) ||
+		(voxelData.dataType == VoxelDataType::Edge))
+	{
+		if (voxelID >= this->shapes.size())
+		{
+			this->shapes.resize(voxelID + 1);
+		}
+
+		RenderVoxelShape &shape = this->shapes[voxelID];
+		if (voxelData.dataType == VoxelDataType::Raised)
+		{
+			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			shape.yOffset = raisedData.yOffset;
+			shape.ySize = raisedData.ySize;
+			shape.vTop = raisedData.vTop;
+			shape.vBottom = raisedData.vBottom;
+		}
+		else
+		{
+			shape.yOffset = voxelData.edge.yOffset;
+		}
+	}
+}
+
+bool SoftwareRenderer::RenderVoxelGrid::matches(const VoxelGrid &voxelGrid) const
+{
+	return (this->voxelGrid == &voxelGrid) && (this->width == voxelGrid.getWidth()) &&
+		(this->height == voxelGrid.getHeight()) && (this->depth == voxelGrid.getDepth());
+}
+
+const SoftwareRenderer::RenderVoxel *SoftwareRenderer::RenderVoxelGrid::getColumn(int x,
+	int z) const
+{
+	return this->voxels.data() + ((x + (z * this->width)) * this->height);
+}
+
+const int SoftwareRenderer::VisibilityGrid::NO_ROOM = -1;
+
+SoftwareRenderer::VisibilityGrid::VisibilityGrid()
+{
+	this->maxDistance = 0.0;
+	this->width = 0;
+	this->depth = 0;
+	this->blockWidth = 0;
+	this->blockDepth = 0;
+	this->blockRowSize = 0;
+	this->cameraBlock = 0;
+	this->isActive = false;
+}
+
+bool SoftwareRenderer::VisibilityGrid::init(const RenderVoxelGrid &voxelGrid, double maxDistance,
+	const std::atomic<bool> &isCancelled)
+{
+	const int blockSize = VoxelGrid::BLOCK_SIZE;
+	this->width = voxelGrid.width;
+	this->depth = voxelGrid.depth;
+	this->blockWidth = (this->width + blockSize - 1) / blockSize;
+	this->blockDepth = (this->depth + blockSize - 1) / blockSize;
+	this->blockRowSize = ((this->blockWidth * this->blockDepth) + 31) / 32;
+	this->maxDistance = maxDistance;
+	this->isActive = false;
+
+	// A voxel column is solid if nothing can be seen through any of its voxels, and it's a
+	// door if its only voxel that isn't solid is a door. Floors and ceilings are only solid
+	// at the bottom and top of the grid since they're just one face of the voxel.
+	const int columnCount = this->width * this->depth;
+	std::vector<bool> solidColumns(columnCount, false);
+	std::vector<int> doorTextureIDs(columnCount, -1);
+	for (int z = 0; z < this->depth; z++)
+	{
+		for (int x = 0; x < this->width; x++)
+		{
+			const RenderVoxel *column = voxelGrid.getColumn(x, z);
+			int openCount = 0;
+			int doorCount = 0;
+			int doorTextureID = -1;
+			for (int y = 0; y < voxelGrid.height; y++)
+			{
+				const VoxelDataType dataType = column[y].dataType;
+				if (dataType == VoxelDataType::Door)
+				{
+					doorTextureID = column[y].textureID;
+					doorCount++;
+				}
+				else if ((dataType != VoxelDataType::Wall) &&
+					!((dataType == VoxelDataType::Floor) && (y == 0)) &&
+					!((dataType == VoxelDataType::Ceiling) && (y == (voxelGrid.height - 1))))
+				{
+					openCount++;
+				}
+			}
+
+			const int index = x + (z * this->width);
+			solidColumns[index] = (openCount == 0) && (doorCount == 0);
+			if ((openCount == 0) && (doorCount == 1))
+			{
+				doorTextureIDs[index] = doorTextureID;
+			}
+		}
+	}
+
+	// Flood fill rooms through columns that touch, including at corners, since lines can
+	// pass between them there.
+	this->rooms = std::vector<int>(columnCount, VisibilityGrid::NO_ROOM);
+	this->roomDoors.clear();
+	this->doors.clear();
+	std::vector<int> columnStack;
+	for (int i = 0; i < columnCount; i++)
+	{
+		if (solidColumns[i] || (this->rooms[i] != VisibilityGrid::NO_ROOM))
+		{
+			continue;
+		}
+
+		const int room = static_cast<int>(this->roomDoors.size());
+		this->rooms[i] = room;
+
+		if (doorTextureIDs[i] != -1)
+		{
+			VisibilityGrid::Door door;
+			door.x = i % this->width;
+			door.z = i / this->width;
+			door.textureID = doorTextureIDs[i];
+			this->roomDoors.push_back(static_cast<int>(this->doors.size()));
+			this->doors.push_back(door);
+			continue;
+		}
+
+		this->roomDoors.push_back(-1);
+		columnStack.push_back(i);
+		while (columnStack.size() > 0)
+		{
+			const int index = columnStack.back();
+			columnStack.pop_back();
+
+			const int x = index % this->width;
+			const int z = index / this->width;
+			for (int neighborZ = std::max(z - 1, 0);
+				neighborZ <= std::min(z + 1, this->depth - 1); neighborZ++)
+			{
+				for (int neighborX = std::max(x - 1, 0);
+					neighborX <= std::min(x + 1, this->width - 1); neighborX++)
+				{
+					const int neighborIndex = neighborX + (neighborZ * this->width);
+					if (!solidColumns[neighborIndex] && (doorTextureIDs[neighborIndex] == -1) &&
+						(this->rooms[neighborIndex] == VisibilityGrid::NO_ROOM))
+					{
+						this->rooms[neighborIndex] = room;
+						columnStack.push_back(neighborIndex);
+					}
+				}
+			}
+		}
+	}
+
+	// Doors connect the rooms around them.
+	const int roomCount = static_cast<int>(this->roomDoors.size());
+	this->roomNeighbors = std::vector<std::vector<int>>(roomCount);
+	for (const VisibilityGrid::Door &door : this->doors)
+	{
+		const int doorRoom = this->rooms[door.x + (door.z * this->width)];
+		for (int neighborZ = std::max(door.z - 1, 0);
+			neighborZ <= std::min(door.z + 1, this->depth - 1); neighborZ++)
+		{
+			for (int neighborX = std::max(door.x - 1, 0);
+				neighborX <= std::min(door.x + 1, this->width - 1); neighborX++)
+			{
+				const int neighborRoom = this->rooms[neighborX + (neighborZ * this->width)];
+				if ((neighborRoom != VisibilityGrid::NO_ROOM) && (neighborRoom != doorRoom))
+				{
+					this->roomNeighbors[doorRoom].push_back(neighborRoom);
+					this->roomNeighbors[neighborRoom].push_back(doorRoom);
+				}
+			}
+		}
+	}
+
+	for (std::vector<int> &neighbors : this->roomNeighbors)
+	{
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	}
+
+	this->visibleRooms = std::vector<bool>(roomCount, false);
+	this->roomQueue.reserve(roomCount);
+
+	// Anything seen from inside a block is seen along a line through one of its edges, so rays
+	// are cast outward from points along each edge. The line is never more than the margin
+	// away from the nearest cast ray, so solid columns are shrunk by the margin except on sides
+	// next to other solid columns. Cast rays then only stop where the line would be stopped
+	// too, and the blocks next to the ones they pass through are marked as well.
+	const double margin = 0.25;
+	const double originSpacing = margin;
+	const double angleSpacing = margin / maxDistance;
+
+	auto isSolid = [this, &solidColumns](int x, int z)
+	{
+		// Outside the grid counts as solid so columns along the edge aren't shrunk there.
+		const bool inGrid = (x >= 0) && (x < this->width) && (z >= 0) && (z < this->depth);
+		return !inGrid || solidColumns[x + (z * this->width)];
+	};
+
+	// Whether a part of a ray is in the shrunk shape of a solid column, which is a cross of
+	// two bands that each reach the sides next to other solid columns.
+	auto hitsSolidColumn = [&isSolid, margin](int x, int z, const Double2 &origin,
+		const Double2 &direction, double startT, double endT)
+	{
+		auto hitsBox = [&origin, &direction, startT, endT](double minX, double maxX,
+			double minZ, double maxZ)
+		{
+			double nearT = startT;
+			double farT = endT;
+			auto clipAxis = [&nearT, &farT](double originValue, double directionValue,
+				double minValue, double maxValue)
+			{
+				if (directionValue == 0.0)
+				{
+					return (originValue >= minValue) && (originValue <= maxValue);
+				}
+
+				const double minT = (minValue - originValue) / directionValue;
+				const double maxT = (maxValue - originValue) / directionValue;
+				nearT = std::max(nearT, std::min(minT, maxT));
+				farT = std::min(farT, std::max(minT, maxT));
+				return nearT <= farT;
+			};
+
+			return clipAxis(origin.x, direction.x, minX, maxX) &&
+				clipAxis(origin.y, direction.y, minZ, maxZ);
+		};
+
+		const double xReal = static_cast<double>(x);
+		const double zReal = static_cast<double>(z);
+		const double minX = xReal + (isSolid(x - 1, z) ? 0.0 : margin);
+		const double maxX = xReal + 1.0 - (isSolid(x + 1, z) ? 0.0 : margin);
+		const double minZ = zReal + (isSolid(x, z - 1) ? 0.0 : margin);
+		const double maxZ = zReal + 1.0 - (isSolid(x, z + 1) ? 0.0 : margin);
+		return hitsBox(minX, maxX, zReal + margin, zReal + 1.0 - margin) ||
+			hitsBox(xReal + margin, xReal + 1.0 - margin, minZ, maxZ);
+	};
+
+	auto markColumn = [this, blockSize](uint32_t *bits, int x, int z)
+	{
+		const int minBlockX = std::max(x - 1, 0) / blockSize;
+		const int maxBlockX = std::min(x + 1, this->width - 1) / blockSize;
+		const int minBlockZ = std::max(z - 1, 0) / blockSize;
+		const int maxBlockZ = std::min(z + 1, this->depth - 1) / blockSize;
+		for (int blockZ = minBlockZ; blockZ <= maxBlockZ; blockZ++)
+		{
+			for (int blockX = minBlockX; blockX <= maxBlockX; blockX++)
+			{
+				const int block = blockX + (blockZ * this->blockWidth);
+				bits[block >> 5] |= 1u << (block & 31);
+			}
+		}
+	};
+
+	// Columns are marked with the block whose rays reached them, and turned into block bits
+	// once all of that block's rays are cast.
+	std::vector<int> seenColumns(columnCount, -1);
+
+	auto castRay = [this, maxDistance, &solidColumns, &hitsSolidColumn, &seenColumns](
+		int block, const Double2 &origin, const Double2 &direction)
+	{
+		// Start in the column the ray goes into from the edge.
+		int x = static_cast<int>(std::floor(origin.x + (direction.x * Constants::Epsilon)));
+		int z = static_cast<int>(std::floor(origin.y + (direction.y * Constants::Epsilon)));
+		const int stepX = (direction.x >= 0.0) ? 1 : -1;
+		const int stepZ = (direction.y >= 0.0) ? 1 : -1;
+		const double infinity = std::numeric_limits<double>::infinity();
+		const double deltaX = (direction.x != 0.0) ? std::abs(1.0 / direction.x) : infinity;
+		const double deltaZ = (direction.y != 0.0) ? std::abs(1.0 / direction.y) : infinity;
+		double nextX = (direction.x != 0.0) ? ((static_cast<double>(x + ((stepX + 1) / 2)) -
+			origin.x) / direction.x) : infinity;
+		double nextZ = (direction.y != 0.0) ? ((static_cast<double>(z + ((stepZ + 1) / 2)) -
+			origin.y) / direction.y) : infinity;
+		double t = 0.0;
+
+		while ((t < maxDistance) && (x >= 0) && (x < this->width) && (z >= 0) &&
+			(z < this->depth))
+		{
+			const int index = x + (z * this->width);
+			const bool isStopped = solidColumns[index] && hitsSolidColumn(x, z, origin,
+				direction, t, std::min(std::min(nextX, nextZ), maxDistance));
+			seenColumns[index] = block;
+
+			if (isStopped)
+			{
+				break;
+			}
+
+			if (nextX < nextZ)
+			{
+				x += stepX;
+				t = nextX;
+				nextX += deltaX;
+			}
+			else
+			{
+				z += stepZ;
+				t = nextZ;
+				nextZ += deltaZ;
+			}
+		}
+	};
+
+	// Ray directions for each block edge, covering every direction that leaves through it.
+	// Edges are in -X, +X, -Z, +Z order.
+	const int directionCount = static_cast<int>(std::ceil(Constants::Pi / angleSpacing)) + 1;
+	const std::array<double, 4> edgeAngles = { Constants::Pi, 0.0, -Constants::HalfPi, Constants::HalfPi };
+	std::array<std::vector<Double2>, 4> edgeDirections;
+	for (size_t i = 0; i < edgeDirections.size(); i++)
+	{
+		std::vector<Double2> &directions = edgeDirections[i];
+		directions.resize(directionCount);
+		for (int j = 0; j < directionCount; j++)
+		{
+			const double percent = static_cast<double>(j) / static_cast<double>(directionCount - 1);
+			const double angle = edgeAngles[i] - Constants::HalfPi + (percent * Constants::Pi);
+			directions[j] = Double2(std::cos(angle), std::sin(angle));
+		}
+	}
+
+	this->blockBits = std::vector<uint32_t>(
+		this->blockWidth * this->blockDepth * this->blockRowSize, 0);
+
+	for (int blockZ = 0; blockZ < this->blockDepth; blockZ++)
+	{
+		for (int blockX = 0; blockX < this->blockWidth; blockX++)
+		{
+			if (isCancelled)
+			{
+				return false;
+			}
+
+			const int block = blockX + (blockZ * this->blockWidth);
+			uint32_t *bits = this->blockBits.data() + (block * this->blockRowSize);
+			const int startX = blockX * blockSize;
+			const int startZ = blockZ * blockSize;
+			const int endX = std::min(startX + blockSize, this->width);
+			const int endZ = std::min(startZ + blockSize, this->depth);
+
+			bool hasRoom = false;
+			for (int z = startZ; z < endZ; z++)
+			{
+				for (int x = startX; x < endX; x++)
+				{
+					hasRoom |= !solidColumns[x + (z * this->width)];
+				}
+			}
+
+			// The camera is only in an entirely solid block if it's somewhere it shouldn't be,
+			// so it can see everything from there.
+			if (!hasRoom)
+			{
+				std::fill(bits, bits + this->blockRowSize, ~0u);
+				continue;
+			}
+
+			bits[block >> 5] |= 1u << (block & 31);
+
+			const std::array<Double2, 4> edgeStarts =
+			{
+				Double2(startX, startZ), Double2(endX, startZ),
+				Double2(startX, startZ), Double2(startX, endZ)
+			};
+
+			const std::array<Double2, 4> edgeEnds =
+			{
+				Double2(startX, endZ), Double2(endX, endZ),
+				Double2(endX, startZ), Double2(endX, endZ)
+			};
+
+			// Edges along the outside of the grid have nothing past them.
+			const std::array<bool, 4> edgeHasNeighbor =
+			{
+				startX > 0, endX < this->width, startZ > 0, endZ < this->depth
+			};
+
+			for (size_t i = 0; i < edgeStarts.size(); i++)
+			{
+				if (!edgeHasNeighbor[i])
+				{
+					continue;
+				}
+
+				const Double2 &edgeStart = edgeStarts[i];
+				const Double2 edgeDiff = edgeEnds[i] - edgeStart;
+				const int originCount = static_cast<int>(
+					std::ceil(edgeDiff.length() / originSpacing)) + 1;
+				for (int j = 0; j < originCount; j++)
+				{
+					const double percent = static_cast<double>(j) /
+						static_cast<double>(originCount - 1);
+					const Double2 origin = edgeStart + (edgeDiff * percent);
+					for (const Double2 &direction : edgeDirections[i])
+					{
+						castRay(block, origin, direction);
+					}
+				}
+			}
+
+			for (int z = 0; z < this->depth; z++)
+			{
+				for (int x = 0; x < this->width; x++)
+				{
+					if (seenColumns[x + (z * this->width)] == block)
+					{
+						markColumn(bits, x, z);
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+void SoftwareRenderer::VisibilityGrid::update(const Double3 &eye, double fogDistance,
+	const VoxelGrid &voxelGrid, const LevelData::OpenDoors &openDoors,
+	const std::vector<VoxelTexture> &voxelTextures)
+{
+	this->isActive = false;
+
+	const bool matchesGrid = (this->width == voxelGrid.getWidth()) &&
+		(this->depth == voxelGrid.getDepth());
+	if (this->blockBits.empty() || !matchesGrid || (fogDistance > this->maxDistance))
+	{
+		return;
+	}
+
+	const int eyeX = static_cast<int>(std::floor(eye.x));
+	const int eyeZ = static_cast<int>(std::floor(eye.z));
+	const bool eyeInGrid = (eyeX >= 0) && (eyeX < this->width) && (eyeZ >= 0) &&
+		(eyeZ < this->depth);
+	if (!eyeInGrid)
+	{
+		return;
+	}
+
+	const int eyeRoom = this->rooms[eyeX + (eyeZ * this->width)];
+	if (eyeRoom == VisibilityGrid::NO_ROOM)
+	{
+		return;
+	}
+
+	this->cameraBlock = (eyeX / VoxelGrid::BLOCK_SIZE) +
+		((eyeZ / VoxelGrid::BLOCK_SIZE) * this->blockWidth);
+
+	// Search outward from the camera's room. The near side of a closed door can be seen, but
+	// not past it unless it's opening or closing, or has see-through texels.
+	std::fill(this->visibleRooms.begin(), this->visibleRooms.end(), false);
+	this->visibleRooms[eyeRoom] = true;
+	this->roomQueue.clear();
+	this->roomQueue.push_back(eyeRoom);
+
+	for (size_t i = 0; i < this->roomQueue.size(); i++)
+	{
+		const int room = this->roomQueue[i];
+		const int doorIndex = this->roomDoors[room];
+		if ((doorIndex != -1) && (room != eyeRoom))
+		{
+			const VisibilityGrid::Door &door = this->doors[doorIndex];
+			const bool isClosed = openDoors.find(Int2(door.x, door.z)) == nullptr;
+			if (isClosed && !voxelTextures.at(door.textureID).hasTransparentTexels)
+			{
+				continue;
+			}
+		}
+
+		for (const int neighborRoom : this->roomNeighbors[room])
+		{
+			if (!this->visibleRooms[neighborRoom])
+			{
+				this->visibleRooms[neighborRoom] = true;
+				this->roomQueue.push_back(neighborRoom);
+			}
+		}
+	}
+
+	this->isActive = true;
+}
+
+bool SoftwareRenderer::VisibilityGrid::isColumnVisible(int x, int z) const
+{
+	if (!this->isActive)
+	{
+		return true;
+	}
+
+	const int block = (x / VoxelGrid::BLOCK_SIZE) + ((z / VoxelGrid::BLOCK_SIZE) * this->blockWidth);
+	const uint32_t *bits = this->blockBits.data() + (this->cameraBlock * this->blockRowSize);
+	if ((bits[block >> 5] & (1u << (block & 31))) == 0)
+	{
+		return false;
+	}
+
+	// Solid columns have no room, but their faces can be seen from the rooms around them.
+	const int room = this->rooms[x + (z * this->width)];
+	return (room == VisibilityGrid::NO_ROOM) || this->visibleRooms[room];
+}
+
+bool SoftwareRenderer::VisibilityGrid::isCircleVisible(const Double2 &center, double radius) const
+{
+	if (!this->isActive)
+	{
+		return true;
+	}
+
+	const int minX = static_cast<int>(std::floor(center.x - radius));
+	const int maxX = static_cast<int>(std::floor(center.x + radius));
+	const int minZ = static_cast<int>(std::floor(center.y - radius));
+	const int maxZ = static_cast<int>(std::floor(center.y + radius));
+	if ((minX < 0) || (maxX >= this->width) || (minZ < 0) || (maxZ >= this->depth))
+	{
+		return true;
+	}
+
+	// Anything inside a solid column is hidden by it.
+	for (int z = minZ; z <= maxZ; z++)
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			const int room = this->rooms[x + (z * this->width)];
+			if ((room != VisibilityGrid::NO_ROOM) && this->isColumnVisible(x, z))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+SoftwareRenderer::Light::Light(int id, const Double3 &point, const Double3 &color,
+	double intensity)
+	: point(point), color(color)
+{
+	this->id = id;
+	this->intensity = intensity;
+}
+
+bool SoftwareRenderer::Light::getVoxelRange(int gridWidth, int gridDepth, int *startX,
+	int *endX, int *startZ, int *endZ) const
+{
+	*startX = std::max(static_cast<int>(std::floor(this->point.x - this->intensity)), 0);
+	*endX = std::min(static_cast<int>(std::floor(this->point.x + this->intensity)) + 1, gridWidth);
+	*startZ = std::max(static_cast<int>(std::floor(this->point.z - this->intensity)), 0);
+	*endZ = std::min(static_cast<int>(std::floor(this->point.z + this->intensity)) + 1, gridDepth);
+	return (this->intensity > 0.0) && (*startX < *endX) && (*startZ < *endZ);
+}
+
+SoftwareRenderer::LightGrid::LightGrid()
+{
+	this->width = 0;
+	this->depth = 0;
+}
+
+void SoftwareRenderer::LightGrid::init(int width, int depth, const std::vector<Light> &lights)
+{
+	this->width = width;
+	this->depth = depth;
+	this->cells.clear();
+	this->cells.resize(width * depth);
+
+	for (int i = 0; i < static_cast<int>(lights.size()); i++)
+	{
+		this->addLight(i, lights[i]);
+	}
+}
+
+void SoftwareRenderer::LightGrid::addLight(int lightIndex, const Light &light)
+{
+	int startX, endX, startZ, endZ;
+	if (!light.getVoxelRange(this->width, this->depth, &startX, &endX, &startZ, &endZ))
+	{
+		return;
+	}
+
+	for (int z = startZ; z < endZ; z++)
+	{
+		for (int x = startX; x < endX; x++)
+		{
+			this->cells[x + (z * this->width)].push_back(lightIndex);
+		}
+	}
+}
+
+void SoftwareRenderer::LightGrid::removeLight(int lightIndex, const Light &light)
+{
+	int startX, endX, startZ, endZ;
+	if (!light.getVoxelRange(this->width, this->depth, &startX, &endX, &startZ, &endZ))
+	{
+		return;
+	}
+
+	for (int z = startZ; z < endZ; z++)
+	{
+		for (int x = startX; x < endX; x++)
+		{
+			// Order within a cell doesn't matter.
+			std::vector<int> &cell = this->cells[x + (z * this->width)];
+			const auto iter = std::find(cell.begin(), cell.end(), lightIndex);
+			DebugAssert(iter != cell.end());
+			*iter = cell.back();
+			cell.pop_back();
+		}
+	}
+}
+
+void SoftwareRenderer::LightGrid::moveLight(int oldIndex, int newIndex, const Light &light)
+{
+	int startX, endX, startZ, endZ;
+	if (!light.getVoxelRange(this->width, this->depth, &startX, &endX, &startZ, &endZ))
+	{
+		return;
+	}
+
+	for (int z = startZ; z < endZ; z++)
+	{
+		for (int x = startX; x < endX; x++)
+		{
+			std::vector<int> &cell = this->cells[x + (z * this->width)];
+			std::replace(cell.begin(), cell.end(), oldIndex, newIndex);
+		}
+	}
+}
+
+const std::vector<int> *SoftwareRenderer::LightGrid::getLights(const Double2 &point) const
+{
+	const int x = static_cast<int>(std::floor(point.x));
+	const int z = static_cast<int>(std::floor(point.y));
+	if ((x < 0) || (x >= this->width) || (z < 0) || (z >= this->depth))
+	{
+		return nullptr;
+	}
+
+	const std::vector<int> &cell = this->cells[x + (z * this->width)];
+	return (cell.size() > 0) ? &cell : nullptr;
+}
+
+const int SoftwareRenderer::Lightmap::SAMPLES_PER_SIDE = 3;
+const int SoftwareRenderer::Lightmap::FACE_COUNT = 6;
+const int SoftwareRenderer::Lightmap::NO_SAMPLES = -1;
+const double SoftwareRenderer::Lightmap::SURFACE_OFFSET = 0.01;
+
+SoftwareRenderer::Lightmap::Lightmap()
+{
+	this->ceilingHeight = 0.0;
+	this->width = 0;
+	this->height = 0;
+	this->depth = 0;
+}
+
+void SoftwareRenderer::Lightmap::init(const RenderVoxelGrid &voxelGrid,
+	const LightGrid &lightGrid, const std::vector<int> &openDoorColumns, double ceilingHeight)
+{
+	this->width = voxelGrid.width;
+	this->height = voxelGrid.height;
+	this->depth = voxelGrid.depth;
+	this->ceilingHeight = ceilingHeight;
+	this->openDoorColumns = openDoorColumns;
+	this->voxelOffsets = std::vector<int>(voxelGrid.voxels.size(), Lightmap::NO_SAMPLES);
+
+	// Each sample is three floats.
+	const int voxelSampleCount = Lightmap::FACE_COUNT * Lightmap::SAMPLES_PER_SIDE *
+		Lightmap::SAMPLES_PER_SIDE * 3;
+	int sampleCount = 0;
+
+	for (int z = 0; z < this->depth; z++)
+	{
+		for (int x = 0; x < this->width; x++)
+		{
+			if (lightGrid.cells[x + (z * this->width)].size() == 0)
+			{
+				continue;
+			}
+
+			const int columnIndex = (x + (z * this->width)) * this->height;
+			const RenderVoxel *column = voxelGrid.getColumn(x, z);
+			for (int y = 0; y < this->height; y++)
+			{
+				if (!this->isSolid(column[y].dataType, x, z))
+				{
+					this->voxelOffsets[columnIndex + y] = sampleCount;
+					sampleCount += voxelSampleCount;
+				}
+			}
+		}
+	}
+
+	this->samples = std::vector<float>(sampleCount, 0.0f);
+}
+
+void SoftwareRenderer::Lightmap::bake(const RenderVoxelGrid &voxelGrid,
+	const std::vector<Light> &lights, const LightGrid &lightGrid, int startX, int stepX,
+	const std::atomic<bool> &isCancelled)
+{
+	const int sideCount = Lightmap::SAMPLES_PER_SIDE;
+	const double sampleSpacing = 1.0 / static_cast<double>(sideCount - 1);
+
+	// Samples are moved a little into their voxel so the path to a light doesn't start in
+	// a neighboring voxel.
+	const double inset = 0.001;
+
+	// Returns whether no solid voxel is between the two points. Voxels are stepped through
+	// in voxel units, so Y is divided by the ceiling height.
+	auto isPathOpen = [this, &voxelGrid](const Double3 &start, const Double3 &end)
+	{
+		const double startY = start.y / this->ceilingHeight;
+		const double diffX = end.x - start.x;
+		const double diffY = (end.y / this->ceilingHeight) - startY;
+		const double diffZ = end.z - start.z;
+		int voxelX = static_cast<int>(std::floor(start.x));
+		int voxelY = static_cast<int>(std::floor(startY));
+		int voxelZ = static_cast<int>(std::floor(start.z));
+		const int stepX = (diffX > 0.0) ? 1 : -1;
+		const int stepY = (diffY > 0.0) ? 1 : -1;
+		const int stepZ = (diffZ > 0.0) ? 1 : -1;
+
+		// Percent of the path between voxel boundaries on each axis, and to the next one.
+		const double infinity = std::numeric_limits<double>::infinity();
+		auto getDelta = [infinity](double diff)
+		{
+			return (diff != 0.0) ? std::abs(1.0 / diff) : infinity;
+		};
+
+		auto getFirstBoundary = [infinity](double point, int voxel, double diff, double delta)
+		{
+			if (diff == 0.0)
+			{
+				return infinity;
+			}
+
+			const double voxelReal = static_cast<double>(voxel);
+			return ((diff > 0.0) ? ((voxelReal + 1.0) - point) : (point - voxelReal)) * delta;
+		};
+
+		const double deltaX = getDelta(diffX);
+		const double deltaY = getDelta(diffY);
+		const double deltaZ = getDelta(diffZ);
+		double nextX = getFirstBoundary(start.x, voxelX, diffX, deltaX);
+		double nextY = getFirstBoundary(startY, voxelY, diffY, deltaY);
+		double nextZ = getFirstBoundary(start.z, voxelZ, diffZ, deltaZ);
+
+		while (true)
+		{
+			// Step into the next voxel on whichever axis has the nearest boundary.
+			if ((nextX <= nextY) && (nextX <= nextZ))
+			{
+				if (nextX >= 1.0)
+				{
+					return true;
+				}
+
+				voxelX += stepX;
+				nextX += deltaX;
+			}
+			else if (nextY <= nextZ)
+			{
+				if (nextY >= 1.0)
+				{
+					return true;
+				}
+
+				voxelY += stepY;
+				nextY += deltaY;
+			}
+			else
+			{
+				if (nextZ >= 1.0)
+				{
+					return true;
+				}
+
+				voxelZ += stepZ;
+				nextZ += deltaZ;
+			}
+
+			// Outside the grid is empty.
+			const bool isInGrid = (voxelX >= 0) && (voxelX < this->width) &&
+				(voxelY >= 0) && (voxelY < this->height) &&
+				(voxelZ >= 0) && (voxelZ < this->depth);
+			if (isInGrid && this->isSolid(
+				voxelGrid.getColumn(voxelX, voxelZ)[voxelY].dataType, voxelX, voxelZ))
+			{
+				return false;
+			}
+		}
+	};
+
+	for (int x = startX; x < this->width; x += stepX)
+	{
+		if (isCancelled)
+		{
+			return;
+		}
+
+		for (int z = 0; z < this->depth; z++)
+		{
+			const std::vector<int> &lightIndices = lightGrid.cells[x + (z * this->width)];
+			const int columnIndex = (x + (z * this->width)) * this->height;
+
+			for (int y = 0; y < this->height; y++)
+			{
+				const int offset = this->voxelOffsets[columnIndex + y];
+				if (offset == Lightmap::NO_SAMPLES)
+				{
+					continue;
+				}
+
+				const std::array<int, 3> voxel = { x, y, z };
+				float *voxelSamples = this->samples.data() + offset;
+
+				for (int face = 0; face < Lightmap::FACE_COUNT; face++)
+				{
+					// Faces lighting surfaces that face positive are on the low side.
+					const int axis = face / 2;
+					const int sAxis = (axis + 1) % 3;
+					const int tAxis = (axis + 2) % 3;
+					const double sign = ((face % 2) == 0) ? 1.0 : -1.0;
+
+					for (int t = 0; t < sideCount; t++)
+					{
+						for (int s = 0; s < sideCount; s++)
+						{
+							// Sample point in voxel units.
+							std::array<double, 3> local;
+							local[axis] = (sign > 0.0) ? inset : (1.0 - inset);
+							local[sAxis] = MathUtils::clamp(
+								static_cast<double>(s) * sampleSpacing, inset, 1.0 - inset);
+							local[tAxis] = MathUtils::clamp(
+								static_cast<double>(t) * sampleSpacing, inset, 1.0 - inset);
+
+							const Double3 point(
+								static_cast<double>(voxel[0]) + local[0],
+								(static_cast<double>(voxel[1]) + local[1]) * this->ceilingHeight,
+								static_cast<double>(voxel[2]) + local[2]);
+
+							// Same falloff as point lights, but only from lights in front of
+							// the face with nothing solid in the way.
+							double colorR = 0.0;
+							double colorG = 0.0;
+							double colorB = 0.0;
+							for (const int lightIndex : lightIndices)
+							{
+								const Light &light = lights[lightIndex];
+								const std::array<double, 3> diff =
+								{
+									light.point.x - point.x,
+									light.point.y - point.y,
+									light.point.z - point.z
+								};
+
+								if ((diff[axis] * sign) <= 0.0)
+								{
+									continue;
+								}
+
+								const double distanceSquared = (diff[0] * diff[0]) +
+									(diff[1] * diff[1]) + (diff[2] * diff[2]);
+								const double intensitySquared = light.intensity * light.intensity;
+								if ((distanceSquared >= intensitySquared) ||
+									!isPathOpen(point, light.point))
+								{
+									continue;
+								}
+
+								const double falloff = 1.0 - (distanceSquared / intensitySquared);
+								const double percent = falloff * falloff;
+								colorR += light.color.x * percent;
+								colorG += light.color.y * percent;
+								colorB += light.color.z * percent;
+							}
+
+							float *sample = voxelSamples +
+								((((face * sideCount) + t) * sideCount) + s) * 3;
+							sample[0] = static_cast<float>(colorR);
+							sample[1] = static_cast<float>(colorG);
+							sample[2] = static_cast<float>(colorB);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+bool SoftwareRenderer::Lightmap::hasLight(const Double2 &point, const Double3 &normal) const
+{
+	// Wall points are on the edge of a solid column, so they're nudged into the column in
+	// front of the wall like in getLight().
+	const int x = static_cast<int>(std::floor(point.x + (normal.x * Lightmap::SURFACE_OFFSET)));
+	const int z = static_cast<int>(std::floor(point.y + (normal.z * Lightmap::SURFACE_OFFSET)));
+	if ((x < 0) || (x >= this->width) || (z < 0) || (z >= this->depth))
+	{
+		return false;
+	}
+
+	const int columnIndex = (x + (z * this->width)) * this->height;
+	for (int y = 0; y < this->height; y++)
+	{
+		if (this->voxelOffsets[columnIndex + y] != Lightmap::NO_SAMPLES)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+Double3 SoftwareRenderer::Lightmap::getLight(const Double3 &point, const Double3 &normal) const
+{
+	// The point is nudged off the surface into the voxel in front of it, in voxel units.
+	const double surfaceOffset = Lightmap::SURFACE_OFFSET;
+	const double pointX = point.x + (normal.x * surfaceOffset);
+	const double pointY = (point.y / this->ceilingHeight) + (normal.y * surfaceOffset);
+	const double pointZ = point.z + (normal.z * surfaceOffset);
+
+	// This runs for every lit pixel, so voxels are found by truncating instead of with
+	// std::floor(), which is the same once negative points are ruled out.
+	if ((pointX < 0.0) || (pointY < 0.0) || (pointZ < 0.0))
+	{
+		return Double3::Zero;
+	}
+
+	const int voxelX = static_cast<int>(pointX);
+	const int voxelY = static_cast<int>(pointY);
+	const int voxelZ = static_cast<int>(pointZ);
+	if ((voxelX >= this->width) || (voxelY >= this->height) || (voxelZ >= this->depth))
+	{
+		return Double3::Zero;
+	}
+
+	const int offset = this->voxelOffsets[
+		((voxelX + (voxelZ * this->width)) * this->height) + voxelY];
+	if (offset == Lightmap::NO_SAMPLES)
+	{
+		return Double3::Zero;
+	}
+
+	// The axis the surface mostly faces along picks the face. The next two axes (wrapping
+	// around) are the face's S and T axes, like when baking.
+	const double percentX = pointX - static_cast<double>(voxelX);
+	const double percentY = pointY - static_cast<double>(voxelY);
+	const double percentZ = pointZ - static_cast<double>(voxelZ);
+	const double absX = std::abs(normal.x);
+	const double absY = std::abs(normal.y);
+	const double absZ = std::abs(normal.z);
+	int face;
+	double sPercent, tPercent;
+	if ((absX >= absY) && (absX >= absZ))
+	{
+		face = (normal.x > 0.0) ? 0 : 1;
+		sPercent = percentY;
+		tPercent = percentZ;
+	}
+	else if (absY >= absZ)
+	{
+		face = (normal.y > 0.0) ? 2 : 3;
+		sPercent = percentZ;
+		tPercent = percentX;
+	}
+	else
+	{
+		face = (normal.z > 0.0) ? 4 : 5;
+		sPercent = percentX;
+		tPercent = percentY;
+	}
+
+	// Bilinearly interpolate the four samples around the point on the face.
+	const int sideCount = Lightmap::SAMPLES_PER_SIDE;
+	const double sideScale = static_cast<double>(sideCount - 1);
+	const double s = sPercent * sideScale;
+	const double t = tPercent * sideScale;
+	const int s0 = std::min(static_cast<int>(s), sideCount - 2);
+	const int t0 = std::min(static_cast<int>(t), sideCount - 2);
+	const double sLerp = s - static_cast<double>(s0);
+	const double tLerp = t - static_cast<double>(t0);
+
+	const float *sample00 = this->samples.data() + offset +
+		((((face * sideCount) + t0) * sideCount) + s0) * 3;
+	const float *sample01 = sample00 + 3;
+	const float *sample10 = sample00 + (sideCount * 3);
+	const float *sample11 = sample10 + 3;
+
+	auto interpolate = [sLerp, tLerp, sample00, sample01, sample10, sample11](int channel)
+	{
+		const double top = sample00[channel] +
+			((sample01[channel] - sample00[channel]) * sLerp);
+		const double bottom = sample10[channel] +
+			((sample11[channel] - sample10[channel]) * sLerp);
+		return top + ((bottom - top) * tLerp);
+	};
+
+	return Double3(interpolate(0), interpolate(1), interpolate(2));
+}
+
+bool SoftwareRenderer::Lightmap::isSolid(VoxelDataType dataType, int x, int z) const
+{
+	if (dataType == VoxelDataType::Door)
+	{
+		return !std::binary_search(this->openDoorColumns.begin(), this->openDoorColumns.end(),
+			x + (z * this->width));
+	}
+
+	return (dataType == VoxelDataType::Wall) || (dataType == VoxelDataType::Floor) ||
+		(dataType == VoxelDataType::Ceiling);
+}
+
+SoftwareRenderer::ColumnLights::ColumnLights()
+{
+	this->lightIndices = nullptr;
+	this->isBaked = false;
+}
+
+bool SoftwareRenderer::ColumnLights::isLit() const
+{
+	return (this->lightIndices != nullptr) || this->isBaked;
+}
+
+SoftwareRenderer::ShadingInfo::ShadingInfo(const std::vector<Double3> &skyPalette,
+	double daytimePercent, double ambient, double fogDistance, const Colormap *colormap,
+	bool mipmapping, const std::vector<Light> &lights, const LightGrid &lightGrid,
+	const Lightmap *lightmap)
+{
+	// The "sliding window" of sky colors is backwards in the AM (horizon is latest in the palette)
+	// and forwards in the PM (horizon is earliest in the palette).
+	this->isAM = daytimePercent < 0.50;
+	const int slideDirection = this->isAM ? -1 : 1;
+
+	// Get the real index (not the integer index) of the color for the current time as a
+	// reference point so each sky color can be interpolated between two samples via 'percent'.
+	const double realIndex = static_cast<double>(skyPalette.size()) * daytimePercent;
+	const double percent = realIndex - std::floor(realIndex);
+
+	// Lambda for keeping the given index within the palette range.
+	auto wrapIndex = [&skyPalette](int index)
+	{
+		const int paletteCount = static_cast<int>(skyPalette.size());
+
+		while (index >= paletteCount)
+		{
+			index -= paletteCount;
+		}
+
+		while (index < 0)
+		{
+			index += paletteCount;
+		}
+
+		return index;
+	};
+
+	// Calculate sky colors based on the time of day.
+	for (int i = 0; i < static_cast<int>(this->skyColors.size()); i++)
+	{
+		const int indexDiff = slideDirection * i;
+		const int index = wrapIndex(static_cast<int>(realIndex) + indexDiff);
+		const int nextIndex = wrapIndex(index + slideDirection);
+		const Double3 &color = skyPalette.at(index);
+		const Double3 &nextColor = skyPalette.at(nextIndex);
+
+		this->skyColors.at(i) = color.lerp(nextColor, this->isAM ? (1.0 - percent) : percent);
+	}
+
+	// The sun rises in the west (-Z) and sets in the east (+Z).
+	this->sunDirection = [daytimePercent]()
+	{
+		const double radians = daytimePercent * Constants::TwoPi;
+		return Double3(0.0, -std::cos(radians), -std::sin(radians)).normalized();
+	}();
+	
+	this->sunColor = [this]()
+	{
+		const Double3 baseSunColor(0.90, 0.875, 0.85);
+
+		// Darken the sun color if it's below the horizon so wall faces aren't lit 
+		// as much during the night. This is just an artistic value to compensate
+		// for the lack of shadows.
+		return (this->sunDirection.y >= 0.0) ? baseSunColor :
+			(baseSunColor * (1.0 - (5.0 * std::abs(this->sunDirection.y)))).clamped();
+	}();
+
+	this->ambient = ambient;
+
+	// At their darkest, distant objects are ~1/4 of their intensity.
+	this->distantAmbient = MathUtils::clamp(ambient, 0.25, 1.0);
+
+	this->fogDistance = fogDistance;
+	this->colormap = colormap;
+	this->mipmapping = mipmapping;
+	this->lights = &lights;
+	this->lightGrid = &lightGrid;
+	this->lightmap = lightmap;
+}
+
+const Double3 &SoftwareRenderer::ShadingInfo::getFogColor() const
+{
+	// The fog color is the same as the horizon color.
+	return this->skyColors.front();
+}
+
+bool SoftwareRenderer::ShadingInfo::hasLights() const
+{
+	return (this->lights->size() > 0) || (this->lightmap != nullptr);
+}
+
+SoftwareRenderer::ColumnLights SoftwareRenderer::ShadingInfo::getLights(
+	const Double2 &point, const Double3 &normal) const
+{
+	ColumnLights columnLights;
+	columnLights.lightIndices = this->lightGrid->getLights(point);
+	columnLights.isBaked = (this->lightmap != nullptr) &&
+		this->lightmap->hasLight(point, normal);
+	return columnLights;
+}
+
+Double3 SoftwareRenderer::ShadingInfo::getLightColor(const Double3 &point,
+	const Double3 &normal, const ColumnLights &columnLights) const
+{
+	// This runs for every lit pixel, so it's written out by component. The falloff is
+	// (1 - d^2/r^2)^2, which is close to linear without needing a square root.
+	double colorR = 0.0;
+	double colorG = 0.0;
+	double colorB = 0.0;
+	if (columnLights.lightIndices != nullptr)
+	{
+		for (const int lightIndex : *columnLights.lightIndices)
+		{
+			const Light &light = (*this->lights)[lightIndex];
+			const double diffX = point.x - light.point.x;
+			const double diffY = point.y - light.point.y;
+			const double diffZ = point.z - light.point.z;
+			const double distanceSquared = (diffX * diffX) + (diffY * diffY) + (diffZ * diffZ);
+			const double intensitySquared = light.intensity * light.intensity;
+			if (distanceSquared < intensitySquared)
+			{
+				const double falloff = 1.0 - (distanceSquared / intensitySquared);
+				const double percent = falloff * falloff;
+				colorR += light.color.x * percent;
+				colorG += light.color.y * percent;
+				colorB += light.color.z * percent;
+			}
+		}
+	}
+
+	// Static lights are already added up in the lightmap.
+	if (columnLights.isBaked)
+	{
+		const Double3 bakedLight = this->lightmap->getLight(point, normal);
+		colorR += bakedLight.x;
+		colorG += bakedLight.y;
+		colorB += bakedLight.z;
+	}
+
+	return Double3(colorR, colorG, colorB);
+}
+
+SoftwareRenderer::LastFrame::LastFrame()
+{
+	this->fovY = 0.0;
+	this->ambient = 0.0;
+	this->ceilingHeight = 0.0;
+	this->drawnCount = 0;
+	this->parallaxSky = false;
+	this->paletteShading = false;
+	this->mipmapping = false;
+	this->interleavedColumns = false;
+}
+
+void SoftwareRenderer::LastFrame::reset()
+{
+	this->drawnCount = 0;
+}
+
+SoftwareRenderer::FrameView::FrameView(uint32_t *colorBuffer, double *depthBuffer, 
+	double *depthTiles, uint16_t *planeIDs, int width, int height, int columnStep,
+	int columnParity)
+{
+	this->colorBuffer = colorBuffer;
+	this->depthBuffer = depthBuffer;
+	this->depthTiles = depthTiles;
+	this->planeIDs = planeIDs;
+	this->width = width;
+	this->height = height;
+	this->depthTileRows = SoftwareRenderer::getDepthTileRows(height);
+	this->columnStep = columnStep;
+	this->columnParity = columnParity;
+	this->widthReal = static_cast<double>(width);
+	this->heightReal = static_cast<double>(height);
+}
+
+bool SoftwareRenderer::FrameView::isColumnDrawn(int x) const
+{
+	return (x % this->columnStep) == this->columnParity;
+}
+
+int SoftwareRenderer::FrameView::getFirstDrawnColumn(int x) const
+{
+	return this->isColumnDrawn(x) ? x : (x + 1);
+}
+
+double SoftwareRenderer::FrameView::getMaxTileDepth(int x, int startY, int endY) const
+{
+	const int startTileY = startY / SoftwareRenderer::DEPTH_TILE_HEIGHT;
+	const int endTileY = (endY + SoftwareRenderer::DEPTH_TILE_HEIGHT - 1) /
+		SoftwareRenderer::DEPTH_TILE_HEIGHT;
+
+	double maxDepth = 0.0;
+	for (int tileY = startTileY; tileY < endTileY; tileY++)
+	{
+		maxDepth = std::max(maxDepth, this->depthTiles[x + (tileY * this->width)]);
+	}
+
+	return maxDepth;
+}
+
+SoftwareRenderer::ShadingBatch::ShadingBatch(const Double3 &shading, const Double3 &fogColor,
+	uint32_t *colorBuffer)
+	: shading(shading), fogColor(fogColor)
+{
+	this->colorBuffer = colorBuffer;
+	this->count = 0;
+	this->isLit = false;
+}
+
+void SoftwareRenderer::ShadingBatch::add(uint32_t texel, double fogPercent, int index)
+{
+	this->texels[this->count] = texel;
+	this->fogPercents[this->count] = fogPercent;
+	this->indices[this->count] = index;
+
+	if (this->isLit)
+	{
+		this->lightR[this->count] = 0.0;
+		this->lightG[this->count] = 0.0;
+		this->lightB[this->count] = 0.0;
+	}
+
+	this->count++;
+
+	if (this->count == ShadingBatch::MAX_COUNT)
+	{
+		this->flush();
+	}
+}
+
+void SoftwareRenderer::ShadingBatch::addLit(uint32_t texel, double fogPercent, int index,
+	const Double3 &lightColor)
+{
+	// Texels added before the first lit one have no light.
+	if (!this->isLit)
+	{
+		std::fill(this->lightR.begin(), this->lightR.begin() + this->count, 0.0);
+		std::fill(this->lightG.begin(), this->lightG.begin() + this->count, 0.0);
+		std::fill(this->lightB.begin(), this->lightB.begin() + this->count, 0.0);
+		this->isLit = true;
+	}
+
+	this->texels[this->count] = texel;
+	this->fogPercents[this->count] = fogPercent;
+	this->indices[this->count] = index;
+	this->lightR[this->count] = lightColor.x;
+	this->lightG[this->count] = lightColor.y;
+	this->lightB[this->count] = lightColor.z;
+	this->count++;
+
+	if (this->count == ShadingBatch::MAX_COUNT)
+	{
+		this->flush();
+	}
+}
+
+void SoftwareRenderer::ShadingBatch::flush()
+{
+	if (this->isLit)
+	{
+		const ShadingKernels::TexelLights lights =
+		{
+			this->lightR.data(), this->lightG.data(), this->lightB.data()
+		};
+
+		ShadingKernels::shadeLit(this->texels.data(), this->fogPercents.data(), lights,
+			this->count, this->shading, this->fogColor, this->colors.data());
+		this->isLit = false;
+	}
+	else
+	{
+		ShadingKernels::shade(this->texels.data(), this->fogPercents.data(), this->count,
+			this->shading, this->fogColor, this->colors.data());
+	}
+
+	// Colors are scattered one at a time since the indices are a column apart.
+	for (int i = 0; i < this->count; i++)
+	{
+		this->colorBuffer[this->indices[i]] = this->colors[i];
+	}
+
+	this->count = 0;
+}
+
+SoftwareRenderer::VisibleFlat::VisibleFlat(const Flat &flat, Flat::Frame &&frame)
+{
+	this->flat = &flat;
+	this->frame = std::move(frame);
+}
+
+const SoftwareRenderer::Flat &SoftwareRenderer::VisibleFlat::getFlat() const
+{
+	return *this->flat;
+}
+
+const SoftwareRenderer::Flat::Frame &SoftwareRenderer::VisibleFlat::getFrame() const
+{
+	return this->frame;
+}
+
+SoftwareRenderer::FlatCell::FlatCell(const Double2 &center)
+	: center(center)
+{
+	this->maxHalfWidth = 0.0;
 }
 
 SoftwareRenderer::DistantObject::DistantObject(int textureIndex, DistantObject::Type type, const void *obj)
@@ -372,49 +2156,174 @@ SoftwareRenderer::VisDistantObject::VisDistantObject(const SkyTexture &texture,
 	: VisDistantObject(texture, std::move(drawRange), ParallaxData(), xProjStart, xProjEnd,
 		xStart, xEnd, emissive) { }
 
-void SoftwareRenderer::RenderThreadData::SkyGradient::init()
+SoftwareRenderer::SkyPanorama::Texel::Texel()
+{
+	this->r = 0;
+	this->g = 0;
+	this->b = 0;
+	this->opaque = false;
+	this->emissive = false;
+}
+
+SoftwareRenderer::SkyPanorama::Texel::Texel(uint8_t r, uint8_t g, uint8_t b, bool emissive)
+{
+	this->r = r;
+	this->g = g;
+	this->b = b;
+	this->opaque = true;
+	this->emissive = emissive;
+}
+
+SoftwareRenderer::SkyPanorama::SkyPanorama()
+{
+	this->columnAngle = 0.0;
+	this->fovY = 0.0;
+	this->aspect = 0.0;
+	this->width = 0;
+	this->height = 0;
+	this->rowOrigin = 0;
+	this->frameWidth = 0;
+	this->frameHeight = 0;
+	this->parallaxSky = false;
+	this->dirty = true;
+}
+
+SoftwareRenderer::ChunkQueue::ChunkQueue()
+{
+	this->ranges = nullptr;
+	this->threadCount = 0;
+	this->chunkSize = 0;
+	this->size = 0;
+}
+
+void SoftwareRenderer::ChunkQueue::init(int size, int chunkSize, int threadCount)
+{
+	DebugAssert(chunkSize > 0);
+	DebugAssert(threadCount > 0);
+
+	if (threadCount != this->threadCount)
+	{
+		const size_t rangesSize = sizeof(ThreadRange) * threadCount;
+		size_t storageSize = rangesSize + alignof(ThreadRange) - 1;
+		this->rangeStorage = std::make_unique<uint8_t[]>(storageSize);
+
+		void *storage = this->rangeStorage.get();
+		this->ranges = static_cast<ThreadRange*>(
+			std::align(alignof(ThreadRange), rangesSize, storage, storageSize));
+
+		for (int i = 0; i < threadCount; i++)
+		{
+			new (this->ranges + i) ThreadRange();
+		}
+
+		this->threadCount = threadCount;
+	}
+
+	this->chunkSize = chunkSize;
+	this->size = size;
+
+	// Give each thread an even share of chunks, rounding so every chunk is covered.
+	const int chunkCount = (size + chunkSize - 1) / chunkSize;
+	for (int i = 0; i < threadCount; i++)
+	{
+		ThreadRange &range = this->ranges[i];
+		range.next.store((i * chunkCount) / threadCount, std::memory_order_relaxed);
+		range.end = ((i + 1) * chunkCount) / threadCount;
+	}
+}
+
+bool SoftwareRenderer::ChunkQueue::claim(int threadIndex, int *start, int *end)
+{
+	// Try the thread's own range first, then steal from the others in order.
+	for (int i = 0; i < this->threadCount; i++)
+	{
+		ThreadRange &range = this->ranges[(threadIndex + i) % this->threadCount];
+
+		// Skip exhausted ranges without writing to their cache line.
+		if (range.next.load(std::memory_order_relaxed) >= range.end)
+		{
+			continue;
+		}
+
+		const int chunk = range.next.fetch_add(1, std::memory_order_relaxed);
+		if (chunk < range.end)
+		{
+			*start = chunk * this->chunkSize;
+			*end = std::min(*start + this->chunkSize, this->size);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void SoftwareRenderer::RenderThreadData::SkyGradient::init(int threadCount, int height)
 {
-	this->threadsDone = 0;
+	this->rows.init(height, SoftwareRenderer::ROW_CHUNK_SIZE, threadCount);
 }
 
-void SoftwareRenderer::RenderThreadData::DistantSky::init(bool parallaxSky,
-	const std::vector<VisDistantObject> &visDistantObjs,
-	const std::vector<SkyTexture> &skyTextures)
+void SoftwareRenderer::RenderThreadData::DistantSky::init(int threadCount, int width,
+	bool parallaxSky, const std::vector<VisDistantObject> &visDistantObjs,
+	const std::vector<SkyTexture> &skyTextures, const SkyPanorama &skyPanorama)
 {
-	this->threadsDone = 0;
+	this->columns.init(width, SoftwareRenderer::COLUMN_CHUNK_SIZE, threadCount);
 	this->visDistantObjs = &visDistantObjs;
 	this->skyTextures = &skyTextures;
+	this->skyPanorama = &skyPanorama;
 	this->parallaxSky = parallaxSky;
-	this->doneVisTesting = false;
 }
 
-void SoftwareRenderer::RenderThreadData::Voxels::init(double ceilingHeight,
-	const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
-	const std::vector<VoxelTexture> &voxelTextures, std::vector<OcclusionData> &occlusion)
+void SoftwareRenderer::RenderThreadData::Voxels::init(int threadCount, int width,
+	double ceilingHeight, const LevelData::OpenDoors &openDoors,
+	const VoxelGrid &voxelGrid, const RenderVoxelGrid &renderVoxelGrid,
+	const VisibilityGrid &visibility, const std::vector<VoxelTexture> &voxelTextures,
+	std::vector<OcclusionData> &occlusion)
 {
-	this->threadsDone = 0;
+	this->columns.init(width, SoftwareRenderer::COLUMN_CHUNK_SIZE, threadCount);
 	this->ceilingHeight = ceilingHeight;
 	this->openDoors = &openDoors;
 	this->voxelGrid = &voxelGrid;
+	this->renderVoxelGrid = &renderVoxelGrid;
+	this->visibility = &visibility;
 	this->voxelTextures = &voxelTextures;
 	this->occlusion = &occlusion;
 }
 
-void SoftwareRenderer::RenderThreadData::Flats::init(const Double3 &flatNormal,
-	const std::vector<VisibleFlat> &visibleFlats, const std::vector<FlatTexture> &flatTextures)
+void SoftwareRenderer::RenderThreadData::Flats::init(int threadCount, int width,
+	const Double3 &flatNormal, const VisibilityGrid &visibility,
+	const std::vector<Flat> &flats, const std::vector<FlatCell> &flatCells, const std::vector<VisibleFlat> &visibleFlats,
+	const std::vector<FlatTexture> &flatTextures)
 {
-	this->threadsDone = 0;
+	// One extra list and range of cells for the main thread.
+	const int cellThreadCount = threadCount + 1;
+	this->cells.init(static_cast<int>(flatCells.size()), SoftwareRenderer::FLAT_CELL_CHUNK_SIZE,
+		cellThreadCount);
+	this->threadVisibleFlats.resize(cellThreadCount);
+	for (auto &threadFlats : this->threadVisibleFlats)
+	{
+		threadFlats.clear();
+	}
+
+	this->flats = &flats;
+	this->flatCells = &flatCells;
+	this->columns.init(width, SoftwareRenderer::COLUMN_CHUNK_SIZE, threadCount);
 	this->flatNormal = &flatNormal;
+	this->visibility = &visibility;
 	this->visibleFlats = &visibleFlats;
 	this->flatTextures = &flatTextures;
-	this->doneSorting = false;
+}
+
+void SoftwareRenderer::RenderThreadData::Reconstruction::init(int threadCount, int width,
+	uint32_t *columnHistory, bool useHistory)
+{
+	this->columns.init(width, SoftwareRenderer::COLUMN_CHUNK_SIZE, threadCount);
+	this->columnHistory = columnHistory;
+	this->useHistory = useHistory;
 }
 
 SoftwareRenderer::RenderThreadData::RenderThreadData()
 {
-	// Make sure 'go' is initialized to false.
 	this->totalThreads = 0;
-	this->go = false;
 	this->isDestructing = false;
 	this->camera = nullptr;
 	this->shadingInfo = nullptr;
@@ -428,10 +2337,63 @@ void SoftwareRenderer::RenderThreadData::init(int totalThreads, const Camera &ca
 	this->camera = &camera;
 	this->shadingInfo = &shadingInfo;
 	this->frame = &frame;
-	this->go = false;
 	this->isDestructing = false;
 }
 
+SoftwareRenderer::PipelinedFrame::PipelinedFrame()
+	: startBarrier(2), doneBarrier(2)
+{
+	this->fovY = 0.0;
+	this->ambient = 0.0;
+	this->daytimePercent = 0.0;
+	this->ceilingHeight = 0.0;
+	this->parallaxSky = false;
+	this->paletteShading = false;
+	this->mipmapping = false;
+	this->interleavedColumns = false;
+	this->isDrawing = false;
+	this->isFinished = false;
+	this->isDestructing = false;
+}
+
+SoftwareRenderer::VisibilityBuild::VisibilityBuild()
+{
+	this->isFinished = false;
+	this->isCancelled = false;
+	this->maxDistance = 0.0;
+	this->isRequested = false;
+}
+
+SoftwareRenderer::LightmapBuild::LightmapBuild()
+{
+	this->remainingThreads = 0;
+	this->isCancelled = false;
+	this->key = 0;
+	this->ceilingHeight = 0.0;
+	this->isRequested = false;
+}
+
+SoftwareRenderer::CachedLightmap::CachedLightmap()
+{
+	this->lastUse = 0;
+}
+
+SoftwareRenderer::RenderThreadStats::RenderThreadStats()
+{
+	this->busySeconds = 0.0;
+	this->idleSeconds = 0.0;
+}
+
+SoftwareRenderer::PhaseTimings::PhaseTimings()
+{
+	this->skyGradient = 0.0;
+	this->distantSky = 0.0;
+	this->voxels = 0.0;
+	this->flats = 0.0;
+	this->visibleDistantObjects = 0.0;
+	this->visibleFlats = 0.0;
+}
+
 const double SoftwareRenderer::NEAR_PLANE = 0.0001;
 const double SoftwareRenderer::FAR_PLANE = 1000.0;
 const int SoftwareRenderer::DEFAULT_VOXEL_TEXTURE_COUNT = 64;
@@ -440,6 +2402,14 @@ const double SoftwareRenderer::DOOR_MIN_VISIBLE = 0.10;
 const int SoftwareRenderer::NO_SUN = -1;
 const double SoftwareRenderer::SKY_GRADIENT_ANGLE = 30.0;
 const double SoftwareRenderer::DISTANT_CLOUDS_MAX_ANGLE = 25.0;
+const int SoftwareRenderer::ROW_CHUNK_SIZE = 4;
+const int SoftwareRenderer::COLUMN_CHUNK_SIZE = 16;
+const double SoftwareRenderer::FLAT_CELL_SIZE = 8.0;
+const int SoftwareRenderer::FLAT_CELL_CHUNK_SIZE = 4;
+const int SoftwareRenderer::DEPTH_TILE_HEIGHT = 16;
+const double SoftwareRenderer::COLUMN_HISTORY_MAX_DISTANCE = 0.01;
+const double SoftwareRenderer::COLOR_PRECISION = 0.50 / 255.0;
+const int SoftwareRenderer::LIGHTMAP_CACHE_SIZE = 8;
 const double SoftwareRenderer::TALL_PIXEL_RATIO = 1.20;
 
 SoftwareRenderer::SoftwareRenderer()
@@ -450,10 +2420,28 @@ SoftwareRenderer::SoftwareRenderer()
 	this->renderThreadsMode = 0;
 	this->sunTextureIndex = SoftwareRenderer::NO_SUN;
 	this->fogDistance = 0.0;
+	this->frameLatency = 0.0;
+	this->historyColumnParity = 0;
+	this->columnHistoryValid = false;
+	this->skippedFrameCount = 0;
+	this->lightmap = nullptr;
+	this->lightmapUseCount = 0;
 }
 
 SoftwareRenderer::~SoftwareRenderer()
 {
+	this->cancelVisibilityBuild();
+	this->cancelLightmapBake();
+
+	// Stop the frame thread before the render threads it uses.
+	this->waitForFrame();
+	if (this->frameThread.joinable())
+	{
+		this->pipelinedFrame.isDestructing = true;
+		this->pipelinedFrame.startBarrier.wait();
+		this->frameThread.join();
+	}
+
 	this->resetRenderThreads();
 }
 
@@ -463,16 +2451,51 @@ bool SoftwareRenderer::isInited() const
 	return (this->width > 0) && (this->height > 0);
 }
 
+const std::vector<SoftwareRenderer::RenderThreadStats> &SoftwareRenderer::getRenderThreadStats() const
+{
+	return this->renderThreadStats;
+}
+
+const SoftwareRenderer::PhaseTimings &SoftwareRenderer::getPhaseTimings() const
+{
+	return this->phaseTimings;
+}
+
+double SoftwareRenderer::getFrameLatency() const
+{
+	return this->frameLatency;
+}
+
+bool SoftwareRenderer::isFramePending() const
+{
+	return this->pipelinedFrame.isDrawing || this->pipelinedFrame.isFinished;
+}
+
+int SoftwareRenderer::getSkippedFrameCount() const
+{
+	return this->skippedFrameCount;
+}
+
 void SoftwareRenderer::init(int width, int height, int renderThreadsMode)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+	this->pipelinedFrame.isFinished = false;
+
 	// Initialize 2D frame buffer.
 	const int pixelCount = width * height;
 	this->depthBuffer = std::vector<double>(pixelCount,
 		std::numeric_limits<double>::infinity());
+	this->depthTiles = std::vector<double>(width * SoftwareRenderer::getDepthTileRows(height),
+		std::numeric_limits<double>::infinity());
+	this->planeIDs = std::vector<uint16_t>(pixelCount, 0);
 
 	// Initialize occlusion columns.
 	this->occlusion = std::vector<OcclusionData>(width, OcclusionData(0, height));
 
+	// Interleaved columns start over from their neighbors.
+	this->columnHistoryValid = false;
+
 	// Initialize texture vectors to default sizes.
 	this->voxelTextures = std::vector<VoxelTexture>(SoftwareRenderer::DEFAULT_VOXEL_TEXTURE_COUNT);
 	this->flatTextures = std::vector<FlatTexture>(SoftwareRenderer::DEFAULT_FLAT_TEXTURE_COUNT);
@@ -484,50 +2507,94 @@ void SoftwareRenderer::init(int width, int height, int renderThreadsMode)
 	// Fog distance is zero by default.
 	this->fogDistance = 0.0;
 
+	DebugMention("Using " + std::string(ShadingKernels::getInstructionSetName(
+		ShadingKernels::getInstructionSet())) + " shading kernels.");
+
 	// Initialize render threads.
 	const int threadCount = SoftwareRenderer::getRenderThreadsFromMode(renderThreadsMode);
-	this->initRenderThreads(width, height, threadCount);
+	this->initRenderThreads(threadCount);
 }
 
 void SoftwareRenderer::setRenderThreadsMode(int mode)
 {
+	this->waitForFrame();
 	this->renderThreadsMode = mode;
 
 	// Re-initialize render threads.
 	const int threadCount = SoftwareRenderer::getRenderThreadsFromMode(renderThreadsMode);
-	this->initRenderThreads(this->width, this->height, threadCount);
+	this->initRenderThreads(threadCount);
+}
+
+void SoftwareRenderer::setRenderThreadCount(int threadCount)
+{
+	DebugAssertMsg(threadCount > 0, "Render thread count must be positive.");
+
+	this->waitForFrame();
+	this->initRenderThreads(threadCount);
 }
 
 void SoftwareRenderer::addFlat(int id, const Double3 &position, double width, 
 	double height, int textureID)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	// Verify that the ID is not already in use.
-	DebugAssertMsg(this->flats.find(id) == this->flats.end(),
+	DebugAssertMsg(this->flatIndices.find(id) == this->flatIndices.end(),
 		"Flat ID \"" + std::to_string(id) + "\" already taken.");
 
 	SoftwareRenderer::Flat flat;
 	flat.position = position;
 	flat.width = width;
 	flat.height = height;
+	flat.id = id;
 	flat.textureID = textureID;
+	flat.cellIndex = -1;
 	flat.flipped = false; // The initial value doesn't matter; it's updated frequently.
 
 	// Add the flat (sprite, door, store sign, etc.).
-	this->flats.insert(std::make_pair(id, flat));
+	const int flatIndex = static_cast<int>(this->flats.size());
+	this->flats.push_back(flat);
+	this->flatIndices.insert(std::make_pair(id, flatIndex));
+	this->addFlatToCell(flatIndex);
 }
 
 void SoftwareRenderer::addLight(int id, const Double3 &point, const Double3 &color, 
 	double intensity)
 {
-	DebugNotImplemented();
+	this->waitForFrame();
+	this->lastFrame.reset();
+
+	// Verify that the ID is not already in use.
+	DebugAssertMsg(this->lightIndices.find(id) == this->lightIndices.end(),
+		"Light ID \"" + std::to_string(id) + "\" already taken.");
+
+	const int lightIndex = static_cast<int>(this->lights.size());
+	this->lights.push_back(Light(id, point, color, intensity));
+	this->lightIndices.insert(std::make_pair(id, lightIndex));
+	this->lightGrid.addLight(lightIndex, this->lights.back());
+}
+
+void SoftwareRenderer::addStaticLight(const Double3 &point, const Double3 &color,
+	double intensity)
+{
+	// Static lights are only read by bakes, so they don't change the frame until then.
+	const int id = static_cast<int>(this->staticLights.size());
+	this->staticLights.push_back(Light(id, point, color, intensity));
 }
 
 void SoftwareRenderer::setVoxelTexture(int id, const uint32_t *srcTexels)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	// Clear the selected texture.
 	VoxelTexture &texture = this->voxelTextures.at(id);
 	std::fill(texture.texels.begin(), texture.texels.end(), VoxelTexel());
+	std::fill(texture.indexedTexels.begin(), texture.indexedTexels.end(),
+		TexturePalette::TRANSPARENT_INDEX);
 	texture.lightTexels.clear();
+	texture.hasTransparentTexels = false;
 
 	for (int y = 0; y < VoxelTexture::HEIGHT; y++)
 	{
@@ -536,20 +2603,19 @@ void SoftwareRenderer::setVoxelTexture(int id, const uint32_t *srcTexels)
 			// @todo: change this calculation for rotated textures. Make sure to have a 
 			// source index and destination index.
 			// - "dstX" and "dstY" should be calculated, and also used with lightTexels.
-			const int index = x + (y * VoxelTexture::WIDTH);
-
-			// Convert ARGB color from integer to double-precision format. This does waste
-			// an extreme amount of memory (32 bytes per pixel!), but it's not a big deal
-			// for Arena's textures (eight textures is a megabyte).
-			const Double4 srcTexel = Double4::fromARGB(srcTexels[index]);
-			VoxelTexel &dstTexel = texture.texels[index];
-			dstTexel.r = srcTexel.x;
-			dstTexel.g = srcTexel.y;
-			dstTexel.b = srcTexel.z;
-			dstTexel.transparent = srcTexel.w == 0.0;
+			const int srcIndex = x + (y * VoxelTexture::WIDTH);
+			const int dstIndex = y + (x * VoxelTexture::HEIGHT);
+
+			// Pack the ARGB color into the texel's 8-bit channels.
+			const Color srcColor = Color::fromARGB(srcTexels[srcIndex]);
+			const uint8_t flags = (srcColor.a == 0) ? VoxelTexel::FLAG_TRANSPARENT : 0;
+			texture.texels[dstIndex] = VoxelTexel(srcColor.r, srcColor.g, srcColor.b, flags);
+			texture.hasTransparentTexels |= srcColor.a == 0;
+			texture.indexedTexels[dstIndex] = (srcColor.a == 0) ?
+				TexturePalette::TRANSPARENT_INDEX : this->texturePalette.getIndex(srcColor.toRGB());
 
 			// If it's a white texel, it's used with night lights (i.e., yellow at night).
-			const bool isWhite = (srcTexel.x == 1.0) && (srcTexel.y == 1.0) && (srcTexel.z == 1.0);
+			const bool isWhite = (srcColor.r == 255) && (srcColor.g == 255) && (srcColor.b == 255);
 
 			if (isWhite)
 			{
@@ -557,47 +2623,65 @@ void SoftwareRenderer::setVoxelTexture(int id, const uint32_t *srcTexels)
 			}
 		}
 	}
+
+	texture.updateMips();
 }
 
 void SoftwareRenderer::setFlatTexture(int id, const uint32_t *srcTexels, int width, int height)
 {
-	const int texelCount = width * height;
+	this->waitForFrame();
+	this->lastFrame.reset();
 
 	// Reset the selected texture.
 	FlatTexture &texture = this->flatTextures.at(id);
-	texture.texels = std::vector<FlatTexel>(texelCount);
-	texture.width = width;
-	texture.height = height;
+	texture.init(width, height);
 
-	for (int i = 0; i < texelCount; i++)
+	for (int y = 0; y < height; y++)
 	{
-		const Double4 srcTexel = Double4::fromARGB(srcTexels[i]);
-		FlatTexel &dstTexel = texture.texels[i];
-		dstTexel.r = srcTexel.x;
-		dstTexel.g = srcTexel.y;
-		dstTexel.b = srcTexel.z;
-		dstTexel.a = srcTexel.w;
+		for (int x = 0; x < width; x++)
+		{
+			const int srcIndex = x + (y * width);
+			const int dstIndex = y + (x * height);
+			const Color srcColor = Color::fromARGB(srcTexels[srcIndex]);
+			texture.texels[dstIndex] = FlatTexel(srcColor.r, srcColor.g, srcColor.b, srcColor.a);
+			texture.indexedTexels[dstIndex] = (srcColor.a == 0) ?
+				TexturePalette::TRANSPARENT_INDEX : this->texturePalette.getIndex(srcColor.toRGB());
+		}
 	}
+
+	texture.updateMips();
 }
 
 void SoftwareRenderer::updateFlat(int id, const Double3 *position, const double *width, 
 	const double *height, const int *textureID, const bool *flipped)
 {
-	const auto flatIter = this->flats.find(id);
-	DebugAssertMsg(flatIter != this->flats.end(),
+	this->waitForFrame();
+	this->lastFrame.reset();
+
+	const auto indexIter = this->flatIndices.find(id);
+	DebugAssertMsg(indexIter != this->flatIndices.end(),
 		"Cannot update a non-existent flat (" + std::to_string(id) + ").");
 
-	SoftwareRenderer::Flat &flat = flatIter->second;
+	const int flatIndex = indexIter->second;
+	SoftwareRenderer::Flat &flat = this->flats[flatIndex];
 
-	// Check which values requested updating and update them.
-	if (position != nullptr)
+	// Check which values requested updating and update them. The flat's grid cell might
+	// change with its position or width, so it's put in again.
+	if ((position != nullptr) || (width != nullptr))
 	{
-		flat.position = *position;
-	}
+		this->removeFlatFromCell(flatIndex);
 
-	if (width != nullptr)
-	{
-		flat.width = *width;
+		if (position != nullptr)
+		{
+			flat.position = *position;
+		}
+
+		if (width != nullptr)
+		{
+			flat.width = *width;
+		}
+
+		this->addFlatToCell(flatIndex);
 	}
 
 	if (height != nullptr)
@@ -619,19 +2703,171 @@ void SoftwareRenderer::updateFlat(int id, const Double3 *position, const double
 void SoftwareRenderer::updateLight(int id, const Double3 *point,
 	const Double3 *color, const double *intensity)
 {
-	DebugNotImplemented();
+	this->waitForFrame();
+	this->lastFrame.reset();
+
+	const auto indexIter = this->lightIndices.find(id);
+	DebugAssertMsg(indexIter != this->lightIndices.end(),
+		"Cannot update a non-existent light (" + std::to_string(id) + ").");
+
+	const int lightIndex = indexIter->second;
+	Light &light = this->lights[lightIndex];
+
+	// The voxel columns a light reaches only change with its point or intensity, and most
+	// moves stay within the same ones, so the light grid is only touched when they differ.
+	if ((point != nullptr) || (intensity != nullptr))
+	{
+		const Light oldLight = light;
+
+		if (point != nullptr)
+		{
+			light.point = *point;
+		}
+
+		if (intensity != nullptr)
+		{
+			light.intensity = *intensity;
+		}
+
+		int oldStartX, oldEndX, oldStartZ, oldEndZ, newStartX, newEndX, newStartZ, newEndZ;
+		const bool oldReaches = oldLight.getVoxelRange(this->lightGrid.width,
+			this->lightGrid.depth, &oldStartX, &oldEndX, &oldStartZ, &oldEndZ);
+		const bool newReaches = light.getVoxelRange(this->lightGrid.width,
+			this->lightGrid.depth, &newStartX, &newEndX, &newStartZ, &newEndZ);
+		const bool isSameRange = (oldReaches == newReaches) && (!oldReaches ||
+			((oldStartX == newStartX) && (oldEndX == newEndX) &&
+			(oldStartZ == newStartZ) && (oldEndZ == newEndZ)));
+
+		if (!isSameRange)
+		{
+			this->lightGrid.removeLight(lightIndex, oldLight);
+			this->lightGrid.addLight(lightIndex, light);
+		}
+	}
+
+	if (color != nullptr)
+	{
+		light.color = *color;
+	}
 }
 
 void SoftwareRenderer::setFogDistance(double fogDistance)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	this->fogDistance = fogDistance;
+
+	// A visible set only holds up to the distance it was built for, and one built for a
+	// farther distance than needed looks at more rays than it has to.
+	if (this->visibilityBuild.isRequested && (fogDistance != this->visibilityBuild.maxDistance))
+	{
+		this->startVisibilityBuild();
+	}
+}
+
+void SoftwareRenderer::setVoxelGrid(const VoxelGrid &voxelGrid)
+{
+	this->waitForFrame();
+	this->lastFrame.reset();
+
+	this->renderVoxelGrid.init(voxelGrid);
+
+	// Lights are looked up by voxel column, so the light grid matches the voxel grid.
+	this->lightGrid.init(voxelGrid.getWidth(), voxelGrid.getDepth(), this->lights);
+
+	// The old level's visible set doesn't apply anymore.
+	this->cancelVisibilityBuild();
+	this->visibilityBuild.isRequested = false;
+	this->visibility = VisibilityGrid();
+
+	// Static lights belong to the old level. Its lightmap stays in the cache.
+	this->cancelLightmapBake();
+	this->lightmapBuild.isRequested = false;
+	this->staticLights.clear();
+	this->lightmapDoorColumns.clear();
+	this->lightmap = nullptr;
+}
+
+void SoftwareRenderer::updateVoxel(int x, int y, int z, const VoxelGrid &voxelGrid)
+{
+	// A level that isn't active gets its whole grid baked when it becomes active.
+	if (!this->renderVoxelGrid.matches(voxelGrid))
+	{
+		return;
+	}
+
+	this->waitForFrame();
+	this->lastFrame.reset();
+	this->renderVoxelGrid.update(x, y, z, voxelGrid);
+
+	// The visible set might hide voxels and flats the change uncovered, so frames aren't
+	// culled until the new one is built.
+	if (this->visibilityBuild.isRequested)
+	{
+		this->visibility = VisibilityGrid();
+		this->startVisibilityBuild();
+	}
+
+	// The lightmap in use is kept until the new one is baked.
+	if (this->lightmapBuild.isRequested)
+	{
+		this->startLightmapBake();
+	}
+}
+
+void SoftwareRenderer::buildVisibility()
+{
+	this->visibilityBuild.isRequested = true;
+	this->startVisibilityBuild();
+}
+
+void SoftwareRenderer::waitForVisibility()
+{
+	VisibilityBuild &build = this->visibilityBuild;
+	if (build.thread.joinable())
+	{
+		build.thread.join();
+	}
+
+	this->takeBuiltVisibility();
+}
+
+void SoftwareRenderer::bakeLightmap(double ceilingHeight)
+{
+	// The lightmap in use might change right away if it's in the cache.
+	this->waitForFrame();
+
+	LightmapBuild &build = this->lightmapBuild;
+	build.isRequested = true;
+	build.ceilingHeight = ceilingHeight;
+	this->startLightmapBake();
+}
+
+void SoftwareRenderer::waitForLightmap()
+{
+	this->waitForFrame();
+
+	for (std::thread &thread : this->lightmapBuild.threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	this->takeBakedLightmap();
 }
 
 void SoftwareRenderer::setDistantSky(const DistantSky &distantSky)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	// Clear old distant sky data.
 	this->distantObjects.clear();
 	this->skyTextures.clear();
+	this->skyPanorama.dirty = true;
 
 	// Creates a render texture from the given surface, adds it to the sky textures list, and
 	// returns its index in the sky textures list.
@@ -650,12 +2886,8 @@ void SoftwareRenderer::setDistantSky(const DistantSky &distantSky)
 
 		for (int i = 0; i < texelCount; i++)
 		{
-			const Double4 srcTexel = Double4::fromARGB(texels[i]);
-			SkyTexel &dstTexel = texture.texels[i];
-			dstTexel.r = srcTexel.x;
-			dstTexel.g = srcTexel.y;
-			dstTexel.b = srcTexel.z;
-			dstTexel.transparent = srcTexel.w == 0.0;
+			const Color srcColor = Color::fromARGB(texels[i]);
+			texture.texels[i] = SkyTexel(srcColor.r, srcColor.g, srcColor.b, srcColor.a == 0);
 		}
 
 		return static_cast<int>(this->skyTextures.size()) - 1;
@@ -711,6 +2943,9 @@ void SoftwareRenderer::setDistantSky(const DistantSky &distantSky)
 
 void SoftwareRenderer::setSkyPalette(const uint32_t *colors, int count)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	this->skyPalette = std::vector<Double3>(count);
 
 	for (size_t i = 0; i < this->skyPalette.size(); i++)
@@ -721,12 +2956,16 @@ void SoftwareRenderer::setSkyPalette(const uint32_t *colors, int count)
 
 void SoftwareRenderer::setNightLightsActive(bool active)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	// @todo: activate lights (don't worry about textures).
 
 	// Change voxel texels based on whether it's night.
-	const Double4 texelColor = Double4::fromARGB(
-		(active ? Color(255, 166, 0) : Color::Black).toARGB());
-	const double texelEmission = active ? 1.0 : 0.0;
+	const Color texelColor = active ? Color(255, 166, 0) : Color::Black;
+	const uint8_t texelFlags = active ? VoxelTexel::FLAG_EMISSIVE : 0;
+	const uint8_t texelIndex = active ? TexturePalette::NIGHT_LIGHT_INDEX :
+		this->texturePalette.getIndex(texelColor.toRGB());
 
 	for (auto &voxelTexture : this->voxelTextures)
 	{
@@ -734,77 +2973,151 @@ void SoftwareRenderer::setNightLightsActive(bool active)
 
 		for (const auto &lightTexels : voxelTexture.lightTexels)
 		{
-			const int index = lightTexels.x + (lightTexels.y * VoxelTexture::WIDTH);
+			const int index = lightTexels.y + (lightTexels.x * VoxelTexture::HEIGHT);
+			texels.at(index) = VoxelTexel(texelColor.r, texelColor.g, texelColor.b, texelFlags);
+			voxelTexture.indexedTexels.at(index) = texelIndex;
+		}
 
-			VoxelTexel &texel = texels.at(index);
-			texel.r = texelColor.x;
-			texel.g = texelColor.y;
-			texel.b = texelColor.z;
-			texel.transparent = texelColor.w == 0.0;
-			texel.emission = texelEmission;
+		if (voxelTexture.lightTexels.size() > 0)
+		{
+			voxelTexture.updateMips();
 		}
 	}
 }
 
 void SoftwareRenderer::removeFlat(int id)
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	// Make sure the flat exists before removing it.
-	const auto flatIter = this->flats.find(id);
-	DebugAssertMsg(flatIter != this->flats.end(),
+	const auto indexIter = this->flatIndices.find(id);
+	DebugAssertMsg(indexIter != this->flatIndices.end(),
 		"Cannot remove a non-existent flat (" + std::to_string(id) + ").");
 
-	this->flats.erase(flatIter);
+	const int flatIndex = indexIter->second;
+	this->removeFlatFromCell(flatIndex);
+	this->flatIndices.erase(indexIter);
+
+	// Move the last flat into the removed one's place so the list stays packed.
+	const int lastIndex = static_cast<int>(this->flats.size()) - 1;
+	if (flatIndex != lastIndex)
+	{
+		Flat &lastFlat = this->flats[lastIndex];
+		std::vector<int> &cellFlatIndices = this->flatCells[lastFlat.cellIndex].flatIndices;
+		std::replace(cellFlatIndices.begin(), cellFlatIndices.end(), lastIndex, flatIndex);
+		this->flatIndices[lastFlat.id] = flatIndex;
+		this->flats[flatIndex] = lastFlat;
+	}
+
+	this->flats.pop_back();
+
+	// Forget about old cells once every flat is gone (i.e., when changing levels).
+	if (this->flats.empty())
+	{
+		this->flatCells.clear();
+		this->flatCellIndices.clear();
+	}
 }
 
 void SoftwareRenderer::removeLight(int id)
 {
-	DebugNotImplemented();
+	this->waitForFrame();
+	this->lastFrame.reset();
+
+	// Make sure the light exists before removing it.
+	const auto indexIter = this->lightIndices.find(id);
+	DebugAssertMsg(indexIter != this->lightIndices.end(),
+		"Cannot remove a non-existent light (" + std::to_string(id) + ").");
+
+	const int lightIndex = indexIter->second;
+	this->lightGrid.removeLight(lightIndex, this->lights[lightIndex]);
+	this->lightIndices.erase(indexIter);
+
+	// Move the last light into the removed one's place so the list stays packed.
+	const int lastIndex = static_cast<int>(this->lights.size()) - 1;
+	if (lightIndex != lastIndex)
+	{
+		const Light &lastLight = this->lights[lastIndex];
+		this->lightGrid.moveLight(lastIndex, lightIndex, lastLight);
+		this->lightIndices[lastLight.id] = lightIndex;
+		this->lights[lightIndex] = lastLight;
+	}
+
+	this->lights.pop_back();
 }
 
 void SoftwareRenderer::clearTextures()
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	for (auto &texture : this->voxelTextures)
 	{
 		std::fill(texture.texels.begin(), texture.texels.end(), VoxelTexel());
+		std::fill(texture.indexedTexels.begin(), texture.indexedTexels.end(),
+			TexturePalette::TRANSPARENT_INDEX);
 		texture.lightTexels.clear();
+		texture.hasTransparentTexels = true;
 	}
 
 	for (auto &texture : this->flatTextures)
 	{
 		std::fill(texture.texels.begin(), texture.texels.end(), FlatTexel());
+		std::fill(texture.indexedTexels.begin(), texture.indexedTexels.end(),
+			TexturePalette::TRANSPARENT_INDEX);
+		texture.mipOffsets.clear();
 		texture.width = 0;
 		texture.height = 0;
 	}
 
+	// All texture colors are gone, so the palette can start over.
+	this->texturePalette.clear();
+
 	// Distant sky textures are cleared because the vector size is managed internally.
 	this->skyTextures.clear();
 	this->sunTextureIndex = SoftwareRenderer::NO_SUN;
+	this->skyPanorama.dirty = true;
 }
 
 void SoftwareRenderer::clearDistantSky()
 {
+	this->waitForFrame();
+	this->lastFrame.reset();
+
 	this->distantObjects.clear();
+	this->skyPanorama.dirty = true;
 }
 
 void SoftwareRenderer::resize(int width, int height)
 {
+	// Any pending frame has the old dimensions, so it's thrown away.
+	this->waitForFrame();
+	this->lastFrame.reset();
+	this->pipelinedFrame.isFinished = false;
+
 	const int pixelCount = width * height;
 	this->depthBuffer.resize(pixelCount);
 	std::fill(this->depthBuffer.begin(), this->depthBuffer.end(), 
 		std::numeric_limits<double>::infinity());
 
+	this->depthTiles.resize(width * SoftwareRenderer::getDepthTileRows(height));
+	std::fill(this->depthTiles.begin(), this->depthTiles.end(),
+		std::numeric_limits<double>::infinity());
+
+	this->planeIDs.resize(pixelCount);
+	std::fill(this->planeIDs.begin(), this->planeIDs.end(), 0);
+
 	this->occlusion.resize(width);
 	std::fill(this->occlusion.begin(), this->occlusion.end(), OcclusionData(0, height));
 
+	this->columnHistoryValid = false;
+
 	this->width = width;
 	this->height = height;
-
-	// Restart render threads with new dimensions.
-	const int threadCount = SoftwareRenderer::getRenderThreadsFromMode(this->renderThreadsMode);
-	this->initRenderThreads(width, height, threadCount);
 }
 
-void SoftwareRenderer::initRenderThreads(int width, int height, int threadCount)
+void SoftwareRenderer::initRenderThreads(int threadCount)
 {
 	// If there are existing threads, reset them.
 	if (this->renderThreads.size() > 0)
@@ -818,40 +3131,28 @@ void SoftwareRenderer::initRenderThreads(int width, int height, int threadCount)
 		this->renderThreads.resize(threadCount);
 	}
 
-	// Block width and height are the approximate number of columns and rows per thread,
-	// respectively.
-	const double blockWidth = static_cast<double>(width) / static_cast<double>(threadCount);
-	const double blockHeight = static_cast<double>(height) / static_cast<double>(threadCount);
+	// The main thread takes part in the frame barrier.
+	this->threadData.frameBarrier.init(threadCount + 1);
+	this->threadData.threadBarrier.init(threadCount);
+	this->threadData.busySeconds = std::vector<double>(threadCount, 0.0);
+	this->renderThreadStats = std::vector<RenderThreadStats>(threadCount);
+	this->frameThreadStats = std::vector<RenderThreadStats>(threadCount);
 
-	// Start thread loop for each render thread. Rounding is involved so the start and stop
-	// coordinates are correct for all resolutions.
+	// Start thread loop for each render thread. Rows and columns are divided between the
+	// threads each frame, so the dimensions aren't needed here.
 	for (size_t i = 0; i < this->renderThreads.size(); i++)
 	{
 		const int threadIndex = static_cast<int>(i);
-		const int startX = static_cast<int>(std::round(static_cast<double>(i) * blockWidth));
-		const int endX = static_cast<int>(std::round(static_cast<double>(i + 1) * blockWidth));
-		const int startY = static_cast<int>(std::round(static_cast<double>(i) * blockHeight));
-		const int endY = static_cast<int>(std::round(static_cast<double>(i + 1) * blockHeight));
-
-		// Make sure the rounding is correct.
-		assert(startX >= 0);
-		assert(endX <= width);
-		assert(startY >= 0);
-		assert(endY <= height);
-
 		this->renderThreads.at(i) = std::thread(SoftwareRenderer::renderThreadLoop,
-			std::ref(this->threadData), threadIndex, startX, endX, startY, endY);
+			std::ref(this->threadData), threadIndex);
 	}
 }
 
 void SoftwareRenderer::resetRenderThreads()
 {
-	// Tell each render thread it needs to terminate.
-	std::unique_lock<std::mutex> lk(this->threadData.mutex);
-	this->threadData.go = true;
+	// Tell each render thread it needs to terminate. They are waiting at the start of a frame.
 	this->threadData.isDestructing = true;
-	lk.unlock();
-	this->threadData.condVar.notify_all();
+	this->threadData.frameBarrier.wait();
 
 	for (auto &thread : this->renderThreads)
 	{
@@ -861,11 +3162,278 @@ void SoftwareRenderer::resetRenderThreads()
 		}
 	}
 
-	// Set signal variables back to defaults, in case the render threads are used again.
-	this->threadData.go = false;
+	// Set the signal back to its default, in case the render threads are used again.
 	this->threadData.isDestructing = false;
 }
 
+void SoftwareRenderer::waitForFrame()
+{
+	PipelinedFrame &pipelinedFrame = this->pipelinedFrame;
+	if (pipelinedFrame.isDrawing)
+	{
+		pipelinedFrame.doneBarrier.wait();
+		pipelinedFrame.isDrawing = false;
+		pipelinedFrame.isFinished = true;
+
+		// The frame thread is idle now, so its results can be read.
+		this->renderThreadStats = this->frameThreadStats;
+		this->phaseTimings = this->framePhaseTimings;
+		this->frameLatency = std::chrono::duration<double>(
+			std::chrono::high_resolution_clock::now() - pipelinedFrame.startTime).count();
+	}
+}
+
+void SoftwareRenderer::startVisibilityBuild()
+{
+	this->cancelVisibilityBuild();
+
+	VisibilityBuild &build = this->visibilityBuild;
+	if (!build.isRequested || (this->fogDistance <= 0.0))
+	{
+		return;
+	}
+
+	// The thread gets its own copy of the voxels so the level can keep changing.
+	build.grid = std::make_unique<VisibilityGrid>();
+	build.maxDistance = this->fogDistance;
+	build.isFinished = false;
+	build.isCancelled = false;
+	build.thread = std::thread([&build, renderVoxelGrid = this->renderVoxelGrid]()
+	{
+		if (build.grid->init(renderVoxelGrid, build.maxDistance, build.isCancelled))
+		{
+			build.isFinished = true;
+		}
+	});
+}
+
+void SoftwareRenderer::cancelVisibilityBuild()
+{
+	VisibilityBuild &build = this->visibilityBuild;
+	if (build.thread.joinable())
+	{
+		build.isCancelled = true;
+		build.thread.join();
+	}
+
+	build.grid = nullptr;
+	build.isFinished = false;
+}
+
+void SoftwareRenderer::takeBuiltVisibility()
+{
+	VisibilityBuild &build = this->visibilityBuild;
+	if (build.isFinished)
+	{
+		if (build.thread.joinable())
+		{
+			build.thread.join();
+		}
+
+		this->visibility = std::move(*build.grid);
+		build.grid = nullptr;
+		build.isFinished = false;
+	}
+}
+
+uint64_t SoftwareRenderer::getLightmapKey(double ceilingHeight) const
+{
+	// FNV-1a hash of everything the lightmap is baked from. Only the voxels' data types and
+	// which doors are open matter since they decide which voxels are solid.
+	uint64_t key = 14695981039346656037ULL;
+	auto addBytes = [&key](const void *data, size_t size)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			key = (key ^ bytes[i]) * 1099511628211ULL;
+		}
+	};
+
+	const RenderVoxelGrid &voxelGrid = this->renderVoxelGrid;
+	const std::array<int, 3> dimensions = { voxelGrid.width, voxelGrid.height, voxelGrid.depth };
+	addBytes(dimensions.data(), sizeof(dimensions));
+	addBytes(&ceilingHeight, sizeof(ceilingHeight));
+
+	for (const RenderVoxel &voxel : voxelGrid.voxels)
+	{
+		addBytes(&voxel.dataType, sizeof(voxel.dataType));
+	}
+
+	// The door count keeps the door columns apart from the light values after them.
+	const std::vector<int> &doorColumns = this->lightmapDoorColumns;
+	const int doorCount = static_cast<int>(doorColumns.size());
+	addBytes(&doorCount, sizeof(doorCount));
+	addBytes(doorColumns.data(), doorColumns.size() * sizeof(int));
+
+	for (const Light &light : this->staticLights)
+	{
+		const std::array<double, 7> values =
+		{
+			light.point.x, light.point.y, light.point.z,
+			light.color.x, light.color.y, light.color.z,
+			light.intensity
+		};
+
+		addBytes(values.data(), sizeof(values));
+	}
+
+	return key;
+}
+
+void SoftwareRenderer::updateLightmapDoors(const LevelData::OpenDoors &openDoors)
+{
+	std::vector<int> &doorColumns = this->lightmapDoorColumns;
+	const int width = this->renderVoxelGrid.width;
+	auto getDoorColumn = [width](const LevelData::DoorState &door)
+	{
+		const Int2 &voxel = door.getVoxel();
+		return voxel.x + (voxel.y * width);
+	};
+
+	// Each door has its own voxel, so the same count with every door found is the same set.
+	bool isSame = openDoors.getCount() == static_cast<int>(doorColumns.size());
+	for (int i = 0; isSame && (i < openDoors.getCount()); i++)
+	{
+		isSame = std::binary_search(doorColumns.begin(), doorColumns.end(),
+			getDoorColumn(openDoors.get(i)));
+	}
+
+	if (isSame)
+	{
+		return;
+	}
+
+	doorColumns.clear();
+	for (int i = 0; i < openDoors.getCount(); i++)
+	{
+		doorColumns.push_back(getDoorColumn(openDoors.get(i)));
+	}
+
+	std::sort(doorColumns.begin(), doorColumns.end());
+
+	// The lightmap in use is kept until the new one is baked. Doors that open and close
+	// again find their old lightmap in the cache.
+	if (this->lightmapBuild.isRequested)
+	{
+		this->startLightmapBake();
+	}
+}
+
+void SoftwareRenderer::startLightmapBake()
+{
+	this->cancelLightmapBake();
+
+	LightmapBuild &build = this->lightmapBuild;
+	if (!build.isRequested)
+	{
+		return;
+	}
+
+	if (this->staticLights.size() == 0)
+	{
+		this->lightmap = nullptr;
+		this->lastFrame.reset();
+		return;
+	}
+
+	// Levels entered again have the same voxels and lights, so they're already baked.
+	const uint64_t key = this->getLightmapKey(build.ceilingHeight);
+	const auto cacheIter = this->lightmaps.find(key);
+	if (cacheIter != this->lightmaps.end())
+	{
+		CachedLightmap &cachedLightmap = cacheIter->second;
+		this->lightmapUseCount++;
+		cachedLightmap.lastUse = this->lightmapUseCount;
+		this->lightmap = &cachedLightmap.lightmap;
+		this->lastFrame.reset();
+		return;
+	}
+
+	// The threads get their own copy of the voxels and lights so the level can keep changing.
+	build.voxelGrid = this->renderVoxelGrid;
+	build.lights = this->staticLights;
+	build.lightGrid.init(build.voxelGrid.width, build.voxelGrid.depth, build.lights);
+	build.lightmap = std::make_unique<Lightmap>();
+	build.lightmap->init(build.voxelGrid, build.lightGrid, this->lightmapDoorColumns,
+		build.ceilingHeight);
+	build.key = key;
+	build.isCancelled = false;
+
+	// Frames keep being drawn while the lightmap is baked, so it only gets a quarter of the
+	// CPU's threads and the render threads aren't left waiting at their barriers for a core.
+	// Each thread bakes every Nth voxel column so they take about as long as each other.
+	const int threadCount = std::max(Platform::getThreadCount() / 4, 1);
+	build.remainingThreads = threadCount;
+	for (int i = 0; i < threadCount; i++)
+	{
+		build.threads.push_back(std::thread([&build, i, threadCount]()
+		{
+			build.lightmap->bake(build.voxelGrid, build.lights, build.lightGrid, i,
+				threadCount, build.isCancelled);
+			build.remainingThreads--;
+		}));
+	}
+}
+
+void SoftwareRenderer::cancelLightmapBake()
+{
+	LightmapBuild &build = this->lightmapBuild;
+	build.isCancelled = true;
+
+	for (std::thread &thread : build.threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	build.threads.clear();
+	build.lightmap = nullptr;
+}
+
+void SoftwareRenderer::takeBakedLightmap()
+{
+	LightmapBuild &build = this->lightmapBuild;
+	if ((build.lightmap == nullptr) || (build.remainingThreads > 0))
+	{
+		return;
+	}
+
+	for (std::thread &thread : build.threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	build.threads.clear();
+
+	// Make room by dropping the lightmap that was used longest ago. The one in use is
+	// replaced now anyway.
+	if (static_cast<int>(this->lightmaps.size()) >= SoftwareRenderer::LIGHTMAP_CACHE_SIZE)
+	{
+		const auto oldestIter = std::min_element(this->lightmaps.begin(), this->lightmaps.end(),
+			[](const std::pair<const uint64_t, CachedLightmap> &a,
+				const std::pair<const uint64_t, CachedLightmap> &b)
+		{
+			return a.second.lastUse < b.second.lastUse;
+		});
+
+		this->lightmaps.erase(oldestIter);
+	}
+
+	CachedLightmap &cachedLightmap = this->lightmaps[build.key];
+	cachedLightmap.lightmap = std::move(*build.lightmap);
+	this->lightmapUseCount++;
+	cachedLightmap.lastUse = this->lightmapUseCount;
+	this->lightmap = &cachedLightmap.lightmap;
+	build.lightmap = nullptr;
+	this->lastFrame.reset();
+}
+
 void SoftwareRenderer::updateVisibleDistantObjects(bool parallaxSky, const Double3 &sunDirection,
 	const Camera &camera, const FrameView &frame)
 {
@@ -929,7 +3497,9 @@ void SoftwareRenderer::updateVisibleDistantObjects(bool parallaxSky, const Doubl
 			const int yEnd = SoftwareRenderer::getUpperBoundedPixel(
 				yProjScreenEnd, frame.height);
 
-			return DrawRange(yProjScreenStart, yProjScreenEnd, yStart, yEnd);
+			// Distant objects aren't lit, so they have no world points.
+			return DrawRange(Double3::Zero, Double3::Zero, yProjScreenStart, yProjScreenEnd,
+				yStart, yEnd);
 		}();
 
 		// The position of the object's left and right edges depends on whether parallax
@@ -1079,47 +3649,124 @@ void SoftwareRenderer::updateVisibleDistantObjects(bool parallaxSky, const Doubl
 		}
 	};
 
-	// Iterate all distant objects and gather up the visible ones.
+	// Try to add the sun to the visible distant objects.
+	if (this->sunTextureIndex != SoftwareRenderer::NO_SUN)
+	{
+		const SkyTexture &sunTexture = this->skyTextures.at(this->sunTextureIndex);
+		const double sunXAngleRadians = MathUtils::fullAtan2(sunDirection.x, sunDirection.z);
+
+		// When the sun is directly above or below, it might cause the X angle to be undefined.
+		// We want to filter this out before we try projecting it on-screen.
+		if (std::isfinite(sunXAngleRadians))
+		{
+			const double sunYAngleRadians = sunDirection.getYAngleRadians();
+			const bool sunEmissive = true;
+			const Orientation sunOrientation = Orientation::Top;
+			tryAddObject(sunTexture, sunXAngleRadians, sunYAngleRadians,
+				sunEmissive, sunOrientation);
+		}
+	}
+}
+
+void SoftwareRenderer::updateSkyPanorama(bool parallaxSky, const Camera &camera,
+	const FrameView &frame)
+{
+	SkyPanorama &panorama = this->skyPanorama;
+
+	// Check if any animated land is showing a different frame than when it was drawn.
+	bool animChanged = false;
+	size_t animCount = 0;
+	for (const auto &obj : this->distantObjects)
+	{
+		if (obj.type == DistantObject::Type::AnimatedLand)
+		{
+			const int animIndex = obj.animLand->getIndex();
+			animChanged |= (animCount >= panorama.animIndices.size()) ||
+				(panorama.animIndices[animCount] != animIndex);
+			animCount++;
+		}
+	}
+
+	animChanged |= animCount != panorama.animIndices.size();
+
+	const bool isCurrent = !panorama.dirty && !animChanged &&
+		(panorama.parallaxSky == parallaxSky) && (panorama.fovY == camera.fovY) &&
+		(panorama.aspect == camera.aspect) && (panorama.frameWidth == frame.width) &&
+		(panorama.frameHeight == frame.height);
+
+	if (isCurrent)
+	{
+		return;
+	}
+
+	panorama.animIndices.clear();
+	panorama.fovY = camera.fovY;
+	panorama.aspect = camera.aspect;
+	panorama.frameWidth = frame.width;
+	panorama.frameHeight = frame.height;
+	panorama.parallaxSky = parallaxSky;
+	panorama.dirty = false;
+
+	// Columns are about as wide as a pixel in the middle of the screen.
+	const double pixelAngle = (2.0 * camera.aspect / camera.zoom) / frame.widthReal;
+	panorama.width = std::max(static_cast<int>(std::ceil(Constants::TwoPi / pixelAngle)), 1);
+	panorama.columnAngle = Constants::TwoPi / static_cast<double>(panorama.width);
+
+	// Rows are measured from the horizon with the camera looking straight ahead, which
+	// doesn't change when the camera looks up or down.
+	const Double3 forward(camera.forwardX, 0.0, camera.forwardZ);
+	const Camera levelCamera(camera.eye, forward, camera.fovY, camera.aspect,
+		SoftwareRenderer::TALL_PIXEL_RATIO);
+	const double horizonY = SoftwareRenderer::getProjectedY(
+		levelCamera.eye + forward, levelCamera.transform, levelCamera.yShear) * frame.heightReal;
+
+	// Where a distant object is in the panorama, in radians and pixels from the horizon.
+	struct Placement
+	{
+		const SkyTexture *texture;
+		double angleLeft, angleRight;
+		double yStart, yEnd;
+		bool emissive;
+	};
+
+	std::vector<Placement> placements;
+	placements.reserve(this->distantObjects.size());
+
 	for (const auto &obj : this->distantObjects)
 	{
 		const SkyTexture *texture = nullptr;
 		double xAngleRadians, yAngleRadians;
 		bool emissive;
-		Orientation orientation;
 
 		if (obj.type == DistantObject::Type::Land)
 		{
 			const DistantSky::LandObject &land = *obj.land;
-			texture = &skyTextures.at(obj.textureIndex);
+			texture = &this->skyTextures.at(obj.textureIndex);
 			xAngleRadians = land.getAngleRadians();
 			yAngleRadians = 0.0;
 			emissive = false;
-			orientation = Orientation::Bottom;
 		}
 		else if (obj.type == DistantObject::Type::AnimatedLand)
 		{
 			const DistantSky::AnimatedLandObject &animLand = *obj.animLand;
-			texture = &skyTextures.at(obj.textureIndex + animLand.getIndex());
+			const int animIndex = animLand.getIndex();
+			texture = &this->skyTextures.at(obj.textureIndex + animIndex);
 			xAngleRadians = animLand.getAngleRadians();
 			yAngleRadians = 0.0;
 			emissive = true;
-			orientation = Orientation::Bottom;
+			panorama.animIndices.push_back(animIndex);
 		}
 		else if (obj.type == DistantObject::Type::Air)
 		{
 			const DistantSky::AirObject &air = *obj.air;
-			texture = &skyTextures.at(obj.textureIndex);
+			texture = &this->skyTextures.at(obj.textureIndex);
 			xAngleRadians = air.getAngleRadians();
-			yAngleRadians = [&air]()
-			{
-				// 0 is at horizon, 1 is at top of distant cloud height limit.
-				const double gradientPercent = air.getHeight();
-				return gradientPercent *
-					(SoftwareRenderer::DISTANT_CLOUDS_MAX_ANGLE * Constants::DegToRad);
-			}();
 
+			// 0 is at horizon, 1 is at top of distant cloud height limit.
+			const double gradientPercent = air.getHeight();
+			yAngleRadians = gradientPercent *
+				(SoftwareRenderer::DISTANT_CLOUDS_MAX_ANGLE * Constants::DegToRad);
 			emissive = false;
-			orientation = Orientation::Bottom;
 		}
 		else if (obj.type == DistantObject::Type::Space)
 		{
@@ -1132,99 +3779,313 @@ void SoftwareRenderer::updateVisibleDistantObjects(bool parallaxSky, const Doubl
 				std::to_string(static_cast<int>(obj.type)) + "\".");
 		}
 
-		tryAddObject(*texture, xAngleRadians, yAngleRadians, emissive, orientation);
+		// The size of textures in world space is based on 320px being 1 unit, and a 320px
+		// wide texture spans a screen's worth of horizontal FOV.
+		constexpr double identityDim = 320.0;
+		constexpr double identityAngleRadians = 90.0 * Constants::DegToRad;
+		const double objWidth = static_cast<double>(texture->width) / identityDim;
+		const double objHeight = static_cast<double>(texture->height) / identityDim;
+		const double objHalfWidth = objWidth * 0.50;
+
+		// Project the bottom first then add the object's height above it in screen-space
+		// to get the top, the same as for the sun.
+		const Double3 objDirBottom = Double3(
+			camera.forwardX,
+			std::tan(yAngleRadians),
+			camera.forwardZ).normalized();
+		const double yProjEnd = SoftwareRenderer::getProjectedY(
+			levelCamera.eye + objDirBottom, levelCamera.transform, levelCamera.yShear);
+		const double yProjStart = yProjEnd - (objHeight * levelCamera.zoom);
+
+		// With parallax, the object covers a fixed angle. Otherwise it covers a fixed part
+		// of the screen, which is converted to the angle it would have in the middle.
+		const double xDeltaRadians = parallaxSky ? (objHalfWidth * identityAngleRadians) :
+			std::atan(objWidth / SoftwareRenderer::TALL_PIXEL_RATIO);
+
+		Placement placement;
+		placement.texture = texture;
+		placement.angleLeft = xAngleRadians + xDeltaRadians;
+		placement.angleRight = xAngleRadians - xDeltaRadians;
+		placement.yStart = (yProjStart * frame.heightReal) - horizonY;
+		placement.yEnd = (yProjEnd * frame.heightReal) - horizonY;
+		placement.emissive = emissive;
+		placements.push_back(placement);
 	}
 
-	// Try to add the sun to the visible distant objects.
-	if (this->sunTextureIndex != SoftwareRenderer::NO_SUN)
+	// Only keep the rows that objects are in.
+	double yMin = 0.0;
+	double yMax = 0.0;
+	if (placements.size() > 0)
 	{
-		const SkyTexture &sunTexture = this->skyTextures.at(this->sunTextureIndex);
-		const double sunXAngleRadians = MathUtils::fullAtan2(sunDirection.x, sunDirection.z);
+		yMin = std::numeric_limits<double>::infinity();
+		yMax = -std::numeric_limits<double>::infinity();
+		for (const Placement &placement : placements)
+		{
+			if (std::isfinite(placement.yStart) && std::isfinite(placement.yEnd))
+			{
+				yMin = std::min(yMin, placement.yStart);
+				yMax = std::max(yMax, placement.yEnd);
+			}
+		}
 
-		// When the sun is directly above or below, it might cause the X angle to be undefined.
-		// We want to filter this out before we try projecting it on-screen.
-		if (std::isfinite(sunXAngleRadians))
+		// Objects near straight up or down would make the panorama huge, so keep it within
+		// a few screens of the horizon.
+		yMin = std::max(yMin, -3.0 * frame.heightReal);
+		yMax = std::min(yMax, 3.0 * frame.heightReal);
+		yMax = std::max(yMax, yMin);
+	}
+
+	panorama.rowOrigin = static_cast<int>(std::floor(yMin));
+	panorama.height = static_cast<int>(std::ceil(yMax)) - panorama.rowOrigin;
+	panorama.texels.resize(panorama.width * panorama.height);
+	std::fill(panorama.texels.begin(), panorama.texels.end(), SkyPanorama::Texel());
+	panorama.rowStarts.resize(panorama.width);
+	panorama.rowEnds.resize(panorama.width);
+	std::fill(panorama.rowStarts.begin(), panorama.rowStarts.end(), panorama.height);
+	std::fill(panorama.rowEnds.begin(), panorama.rowEnds.end(), 0);
+
+	// Reverse iterate so objects are drawn far to near.
+	for (auto it = placements.rbegin(); it != placements.rend(); ++it)
+	{
+		const Placement &placement = *it;
+		const SkyTexture &texture = *placement.texture;
+		const double yStart = placement.yStart - static_cast<double>(panorama.rowOrigin);
+		const double yEnd = placement.yEnd - static_cast<double>(panorama.rowOrigin);
+		const int rowStart = SoftwareRenderer::getLowerBoundedPixel(yStart, panorama.height);
+		const int rowEnd = SoftwareRenderer::getUpperBoundedPixel(yEnd, panorama.height);
+
+		// Columns whose centers are inside the object's angles. These may go past either
+		// end of the panorama and wrap around.
+		const int columnStart = static_cast<int>(std::ceil(
+			(placement.angleRight / panorama.columnAngle) - 0.50));
+		const int columnEnd = static_cast<int>(std::ceil(
+			(placement.angleLeft / panorama.columnAngle) - 0.50));
+
+		for (int i = columnStart; i < columnEnd; i++)
+		{
+			const double angle = (static_cast<double>(i) + 0.50) * panorama.columnAngle;
+			const double u = MathUtils::clamp(
+				(placement.angleLeft - angle) / (placement.angleLeft - placement.angleRight),
+				0.0, Constants::JustBelowOne);
+			const int textureX = static_cast<int>(u * static_cast<double>(texture.width));
+			const int column = ((i % panorama.width) + panorama.width) % panorama.width;
+			SkyPanorama::Texel *columnTexels = panorama.texels.data() + (column * panorama.height);
+			int &columnRowStart = panorama.rowStarts[column];
+			int &columnRowEnd = panorama.rowEnds[column];
+
+			for (int row = rowStart; row < rowEnd; row++)
+			{
+				const double v = MathUtils::clamp(
+					((static_cast<double>(row) + 0.50) - yStart) / (yEnd - yStart),
+					0.0, Constants::JustBelowOne);
+				const int textureY = static_cast<int>(v * static_cast<double>(texture.height));
+				const SkyTexel &texel = texture.texels[textureX + (textureY * texture.width)];
+
+				if (!texel.transparent)
+				{
+					columnTexels[row] = SkyPanorama::Texel(
+						texel.r, texel.g, texel.b, placement.emissive);
+					columnRowStart = std::min(columnRowStart, row);
+					columnRowEnd = std::max(columnRowEnd, row + 1);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::getAnimIndices(std::vector<int> *animIndices) const
+{
+	animIndices->clear();
+	for (const auto &obj : this->distantObjects)
+	{
+		if (obj.type == DistantObject::Type::AnimatedLand)
 		{
-			const double sunYAngleRadians = sunDirection.getYAngleRadians();
-			const bool sunEmissive = true;
-			const Orientation sunOrientation = Orientation::Top;
-			tryAddObject(sunTexture, sunXAngleRadians, sunYAngleRadians,
-				sunEmissive, sunOrientation);
+			animIndices->push_back(obj.animLand->getIndex());
+		}
+	}
+}
+
+bool SoftwareRenderer::matchesLastFrame(const Double3 &eye, const Double3 &direction,
+	double fovY, const ShadingInfo &shadingInfo, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors) const
+{
+	const LastFrame &lastFrame = this->lastFrame;
+	if ((lastFrame.drawnCount == 0) || (eye != lastFrame.eye) ||
+		(direction != lastFrame.direction) || (fovY != lastFrame.fovY) ||
+		(parallaxSky != lastFrame.parallaxSky) || (paletteShading != lastFrame.paletteShading) ||
+		(mipmapping != lastFrame.mipmapping) ||
+		(interleavedColumns != lastFrame.interleavedColumns) ||
+		(ceilingHeight != lastFrame.ceilingHeight))
+	{
+		return false;
+	}
+
+	// Any door that moved, opened, or closed changes the frame.
+	if (openDoors.getCount() != static_cast<int>(lastFrame.doors.size()))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < openDoors.getCount(); i++)
+	{
+		const LevelData::DoorState &door = openDoors.get(i);
+		const LevelData::DoorState &lastDoor = lastFrame.doors[i];
+		if ((door.getVoxel() != lastDoor.getVoxel()) ||
+			(door.getPercentOpen() != lastDoor.getPercentOpen()))
+		{
+			return false;
+		}
+	}
+
+	// Animated distant objects must be showing the same frames.
+	size_t animCount = 0;
+	for (const auto &obj : this->distantObjects)
+	{
+		if (obj.type == DistantObject::Type::AnimatedLand)
+		{
+			if ((animCount >= lastFrame.animIndices.size()) ||
+				(lastFrame.animIndices[animCount] != obj.animLand->getIndex()))
+			{
+				return false;
+			}
+
+			animCount++;
+		}
+	}
+
+	if (animCount != lastFrame.animIndices.size())
+	{
+		return false;
+	}
+
+	// The time of day changes the sky, fog, and sun colors, and the sun's direction. They
+	// only matter once they change by more than a color channel step, or the sun moves by
+	// more than half a pixel.
+	auto isColorSimilar = [](const Double3 &a, const Double3 &b)
+	{
+		return (std::abs(a.x - b.x) <= SoftwareRenderer::COLOR_PRECISION) &&
+			(std::abs(a.y - b.y) <= SoftwareRenderer::COLOR_PRECISION) &&
+			(std::abs(a.z - b.z) <= SoftwareRenderer::COLOR_PRECISION);
+	};
+
+	for (size_t i = 0; i < shadingInfo.skyColors.size(); i++)
+	{
+		if (!isColorSimilar(shadingInfo.skyColors[i], lastFrame.skyColors[i]))
+		{
+			return false;
 		}
 	}
+
+	const double halfPixelRadians = ((fovY * Constants::DegToRad) /
+		static_cast<double>(std::max(this->height, 1))) * 0.50;
+	const double maxSunRadians = std::min(halfPixelRadians, SoftwareRenderer::COLOR_PRECISION);
+	const double sunRadians = std::acos(std::min(
+		shadingInfo.sunDirection.dot(lastFrame.sunDirection), 1.0));
+
+	return isColorSimilar(shadingInfo.sunColor, lastFrame.sunColor) &&
+		(sunRadians <= maxSunRadians) &&
+		(std::abs(shadingInfo.ambient - lastFrame.ambient) <= SoftwareRenderer::COLOR_PRECISION);
 }
 
-void SoftwareRenderer::updateVisibleFlats(const Camera &camera)
+void SoftwareRenderer::updateLastFrame(const Double3 &eye, const Double3 &direction,
+	double fovY, double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors)
 {
-	this->visibleFlats.clear();
-
-	// Each flat shares the same axes. The forward direction always faces opposite to 
-	// the camera direction.
-	const Double3 flatForward = Double3(-camera.forwardX, 0.0, -camera.forwardZ).normalized();
-	const Double3 flatUp = Double3::UnitY;
-	const Double3 flatRight = flatForward.cross(flatUp).normalized();
+	const ShadingInfo shadingInfo(this->skyPalette, daytimePercent, ambient, this->fogDistance,
+		nullptr, mipmapping, this->lights, this->lightGrid, this->lightmap);
 
-	const Double2 eye2D(camera.eye.x, camera.eye.z);
-	const Double2 direction(camera.forwardX, camera.forwardZ);
+	// Interleaved frames need two frames in a row from the same state to fill in every column.
+	LastFrame &lastFrame = this->lastFrame;
+	const bool isSame = this->matchesLastFrame(eye, direction, fovY, shadingInfo, parallaxSky,
+		paletteShading, mipmapping, interleavedColumns, ceilingHeight, openDoors);
+	lastFrame.drawnCount = isSame ? (lastFrame.drawnCount + 1) : 1;
 
-	// This is the visible flat determination algorithm. It goes through all flats and sees 
-	// which ones would be at least partially visible in the view frustum.
-	for (const auto &pair : this->flats)
+	// Only remember new values if they are different enough, so slow changes like the time
+	// of day can't creep forward a little at a time without ever drawing a new frame.
+	if (isSame)
 	{
-		const Flat &flat = pair.second;
-
-		// Scaled axes based on flat dimensions.
-		const Double3 flatRightScaled = flatRight * (flat.width * 0.50);
-		const Double3 flatUpScaled = flatUp * flat.height;
+		return;
+	}
 
-		// Calculate each corner of the flat in world space.
-		Flat::Frame flatFrame;
-		flatFrame.bottomStart = flat.position + flatRightScaled;
-		flatFrame.bottomEnd = flat.position - flatRightScaled;
-		flatFrame.topStart = flatFrame.bottomStart + flatUpScaled;
-		flatFrame.topEnd = flatFrame.bottomEnd + flatUpScaled;
+	lastFrame.doors.clear();
+	for (int i = 0; i < openDoors.getCount(); i++)
+	{
+		lastFrame.doors.push_back(openDoors.get(i));
+	}
 
-		// If the flat is somewhere in front of the camera, do further checks.
-		const Double2 flatPosition2D(flat.position.x, flat.position.z);
-		const Double2 flatEyeDiff = (flatPosition2D - eye2D).normalized();
-		const bool inFrontOfCamera = direction.dot(flatEyeDiff) > 0.0;
+	this->getAnimIndices(&lastFrame.animIndices);
+	lastFrame.skyColors = shadingInfo.skyColors;
+	lastFrame.eye = eye;
+	lastFrame.direction = direction;
+	lastFrame.sunColor = shadingInfo.sunColor;
+	lastFrame.sunDirection = shadingInfo.sunDirection;
+	lastFrame.fovY = fovY;
+	lastFrame.ambient = ambient;
+	lastFrame.ceilingHeight = ceilingHeight;
+	lastFrame.parallaxSky = parallaxSky;
+	lastFrame.paletteShading = paletteShading;
+	lastFrame.mipmapping = mipmapping;
+	lastFrame.interleavedColumns = interleavedColumns;
+}
 
-		if (inFrontOfCamera)
-		{
-			// Now project two of the flat's opposing corner points into camera space.
-			// The Z value is used with flat sorting (not rendering), and the X and Y values 
-			// are used to find where the flat is on-screen.
-			Double4 projStart = camera.transform * Double4(flatFrame.topStart, 1.0);
-			Double4 projEnd = camera.transform * Double4(flatFrame.bottomEnd, 1.0);
+void SoftwareRenderer::addFlatToCell(int flatIndex)
+{
+	Flat &flat = this->flats[flatIndex];
+	const int cellX = static_cast<int>(std::floor(flat.position.x / SoftwareRenderer::FLAT_CELL_SIZE));
+	const int cellZ = static_cast<int>(std::floor(flat.position.z / SoftwareRenderer::FLAT_CELL_SIZE));
+	const int64_t cellKey = (static_cast<int64_t>(cellX) << 32) |
+		static_cast<int64_t>(static_cast<uint32_t>(cellZ));
+
+	// Create the cell if no flat has been in it yet.
+	auto cellIter = this->flatCellIndices.find(cellKey);
+	if (cellIter == this->flatCellIndices.end())
+	{
+		const Double2 center(
+			(static_cast<double>(cellX) + 0.50) * SoftwareRenderer::FLAT_CELL_SIZE,
+			(static_cast<double>(cellZ) + 0.50) * SoftwareRenderer::FLAT_CELL_SIZE);
+		this->flatCells.push_back(FlatCell(center));
+		cellIter = this->flatCellIndices.insert(std::make_pair(
+			cellKey, static_cast<int>(this->flatCells.size()) - 1)).first;
+	}
 
-			// Normalize coordinates.
-			projStart = projStart / projStart.w;
-			projEnd = projEnd / projEnd.w;
+	FlatCell &cell = this->flatCells[cellIter->second];
+	cell.flatIndices.push_back(flatIndex);
+	cell.maxHalfWidth = std::max(cell.maxHalfWidth, flat.width * 0.50);
+	flat.cellIndex = cellIter->second;
+}
 
-			// Assign each screen value to the flat frame data.
-			flatFrame.startX = 0.50 + (projStart.x * 0.50);
-			flatFrame.endX = 0.50 + (projEnd.x * 0.50);
-			flatFrame.startY = (0.50 + camera.yShear) - (projStart.y * 0.50);
-			flatFrame.endY = (0.50 + camera.yShear) - (projEnd.y * 0.50);
-			flatFrame.z = projStart.z;
+void SoftwareRenderer::removeFlatFromCell(int flatIndex)
+{
+	Flat &flat = this->flats[flatIndex];
+	std::vector<int> &cellFlatIndices = this->flatCells[flat.cellIndex].flatIndices;
+	const auto iter = std::find(cellFlatIndices.begin(), cellFlatIndices.end(), flatIndex);
+	DebugAssert(iter != cellFlatIndices.end());
+
+	// Order within a cell doesn't matter.
+	*iter = cellFlatIndices.back();
+	cellFlatIndices.pop_back();
+	flat.cellIndex = -1;
+}
 
-			// Check that the Z value is within the clipping planes.
-			const bool inPlanes = (flatFrame.z >= SoftwareRenderer::NEAR_PLANE) &&
-				(flatFrame.z <= SoftwareRenderer::FAR_PLANE);
+void SoftwareRenderer::updateVisibleFlats()
+{
+	this->visibleFlats.clear();
 
-			if (inPlanes)
-			{
-				// Add the flat data to the draw list.
-				this->visibleFlats.push_back(VisibleFlat(flat, std::move(flatFrame)));
-			}
-		}
+	for (const auto &threadFlats : this->threadData.flats.threadVisibleFlats)
+	{
+		this->visibleFlats.insert(this->visibleFlats.end(), threadFlats.begin(), threadFlats.end());
 	}
 
-	// Sort the visible flats farthest to nearest (relevant for transparencies).
+	// Sort the visible flats farthest to nearest (relevant for transparencies). Flats at the
+	// same depth are ordered by ID so the result doesn't depend on which thread found them.
 	std::sort(this->visibleFlats.begin(), this->visibleFlats.end(),
 		[](const VisibleFlat &a, const VisibleFlat &b)
 	{
-		return a.getFrame().z > b.getFrame().z;
+		const double aZ = a.getFrame().z;
+		const double bZ = b.getFrame().z;
+		return (aZ > bZ) || ((aZ == bZ) && (a.getFlat().id < b.getFlat().id));
 	});
 }
 
@@ -1836,19 +4697,6 @@ VoxelData::Facing SoftwareRenderer::getChasmFarFacing(int voxelX, int voxelZ,
 	}
 }
 
-double SoftwareRenderer::getDoorPercentOpen(int voxelX, int voxelZ,
-	const std::vector<LevelData::DoorState> &openDoors)
-{
-	const Int2 voxel(voxelX, voxelZ);
-	const auto iter = std::find_if(openDoors.begin(), openDoors.end(),
-		[&voxel](const LevelData::DoorState &openDoor)
-	{
-		return openDoor.getVoxel() == voxel;
-	});
-
-	return (iter != openDoors.end()) ? iter->getPercentOpen() : 0.0;
-}
-
 double SoftwareRenderer::getProjectedY(const Double3 &point, 
 	const Matrix4d &transform, double yShear)
 {	
@@ -1875,6 +4723,25 @@ int SoftwareRenderer::getUpperBoundedPixel(double projected, int frameDim)
 	return MathUtils::clamp(static_cast<int>(std::floor(projected + 0.50)), 0, frameDim);
 }
 
+int SoftwareRenderer::getDepthTileRows(int frameHeight)
+{
+	return (frameHeight + SoftwareRenderer::DEPTH_TILE_HEIGHT - 1) /
+		SoftwareRenderer::DEPTH_TILE_HEIGHT;
+}
+
+int SoftwareRenderer::getMipLevel(double texelsPerPixel, int levelCount)
+{
+	// Each level halves the texels per pixel. Stop at the first one that doesn't skip texels.
+	int level = 0;
+	while ((texelsPerPixel >= 2.0) && (level < (levelCount - 1)))
+	{
+		texelsPerPixel *= 0.50;
+		level++;
+	}
+
+	return level;
+}
+
 SoftwareRenderer::DrawRange SoftwareRenderer::makeDrawRange(const Double3 &startPoint,
 	const Double3 &endPoint, const Camera &camera, const FrameView &frame)
 {
@@ -1885,7 +4752,7 @@ SoftwareRenderer::DrawRange SoftwareRenderer::makeDrawRange(const Double3 &start
 	const int yStart = SoftwareRenderer::getLowerBoundedPixel(yProjStart, frame.height);
 	const int yEnd = SoftwareRenderer::getUpperBoundedPixel(yProjEnd, frame.height);
 
-	return DrawRange(yProjStart, yProjEnd, yStart, yEnd);
+	return DrawRange(startPoint, endPoint, yProjStart, yProjEnd, yStart, yEnd);
 }
 
 std::array<SoftwareRenderer::DrawRange, 2> SoftwareRenderer::makeDrawRangeTwoPart(
@@ -1906,8 +4773,8 @@ std::array<SoftwareRenderer::DrawRange, 2> SoftwareRenderer::makeDrawRangeTwoPar
 
 	return std::array<DrawRange, 2>
 	{
-		DrawRange(startYProjStart, startYProjEnd, startYStart, startYEnd),
-		DrawRange(startYProjEnd, endYProjEnd, endYStart, endYEnd)
+		DrawRange(startPoint, midPoint, startYProjStart, startYProjEnd, startYStart, startYEnd),
+		DrawRange(midPoint, endPoint, startYProjEnd, endYProjEnd, endYStart, endYEnd)
 	};
 }
 
@@ -1933,9 +4800,9 @@ std::array<SoftwareRenderer::DrawRange, 3> SoftwareRenderer::makeDrawRangeThreeP
 
 	return std::array<DrawRange, 3>
 	{
-		DrawRange(startYProjStart, startYProjEnd, startYStart, startYEnd),
-		DrawRange(startYProjEnd, mid1YProjEnd, mid1YStart, mid1YEnd),
-		DrawRange(mid1YProjEnd, mid2YProjEnd, mid2YStart, mid2YEnd)
+		DrawRange(startPoint, midPoint1, startYProjStart, startYProjEnd, startYStart, startYEnd),
+		DrawRange(midPoint1, midPoint2, startYProjEnd, mid1YProjEnd, mid1YStart, mid1YEnd),
+		DrawRange(midPoint2, endPoint, mid1YProjEnd, mid2YProjEnd, mid2YStart, mid2YEnd)
 	};
 }
 
@@ -2761,8 +5628,16 @@ void SoftwareRenderer::drawPixels(int x, const DrawRange &drawRange, double dept
 	int yStart = drawRange.yStart;
 	int yEnd = drawRange.yEnd;
 
+	// Mip level from how many texels each pixel steps down the column.
+	const int mipLevel = shadingInfo.mipmapping ? SoftwareRenderer::getMipLevel(
+		(std::abs(vEnd - vStart) * static_cast<double>(VoxelTexture::HEIGHT)) /
+		(yProjEnd - yProjStart), VoxelTexture::MIP_LEVEL_COUNT) : 0;
+	const int mipOffset = VoxelTexture::getMipOffset(mipLevel);
+	const int mipSize = VoxelTexture::WIDTH >> mipLevel;
+	const double mipSizeReal = static_cast<double>(mipSize);
+
 	// Horizontal offset in texture.
-	const int textureX = static_cast<int>(u * static_cast<double>(VoxelTexture::WIDTH));
+	const int textureX = static_cast<int>(u * mipSizeReal);
 
 	// Linearly interpolated fog.
 	const Double3 &fogColor = shadingInfo.getFogColor();
@@ -2774,16 +5649,50 @@ void SoftwareRenderer::drawPixels(int x, const DrawRange &drawRange, double dept
 		0.0, 1.0 - shadingInfo.ambient);
 
 	// Shading on the texture.
-	// - @todo: contribution from lights.
 	const Double3 shading(
 		shadingInfo.ambient + sunComponent.x,
 		shadingInfo.ambient + sunComponent.y,
 		shadingInfo.ambient + sunComponent.z);
 
+	// Point lights reaching the column. It's on one voxel face, so they're the same for
+	// every pixel.
+	const ColumnLights columnLights = shadingInfo.getLights(
+		Double2(drawRange.startPoint.x, drawRange.startPoint.z), normal);
+
 	// Clip the Y start and end coordinates as needed, and refresh the occlusion buffer.
 	occlusion.clipRange(&yStart, &yEnd);
 	occlusion.update(yStart, yEnd);
 
+	if ((shadingInfo.colormap != nullptr) && !columnLights.isLit())
+	{
+		// Palette shading. Light and fog are constant for the column, so every texel is
+		// shaded with the same row of palette colors. Lit columns are shaded in true color.
+		const uint32_t *colors = shadingInfo.colormap->getColors(
+			Colormap::getLightLevel(lightNormalDot), Colormap::getFogLevel(fogPercent));
+
+		for (int y = yStart; y < yEnd; y++)
+		{
+			const int index = x + (y * frame.width);
+
+			if (depth <= (frame.depthBuffer[index] - Constants::Epsilon))
+			{
+				const double yPercent =
+					((static_cast<double>(y) + 0.50) - yProjStart) / (yProjEnd - yProjStart);
+				const double v = vStart + ((vEnd - vStart) * yPercent);
+				const int textureY = static_cast<int>(v * mipSizeReal);
+				const int textureIndex = mipOffset + textureY + (textureX * mipSize);
+
+				frame.colorBuffer[index] = colors[texture.indexedTexels[textureIndex]];
+				frame.depthBuffer[index] = depth;
+			}
+		}
+
+		return;
+	}
+
+	// Visible texels are gathered and shaded several at a time.
+	ShadingBatch batch(shading, fogColor, frame.colorBuffer);
+
 	// Draw the column to the output buffer.
 	for (int y = yStart; y < yEnd; y++)
 	{
@@ -2802,39 +5711,30 @@ void SoftwareRenderer::drawPixels(int x, const DrawRange &drawRange, double dept
 			const double v = vStart + ((vEnd - vStart) * yPercent);
 
 			// Y position in texture.
-			const int textureY = static_cast<int>(v * static_cast<double>(VoxelTexture::HEIGHT));
+			const int textureY = static_cast<int>(v * mipSizeReal);
 
 			// Alpha is ignored in this loop, so transparent texels will appear black.
-			const int textureIndex = textureX + (textureY * VoxelTexture::WIDTH);
+			const int textureIndex = mipOffset + textureY + (textureX * mipSize);
 			const VoxelTexel &texel = texture.texels[textureIndex];
+			const uint32_t packedTexel = ShadingKernels::packTexel(
+				texel.r, texel.g, texel.b, texel.isEmissive());
 
-			// Texture color with shading.
-			const double shadingMax = 1.0;
-			double colorR = texel.r * std::min(shading.x + texel.emission, shadingMax);
-			double colorG = texel.g * std::min(shading.y + texel.emission, shadingMax);
-			double colorB = texel.b * std::min(shading.z + texel.emission, shadingMax);
-
-			// Linearly interpolate with fog.
-			colorR += (fogColor.x - colorR) * fogPercent;
-			colorG += (fogColor.y - colorG) * fogPercent;
-			colorB += (fogColor.z - colorB) * fogPercent;
-
-			// Clamp maximum (don't worry about negative values).
-			const double high = 1.0;
-			colorR = (colorR > high) ? high : colorR;
-			colorG = (colorG > high) ? high : colorG;
-			colorB = (colorB > high) ? high : colorB;
-
-			// Convert floats to integers.
-			const uint32_t colorRGB = static_cast<uint32_t>(
-				((static_cast<uint8_t>(colorR * 255.0)) << 16) |
-				((static_cast<uint8_t>(colorG * 255.0)) << 8) |
-				((static_cast<uint8_t>(colorB * 255.0))));
+			if (columnLights.isLit())
+			{
+				const Double3 point = drawRange.startPoint.lerp(drawRange.endPoint, yPercent);
+				batch.addLit(packedTexel, fogPercent, index,
+					shadingInfo.getLightColor(point, normal, columnLights));
+			}
+			else
+			{
+				batch.add(packedTexel, fogPercent, index);
+			}
 
-			frame.colorBuffer[index] = colorRGB;
 			frame.depthBuffer[index] = depth;
 		}
 	}
+
+	batch.flush();
 }
 
 void SoftwareRenderer::drawPerspectivePixels(int x, const DrawRange &drawRange,
@@ -2857,23 +5757,77 @@ void SoftwareRenderer::drawPerspectivePixels(int x, const DrawRange &drawRange,
 		0.0, 1.0 - shadingInfo.ambient);
 
 	// Shading on the texture.
-	// - @todo: contribution from lights.
 	const Double3 shading(
 		shadingInfo.ambient + sunComponent.x,
 		shadingInfo.ambient + sunComponent.y,
 		shadingInfo.ambient + sunComponent.z);
 
+	// Point lights reaching the column. Its start and end points are on the edges of one
+	// voxel, so the voxel is found from the point between them.
+	const ColumnLights columnLights = shadingInfo.getLights(
+		startPoint.lerp(endPoint, 0.50), normal);
+
 	// Values for perspective-correct interpolation.
 	const double depthStartRecip = 1.0 / depthStart;
 	const double depthEndRecip = 1.0 / depthEnd;
 	const Double2 startPointDiv = startPoint * depthStartRecip;
 	const Double2 endPointDiv = endPoint * depthEndRecip;
 	const Double2 pointDivDiff = endPointDiv - startPointDiv;
+
+	// Mip level from the average number of texels each pixel steps down the column. The
+	// far end steps more and the near end less, but one level is used for the whole column.
+	const int mipLevel = shadingInfo.mipmapping ? SoftwareRenderer::getMipLevel(
+		((endPoint - startPoint).length() * static_cast<double>(VoxelTexture::WIDTH)) /
+		(yProjEnd - yProjStart), VoxelTexture::MIP_LEVEL_COUNT) : 0;
+	const int mipOffset = VoxelTexture::getMipOffset(mipLevel);
+	const int mipSize = VoxelTexture::WIDTH >> mipLevel;
+	const double mipSizeReal = static_cast<double>(mipSize);
 	
 	// Clip the Y start and end coordinates as needed, and refresh the occlusion buffer.
 	occlusion.clipRange(&yStart, &yEnd);
 	occlusion.update(yStart, yEnd);
 
+	if ((shadingInfo.colormap != nullptr) && !columnLights.isLit())
+	{
+		// Palette shading. Light is constant for the column but fog varies per pixel.
+		const int lightLevel = Colormap::getLightLevel(lightNormalDot);
+
+		for (int y = yStart; y < yEnd; y++)
+		{
+			const int index = x + (y * frame.width);
+			const double yPercent =
+				((static_cast<double>(y) + 0.50) - yProjStart) / (yProjEnd - yProjStart);
+			const double depth = 1.0 /
+				(depthStartRecip + ((depthEndRecip - depthStartRecip) * yPercent));
+
+			if (depth <= frame.depthBuffer[index])
+			{
+				const double fogPercent = std::min(depth / shadingInfo.fogDistance, 1.0);
+				const double currentPointX = (startPointDiv.x + (pointDivDiff.x * yPercent)) * depth;
+				const double currentPointY = (startPointDiv.y + (pointDivDiff.y * yPercent)) * depth;
+				const double u = MathUtils::clamp(
+					Constants::JustBelowOne - (currentPointX - std::floor(currentPointX)),
+					0.0, Constants::JustBelowOne);
+				const double v = MathUtils::clamp(
+					Constants::JustBelowOne - (currentPointY - std::floor(currentPointY)),
+					0.0, Constants::JustBelowOne);
+				const int textureX = static_cast<int>(u * mipSizeReal);
+				const int textureY = static_cast<int>(v * mipSizeReal);
+				const int textureIndex = mipOffset + textureY + (textureX * mipSize);
+
+				const uint32_t *colors = shadingInfo.colormap->getColors(
+					lightLevel, Colormap::getFogLevel(fogPercent));
+				frame.colorBuffer[index] = colors[texture.indexedTexels[textureIndex]];
+				frame.depthBuffer[index] = depth;
+			}
+		}
+
+		return;
+	}
+
+	// Visible texels are gathered and shaded several at a time.
+	ShadingBatch batch(shading, fogColor, frame.colorBuffer);
+
 	// Draw the column to the output buffer.
 	for (int y = yStart; y < yEnd; y++)
 	{
@@ -2908,38 +5862,55 @@ void SoftwareRenderer::drawPerspectivePixels(int x, const DrawRange &drawRange,
 				0.0, Constants::JustBelowOne);
 
 			// Offsets in texture.
-			const int textureX = static_cast<int>(u * static_cast<double>(VoxelTexture::WIDTH));
-			const int textureY = static_cast<int>(v * static_cast<double>(VoxelTexture::HEIGHT));
+			const int textureX = static_cast<int>(u * mipSizeReal);
+			const int textureY = static_cast<int>(v * mipSizeReal);
 
 			// Alpha is ignored in this loop, so transparent texels will appear black.
-			const int textureIndex = textureX + (textureY * VoxelTexture::WIDTH);
+			const int textureIndex = mipOffset + textureY + (textureX * mipSize);
 			const VoxelTexel &texel = texture.texels[textureIndex];
+			const uint32_t packedTexel = ShadingKernels::packTexel(
+				texel.r, texel.g, texel.b, texel.isEmissive());
 
-			// Texture color with shading.
-			const double shadingMax = 1.0;
-			double colorR = texel.r * std::min(shading.x + texel.emission, shadingMax);
-			double colorG = texel.g * std::min(shading.y + texel.emission, shadingMax);
-			double colorB = texel.b * std::min(shading.z + texel.emission, shadingMax);
+			if (columnLights.isLit())
+			{
+				const Double3 point(currentPointX, drawRange.startPoint.y, currentPointY);
+				batch.addLit(packedTexel, fogPercent, index,
+					shadingInfo.getLightColor(point, normal, columnLights));
+			}
+			else
+			{
+				batch.add(packedTexel, fogPercent, index);
+			}
 
-			// Linearly interpolate with fog.
-			colorR += (fogColor.x - colorR) * fogPercent;
-			colorG += (fogColor.y - colorG) * fogPercent;
-			colorB += (fogColor.z - colorB) * fogPercent;
+			frame.depthBuffer[index] = depth;
+		}
+	}
 
-			// Clamp maximum (don't worry about negative values).
-			const double high = 1.0;
-			colorR = (colorR > high) ? high : colorR;
-			colorG = (colorG > high) ? high : colorG;
-			colorB = (colorB > high) ? high : colorB;
+	batch.flush();
+}
 
-			// Convert floats to integers.
-			const uint32_t colorRGB = static_cast<uint32_t>(
-				((static_cast<uint8_t>(colorR * 255.0)) << 16) |
-				((static_cast<uint8_t>(colorG * 255.0)) << 8) |
-				((static_cast<uint8_t>(colorB * 255.0))));
+void SoftwareRenderer::drawPlanePixels(int x, const DrawRange &drawRange, int planeY,
+	int textureID, OcclusionData &occlusion, const FrameView &frame)
+{
+	int yStart = drawRange.yStart;
+	int yEnd = drawRange.yEnd;
 
-			frame.colorBuffer[index] = colorRGB;
-			frame.depthBuffer[index] = depth;
+	// Clip the Y start and end coordinates as needed, and refresh the occlusion buffer.
+	occlusion.clipRange(&yStart, &yEnd);
+	occlusion.update(yStart, yEnd);
+
+	// The plane's Y level is offset by one so zero can mean no plane, and the texture goes
+	// in the high byte.
+	const uint16_t planeID = static_cast<uint16_t>((textureID << 8) | (planeY + 1));
+
+	for (int y = yStart; y < yEnd; y++)
+	{
+		// Voxels are drawn front to back, so a plane that's already here is nearer. Depth is
+		// tested when the spans are drawn, since transparent texels might be in front.
+		uint16_t &pixelPlaneID = frame.planeIDs[x + (y * frame.width)];
+		if (pixelPlaneID == 0)
+		{
+			pixelPlaneID = planeID;
 		}
 	}
 }
@@ -2954,8 +5925,16 @@ void SoftwareRenderer::drawTransparentPixels(int x, const DrawRange &drawRange,
 	int yStart = drawRange.yStart;
 	int yEnd = drawRange.yEnd;
 
+	// Mip level from how many texels each pixel steps down the column.
+	const int mipLevel = shadingInfo.mipmapping ? SoftwareRenderer::getMipLevel(
+		(std::abs(vEnd - vStart) * static_cast<double>(VoxelTexture::HEIGHT)) /
+		(yProjEnd - yProjStart), VoxelTexture::MIP_LEVEL_COUNT) : 0;
+	const int mipOffset = VoxelTexture::getMipOffset(mipLevel);
+	const int mipSize = VoxelTexture::WIDTH >> mipLevel;
+	const double mipSizeReal = static_cast<double>(mipSize);
+
 	// Horizontal offset in texture.
-	const int textureX = static_cast<int>(u * static_cast<double>(VoxelTexture::WIDTH));
+	const int textureX = static_cast<int>(u * mipSizeReal);
 
 	// Linearly interpolated fog.
 	const Double3 &fogColor = shadingInfo.getFogColor();
@@ -2967,16 +5946,52 @@ void SoftwareRenderer::drawTransparentPixels(int x, const DrawRange &drawRange,
 		0.0, 1.0 - shadingInfo.ambient);
 
 	// Shading on the texture.
-	// - @todo: contribution from lights.
 	const Double3 shading(
 		shadingInfo.ambient + sunComponent.x,
 		shadingInfo.ambient + sunComponent.y,
 		shadingInfo.ambient + sunComponent.z);
 
+	// Point lights reaching the column.
+	const ColumnLights columnLights = shadingInfo.getLights(
+		Double2(drawRange.startPoint.x, drawRange.startPoint.z), normal);
+
 	// Clip the Y start and end coordinates as needed, but do not refresh the occlusion buffer,
 	// because transparent ranges do not occlude as simply as opaque ranges.
 	occlusion.clipRange(&yStart, &yEnd);
 
+	if ((shadingInfo.colormap != nullptr) && !columnLights.isLit())
+	{
+		// Palette shading with alpha testing.
+		const uint32_t *colors = shadingInfo.colormap->getColors(
+			Colormap::getLightLevel(lightNormalDot), Colormap::getFogLevel(fogPercent));
+
+		for (int y = yStart; y < yEnd; y++)
+		{
+			const int index = x + (y * frame.width);
+
+			if (depth <= (frame.depthBuffer[index] - Constants::Epsilon))
+			{
+				const double yPercent =
+					((static_cast<double>(y) + 0.50) - yProjStart) / (yProjEnd - yProjStart);
+				const double v = vStart + ((vEnd - vStart) * yPercent);
+				const int textureY = static_cast<int>(v * mipSizeReal);
+				const int textureIndex = mipOffset + textureY + (textureX * mipSize);
+				const uint8_t texelIndex = texture.indexedTexels[textureIndex];
+
+				if (texelIndex != TexturePalette::TRANSPARENT_INDEX)
+				{
+					frame.colorBuffer[index] = colors[texelIndex];
+					frame.depthBuffer[index] = depth;
+				}
+			}
+		}
+
+		return;
+	}
+
+	// Visible texels are gathered and shaded several at a time.
+	ShadingBatch batch(shading, fogColor, frame.colorBuffer);
+
 	// Draw the column to the output buffer.
 	for (int y = yStart; y < yEnd; y++)
 	{
@@ -2993,42 +6008,34 @@ void SoftwareRenderer::drawTransparentPixels(int x, const DrawRange &drawRange,
 			const double v = vStart + ((vEnd - vStart) * yPercent);
 
 			// Y position in texture.
-			const int textureY = static_cast<int>(v * static_cast<double>(VoxelTexture::HEIGHT));
+			const int textureY = static_cast<int>(v * mipSizeReal);
 
 			// Alpha is checked in this loop, and transparent texels are not drawn.
-			const int textureIndex = textureX + (textureY * VoxelTexture::WIDTH);
+			const int textureIndex = mipOffset + textureY + (textureX * mipSize);
 			const VoxelTexel &texel = texture.texels[textureIndex];
 			
-			if (!texel.transparent)
+			if (!texel.isTransparent())
 			{
-				// Texture color with shading.
-				const double shadingMax = 1.0;
-				double colorR = texel.r * std::min(shading.x + texel.emission, shadingMax);
-				double colorG = texel.g * std::min(shading.y + texel.emission, shadingMax);
-				double colorB = texel.b * std::min(shading.z + texel.emission, shadingMax);
-
-				// Linearly interpolate with fog.
-				colorR += (fogColor.x - colorR) * fogPercent;
-				colorG += (fogColor.y - colorG) * fogPercent;
-				colorB += (fogColor.z - colorB) * fogPercent;
-				
-				// Clamp maximum (don't worry about negative values).
-				const double high = 1.0;
-				colorR = (colorR > high) ? high : colorR;
-				colorG = (colorG > high) ? high : colorG;
-				colorB = (colorB > high) ? high : colorB;
+				const uint32_t packedTexel = ShadingKernels::packTexel(
+					texel.r, texel.g, texel.b, texel.isEmissive());
 
-				// Convert floats to integers.
-				const uint32_t colorRGB = static_cast<uint32_t>(
-					((static_cast<uint8_t>(colorR * 255.0)) << 16) |
-					((static_cast<uint8_t>(colorG * 255.0)) << 8) |
-					((static_cast<uint8_t>(colorB * 255.0))));
+				if (columnLights.isLit())
+				{
+					const Double3 point = drawRange.startPoint.lerp(drawRange.endPoint, yPercent);
+					batch.addLit(packedTexel, fogPercent, index,
+						shadingInfo.getLightColor(point, normal, columnLights));
+				}
+				else
+				{
+					batch.add(packedTexel, fogPercent, index);
+				}
 
-				frame.colorBuffer[index] = colorRGB;
 				frame.depthBuffer[index] = depth;
 			}
 		}
 	}
+
+	batch.flush();
 }
 
 void SoftwareRenderer::drawDistantPixels(int x, const DrawRange &drawRange, double u,
@@ -3069,9 +6076,9 @@ void SoftwareRenderer::drawDistantPixels(int x, const DrawRange &drawRange, doub
 		if (!texel.transparent)
 		{
 			// Texture color with shading.
-			double colorR = texel.r * shading;
-			double colorG = texel.g * shading;
-			double colorB = texel.b * shading;
+			double colorR = ShadingKernels::NormalizedChannels[texel.r] * shading;
+			double colorG = ShadingKernels::NormalizedChannels[texel.g] * shading;
+			double colorB = ShadingKernels::NormalizedChannels[texel.b] * shading;
 
 			// @todo: determine if distant objects should be affected by fog using some
 			// arbitrary range in the new engine, just for aesthetic purposes.
@@ -3096,8 +6103,9 @@ void SoftwareRenderer::drawDistantPixels(int x, const DrawRange &drawRange, doub
 void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, const Camera &camera,
 	const Ray &ray, VoxelData::Facing facing, const Double2 &nearPoint, const Double2 &farPoint,
 	double nearZ, double farZ, const ShadingInfo &shadingInfo, double ceilingHeight,
-	const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
-	const std::vector<VoxelTexture> &textures, OcclusionData &occlusion, const FrameView &frame)
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+	const RenderVoxelGrid &renderVoxelGrid, const std::vector<VoxelTexture> &textures,
+	OcclusionData &occlusion, const FrameView &frame)
 {
 	// This method handles some special cases such as drawing the back-faces of wall sides.
 
@@ -3136,20 +6144,20 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 	// this voxel column.
 	const Double3 wallNormal = -VoxelData::getNormal(facing);
 
+	// Voxels in this column from bottom to top.
+	const RenderVoxel *voxelColumn = renderVoxelGrid.getColumn(voxelX, voxelZ);
+
 	auto drawInitialVoxel = [x, voxelX, voxelZ, &camera, &ray, &wallNormal, &nearPoint,
 		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors, &voxelGrid,
-		&textures, &occlusion, &frame](int voxelY)
+		voxelColumn, &renderVoxelGrid, &textures, &occlusion, &frame](int voxelY)
 	{
-		const uint16_t voxelID = voxelGrid.getVoxel(voxelX, voxelY, voxelZ);
-		const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+		const RenderVoxel &voxel = voxelColumn[voxelY];
 		const double voxelHeight = ceilingHeight;
 		const double voxelYReal = static_cast<double>(voxelY) * voxelHeight;
 
-		if (voxelData.dataType == VoxelDataType::Wall)
+		if (voxel.dataType == VoxelDataType::Wall)
 		{
 			// Draw inner ceiling, wall, and floor.
-			const VoxelData::WallData &wallData = voxelData.wall;
-
 			const Double3 farCeilingPoint(
 				farPoint.x,
 				voxelYReal + voxelHeight,
@@ -3171,31 +6179,27 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				nearCeilingPoint, farCeilingPoint, farFloorPoint, nearFloorPoint, camera, frame);
 
 			// Ceiling.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), nearPoint, farPoint,
-				nearZ, farZ, -Double3::UnitY, textures.at(wallData.ceilingID), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRanges.at(0), voxelY + 1, voxel.ceilingID,
 				occlusion, frame);
 
 			// Wall.
 			SoftwareRenderer::drawPixels(x, drawRanges.at(1), farZ, wallU, 0.0,
-				Constants::JustBelowOne, wallNormal, textures.at(wallData.sideID), shadingInfo,
+				Constants::JustBelowOne, wallNormal, textures.at(voxel.textureID), shadingInfo,
 				occlusion, frame);
 
 			// Floor.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(2), farPoint, nearPoint,
-				farZ, nearZ, Double3::UnitY, textures.at(wallData.floorID), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRanges.at(2), voxelY, voxel.floorID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Floor)
+		else if (voxel.dataType == VoxelDataType::Floor)
 		{
 			// Do nothing. Floors can only be seen from above.
 		}
-		else if (voxelData.dataType == VoxelDataType::Ceiling)
+		else if (voxel.dataType == VoxelDataType::Ceiling)
 		{
 			// Draw bottom of ceiling voxel if the camera is below it.
 			if (camera.eye.y < voxelYReal)
 			{
-				const VoxelData::CeilingData &ceilingData = voxelData.ceiling;
-
 				const Double3 nearFloorPoint(
 					nearPoint.x,
 					voxelYReal,
@@ -3208,22 +6212,21 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					nearFloorPoint, farFloorPoint, camera, frame);
 
-				SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(ceilingData.id), shadingInfo,
+				SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY, voxel.textureID,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Raised)
+		else if (voxel.dataType == VoxelDataType::Raised)
 		{
-			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			const RenderVoxelShape &raisedShape = renderVoxelGrid.shapes[voxel.shapeIndex];
 
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
-				voxelYReal + ((raisedData.yOffset + raisedData.ySize) * voxelHeight),
+				voxelYReal + ((raisedShape.yOffset + raisedShape.ySize) * voxelHeight),
 				nearPoint.y);
 			const Double3 nearFloorPoint(
 				nearPoint.x,
-				voxelYReal + (raisedData.yOffset * voxelHeight),
+				voxelYReal + (raisedShape.yOffset * voxelHeight),
 				nearPoint.y);
 
 			// Draw order depends on the player's Y position relative to the platform.
@@ -3240,7 +6243,7 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRange, farPoint, nearPoint, farZ,
-					nearZ, Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					nearZ, Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 			}
 			else if (camera.eye.y < nearFloorPoint.y)
@@ -3256,7 +6259,7 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-					farZ, -Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					farZ, -Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 			else
@@ -3277,27 +6280,27 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					nearZ, farZ, -Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(1), farZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(2), farPoint, nearPoint,
-					farZ, nearZ, Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					farZ, nearZ, Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Diagonal)
+		else if (voxel.dataType == VoxelDataType::Diagonal)
 		{
-			const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+			const bool isType1 = (voxel.flags & RenderVoxel::FLAG_DIAGONAL_TYPE1) != 0;
 
 			// Find intersection.
 			RayHit hit;
-			const bool success = diagData.type1 ?
+			const bool success = isType1 ?
 				SoftwareRenderer::findDiag1Intersection(voxelX, voxelZ, nearPoint, farPoint, hit) :
 				SoftwareRenderer::findDiag2Intersection(voxelX, voxelZ, nearPoint, farPoint, hit);
 
@@ -3316,54 +6319,53 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 					diagTopPoint, diagBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawPixels(x, drawRange, nearZ + hit.innerZ, hit.u, 0.0,
-					Constants::JustBelowOne, hit.normal, textures.at(diagData.id), shadingInfo,
-					occlusion, frame);
+					Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::TransparentWall)
+		else if (voxel.dataType == VoxelDataType::TransparentWall)
 		{
 			// Do nothing. Transparent walls have no back-faces.
 		}
-		else if (voxelData.dataType == VoxelDataType::Edge)
+		else if (voxel.dataType == VoxelDataType::Edge)
 		{
-			const VoxelData::EdgeData &edgeData = voxelData.edge;
+			const RenderVoxelShape &edgeShape = renderVoxelGrid.shapes[voxel.shapeIndex];
+			const bool edgeFlipped = (voxel.flags & RenderVoxel::FLAG_EDGE_FLIPPED) != 0;
 
 			// Find intersection.
 			RayHit hit;
 			const bool success = SoftwareRenderer::findInitialEdgeIntersection(
-				voxelX, voxelZ, edgeData.facing, edgeData.flipped, nearPoint, farPoint,
+				voxelX, voxelZ, voxel.getEdgeFacing(), edgeFlipped, nearPoint, farPoint,
 				camera, ray, hit);
 
 			if (success)
 			{
 				const Double3 edgeTopPoint(
 					hit.point.x,
-					voxelYReal + voxelHeight + edgeData.yOffset,
+					voxelYReal + voxelHeight + edgeShape.yOffset,
 					hit.point.y);
 				const Double3 edgeBottomPoint(
 					edgeTopPoint.x,
-					voxelYReal + edgeData.yOffset,
+					voxelYReal + edgeShape.yOffset,
 					edgeTopPoint.z);
 
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					edgeTopPoint, edgeBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ, hit.u,
-					0.0, Constants::JustBelowOne, hit.normal, textures.at(edgeData.id),
+					0.0, Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Chasm)
+		else if (voxel.dataType == VoxelDataType::Chasm)
 		{
 			// Render back-face.
-			const VoxelData::ChasmData &chasmData = voxelData.chasm;
-
 			// Find which far face on the chasm was intersected.
 			const VoxelData::Facing farFacing = SoftwareRenderer::getInitialChasmFarFacing(
 				voxelX, voxelZ, Double2(camera.eye.x, camera.eye.z), ray);
 
 			// Far.
-			if (chasmData.faceIsVisible(farFacing))
+			if (voxel.chasmFaceIsVisible(farFacing))
 			{
 				const double farU = [&farPoint, farFacing]()
 				{
@@ -3393,8 +6395,9 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				const Double3 farNormal = -VoxelData::getNormal(farFacing);
 
 				// Wet chasms and lava chasms are unaffected by ceiling height.
-				const double chasmDepth = (chasmData.type == VoxelData::ChasmData::Type::Dry) ?
-					voxelHeight : VoxelData::ChasmData::WET_LAVA_DEPTH;
+				const bool isDryChasm = voxel.getChasmType() == VoxelData::ChasmData::Type::Dry;
+				const double chasmDepth = isDryChasm ? voxelHeight :
+					VoxelData::ChasmData::WET_LAVA_DEPTH;
 
 				const Double3 farCeilingPoint(
 					farPoint.x,
@@ -3409,23 +6412,22 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 					farCeilingPoint, farFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, farZ, farU, 0.0,
-					Constants::JustBelowOne, farNormal, textures.at(chasmData.id), shadingInfo,
+					Constants::JustBelowOne, farNormal, textures.at(voxel.textureID), shadingInfo,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Door)
+		else if (voxel.dataType == VoxelDataType::Door)
 		{
-			const VoxelData::DoorData &doorData = voxelData.door;
-			const double percentOpen = SoftwareRenderer::getDoorPercentOpen(
-				voxelX, voxelZ, openDoors);
+			const VoxelData::DoorData::Type doorType = voxel.getDoorType();
+			const double percentOpen = openDoors.getPercentOpen(voxelX, voxelZ);
 
 			RayHit hit;
 			const bool success = SoftwareRenderer::findInitialDoorIntersection(voxelX, voxelZ,
-				doorData.type, percentOpen, nearPoint, farPoint, camera, ray, voxelGrid, hit);
+				doorType, percentOpen, nearPoint, farPoint, camera, ray, voxelGrid, hit);
 
 			if (success)
 			{
-				if (doorData.type == VoxelData::DoorData::Type::Swinging)
+				if (doorType == VoxelData::DoorData::Type::Swinging)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -3440,10 +6442,10 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Sliding)
+				else if (doorType == VoxelData::DoorData::Type::Sliding)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -3458,10 +6460,10 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Raising)
+				else if (doorType == VoxelData::DoorData::Type::Raising)
 				{
 					// Top point is fixed, bottom point depends on percent open.
 					const double minVisible = SoftwareRenderer::DOOR_MIN_VISIBLE;
@@ -3484,9 +6486,9 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
 						hit.u, vStart, Constants::JustBelowOne, hit.normal,
-						textures.at(doorData.id), shadingInfo, occlusion, frame);
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Splitting)
+				else if (doorType == VoxelData::DoorData::Type::Splitting)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -3501,8 +6503,8 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
 			}
 		}
@@ -3510,17 +6512,14 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 	auto drawInitialVoxelBelow = [x, voxelX, voxelZ, &camera, &ray, &wallNormal, &nearPoint,
 		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors, &voxelGrid,
-		&textures, &occlusion, &frame](int voxelY)
+		voxelColumn, &renderVoxelGrid, &textures, &occlusion, &frame](int voxelY)
 	{
-		const uint16_t voxelID = voxelGrid.getVoxel(voxelX, voxelY, voxelZ);
-		const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+		const RenderVoxel &voxel = voxelColumn[voxelY];
 		const double voxelHeight = ceilingHeight;
 		const double voxelYReal = static_cast<double>(voxelY) * voxelHeight;
 
-		if (voxelData.dataType == VoxelDataType::Wall)
+		if (voxel.dataType == VoxelDataType::Wall)
 		{
-			const VoxelData::WallData &wallData = voxelData.wall;
-
 			const Double3 farCeilingPoint(
 				farPoint.x,
 				voxelYReal + voxelHeight,
@@ -3534,15 +6533,12 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				farCeilingPoint, nearCeilingPoint, camera, frame);
 
 			// Ceiling.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRange, farPoint, nearPoint, farZ,
-				nearZ, Double3::UnitY, textures.at(wallData.ceilingID), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY + 1, voxel.ceilingID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Floor)
+		else if (voxel.dataType == VoxelDataType::Floor)
 		{
 			// Draw top of floor voxel.
-			const VoxelData::FloorData &floorData = voxelData.floor;
-
 			const Double3 farCeilingPoint(
 				farPoint.x,
 				voxelYReal + voxelHeight,
@@ -3556,25 +6552,24 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				farCeilingPoint, nearCeilingPoint, camera, frame);
 
 			// Ceiling.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRange, farPoint, nearPoint, farZ,
-				nearZ, Double3::UnitY, textures.at(floorData.id), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY + 1, voxel.textureID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Ceiling)
+		else if (voxel.dataType == VoxelDataType::Ceiling)
 		{
 			// Do nothing. Ceilings can only be seen from below.
 		}
-		else if (voxelData.dataType == VoxelDataType::Raised)
+		else if (voxel.dataType == VoxelDataType::Raised)
 		{
-			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			const RenderVoxelShape &raisedShape = renderVoxelGrid.shapes[voxel.shapeIndex];
 
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
-				voxelYReal + ((raisedData.yOffset + raisedData.ySize) * voxelHeight),
+				voxelYReal + ((raisedShape.yOffset + raisedShape.ySize) * voxelHeight),
 				nearPoint.y);
 			const Double3 nearFloorPoint(
 				nearPoint.x,
-				voxelYReal + (raisedData.yOffset * voxelHeight),
+				voxelYReal + (raisedShape.yOffset * voxelHeight),
 				nearPoint.y);
 
 			// Draw order depends on the player's Y position relative to the platform.
@@ -3591,7 +6586,7 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRange, farPoint, nearPoint, farZ,
-					nearZ, Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					nearZ, Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 			}
 			else if (camera.eye.y < nearFloorPoint.y)
@@ -3607,7 +6602,7 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-					farZ, -Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					farZ, -Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 			else
@@ -3628,27 +6623,27 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					nearZ, farZ, -Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(1), farZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(2), farPoint, nearPoint,
-					farZ, nearZ, Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					farZ, nearZ, Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Diagonal)
+		else if (voxel.dataType == VoxelDataType::Diagonal)
 		{
-			const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+			const bool isType1 = (voxel.flags & RenderVoxel::FLAG_DIAGONAL_TYPE1) != 0;
 
 			// Find intersection.
 			RayHit hit;
-			const bool success = diagData.type1 ?
+			const bool success = isType1 ?
 				SoftwareRenderer::findDiag1Intersection(voxelX, voxelZ, nearPoint, farPoint, hit) :
 				SoftwareRenderer::findDiag2Intersection(voxelX, voxelZ, nearPoint, farPoint, hit);
 
@@ -3667,54 +6662,53 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 					diagTopPoint, diagBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawPixels(x, drawRange, nearZ + hit.innerZ, hit.u, 0.0,
-					Constants::JustBelowOne, hit.normal, textures.at(diagData.id), shadingInfo,
-					occlusion, frame);
+					Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::TransparentWall)
+		else if (voxel.dataType == VoxelDataType::TransparentWall)
 		{
 			// Do nothing. Transparent walls have no back-faces.
 		}
-		else if (voxelData.dataType == VoxelDataType::Edge)
+		else if (voxel.dataType == VoxelDataType::Edge)
 		{
-			const VoxelData::EdgeData &edgeData = voxelData.edge;
+			const RenderVoxelShape &edgeShape = renderVoxelGrid.shapes[voxel.shapeIndex];
+			const bool edgeFlipped = (voxel.flags & RenderVoxel::FLAG_EDGE_FLIPPED) != 0;
 
 			// Find intersection.
 			RayHit hit;
 			const bool success = SoftwareRenderer::findInitialEdgeIntersection(
-				voxelX, voxelZ, edgeData.facing, edgeData.flipped, nearPoint, farPoint,
+				voxelX, voxelZ, voxel.getEdgeFacing(), edgeFlipped, nearPoint, farPoint,
 				camera, ray, hit);
 
 			if (success)
 			{
 				const Double3 edgeTopPoint(
 					hit.point.x,
-					voxelYReal + voxelHeight + edgeData.yOffset,
+					voxelYReal + voxelHeight + edgeShape.yOffset,
 					hit.point.y);
 				const Double3 edgeBottomPoint(
 					hit.point.x,
-					voxelYReal + edgeData.yOffset,
+					voxelYReal + edgeShape.yOffset,
 					hit.point.y);
 
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					edgeTopPoint, edgeBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ, hit.u,
-					0.0, Constants::JustBelowOne, hit.normal, textures.at(edgeData.id),
+					0.0, Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Chasm)
+		else if (voxel.dataType == VoxelDataType::Chasm)
 		{
 			// Render back-face.
-			const VoxelData::ChasmData &chasmData = voxelData.chasm;
-
 			// Find which far face on the chasm was intersected.
 			const VoxelData::Facing farFacing = SoftwareRenderer::getInitialChasmFarFacing(
 				voxelX, voxelZ, Double2(camera.eye.x, camera.eye.z), ray);
 
 			// Far.
-			if (chasmData.faceIsVisible(farFacing))
+			if (voxel.chasmFaceIsVisible(farFacing))
 			{
 				const double farU = [&farPoint, farFacing]()
 				{
@@ -3744,8 +6738,9 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				const Double3 farNormal = -VoxelData::getNormal(farFacing);
 
 				// Wet chasms and lava chasms are unaffected by ceiling height.
-				const double chasmDepth = (chasmData.type == VoxelData::ChasmData::Type::Dry) ?
-					voxelHeight : VoxelData::ChasmData::WET_LAVA_DEPTH;
+				const bool isDryChasm = voxel.getChasmType() == VoxelData::ChasmData::Type::Dry;
+				const double chasmDepth = isDryChasm ? voxelHeight :
+					VoxelData::ChasmData::WET_LAVA_DEPTH;
 
 				const Double3 farCeilingPoint(
 					farPoint.x,
@@ -3760,23 +6755,22 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 					farCeilingPoint, farFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, farZ, farU, 0.0,
-					Constants::JustBelowOne, farNormal, textures.at(chasmData.id), shadingInfo,
+					Constants::JustBelowOne, farNormal, textures.at(voxel.textureID), shadingInfo,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Door)
+		else if (voxel.dataType == VoxelDataType::Door)
 		{
-			const VoxelData::DoorData &doorData = voxelData.door;
-			const double percentOpen = SoftwareRenderer::getDoorPercentOpen(
-				voxelX, voxelZ, openDoors);
+			const VoxelData::DoorData::Type doorType = voxel.getDoorType();
+			const double percentOpen = openDoors.getPercentOpen(voxelX, voxelZ);
 
 			RayHit hit;
 			const bool success = SoftwareRenderer::findInitialDoorIntersection(voxelX, voxelZ,
-				doorData.type, percentOpen, nearPoint, farPoint, camera, ray, voxelGrid, hit);
+				doorType, percentOpen, nearPoint, farPoint, camera, ray, voxelGrid, hit);
 
 			if (success)
 			{
-				if (doorData.type == VoxelData::DoorData::Type::Swinging)
+				if (doorType == VoxelData::DoorData::Type::Swinging)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -3791,10 +6785,10 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Sliding)
+				else if (doorType == VoxelData::DoorData::Type::Sliding)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -3809,10 +6803,10 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Raising)
+				else if (doorType == VoxelData::DoorData::Type::Raising)
 				{
 					// Top point is fixed, bottom point depends on percent open.
 					const double minVisible = SoftwareRenderer::DOOR_MIN_VISIBLE;
@@ -3835,9 +6829,9 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
 						hit.u, vStart, Constants::JustBelowOne, hit.normal,
-						textures.at(doorData.id), shadingInfo, occlusion, frame);
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Splitting)
+				else if (doorType == VoxelData::DoorData::Type::Splitting)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -3852,8 +6846,8 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
 			}
 		}
@@ -3861,17 +6855,14 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 	auto drawInitialVoxelAbove = [x, voxelX, voxelZ, &camera, &ray, &wallNormal, &nearPoint,
 		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors, &voxelGrid,
-		&textures, &occlusion, &frame](int voxelY)
+		voxelColumn, &renderVoxelGrid, &textures, &occlusion, &frame](int voxelY)
 	{
-		const uint16_t voxelID = voxelGrid.getVoxel(voxelX, voxelY, voxelZ);
-		const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+		const RenderVoxel &voxel = voxelColumn[voxelY];
 		const double voxelHeight = ceilingHeight;
 		const double voxelYReal = static_cast<double>(voxelY) * voxelHeight;
 
-		if (voxelData.dataType == VoxelDataType::Wall)
+		if (voxel.dataType == VoxelDataType::Wall)
 		{
-			const VoxelData::WallData &wallData = voxelData.wall;
-
 			const Double3 nearFloorPoint(
 				nearPoint.x,
 				voxelYReal,
@@ -3885,19 +6876,16 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 				nearFloorPoint, farFloorPoint, camera, frame);
 
 			// Floor.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-				farZ, -Double3::UnitY, textures.at(wallData.floorID), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY, voxel.floorID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Floor)
+		else if (voxel.dataType == VoxelDataType::Floor)
 		{
 			// Do nothing. Floors can only be seen from above.
 		}
-		else if (voxelData.dataType == VoxelDataType::Ceiling)
+		else if (voxel.dataType == VoxelDataType::Ceiling)
 		{
 			// Draw bottom of ceiling voxel.
-			const VoxelData::CeilingData &ceilingData = voxelData.ceiling;
-
 			const Double3 nearFloorPoint(
 				nearPoint.x,
 				voxelYReal,
@@ -3910,21 +6898,20 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 			const auto drawRange = SoftwareRenderer::makeDrawRange(
 				nearFloorPoint, farFloorPoint, camera, frame);
 
-			SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-				farZ, -Double3::UnitY, textures.at(ceilingData.id), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY, voxel.textureID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Raised)
+		else if (voxel.dataType == VoxelDataType::Raised)
 		{
-			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			const RenderVoxelShape &raisedShape = renderVoxelGrid.shapes[voxel.shapeIndex];
 
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
-				voxelYReal + ((raisedData.yOffset + raisedData.ySize) * voxelHeight),
+				voxelYReal + ((raisedShape.yOffset + raisedShape.ySize) * voxelHeight),
 				nearPoint.y);
 			const Double3 nearFloorPoint(
 				nearPoint.x,
-				voxelYReal + (raisedData.yOffset * voxelHeight),
+				voxelYReal + (raisedShape.yOffset * voxelHeight),
 				nearPoint.y);
 
 			// Draw order depends on the player's Y position relative to the platform.
@@ -3941,7 +6928,7 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRange, farPoint, nearPoint, farZ,
-					nearZ, Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					nearZ, Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 			}
 			else if (camera.eye.y < nearFloorPoint.y)
@@ -3957,7 +6944,7 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-					farZ, -Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					farZ, -Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 			else
@@ -3978,27 +6965,27 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					nearZ, farZ, -Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(1), farZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(2), farPoint, nearPoint,
-					farZ, nearZ, Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					farZ, nearZ, Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Diagonal)
+		else if (voxel.dataType == VoxelDataType::Diagonal)
 		{
-			const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+			const bool isType1 = (voxel.flags & RenderVoxel::FLAG_DIAGONAL_TYPE1) != 0;
 
 			// Find intersection.
 			RayHit hit;
-			const bool success = diagData.type1 ?
+			const bool success = isType1 ?
 				SoftwareRenderer::findDiag1Intersection(voxelX, voxelZ, nearPoint, farPoint, hit) :
 				SoftwareRenderer::findDiag2Intersection(voxelX, voxelZ, nearPoint, farPoint, hit);
 
@@ -4017,60 +7004,60 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 					diagTopPoint, diagBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawPixels(x, drawRange, nearZ + hit.innerZ, hit.u, 0.0,
-					Constants::JustBelowOne, hit.normal, textures.at(diagData.id), shadingInfo,
-					occlusion, frame);
+					Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::TransparentWall)
+		else if (voxel.dataType == VoxelDataType::TransparentWall)
 		{
 			// Do nothing. Transparent walls have no back-faces.
 		}
-		else if (voxelData.dataType == VoxelDataType::Edge)
+		else if (voxel.dataType == VoxelDataType::Edge)
 		{
-			const VoxelData::EdgeData &edgeData = voxelData.edge;
+			const RenderVoxelShape &edgeShape = renderVoxelGrid.shapes[voxel.shapeIndex];
+			const bool edgeFlipped = (voxel.flags & RenderVoxel::FLAG_EDGE_FLIPPED) != 0;
 
 			// Find intersection.
 			RayHit hit;
 			const bool success = SoftwareRenderer::findInitialEdgeIntersection(
-				voxelX, voxelZ, edgeData.facing, edgeData.flipped, nearPoint, farPoint,
+				voxelX, voxelZ, voxel.getEdgeFacing(), edgeFlipped, nearPoint, farPoint,
 				camera, ray, hit);
 
 			if (success)
 			{
 				const Double3 edgeTopPoint(
 					hit.point.x,
-					voxelYReal + voxelHeight + edgeData.yOffset,
+					voxelYReal + voxelHeight + edgeShape.yOffset,
 					hit.point.y);
 				const Double3 edgeBottomPoint(
 					hit.point.x,
-					voxelYReal + edgeData.yOffset,
+					voxelYReal + edgeShape.yOffset,
 					hit.point.y);
 
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					edgeTopPoint, edgeBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ, hit.u,
-					0.0, Constants::JustBelowOne, hit.normal, textures.at(edgeData.id),
+					0.0, Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Chasm)
+		else if (voxel.dataType == VoxelDataType::Chasm)
 		{
 			// Ignore. Chasms should never be above the player's voxel.
 		}
-		else if (voxelData.dataType == VoxelDataType::Door)
+		else if (voxel.dataType == VoxelDataType::Door)
 		{
-			const VoxelData::DoorData &doorData = voxelData.door;
-			const double percentOpen = SoftwareRenderer::getDoorPercentOpen(
-				voxelX, voxelZ, openDoors);
+			const VoxelData::DoorData::Type doorType = voxel.getDoorType();
+			const double percentOpen = openDoors.getPercentOpen(voxelX, voxelZ);
 
 			RayHit hit;
 			const bool success = SoftwareRenderer::findInitialDoorIntersection(voxelX, voxelZ,
-				doorData.type, percentOpen, nearPoint, farPoint, camera, ray, voxelGrid, hit);
+				doorType, percentOpen, nearPoint, farPoint, camera, ray, voxelGrid, hit);
 
 			if (success)
 			{
-				if (doorData.type == VoxelData::DoorData::Type::Swinging)
+				if (doorType == VoxelData::DoorData::Type::Swinging)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4085,10 +7072,10 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Sliding)
+				else if (doorType == VoxelData::DoorData::Type::Sliding)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4103,10 +7090,10 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Raising)
+				else if (doorType == VoxelData::DoorData::Type::Raising)
 				{
 					// Top point is fixed, bottom point depends on percent open.
 					const double minVisible = SoftwareRenderer::DOOR_MIN_VISIBLE;
@@ -4129,9 +7116,9 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
 						hit.u, vStart, Constants::JustBelowOne, hit.normal,
-						textures.at(doorData.id), shadingInfo, occlusion, frame);
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Splitting)
+				else if (doorType == VoxelData::DoorData::Type::Splitting)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4146,8 +7133,8 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
 			}
 		}
@@ -4175,8 +7162,9 @@ void SoftwareRenderer::drawInitialVoxelColumn(int x, int voxelX, int voxelZ, con
 void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Camera &camera,
 	const Ray &ray, VoxelData::Facing facing, const Double2 &nearPoint, const Double2 &farPoint,
 	double nearZ, double farZ, const ShadingInfo &shadingInfo, double ceilingHeight,
-	const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
-	const std::vector<VoxelTexture> &textures, OcclusionData &occlusion, const FrameView &frame)
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+	const RenderVoxelGrid &renderVoxelGrid, const std::vector<VoxelTexture> &textures,
+	OcclusionData &occlusion, const FrameView &frame)
 {
 	// Much of the code here is duplicated from the initial voxel column drawing method, but
 	// there are a couple differences, like the horizontal texture coordinate being flipped,
@@ -4222,20 +7210,20 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 	// this voxel column.
 	const Double3 wallNormal = VoxelData::getNormal(facing);
 
+	// Voxels in this column from bottom to top.
+	const RenderVoxel *voxelColumn = renderVoxelGrid.getColumn(voxelX, voxelZ);
+
 	auto drawVoxel = [x, voxelX, voxelZ, &camera, &ray, facing, &wallNormal, &nearPoint,
-		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors, &voxelGrid,
-		&textures, &occlusion, &frame](int voxelY)
+		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors,
+		voxelColumn, &renderVoxelGrid, &textures, &occlusion, &frame](int voxelY)
 	{
-		const uint16_t voxelID = voxelGrid.getVoxel(voxelX, voxelY, voxelZ);
-		const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+		const RenderVoxel &voxel = voxelColumn[voxelY];
 		const double voxelHeight = ceilingHeight;
 		const double voxelYReal = static_cast<double>(voxelY) * voxelHeight;
 
-		if (voxelData.dataType == VoxelDataType::Wall)
+		if (voxel.dataType == VoxelDataType::Wall)
 		{
 			// Draw side.
-			const VoxelData::WallData &wallData = voxelData.wall;
-
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
 				voxelYReal + voxelHeight,
@@ -4249,19 +7237,17 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				nearCeilingPoint, nearFloorPoint, camera, frame);
 
 			SoftwareRenderer::drawPixels(x, drawRange, nearZ, wallU, 0.0, Constants::JustBelowOne,
-				wallNormal, textures.at(wallData.sideID), shadingInfo, occlusion, frame);
+				wallNormal, textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Floor)
+		else if (voxel.dataType == VoxelDataType::Floor)
 		{
 			// Do nothing. Floors can only be seen from above.
 		}
-		else if (voxelData.dataType == VoxelDataType::Ceiling)
+		else if (voxel.dataType == VoxelDataType::Ceiling)
 		{
 			// Draw bottom of ceiling voxel if the camera is below it.
 			if (camera.eye.y < voxelYReal)
 			{
-				const VoxelData::CeilingData &ceilingData = voxelData.ceiling;
-
 				const Double3 nearFloorPoint(
 					nearPoint.x,
 					voxelYReal,
@@ -4274,22 +7260,21 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					nearFloorPoint, farFloorPoint, camera, frame);
 
-				SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-					farZ, -Double3::UnitY, textures.at(ceilingData.id), shadingInfo,
+				SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY, voxel.textureID,
 					occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Raised)
+		else if (voxel.dataType == VoxelDataType::Raised)
 		{
-			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			const RenderVoxelShape &raisedShape = renderVoxelGrid.shapes[voxel.shapeIndex];
 
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
-				voxelYReal + ((raisedData.yOffset + raisedData.ySize) * voxelHeight),
+				voxelYReal + ((raisedShape.yOffset + raisedShape.ySize) * voxelHeight),
 				nearPoint.y);
 			const Double3 nearFloorPoint(
 				nearPoint.x,
-				voxelYReal + (raisedData.yOffset * voxelHeight),
+				voxelYReal + (raisedShape.yOffset * voxelHeight),
 				nearPoint.y);
 
 			// Draw order depends on the player's Y position relative to the platform.
@@ -4306,13 +7291,13 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), farPoint, nearPoint,
-					farZ, nearZ, Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					farZ, nearZ, Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(1), nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 			}
 			else if (camera.eye.y < nearFloorPoint.y)
 			{
@@ -4327,12 +7312,12 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(0), nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(1), nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					nearZ, farZ, -Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 			else
@@ -4342,17 +7327,17 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					nearCeilingPoint, nearFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Diagonal)
+		else if (voxel.dataType == VoxelDataType::Diagonal)
 		{
-			const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+			const bool isType1 = (voxel.flags & RenderVoxel::FLAG_DIAGONAL_TYPE1) != 0;
 
 			// Find intersection.
 			RayHit hit;
-			const bool success = diagData.type1 ?
+			const bool success = isType1 ?
 				SoftwareRenderer::findDiag1Intersection(voxelX, voxelZ, nearPoint, farPoint, hit) :
 				SoftwareRenderer::findDiag2Intersection(voxelX, voxelZ, nearPoint, farPoint, hit);
 
@@ -4371,15 +7356,13 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					diagTopPoint, diagBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawPixels(x, drawRange, nearZ + hit.innerZ, hit.u, 0.0,
-					Constants::JustBelowOne, hit.normal, textures.at(diagData.id), shadingInfo,
-					occlusion, frame);
+					Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::TransparentWall)
+		else if (voxel.dataType == VoxelDataType::TransparentWall)
 		{
 			// Draw transparent side.
-			const VoxelData::TransparentWallData &transparentWallData = voxelData.transparentWall;
-
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
 				voxelYReal + voxelHeight,
@@ -4393,57 +7376,57 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				nearCeilingPoint, nearFloorPoint, camera, frame);
 
 			SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, wallU, 0.0,
-				Constants::JustBelowOne, wallNormal, textures.at(transparentWallData.id),
+				Constants::JustBelowOne, wallNormal, textures.at(voxel.textureID),
 				shadingInfo, occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Edge)
+		else if (voxel.dataType == VoxelDataType::Edge)
 		{
-			const VoxelData::EdgeData &edgeData = voxelData.edge;
+			const RenderVoxelShape &edgeShape = renderVoxelGrid.shapes[voxel.shapeIndex];
+			const bool edgeFlipped = (voxel.flags & RenderVoxel::FLAG_EDGE_FLIPPED) != 0;
 
 			// Find intersection.
 			RayHit hit;
 			const bool success = SoftwareRenderer::findEdgeIntersection(voxelX, voxelZ,
-				edgeData.facing, edgeData.flipped, facing, nearPoint, farPoint, wallU,
+				voxel.getEdgeFacing(), edgeFlipped, facing, nearPoint, farPoint, wallU,
 				camera, ray, hit);
 
 			if (success)
 			{
 				const Double3 edgeTopPoint(
 					hit.point.x,
-					voxelYReal + voxelHeight + edgeData.yOffset,
+					voxelYReal + voxelHeight + edgeShape.yOffset,
 					hit.point.y);
 				const Double3 edgeBottomPoint(
 					hit.point.x,
-					voxelYReal + edgeData.yOffset,
+					voxelYReal + edgeShape.yOffset,
 					hit.point.y);
 
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					edgeTopPoint, edgeBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ, hit.u,
-					0.0, Constants::JustBelowOne, hit.normal, textures.at(edgeData.id),
+					0.0, Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Chasm)
+		else if (voxel.dataType == VoxelDataType::Chasm)
 		{
 			// Render front and back-faces.
-			const VoxelData::ChasmData &chasmData = voxelData.chasm;
-
 			// Find which faces on the chasm were intersected.
 			const VoxelData::Facing nearFacing = facing;
 			const VoxelData::Facing farFacing = SoftwareRenderer::getChasmFarFacing(
 				voxelX, voxelZ, nearFacing, camera, ray);
 
 			// Near.
-			if (chasmData.faceIsVisible(nearFacing))
+			if (voxel.chasmFaceIsVisible(nearFacing))
 			{
 				const double nearU = Constants::JustBelowOne - wallU;
 				const Double3 nearNormal = wallNormal;
 				
 				// Wet chasms and lava chasms are unaffected by ceiling height.
-				const double chasmDepth = (chasmData.type == VoxelData::ChasmData::Type::Dry) ?
-					voxelHeight : VoxelData::ChasmData::WET_LAVA_DEPTH;
+				const bool isDryChasm = voxel.getChasmType() == VoxelData::ChasmData::Type::Dry;
+				const double chasmDepth = isDryChasm ? voxelHeight :
+					VoxelData::ChasmData::WET_LAVA_DEPTH;
 
 				const Double3 nearCeilingPoint(
 					nearPoint.x,
@@ -4458,12 +7441,12 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					nearCeilingPoint, nearFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, nearU, 0.0,
-					Constants::JustBelowOne, nearNormal, textures.at(chasmData.id),
+					Constants::JustBelowOne, nearNormal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 
 			// Far.
-			if (chasmData.faceIsVisible(farFacing))
+			if (voxel.chasmFaceIsVisible(farFacing))
 			{
 				const double farU = [&farPoint, farFacing]()
 				{
@@ -4493,8 +7476,9 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				const Double3 farNormal = -VoxelData::getNormal(farFacing);
 
 				// Wet chasms and lava chasms are unaffected by ceiling height.
-				const double chasmDepth = (chasmData.type == VoxelData::ChasmData::Type::Dry) ?
-					voxelHeight : VoxelData::ChasmData::WET_LAVA_DEPTH;
+				const bool isDryChasm = voxel.getChasmType() == VoxelData::ChasmData::Type::Dry;
+				const double chasmDepth = isDryChasm ? voxelHeight :
+					VoxelData::ChasmData::WET_LAVA_DEPTH;
 
 				const Double3 farCeilingPoint(
 					farPoint.x,
@@ -4509,23 +7493,22 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					farCeilingPoint, farFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, farZ, farU, 0.0,
-					Constants::JustBelowOne, farNormal, textures.at(chasmData.id),
+					Constants::JustBelowOne, farNormal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Door)
+		else if (voxel.dataType == VoxelDataType::Door)
 		{
-			const VoxelData::DoorData &doorData = voxelData.door;
-			const double percentOpen = SoftwareRenderer::getDoorPercentOpen(
-				voxelX, voxelZ, openDoors);
+			const VoxelData::DoorData::Type doorType = voxel.getDoorType();
+			const double percentOpen = openDoors.getPercentOpen(voxelX, voxelZ);
 
 			RayHit hit;
 			const bool success = SoftwareRenderer::findDoorIntersection(voxelX, voxelZ,
-				doorData.type, percentOpen, facing, nearPoint, farPoint, wallU, hit);
+				doorType, percentOpen, facing, nearPoint, farPoint, wallU, hit);
 
 			if (success)
 			{
-				if (doorData.type == VoxelData::DoorData::Type::Swinging)
+				if (doorType == VoxelData::DoorData::Type::Swinging)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4540,10 +7523,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Sliding)
+				else if (doorType == VoxelData::DoorData::Type::Sliding)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4558,10 +7541,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, 0.0,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 						shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Raising)
+				else if (doorType == VoxelData::DoorData::Type::Raising)
 				{
 					// Top point is fixed, bottom point depends on percent open.
 					const double minVisible = SoftwareRenderer::DOOR_MIN_VISIBLE;
@@ -4583,10 +7566,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					const double vStart = raisedAmount / voxelHeight;
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, vStart,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id), shadingInfo,
-						occlusion, frame);
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+						shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Splitting)
+				else if (doorType == VoxelData::DoorData::Type::Splitting)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4601,7 +7584,7 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, 0.0,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 						shadingInfo, occlusion, frame);
 				}
 			}
@@ -4609,18 +7592,15 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 	};
 
 	auto drawVoxelBelow = [x, voxelX, voxelZ, &camera, &ray, facing, &wallNormal, &nearPoint,
-		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors, &voxelGrid,
-		&textures, &occlusion, &frame](int voxelY)
+		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors,
+		voxelColumn, &renderVoxelGrid, &textures, &occlusion, &frame](int voxelY)
 	{
-		const uint16_t voxelID = voxelGrid.getVoxel(voxelX, voxelY, voxelZ);
-		const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+		const RenderVoxel &voxel = voxelColumn[voxelY];
 		const double voxelHeight = ceilingHeight;
 		const double voxelYReal = static_cast<double>(voxelY) * voxelHeight;
 
-		if (voxelData.dataType == VoxelDataType::Wall)
+		if (voxel.dataType == VoxelDataType::Wall)
 		{
-			const VoxelData::WallData &wallData = voxelData.wall;
-
 			const Double3 farCeilingPoint(
 				farPoint.x,
 				voxelYReal + voxelHeight,
@@ -4638,20 +7618,17 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				farCeilingPoint, nearCeilingPoint, nearFloorPoint, camera, frame);
 
 			// Ceiling.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), farPoint, nearPoint, farZ,
-				nearZ, Double3::UnitY, textures.at(wallData.ceilingID), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRanges.at(0), voxelY + 1, voxel.ceilingID,
 				occlusion, frame);
 
 			// Wall.
 			SoftwareRenderer::drawPixels(x, drawRanges.at(1), nearZ, wallU, 0.0,
-				Constants::JustBelowOne, wallNormal, textures.at(wallData.sideID), shadingInfo,
+				Constants::JustBelowOne, wallNormal, textures.at(voxel.textureID), shadingInfo,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Floor)
+		else if (voxel.dataType == VoxelDataType::Floor)
 		{
 			// Draw top of floor voxel.
-			const VoxelData::FloorData &floorData = voxelData.floor;
-
 			const Double3 farCeilingPoint(
 				farPoint.x,
 				voxelYReal + voxelHeight,
@@ -4664,25 +7641,24 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 			const auto drawRange = SoftwareRenderer::makeDrawRange(
 				farCeilingPoint, nearCeilingPoint, camera, frame);
 
-			SoftwareRenderer::drawPerspectivePixels(x, drawRange, farPoint, nearPoint, farZ,
-				nearZ, Double3::UnitY, textures.at(floorData.id), shadingInfo, 
+			SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY + 1, voxel.textureID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Ceiling)
+		else if (voxel.dataType == VoxelDataType::Ceiling)
 		{
 			// Do nothing. Ceilings can only be seen from below.
 		}
-		else if (voxelData.dataType == VoxelDataType::Raised)
+		else if (voxel.dataType == VoxelDataType::Raised)
 		{
-			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			const RenderVoxelShape &raisedShape = renderVoxelGrid.shapes[voxel.shapeIndex];
 
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
-				voxelYReal + ((raisedData.yOffset + raisedData.ySize) * voxelHeight),
+				voxelYReal + ((raisedShape.yOffset + raisedShape.ySize) * voxelHeight),
 				nearPoint.y);
 			const Double3 nearFloorPoint(
 				nearPoint.x,
-				voxelYReal + (raisedData.yOffset * voxelHeight),
+				voxelYReal + (raisedShape.yOffset * voxelHeight),
 				nearPoint.y);
 
 			// Draw order depends on the player's Y position relative to the platform.
@@ -4699,13 +7675,13 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), farPoint, nearPoint,
-					farZ, nearZ, Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					farZ, nearZ, Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(1), nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 			}
 			else if (camera.eye.y < nearFloorPoint.y)
 			{
@@ -4720,12 +7696,12 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(0), nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(1), nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					nearZ, farZ, -Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 			else
@@ -4735,17 +7711,17 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					nearCeilingPoint, nearFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Diagonal)
+		else if (voxel.dataType == VoxelDataType::Diagonal)
 		{
-			const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+			const bool isType1 = (voxel.flags & RenderVoxel::FLAG_DIAGONAL_TYPE1) != 0;
 
 			// Find intersection.
 			RayHit hit;
-			const bool success = diagData.type1 ?
+			const bool success = isType1 ?
 				SoftwareRenderer::findDiag1Intersection(voxelX, voxelZ, nearPoint, farPoint, hit) :
 				SoftwareRenderer::findDiag2Intersection(voxelX, voxelZ, nearPoint, farPoint, hit);
 
@@ -4764,15 +7740,13 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					diagTopPoint, diagBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawPixels(x, drawRange, nearZ + hit.innerZ, hit.u, 0.0,
-					Constants::JustBelowOne, hit.normal, textures.at(diagData.id), shadingInfo,
-					occlusion, frame);
+					Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::TransparentWall)
+		else if (voxel.dataType == VoxelDataType::TransparentWall)
 		{
 			// Draw transparent side.
-			const VoxelData::TransparentWallData &transparentWallData = voxelData.transparentWall;
-
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
 				voxelYReal + voxelHeight,
@@ -4786,57 +7760,57 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				nearCeilingPoint, nearFloorPoint, camera, frame);
 
 			SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, wallU, 0.0,
-				Constants::JustBelowOne, wallNormal, textures.at(transparentWallData.id),
+				Constants::JustBelowOne, wallNormal, textures.at(voxel.textureID),
 				shadingInfo, occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Edge)
+		else if (voxel.dataType == VoxelDataType::Edge)
 		{
-			const VoxelData::EdgeData &edgeData = voxelData.edge;
+			const RenderVoxelShape &edgeShape = renderVoxelGrid.shapes[voxel.shapeIndex];
+			const bool edgeFlipped = (voxel.flags & RenderVoxel::FLAG_EDGE_FLIPPED) != 0;
 
 			// Find intersection.
 			RayHit hit;
 			const bool success = SoftwareRenderer::findEdgeIntersection(voxelX, voxelZ,
-				edgeData.facing, edgeData.flipped, facing, nearPoint, farPoint, wallU,
+				voxel.getEdgeFacing(), edgeFlipped, facing, nearPoint, farPoint, wallU,
 				camera, ray, hit);
 
 			if (success)
 			{
 				const Double3 edgeTopPoint(
 					hit.point.x,
-					voxelYReal + voxelHeight + edgeData.yOffset,
+					voxelYReal + voxelHeight + edgeShape.yOffset,
 					hit.point.y);
 				const Double3 edgeBottomPoint(
 					hit.point.x,
-					voxelYReal + edgeData.yOffset,
+					voxelYReal + edgeShape.yOffset,
 					hit.point.y);
 
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					edgeTopPoint, edgeBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ, hit.u,
-					0.0, Constants::JustBelowOne, hit.normal, textures.at(edgeData.id),
+					0.0, Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Chasm)
+		else if (voxel.dataType == VoxelDataType::Chasm)
 		{
 			// Render front and back-faces.
-			const VoxelData::ChasmData &chasmData = voxelData.chasm;
-
 			// Find which faces on the chasm were intersected.
 			const VoxelData::Facing nearFacing = facing;
 			const VoxelData::Facing farFacing = SoftwareRenderer::getChasmFarFacing(
 				voxelX, voxelZ, nearFacing, camera, ray);
 
 			// Near.
-			if (chasmData.faceIsVisible(nearFacing))
+			if (voxel.chasmFaceIsVisible(nearFacing))
 			{
 				const double nearU = Constants::JustBelowOne - wallU;
 				const Double3 nearNormal = wallNormal;
 
 				// Wet chasms and lava chasms are unaffected by ceiling height.
-				const double chasmDepth = (chasmData.type == VoxelData::ChasmData::Type::Dry) ?
-					voxelHeight : VoxelData::ChasmData::WET_LAVA_DEPTH;
+				const bool isDryChasm = voxel.getChasmType() == VoxelData::ChasmData::Type::Dry;
+				const double chasmDepth = isDryChasm ? voxelHeight :
+					VoxelData::ChasmData::WET_LAVA_DEPTH;
 
 				const Double3 nearCeilingPoint(
 					nearPoint.x,
@@ -4851,12 +7825,12 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					nearCeilingPoint, nearFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, nearU, 0.0,
-					Constants::JustBelowOne, nearNormal, textures.at(chasmData.id),
+					Constants::JustBelowOne, nearNormal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 
 			// Far.
-			if (chasmData.faceIsVisible(farFacing))
+			if (voxel.chasmFaceIsVisible(farFacing))
 			{
 				const double farU = [&farPoint, farFacing]()
 				{
@@ -4886,8 +7860,9 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				const Double3 farNormal = -VoxelData::getNormal(farFacing);
 
 				// Wet chasms and lava chasms are unaffected by ceiling height.
-				const double chasmDepth = (chasmData.type == VoxelData::ChasmData::Type::Dry) ?
-					voxelHeight : VoxelData::ChasmData::WET_LAVA_DEPTH;
+				const bool isDryChasm = voxel.getChasmType() == VoxelData::ChasmData::Type::Dry;
+				const double chasmDepth = isDryChasm ? voxelHeight :
+					VoxelData::ChasmData::WET_LAVA_DEPTH;
 
 				const Double3 farCeilingPoint(
 					farPoint.x,
@@ -4902,23 +7877,22 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					farCeilingPoint, farFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, farZ, farU, 0.0,
-					Constants::JustBelowOne, farNormal, textures.at(chasmData.id),
+					Constants::JustBelowOne, farNormal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Door)
+		else if (voxel.dataType == VoxelDataType::Door)
 		{
-			const VoxelData::DoorData &doorData = voxelData.door;
-			const double percentOpen = SoftwareRenderer::getDoorPercentOpen(
-				voxelX, voxelZ, openDoors);
+			const VoxelData::DoorData::Type doorType = voxel.getDoorType();
+			const double percentOpen = openDoors.getPercentOpen(voxelX, voxelZ);
 
 			RayHit hit;
 			const bool success = SoftwareRenderer::findDoorIntersection(voxelX, voxelZ,
-				doorData.type, percentOpen, facing, nearPoint, farPoint, wallU, hit);
+				doorType, percentOpen, facing, nearPoint, farPoint, wallU, hit);
 
 			if (success)
 			{
-				if (doorData.type == VoxelData::DoorData::Type::Swinging)
+				if (doorType == VoxelData::DoorData::Type::Swinging)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4933,10 +7907,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Sliding)
+				else if (doorType == VoxelData::DoorData::Type::Sliding)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4951,10 +7925,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, 0.0,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 						shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Raising)
+				else if (doorType == VoxelData::DoorData::Type::Raising)
 				{
 					// Top point is fixed, bottom point depends on percent open.
 					const double minVisible = SoftwareRenderer::DOOR_MIN_VISIBLE;
@@ -4976,10 +7950,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					const double vStart = raisedAmount / voxelHeight;
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, vStart,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id), shadingInfo,
-						occlusion, frame);
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+						shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Splitting)
+				else if (doorType == VoxelData::DoorData::Type::Splitting)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -4994,7 +7968,7 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, 0.0,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 						shadingInfo, occlusion, frame);
 				}
 			}
@@ -5002,18 +7976,15 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 	};
 
 	auto drawVoxelAbove = [x, voxelX, voxelZ, &camera, &ray, facing, &wallNormal, &nearPoint,
-		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors, &voxelGrid,
-		&textures, &occlusion, &frame](int voxelY)
+		&farPoint, nearZ, farZ, wallU, &shadingInfo, ceilingHeight, &openDoors,
+		voxelColumn, &renderVoxelGrid, &textures, &occlusion, &frame](int voxelY)
 	{
-		const uint16_t voxelID = voxelGrid.getVoxel(voxelX, voxelY, voxelZ);
-		const VoxelData &voxelData = voxelGrid.getVoxelData(voxelID);
+		const RenderVoxel &voxel = voxelColumn[voxelY];
 		const double voxelHeight = ceilingHeight;
 		const double voxelYReal = static_cast<double>(voxelY) * voxelHeight;
 
-		if (voxelData.dataType == VoxelDataType::Wall)
+		if (voxel.dataType == VoxelDataType::Wall)
 		{
-			const VoxelData::WallData &wallData = voxelData.wall;
-
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
 				voxelYReal + voxelHeight,
@@ -5032,23 +8003,20 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 			
 			// Wall.
 			SoftwareRenderer::drawPixels(x, drawRanges.at(0), nearZ, wallU, 0.0,
-				Constants::JustBelowOne, wallNormal, textures.at(wallData.sideID), shadingInfo,
+				Constants::JustBelowOne, wallNormal, textures.at(voxel.textureID), shadingInfo,
 				occlusion, frame);
 
 			// Floor.
-			SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(1), nearPoint, farPoint,
-				nearZ, farZ, -Double3::UnitY, textures.at(wallData.floorID), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRanges.at(1), voxelY, voxel.floorID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Floor)
+		else if (voxel.dataType == VoxelDataType::Floor)
 		{
 			// Do nothing. Floors can only be seen from above.
 		}
-		else if (voxelData.dataType == VoxelDataType::Ceiling)
+		else if (voxel.dataType == VoxelDataType::Ceiling)
 		{
 			// Draw bottom of ceiling voxel.
-			const VoxelData::CeilingData &ceilingData = voxelData.ceiling;
-
 			const Double3 nearFloorPoint(
 				nearPoint.x,
 				voxelYReal,
@@ -5061,21 +8029,20 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 			const auto drawRange = SoftwareRenderer::makeDrawRange(
 				nearFloorPoint, farFloorPoint, camera, frame);
 
-			SoftwareRenderer::drawPerspectivePixels(x, drawRange, nearPoint, farPoint, nearZ,
-				farZ, -Double3::UnitY, textures.at(ceilingData.id), shadingInfo,
+			SoftwareRenderer::drawPlanePixels(x, drawRange, voxelY, voxel.textureID,
 				occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Raised)
+		else if (voxel.dataType == VoxelDataType::Raised)
 		{
-			const VoxelData::RaisedData &raisedData = voxelData.raised;
+			const RenderVoxelShape &raisedShape = renderVoxelGrid.shapes[voxel.shapeIndex];
 
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
-				voxelYReal + ((raisedData.yOffset + raisedData.ySize) * voxelHeight),
+				voxelYReal + ((raisedShape.yOffset + raisedShape.ySize) * voxelHeight),
 				nearPoint.y);
 			const Double3 nearFloorPoint(
 				nearPoint.x,
-				voxelYReal + (raisedData.yOffset * voxelHeight),
+				voxelYReal + (raisedShape.yOffset * voxelHeight),
 				nearPoint.y);
 
 			// Draw order depends on the player's Y position relative to the platform.
@@ -5092,13 +8059,13 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 
 				// Ceiling.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(0), farPoint, nearPoint,
-					farZ, nearZ, Double3::UnitY, textures.at(raisedData.ceilingID), shadingInfo,
+					farZ, nearZ, Double3::UnitY, textures.at(voxel.ceilingID), shadingInfo,
 					occlusion, frame);
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(1), nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 			}
 			else if (camera.eye.y < nearFloorPoint.y)
 			{
@@ -5113,12 +8080,12 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 
 				// Wall.
 				SoftwareRenderer::drawTransparentPixels(x, drawRanges.at(0), nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 
 				// Floor.
 				SoftwareRenderer::drawPerspectivePixels(x, drawRanges.at(1), nearPoint, farPoint,
-					nearZ, farZ, -Double3::UnitY, textures.at(raisedData.floorID), shadingInfo,
+					nearZ, farZ, -Double3::UnitY, textures.at(voxel.floorID), shadingInfo,
 					occlusion, frame);
 			}
 			else
@@ -5128,17 +8095,17 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					nearCeilingPoint, nearFloorPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, wallU,
-					raisedData.vTop, raisedData.vBottom, wallNormal,
-					textures.at(raisedData.sideID), shadingInfo, occlusion, frame);
+					raisedShape.vTop, raisedShape.vBottom, wallNormal,
+					textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Diagonal)
+		else if (voxel.dataType == VoxelDataType::Diagonal)
 		{
-			const VoxelData::DiagonalData &diagData = voxelData.diagonal;
+			const bool isType1 = (voxel.flags & RenderVoxel::FLAG_DIAGONAL_TYPE1) != 0;
 
 			// Find intersection.
 			RayHit hit;
-			const bool success = diagData.type1 ?
+			const bool success = isType1 ?
 				SoftwareRenderer::findDiag1Intersection(voxelX, voxelZ, nearPoint, farPoint, hit) :
 				SoftwareRenderer::findDiag2Intersection(voxelX, voxelZ, nearPoint, farPoint, hit);
 
@@ -5157,15 +8124,13 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					diagTopPoint, diagBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawPixels(x, drawRange, nearZ + hit.innerZ, hit.u, 0.0,
-					Constants::JustBelowOne, hit.normal, textures.at(diagData.id), shadingInfo,
-					occlusion, frame);
+					Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::TransparentWall)
+		else if (voxel.dataType == VoxelDataType::TransparentWall)
 		{
 			// Draw transparent side.
-			const VoxelData::TransparentWallData &transparentWallData = voxelData.transparentWall;
-
 			const Double3 nearCeilingPoint(
 				nearPoint.x,
 				voxelYReal + voxelHeight,
@@ -5179,55 +8144,55 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 				nearCeilingPoint, nearFloorPoint, camera, frame);
 
 			SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, wallU, 0.0,
-				Constants::JustBelowOne, wallNormal, textures.at(transparentWallData.id),
+				Constants::JustBelowOne, wallNormal, textures.at(voxel.textureID),
 				shadingInfo, occlusion, frame);
 		}
-		else if (voxelData.dataType == VoxelDataType::Edge)
+		else if (voxel.dataType == VoxelDataType::Edge)
 		{
-			const VoxelData::EdgeData &edgeData = voxelData.edge;
+			const RenderVoxelShape &edgeShape = renderVoxelGrid.shapes[voxel.shapeIndex];
+			const bool edgeFlipped = (voxel.flags & RenderVoxel::FLAG_EDGE_FLIPPED) != 0;
 
 			// Find intersection.
 			RayHit hit;
 			const bool success = SoftwareRenderer::findEdgeIntersection(voxelX, voxelZ,
-				edgeData.facing, edgeData.flipped, facing, nearPoint, farPoint, wallU,
+				voxel.getEdgeFacing(), edgeFlipped, facing, nearPoint, farPoint, wallU,
 				camera, ray, hit);
 
 			if (success)
 			{
 				const Double3 edgeTopPoint(
 					hit.point.x,
-					voxelYReal + voxelHeight + edgeData.yOffset,
+					voxelYReal + voxelHeight + edgeShape.yOffset,
 					hit.point.y);
 				const Double3 edgeBottomPoint(
 					hit.point.x,
-					voxelYReal + edgeData.yOffset,
+					voxelYReal + edgeShape.yOffset,
 					hit.point.y);
 
 				const auto drawRange = SoftwareRenderer::makeDrawRange(
 					edgeTopPoint, edgeBottomPoint, camera, frame);
 
 				SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ, hit.u,
-					0.0, Constants::JustBelowOne, hit.normal, textures.at(edgeData.id),
+					0.0, Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 					shadingInfo, occlusion, frame);
 			}
 		}
-		else if (voxelData.dataType == VoxelDataType::Chasm)
+		else if (voxel.dataType == VoxelDataType::Chasm)
 		{
 			// Ignore. Chasms should never be above the player's voxel.
 		}
-		else if (voxelData.dataType == VoxelDataType::Door)
+		else if (voxel.dataType == VoxelDataType::Door)
 		{
-			const VoxelData::DoorData &doorData = voxelData.door;
-			const double percentOpen = SoftwareRenderer::getDoorPercentOpen(
-				voxelX, voxelZ, openDoors);
+			const VoxelData::DoorData::Type doorType = voxel.getDoorType();
+			const double percentOpen = openDoors.getPercentOpen(voxelX, voxelZ);
 
 			RayHit hit;
 			const bool success = SoftwareRenderer::findDoorIntersection(voxelX, voxelZ,
-				doorData.type, percentOpen, facing, nearPoint, farPoint, wallU, hit);
+				doorType, percentOpen, facing, nearPoint, farPoint, wallU, hit);
 
 			if (success)
 			{
-				if (doorData.type == VoxelData::DoorData::Type::Swinging)
+				if (doorType == VoxelData::DoorData::Type::Swinging)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -5242,10 +8207,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ + hit.innerZ,
-						hit.u, 0.0, Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
-						shadingInfo, occlusion, frame);
+						hit.u, 0.0, Constants::JustBelowOne, hit.normal,
+						textures.at(voxel.textureID), shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Sliding)
+				else if (doorType == VoxelData::DoorData::Type::Sliding)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -5260,10 +8225,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, 0.0,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 						shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Raising)
+				else if (doorType == VoxelData::DoorData::Type::Raising)
 				{
 					// Top point is fixed, bottom point depends on percent open.
 					const double minVisible = SoftwareRenderer::DOOR_MIN_VISIBLE;
@@ -5285,10 +8250,10 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 					const double vStart = raisedAmount / voxelHeight;
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, vStart,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id), shadingInfo,
-						occlusion, frame);
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
+						shadingInfo, occlusion, frame);
 				}
-				else if (doorData.type == VoxelData::DoorData::Type::Splitting)
+				else if (doorType == VoxelData::DoorData::Type::Splitting)
 				{
 					const Double3 doorTopPoint(
 						hit.point.x,
@@ -5303,7 +8268,7 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 						doorTopPoint, doorBottomPoint, camera, frame);
 
 					SoftwareRenderer::drawTransparentPixels(x, drawRange, nearZ, hit.u, 0.0,
-						Constants::JustBelowOne, hit.normal, textures.at(doorData.id),
+						Constants::JustBelowOne, hit.normal, textures.at(voxel.textureID),
 						shadingInfo, occlusion, frame);
 				}
 			}
@@ -5313,17 +8278,24 @@ void SoftwareRenderer::drawVoxelColumn(int x, int voxelX, int voxelZ, const Came
 	// Relative Y voxel coordinate of the camera, compensating for the ceiling height.
 	const int adjustedVoxelY = camera.getAdjustedEyeVoxelY(ceilingHeight);
 
+	// Only the part of the column with non-empty voxels needs to be looked at.
+	int columnYStart, columnYEnd;
+	voxelGrid.getColumnYRange(voxelX, voxelZ, &columnYStart, &columnYEnd);
+
 	// Draw voxel straight ahead first.
-	drawVoxel(adjustedVoxelY);
+	if ((adjustedVoxelY >= columnYStart) && (adjustedVoxelY < columnYEnd))
+	{
+		drawVoxel(adjustedVoxelY);
+	}
 
 	// Draw voxels below the voxel.
-	for (int voxelY = (adjustedVoxelY - 1); voxelY >= 0; voxelY--)
+	for (int voxelY = std::min(adjustedVoxelY, columnYEnd) - 1; voxelY >= columnYStart; voxelY--)
 	{
 		drawVoxelBelow(voxelY);
 	}
 
 	// Draw voxels above the voxel.
-	for (int voxelY = (adjustedVoxelY + 1); voxelY < voxelGrid.getHeight(); voxelY++)
+	for (int voxelY = std::max(adjustedVoxelY + 1, columnYStart); voxelY < columnYEnd; voxelY++)
 	{
 		drawVoxelAbove(voxelY);
 	}
@@ -5338,10 +8310,12 @@ void SoftwareRenderer::drawFlat(int startX, int endX, const Flat::Frame &flatFra
 	const Double3 sunComponent = (shadingInfo.sunColor * lightNormalDot).clamped(
 		0.0, 1.0 - shadingInfo.ambient);
 
-	// X percents across the screen for the given start and end columns.
+	// X percents across the screen for the given start and end columns. The end column is
+	// exclusive, so its percent is at its left edge. Otherwise the last column would be
+	// drawn by two threads at once.
 	const double startXPercent = (static_cast<double>(startX) + 0.50) / 
 		static_cast<double>(frame.width);
-	const double endXPercent = (static_cast<double>(endX) + 0.50) /
+	const double endXPercent = static_cast<double>(endX) /
 		static_cast<double>(frame.width);
 
 	const bool startsInRange =
@@ -5373,6 +8347,9 @@ void SoftwareRenderer::drawFlat(int startX, int endX, const Flat::Frame &flatFra
 	// Points interpolated between for per-column depth calculations in the XZ plane.
 	const Double3 startTopPoint = flatFrame.topStart.lerp(flatFrame.topEnd, startFlatPercent);
 	const Double3 endTopPoint = flatFrame.topStart.lerp(flatFrame.topEnd, endFlatPercent);
+	const Double3 startBottomPoint = flatFrame.bottomStart.lerp(
+		flatFrame.bottomEnd, startFlatPercent);
+	const Double3 endBottomPoint = flatFrame.bottomStart.lerp(flatFrame.bottomEnd, endFlatPercent);
 
 	// Horizontal texture coordinates in the flat. Although the flat percent can be
 	// equal to 1.0, the texture coordinate needs to be less than 1.0.
@@ -5392,15 +8369,29 @@ void SoftwareRenderer::drawFlat(int startX, int endX, const Flat::Frame &flatFra
 	const int yStart = SoftwareRenderer::getLowerBoundedPixel(projectedYStart, frame.height);
 	const int yEnd = SoftwareRenderer::getUpperBoundedPixel(projectedYEnd, frame.height);
 
+	// Mip level from how many texels each pixel covers, which is the same across the flat.
+	const int mipLevel = shadingInfo.mipmapping ? SoftwareRenderer::getMipLevel(std::max(
+		static_cast<double>(texture.width) / ((flatFrame.endX - flatFrame.startX) * frame.widthReal),
+		static_cast<double>(texture.height) / (projectedYEnd - projectedYStart)),
+		static_cast<int>(texture.mipOffsets.size())) : 0;
+	const int mipOffset = texture.mipOffsets[mipLevel];
+	const int mipWidth = texture.getMipWidth(mipLevel);
+	const int mipHeight = texture.getMipHeight(mipLevel);
+
 	// Shading on the texture.
-	// - @todo: contribution from lights.
 	const Double3 shading(
 		shadingInfo.ambient + sunComponent.x,
 		shadingInfo.ambient + sunComponent.y,
 		shadingInfo.ambient + sunComponent.z);
 
+	// Fog color to interpolate with.
+	const Double3 &fogColor = shadingInfo.getFogColor();
+
+	// Visible texels are gathered and shaded several at a time.
+	ShadingBatch batch(shading, fogColor, frame.colorBuffer);
+
 	// Draw by-column, similar to wall rendering.
-	for (int x = xStart; x < xEnd; x++)
+	for (int x = frame.getFirstDrawnColumn(xStart); x < xEnd; x += frame.columnStep)
 	{
 		const double xPercent = ((static_cast<double>(x) + 0.50) - projectedXStart) /
 			(projectedXEnd - projectedXStart);
@@ -5411,17 +8402,57 @@ void SoftwareRenderer::drawFlat(int startX, int endX, const Flat::Frame &flatFra
 		// Horizontal texel position.
 		const int textureX = static_cast<int>(
 			(flipped ? (Constants::JustBelowOne - u) : u) *
-			static_cast<double>(texture.width));
+			static_cast<double>(mipWidth));
 
 		const Double3 topPoint = startTopPoint.lerp(endTopPoint, xPercent);
+		const Double3 bottomPoint = startBottomPoint.lerp(endBottomPoint, xPercent);
 
 		// Get the true XZ distance for the depth.
 		const double depth = (Double2(topPoint.x, topPoint.z) - eye).length();
 
+		// Skip the column if it's behind walls in every row the flat covers.
+		if (depth > frame.getMaxTileDepth(x, yStart, yEnd))
+		{
+			continue;
+		}
+
 		// Linearly interpolated fog.
-		const Double3 &fogColor = shadingInfo.getFogColor();
 		const double fogPercent = std::min(depth / shadingInfo.fogDistance, 1.0);
 
+		// Point lights reaching the column.
+		const ColumnLights columnLights = shadingInfo.getLights(
+			Double2(topPoint.x, topPoint.z), normal);
+
+		if ((shadingInfo.colormap != nullptr) && !columnLights.isLit())
+		{
+			// Palette shading. Light and fog are constant for the column.
+			const uint32_t *colors = shadingInfo.colormap->getColors(
+				Colormap::getLightLevel(lightNormalDot), Colormap::getFogLevel(fogPercent));
+
+			for (int y = yStart; y < yEnd; y++)
+			{
+				const int index = x + (y * frame.width);
+
+				if (depth <= frame.depthBuffer[index])
+				{
+					const double yPercent = ((static_cast<double>(y) + 0.50) - projectedYStart) /
+						(projectedYEnd - projectedYStart);
+					const double v = Constants::JustBelowOne * yPercent;
+					const int textureY = static_cast<int>(v * static_cast<double>(mipHeight));
+					const int textureIndex = mipOffset + textureY + (textureX * mipHeight);
+					const uint8_t texelIndex = texture.indexedTexels[textureIndex];
+
+					if (texelIndex != TexturePalette::TRANSPARENT_INDEX)
+					{
+						frame.colorBuffer[index] = colors[texelIndex];
+						frame.depthBuffer[index] = depth;
+					}
+				}
+			}
+
+			continue;
+		}
+
 		for (int y = yStart; y < yEnd; y++)
 		{
 			const int index = x + (y * frame.width);
@@ -5437,49 +8468,43 @@ void SoftwareRenderer::drawFlat(int startX, int endX, const Flat::Frame &flatFra
 				const double v = startV + ((endV - startV) * yPercent);
 
 				// Vertical texel position.
-				const int textureY = static_cast<int>(v * static_cast<double>(texture.height));
+				const int textureY = static_cast<int>(v * static_cast<double>(mipHeight));
 
 				// Alpha is checked in this loop, and transparent texels are not drawn.
 				// Flats do not have emission, so ignore it.
-				const int textureIndex = textureX + (textureY * texture.width);
+				const int textureIndex = mipOffset + textureY + (textureX * mipHeight);
 				const FlatTexel &texel = texture.texels[textureIndex];
 
-				if (texel.a > 0.0)
+				if (texel.a > 0)
 				{
-					// Texture color with shading.
-					const double shadingMax = 1.0;
-					double colorR = texel.r * std::min(shading.x, shadingMax);
-					double colorG = texel.g * std::min(shading.y, shadingMax);
-					double colorB = texel.b * std::min(shading.z, shadingMax);
-
-					// Linearly interpolate with fog.
-					colorR += (fogColor.x - colorR) * fogPercent;
-					colorG += (fogColor.y - colorG) * fogPercent;
-					colorB += (fogColor.z - colorB) * fogPercent;
-
-					// Clamp maximum (don't worry about negative values).
-					const double high = 1.0;
-					colorR = (colorR > high) ? high : colorR;
-					colorG = (colorG > high) ? high : colorG;
-					colorB = (colorB > high) ? high : colorB;
-
-					// Convert floats to integers.
-					const uint32_t colorRGB = static_cast<uint32_t>(
-						((static_cast<uint8_t>(colorR * 255.0)) << 16) |
-						((static_cast<uint8_t>(colorG * 255.0)) << 8) |
-						((static_cast<uint8_t>(colorB * 255.0))));
-
-					frame.colorBuffer[index] = colorRGB;
+					// Flats do not have emission.
+					const uint32_t packedTexel = ShadingKernels::packTexel(
+						texel.r, texel.g, texel.b, false);
+
+					if (columnLights.isLit())
+					{
+						const Double3 point = topPoint.lerp(bottomPoint, yPercent);
+						batch.addLit(packedTexel, fogPercent, index,
+							shadingInfo.getLightColor(point, normal, columnLights));
+					}
+					else
+					{
+						batch.add(packedTexel, fogPercent, index);
+					}
+
 					frame.depthBuffer[index] = depth;
 				}
 			}
 		}
 	}
+
+	batch.flush();
 }
 
 void SoftwareRenderer::rayCast2D(int x, const Camera &camera, const Ray &ray,
 	const ShadingInfo &shadingInfo, double ceilingHeight,
-	const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+	const RenderVoxelGrid &renderVoxelGrid, const VisibilityGrid &visibility,
 	const std::vector<VoxelTexture> &textures, OcclusionData &occlusion, const FrameView &frame)
 {
 	// Initially based on Lode Vandevenne's algorithm, this method of 2.5D ray casting is more 
@@ -5572,8 +8597,8 @@ void SoftwareRenderer::rayCast2D(int x, const Camera &camera, const Ray &ray,
 		// Draw all voxels in a column at the player's XZ coordinate.
 		SoftwareRenderer::drawInitialVoxelColumn(x, camera.eyeVoxel.x, camera.eyeVoxel.z,
 			camera, ray, facing, initialNearPoint, initialFarPoint, SoftwareRenderer::NEAR_PLANE, 
-			zDistance, shadingInfo, ceilingHeight, openDoors, voxelGrid, textures, occlusion,
-			frame);
+			zDistance, shadingInfo, ceilingHeight, openDoors, voxelGrid, renderVoxelGrid,
+			textures, occlusion, frame);
 	}
 
 	// The current voxel coordinate in the DDA loop. For all intents and purposes,
@@ -5628,6 +8653,29 @@ void SoftwareRenderer::rayCast2D(int x, const Camera &camera, const Ray &ray,
 	while (voxelIsValid && (zDistance < shadingInfo.fogDistance) && 
 		(occlusion.yMin != occlusion.yMax))
 	{
+		// Nothing the camera can't see from where it is gets drawn, and nothing past it
+		// could be seen either.
+		if (!visibility.isColumnVisible(cell.x, cell.z))
+		{
+			break;
+		}
+
+		// If the ray is in a block of the grid with nothing in it, step until it leaves
+		// the block without looking at any voxels.
+		const int blockX = cell.x / VoxelGrid::BLOCK_SIZE;
+		const int blockZ = cell.z / VoxelGrid::BLOCK_SIZE;
+		if (voxelGrid.isBlockEmpty(blockX, blockZ))
+		{
+			do
+			{
+				doDDAStep();
+			} while (voxelIsValid && (zDistance < shadingInfo.fogDistance) &&
+				((cell.x / VoxelGrid::BLOCK_SIZE) == blockX) &&
+				((cell.z / VoxelGrid::BLOCK_SIZE) == blockZ));
+
+			continue;
+		}
+
 		// Store the cell coordinates, axis, and Z distance for wall rendering. The
 		// loop needs to do another DDA step to calculate the far point.
 		const int savedCellX = cell.x;
@@ -5650,7 +8698,7 @@ void SoftwareRenderer::rayCast2D(int x, const Camera &camera, const Ray &ray,
 		// Draw all voxels in a column at the given XZ coordinate.
 		SoftwareRenderer::drawVoxelColumn(x, savedCellX, savedCellZ, camera, ray, savedFacing,
 			nearPoint, farPoint, wallDistance, zDistance, shadingInfo, ceilingHeight, 
-			openDoors, voxelGrid, textures, occlusion, frame);
+			openDoors, voxelGrid, renderVoxelGrid, textures, occlusion, frame);
 	}
 }
 
@@ -5710,123 +8758,589 @@ void SoftwareRenderer::drawSkyGradient(int startY, int endY, const Camera &camer
 			gradientBottomPoint, camera.transform, camera.yShear);
 	}();
 
-	for (int y = startY; y < endY; y++)
-	{
-		// Y percent across the screen.
-		const double yPercent = (static_cast<double>(y) + 0.50) / frame.heightReal;
+	for (int y = startY; y < endY; y++)
+	{
+		// Y percent across the screen.
+		const double yPercent = (static_cast<double>(y) + 0.50) / frame.heightReal;
+
+		// Y percent relative to the sky gradient.
+		const double gradientPercent = Constants::JustBelowOne - MathUtils::clamp(
+			(yPercent - gradientTopYPercent) / (gradientBottomYPercent - gradientTopYPercent),
+			0.0, Constants::JustBelowOne);
+
+		// Determine which sky color index the percent falls into, and how much of that
+		// color to interpolate with the next one.
+		const auto &skyColors = shadingInfo.skyColors;
+		const int skyColorCount = static_cast<int>(skyColors.size());
+		const double realIndex = gradientPercent * static_cast<double>(skyColorCount);
+		const double percent = realIndex - std::floor(realIndex);
+		const int index = static_cast<int>(realIndex);
+		const int nextIndex = MathUtils::clamp(index + 1, 0, skyColorCount - 1);
+		const Double3 color = skyColors.at(index).lerp(skyColors.at(nextIndex), percent);
+
+		drawSkyRow(y, color);
+	}
+}
+
+void SoftwareRenderer::drawSkyPanorama(int startX, int endX, const SkyPanorama &skyPanorama,
+	const Camera &camera, const ShadingInfo &shadingInfo, const FrameView &frame)
+{
+	if (skyPanorama.height == 0)
+	{
+		return;
+	}
+
+	// Shaded channel values, the same as drawDistantPixels() would calculate. Some distant
+	// objects are completely bright.
+	std::array<uint8_t, 256> ambientChannels, emissiveChannels;
+	for (size_t i = 0; i < ambientChannels.size(); i++)
+	{
+		const double channel = ShadingKernels::NormalizedChannels[i];
+		ambientChannels[i] = static_cast<uint8_t>(
+			std::min(channel * shadingInfo.distantAmbient, 1.0) * 255.0);
+		emissiveChannels[i] = static_cast<uint8_t>(std::min(channel, 1.0) * 255.0);
+	}
+
+	// The panorama moves up and down with the horizon.
+	const Double3 forward(camera.forwardX, 0.0, camera.forwardZ);
+	const double horizonY = SoftwareRenderer::getProjectedY(
+		camera.eye + forward, camera.transform, camera.yShear) * frame.heightReal;
+	const double originY = horizonY + static_cast<double>(skyPanorama.rowOrigin);
+
+	const Double2 forwardZoomed(camera.forwardZoomedX, camera.forwardZoomedZ);
+	const Double2 rightAspected(camera.rightAspectedX, camera.rightAspectedZ);
+
+	for (int x = startX; x < endX; x++)
+	{
+		// Angle of the ray through the column.
+		const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+		const Double2 direction = forwardZoomed + (rightAspected * ((2.0 * xPercent) - 1.0));
+		const double angle = MathUtils::fullAtan2(direction.x, direction.y);
+		const int column = std::min(static_cast<int>(angle / skyPanorama.columnAngle),
+			skyPanorama.width - 1);
+
+		// Only the rows with something in them are drawn.
+		const int rowStart = skyPanorama.rowStarts[column];
+		const int rowEnd = skyPanorama.rowEnds[column];
+		if (rowStart >= rowEnd)
+		{
+			continue;
+		}
+
+		const int yStart = SoftwareRenderer::getLowerBoundedPixel(
+			originY + static_cast<double>(rowStart), frame.height);
+		const int yEnd = SoftwareRenderer::getUpperBoundedPixel(
+			originY + static_cast<double>(rowEnd), frame.height);
+		const SkyPanorama::Texel *columnTexels =
+			skyPanorama.texels.data() + (column * skyPanorama.height);
+
+		for (int y = yStart; y < yEnd; y++)
+		{
+			const int row = std::min(static_cast<int>(
+				(static_cast<double>(y) + 0.50) - originY), rowEnd - 1);
+			const SkyPanorama::Texel &texel = columnTexels[row];
+
+			if (texel.opaque)
+			{
+				const std::array<uint8_t, 256> &channels = texel.emissive ?
+					emissiveChannels : ambientChannels;
+				frame.colorBuffer[x + (y * frame.width)] = static_cast<uint32_t>(
+					(channels[texel.r] << 16) | (channels[texel.g] << 8) | channels[texel.b]);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::drawDistantSky(int startX, int endX, bool parallaxSky,
+	const std::vector<VisDistantObject> &visDistantObjs, const Camera &camera,
+	const std::vector<SkyTexture> &skyTextures, const ShadingInfo &shadingInfo,
+	const FrameView &frame)
+{
+	// For each visible distant object, if it is at least partially within the start and end
+	// X, then draw. Reverse iterate so objects are drawn far to near.
+	for (auto it = visDistantObjs.rbegin(); it != visDistantObjs.rend(); ++it)
+	{
+		const VisDistantObject &obj = *it;
+		const SkyTexture &texture = *obj.texture;
+		const DrawRange &drawRange = obj.drawRange;
+		const double xProjStart = obj.xProjStart;
+		const double xProjEnd = obj.xProjEnd;
+		const int xDrawStart = std::max(obj.xStart, startX);
+		const int xDrawEnd = std::min(obj.xEnd, endX);
+		const bool emissive = obj.emissive;
+
+		if (parallaxSky)
+		{
+			// Parallax rendering. Render the object based on its left and right edges.
+
+			// @todo: see if these are necessary.
+			//const double xAngleStart = obj.xAngleStart;
+			//const double xAngleEnd = obj.xAngleEnd;
+
+			for (int x = xDrawStart; x < xDrawEnd; x++)
+			{
+				// Percent X across the screen.
+				const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+
+				// Percentage across the horizontal span of the object in screen space.
+				const double widthPercent = MathUtils::clamp(
+					(xPercent - xProjStart) / (xProjEnd - xProjStart),
+					0.0, Constants::JustBelowOne);
+
+				// Horizontal texture coordinate, accounting for parallax.
+				// @todo: incorporate angle/field of view/delta angle from center of view into this.
+				const double u = widthPercent;
+
+				SoftwareRenderer::drawDistantPixels(x, drawRange, u, 0.0,
+					Constants::JustBelowOne, texture, emissive, shadingInfo, frame);
+			}
+		}
+		else
+		{
+			// Classic rendering. Render the object based on its midpoint.
+			for (int x = xDrawStart; x < xDrawEnd; x++)
+			{
+				// Percent X across the screen.
+				const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+
+				// Percentage across the horizontal span of the object in screen space.
+				const double widthPercent = MathUtils::clamp(
+					(xPercent - xProjStart) / (xProjEnd - xProjStart),
+					0.0, Constants::JustBelowOne);
+
+				// Horizontal texture coordinate, not accounting for parallax.
+				const double u = widthPercent;
+
+				SoftwareRenderer::drawDistantPixels(x, drawRange, u, 0.0,
+					Constants::JustBelowOne, texture, emissive, shadingInfo, frame);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::drawVoxels(int startX, int endX, const Camera &camera,
+	double ceilingHeight, const LevelData::OpenDoors &openDoors,
+	const VoxelGrid &voxelGrid, const RenderVoxelGrid &renderVoxelGrid,
+	const VisibilityGrid &visibility, const std::vector<VoxelTexture> &voxelTextures,
+	std::vector<OcclusionData> &occlusion, const ShadingInfo &shadingInfo,
+	const FrameView &frame)
+{
+	const Double2 forwardZoomed(camera.forwardZoomedX, camera.forwardZoomedZ);
+	const Double2 rightAspected(camera.rightAspectedX, camera.rightAspectedZ);
+
+	for (int x = frame.getFirstDrawnColumn(startX); x < endX; x += frame.columnStep)
+	{
+		// X percent across the screen.
+		const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+
+		// "Right" component of the ray direction, based on current screen X.
+		const Double2 rightComp = rightAspected * ((2.0 * xPercent) - 1.0);
+
+		// Calculate the ray direction through the pixel.
+		// - If un-normalized, it uses the Z distance, but the insides of voxels
+		//   don't look right then.
+		const Double2 direction = (forwardZoomed + rightComp).normalized();
+		const Ray ray(direction.x, direction.y);
+
+		// Cast the 2D ray and fill in the column's pixels with color.
+		SoftwareRenderer::rayCast2D(x, camera, ray, shadingInfo, ceilingHeight, openDoors,
+			voxelGrid, renderVoxelGrid, visibility, voxelTextures, occlusion.at(x), frame);
+	}
+}
+
+void SoftwareRenderer::drawPlaneSpans(int startX, int endX, const Camera &camera,
+	double ceilingHeight, const std::vector<VoxelTexture> &voxelTextures,
+	const ShadingInfo &shadingInfo, const FrameView &frame)
+{
+	const Double2 forwardZoomed(camera.forwardZoomedX, camera.forwardZoomedZ);
+	const Double2 rightAspected(camera.rightAspectedX, camera.rightAspectedZ);
+
+	// Change in the un-normalized ray direction from one drawn column to the next.
+	const Double2 directionStep = rightAspected *
+		((2.0 * static_cast<double>(frame.columnStep)) / frame.widthReal);
+
+	// Projected Y of the horizon, where every plane is infinitely far away.
+	const double horizonY = 0.50 + camera.yShear;
+
+	// A point's distance from the horizon on screen is inversely proportional to its distance
+	// along the camera's forward axis, which is the same across a row for a horizontal plane.
+	// The projection of a point one unit ahead gives the ratio, and it changes linearly with
+	// the plane's height.
+	const Double2 unitPoint(camera.eye.x + camera.forwardX, camera.eye.z + camera.forwardZ);
+	const double unitProjectedY0 = SoftwareRenderer::getProjectedY(
+		Double3(unitPoint.x, 0.0, unitPoint.y), camera.transform, camera.yShear);
+	const double unitProjectedY1 = SoftwareRenderer::getProjectedY(
+		Double3(unitPoint.x, 1.0, unitPoint.y), camera.transform, camera.yShear);
+
+	// Planes below the camera are seen from above, so they face up, and planes above it face
+	// down. Light is the same for every plane facing the same way.
+	auto getLightNormalDot = [&shadingInfo](const Double3 &normal)
+	{
+		return std::max(0.0, shadingInfo.sunDirection.dot(normal));
+	};
+
+	auto getShading = [&shadingInfo](double lightNormalDot)
+	{
+		// Contribution from the sun.
+		const Double3 sunComponent = (shadingInfo.sunColor * lightNormalDot).clamped(
+			0.0, 1.0 - shadingInfo.ambient);
+
+		// Shading on the texture.
+		return Double3(
+			shadingInfo.ambient + sunComponent.x,
+			shadingInfo.ambient + sunComponent.y,
+			shadingInfo.ambient + sunComponent.z);
+	};
+
+	const double upLightNormalDot = getLightNormalDot(Double3::UnitY);
+	const double downLightNormalDot = getLightNormalDot(-Double3::UnitY);
+
+	// Visible texels are gathered and shaded several at a time, with one batch for each way
+	// the planes face.
+	const Double3 &fogColor = shadingInfo.getFogColor();
+	const Double3 upShading = getShading(upLightNormalDot);
+	const Double3 downShading = getShading(downLightNormalDot);
+	ShadingBatch upBatch(upShading, fogColor, frame.colorBuffer);
+	ShadingBatch downBatch(downShading, fogColor, frame.colorBuffer);
+
+	// Spans can cross voxel columns, so lights are looked up for each pixel, but only if
+	// there are any.
+	const bool hasLights = shadingInfo.hasLights();
+
+	const int firstX = frame.getFirstDrawnColumn(startX);
+	for (int y = 0; y < frame.height; y++)
+	{
+		uint16_t *planeIDs = frame.planeIDs + (y * frame.width);
+		const double yPercent = (static_cast<double>(y) + 0.50) / frame.heightReal;
+
+		int x = firstX;
+		while (x < endX)
+		{
+			const uint16_t planeID = planeIDs[x];
+			if (planeID == 0)
+			{
+				x += frame.columnStep;
+				continue;
+			}
+
+			// Find where this plane and texture stop in the row.
+			int spanEndX = x + frame.columnStep;
+			while ((spanEndX < endX) && (planeIDs[spanEndX] == planeID))
+			{
+				spanEndX += frame.columnStep;
+			}
+
+			const int planeY = (planeID & 0xFF) - 1;
+			const double planeYReal = static_cast<double>(planeY) * ceilingHeight;
+			const VoxelTexture &texture = voxelTextures[planeID >> 8];
+			const bool facingUp = planeYReal < camera.eye.y;
+
+			// Un-normalized ray directions have a forward component equal to the zoom, so
+			// scaling them by this gives the point on the plane, and scaling their length by
+			// it gives the depth.
+			const double unitProjectedY = unitProjectedY0 +
+				((unitProjectedY1 - unitProjectedY0) * planeYReal);
+			const double forwardDistance = (horizonY - unitProjectedY) / (horizonY - yPercent);
+			const double directionScale = forwardDistance / camera.zoom;
+
+			// Plane point and ray direction at the start of the span, stepped across it.
+			const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+			const Double2 startDirection = forwardZoomed +
+				(rightAspected * ((2.0 * xPercent) - 1.0));
+			double directionX = startDirection.x;
+			double directionZ = startDirection.y;
+			double pointX = camera.eye.x + (directionX * directionScale);
+			double pointZ = camera.eye.z + (directionZ * directionScale);
+			const double pointStepX = directionStep.x * directionScale;
+			const double pointStepZ = directionStep.y * directionScale;
+
+			// Mip level from how far the plane point moves from one pixel to the next, either
+			// across the row or down to the next row, whichever is farther.
+			int mipLevel = 0;
+			if (shadingInfo.mipmapping)
+			{
+				const double acrossStep = std::sqrt((pointStepX * pointStepX) +
+					(pointStepZ * pointStepZ)) / static_cast<double>(frame.columnStep);
+				const double nextRowDistance = forwardDistance / (frame.heightReal *
+					std::abs(horizonY - yPercent));
+				const double downStep = nextRowDistance * (startDirection.length() / camera.zoom);
+				mipLevel = SoftwareRenderer::getMipLevel(std::max(acrossStep, downStep) *
+					static_cast<double>(VoxelTexture::WIDTH), VoxelTexture::MIP_LEVEL_COUNT);
+			}
+
+			const int mipOffset = VoxelTexture::getMipOffset(mipLevel);
+			const int mipSize = VoxelTexture::WIDTH >> mipLevel;
+			const double mipSizeReal = static_cast<double>(mipSize);
+
+			// Gets the texel index of the current plane point.
+			auto getTextureIndex = [&pointX, &pointZ, mipOffset, mipSize, mipSizeReal]()
+			{
+				const double u = MathUtils::clamp(
+					Constants::JustBelowOne - (pointX - std::floor(pointX)),
+					0.0, Constants::JustBelowOne);
+				const double v = MathUtils::clamp(
+					Constants::JustBelowOne - (pointZ - std::floor(pointZ)),
+					0.0, Constants::JustBelowOne);
+				const int textureX = static_cast<int>(u * mipSizeReal);
+				const int textureY = static_cast<int>(v * mipSizeReal);
+				return mipOffset + textureY + (textureX * mipSize);
+			};
+
+			ShadingBatch &batch = facingUp ? upBatch : downBatch;
+			const Double3 normal = facingUp ? Double3::UnitY : -Double3::UnitY;
+
+			// Gets the lights reaching the current plane point. Spans stay in one voxel
+			// column for several pixels, so the last column's lights are kept.
+			int lightsX = -1;
+			int lightsZ = -1;
+			ColumnLights spanLights;
+			auto getLights = [&shadingInfo, &pointX, &pointZ, &normal, hasLights, &lightsX,
+				&lightsZ, &spanLights]()
+			{
+				if (!hasLights)
+				{
+					return spanLights;
+				}
+
+				const int voxelX = static_cast<int>(std::floor(pointX));
+				const int voxelZ = static_cast<int>(std::floor(pointZ));
+				if ((voxelX != lightsX) || (voxelZ != lightsZ))
+				{
+					spanLights = shadingInfo.getLights(Double2(pointX, pointZ), normal);
+					lightsX = voxelX;
+					lightsZ = voxelZ;
+				}
+
+				return spanLights;
+			};
+
+			if (shadingInfo.colormap != nullptr)
+			{
+				// Palette shading. Light is constant for the span but fog varies per pixel.
+				// Lit pixels are shaded in true color.
+				const int lightLevel = Colormap::getLightLevel(
+					facingUp ? upLightNormalDot : downLightNormalDot);
+
+				for (int spanX = x; spanX < spanEndX; spanX += frame.columnStep)
+				{
+					const int index = spanX + (y * frame.width);
+					const double depth = std::sqrt((directionX * directionX) +
+						(directionZ * directionZ)) * directionScale;
+
+					if (depth <= frame.depthBuffer[index])
+					{
+						const double fogPercent = std::min(depth / shadingInfo.fogDistance, 1.0);
+						const int textureIndex = getTextureIndex();
+						const ColumnLights columnLights = getLights();
+
+						if (columnLights.isLit())
+						{
+							const VoxelTexel &texel = texture.texels[textureIndex];
+							const Double3 point(pointX, planeYReal, pointZ);
+							batch.addLit(ShadingKernels::packTexel(texel.r, texel.g, texel.b,
+								texel.isEmissive()), fogPercent, index,
+								shadingInfo.getLightColor(point, normal, columnLights));
+						}
+						else
+						{
+							const uint32_t *colors = shadingInfo.colormap->getColors(
+								lightLevel, Colormap::getFogLevel(fogPercent));
+							frame.colorBuffer[index] = colors[texture.indexedTexels[textureIndex]];
+						}
+
+						frame.depthBuffer[index] = depth;
+					}
+
+					planeIDs[spanX] = 0;
+					directionX += directionStep.x;
+					directionZ += directionStep.y;
+					pointX += pointStepX;
+					pointZ += pointStepZ;
+				}
+			}
+			else
+			{
+				for (int spanX = x; spanX < spanEndX; spanX += frame.columnStep)
+				{
+					const int index = spanX + (y * frame.width);
+					const double depth = std::sqrt((directionX * directionX) +
+						(directionZ * directionZ)) * directionScale;
+
+					// Marking only checked occlusion, so nearer transparent texels might
+					// already be here.
+					if (depth <= frame.depthBuffer[index])
+					{
+						// Linearly interpolated fog.
+						const double fogPercent = std::min(depth / shadingInfo.fogDistance, 1.0);
+
+						// Alpha is ignored in this loop, so transparent texels will appear black.
+						const VoxelTexel &texel = texture.texels[getTextureIndex()];
+						const uint32_t packedTexel = ShadingKernels::packTexel(
+							texel.r, texel.g, texel.b, texel.isEmissive());
+						const ColumnLights columnLights = getLights();
 
-		// Y percent relative to the sky gradient.
-		const double gradientPercent = Constants::JustBelowOne - MathUtils::clamp(
-			(yPercent - gradientTopYPercent) / (gradientBottomYPercent - gradientTopYPercent),
-			0.0, Constants::JustBelowOne);
+						if (columnLights.isLit())
+						{
+							const Double3 point(pointX, planeYReal, pointZ);
+							batch.addLit(packedTexel, fogPercent, index,
+								shadingInfo.getLightColor(point, normal, columnLights));
+						}
+						else
+						{
+							batch.add(packedTexel, fogPercent, index);
+						}
 
-		// Determine which sky color index the percent falls into, and how much of that
-		// color to interpolate with the next one.
-		const auto &skyColors = shadingInfo.skyColors;
-		const int skyColorCount = static_cast<int>(skyColors.size());
-		const double realIndex = gradientPercent * static_cast<double>(skyColorCount);
-		const double percent = realIndex - std::floor(realIndex);
-		const int index = static_cast<int>(realIndex);
-		const int nextIndex = MathUtils::clamp(index + 1, 0, skyColorCount - 1);
-		const Double3 color = skyColors.at(index).lerp(skyColors.at(nextIndex), percent);
+						frame.depthBuffer[index] = depth;
+					}
 
-		drawSkyRow(y, color);
+					planeIDs[spanX] = 0;
+					directionX += directionStep.x;
+					directionZ += directionStep.y;
+					pointX += pointStepX;
+					pointZ += pointStepZ;
+				}
+			}
+
+			x = spanEndX;
+		}
 	}
+
+	upBatch.flush();
+	downBatch.flush();
 }
 
-void SoftwareRenderer::drawDistantSky(int startX, int endX, bool parallaxSky,
-	const std::vector<VisDistantObject> &visDistantObjs, const Camera &camera,
-	const std::vector<SkyTexture> &skyTextures, const ShadingInfo &shadingInfo,
-	const FrameView &frame)
+void SoftwareRenderer::updateDepthTiles(int startX, int endX, const FrameView &frame)
 {
-	// For each visible distant object, if it is at least partially within the start and end
-	// X, then draw. Reverse iterate so objects are drawn far to near.
-	for (auto it = visDistantObjs.rbegin(); it != visDistantObjs.rend(); ++it)
+	for (int tileY = 0; tileY < frame.depthTileRows; tileY++)
 	{
-		const VisDistantObject &obj = *it;
-		const SkyTexture &texture = *obj.texture;
-		const DrawRange &drawRange = obj.drawRange;
-		const double xProjStart = obj.xProjStart;
-		const double xProjEnd = obj.xProjEnd;
-		const int xDrawStart = std::max(obj.xStart, startX);
-		const int xDrawEnd = std::min(obj.xEnd, endX);
-		const bool emissive = obj.emissive;
+		double *tiles = frame.depthTiles + (tileY * frame.width);
+		std::fill(tiles + startX, tiles + endX, 0.0);
 
-		if (parallaxSky)
+		// Rows are read in order so the depth buffer is walked a cache line at a time.
+		const int startY = tileY * SoftwareRenderer::DEPTH_TILE_HEIGHT;
+		const int endY = std::min(startY + SoftwareRenderer::DEPTH_TILE_HEIGHT, frame.height);
+		for (int y = startY; y < endY; y++)
 		{
-			// Parallax rendering. Render the object based on its left and right edges.
+			const double *depths = frame.depthBuffer + (y * frame.width);
+			for (int x = startX; x < endX; x++)
+			{
+				tiles[x] = std::max(tiles[x], depths[x]);
+			}
+		}
+	}
+}
 
-			// @todo: see if these are necessary.
-			//const double xAngleStart = obj.xAngleStart;
-			//const double xAngleEnd = obj.xAngleEnd;
+void SoftwareRenderer::findVisibleFlats(int startCell, int endCell, const Camera &camera,
+	double fogDistance, const VisibilityGrid &visibility, const std::vector<Flat> &flats,
+	const std::vector<FlatCell> &flatCells, std::vector<VisibleFlat> &visibleFlats)
+{
+	// Each flat shares the same axes. The forward direction always faces opposite to 
+	// the camera direction.
+	const Double3 flatForward = Double3(-camera.forwardX, 0.0, -camera.forwardZ).normalized();
+	const Double3 flatUp = Double3::UnitY;
+	const Double3 flatRight = flatForward.cross(flatUp).normalized();
 
-			for (int x = xDrawStart; x < xDrawEnd; x++)
-			{
-				// Percent X across the screen.
-				const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+	const Double2 eye2D(camera.eye.x, camera.eye.z);
+	const Double2 direction(camera.forwardX, camera.forwardZ);
 
-				// Percentage across the horizontal span of the object in screen space.
-				const double widthPercent = MathUtils::clamp(
-					(xPercent - xProjStart) / (xProjEnd - xProjStart),
-					0.0, Constants::JustBelowOne);
+	// Directions perpendicular to the 2D frustum edges, both pointing towards the inside.
+	// A circle is outside the frustum if it's entirely behind either edge.
+	const Double2 frustumLeftPerp = Double2(camera.frustumLeftX, camera.frustumLeftZ).leftPerp();
+	const Double2 frustumRightPerp = Double2(camera.frustumRightX, camera.frustumRightZ).rightPerp();
+	auto isCircleInFrustum = [&eye2D, &frustumLeftPerp, &frustumRightPerp](
+		const Double2 &center, double radius)
+	{
+		const Double2 eyeToCenter = center - eye2D;
+		return (frustumLeftPerp.dot(eyeToCenter) >= -radius) &&
+			(frustumRightPerp.dot(eyeToCenter) >= -radius);
+	};
 
-				// Horizontal texture coordinate, accounting for parallax.
-				// @todo: incorporate angle/field of view/delta angle from center of view into this.
-				const double u = widthPercent;
+	// Ray casting stops at the fog distance since anything past it is completely fogged, so
+	// a circle whose nearest point is past it is skipped too.
+	auto isCircleInFog = [&eye2D, fogDistance](const Double2 &center, double radius)
+	{
+		const double fogRadius = fogDistance + radius;
+		return (center - eye2D).lengthSquared() >= (fogRadius * fogRadius);
+	};
 
-				SoftwareRenderer::drawDistantPixels(x, drawRange, u, 0.0,
-					Constants::JustBelowOne, texture, emissive, shadingInfo, frame);
-			}
+	// Flats in a cell can stick out of it by half their width.
+	const double cellRadius = SoftwareRenderer::FLAT_CELL_SIZE * (std::sqrt(2.0) * 0.50);
+
+	// This is the visible flat determination algorithm. It goes through the flats of each cell
+	// that touches the view frustum and sees which ones would be at least partially visible.
+	for (int i = startCell; i < endCell; i++)
+	{
+		const FlatCell &cell = flatCells[i];
+		const double cellFlatRadius = cellRadius + cell.maxHalfWidth;
+		if (!isCircleInFrustum(cell.center, cellFlatRadius) ||
+			isCircleInFog(cell.center, cellFlatRadius) ||
+			!visibility.isCircleVisible(cell.center, cellFlatRadius))
+		{
+			continue;
 		}
-		else
+
+		for (const int flatIndex : cell.flatIndices)
 		{
-			// Classic rendering. Render the object based on its midpoint.
-			for (int x = xDrawStart; x < xDrawEnd; x++)
-			{
-				// Percent X across the screen.
-				const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+			const Flat &flat = flats[flatIndex];
 
-				// Percentage across the horizontal span of the object in screen space.
-				const double widthPercent = MathUtils::clamp(
-					(xPercent - xProjStart) / (xProjEnd - xProjStart),
-					0.0, Constants::JustBelowOne);
+			// Skip the flat if its XZ extent is outside the frustum, in full fog, or
+			// somewhere the camera can't see.
+			const Double2 flatPosition2D(flat.position.x, flat.position.z);
+			const double flatHalfWidth = flat.width * 0.50;
+			if (!isCircleInFrustum(flatPosition2D, flatHalfWidth) ||
+				isCircleInFog(flatPosition2D, flatHalfWidth) ||
+				!visibility.isCircleVisible(flatPosition2D, flatHalfWidth))
+			{
+				continue;
+			}
 
-				// Horizontal texture coordinate, not accounting for parallax.
-				const double u = widthPercent;
+			// If the flat is somewhere in front of the camera, do further checks.
+			const Double2 flatEyeDiff = (flatPosition2D - eye2D).normalized();
+			const bool inFrontOfCamera = direction.dot(flatEyeDiff) > 0.0;
 
-				SoftwareRenderer::drawDistantPixels(x, drawRange, u, 0.0,
-					Constants::JustBelowOne, texture, emissive, shadingInfo, frame);
+			if (!inFrontOfCamera)
+			{
+				continue;
 			}
-		}
-	}
-}
 
-void SoftwareRenderer::drawVoxels(int startX, int stride, const Camera &camera,
-	double ceilingHeight, const std::vector<LevelData::DoorState> &openDoors,
-	const VoxelGrid &voxelGrid, const std::vector<VoxelTexture> &voxelTextures,
-	std::vector<OcclusionData> &occlusion, const ShadingInfo &shadingInfo, const FrameView &frame)
-{
-	const Double2 forwardZoomed(camera.forwardZoomedX, camera.forwardZoomedZ);
-	const Double2 rightAspected(camera.rightAspectedX, camera.rightAspectedZ);
+			// Scaled axes based on flat dimensions.
+			const Double3 flatRightScaled = flatRight * (flat.width * 0.50);
+			const Double3 flatUpScaled = flatUp * flat.height;
 
-	// Draw pixel columns with spacing determined by the number of render threads.
-	for (int x = startX; x < frame.width; x += stride)
-	{
-		// X percent across the screen.
-		const double xPercent = (static_cast<double>(x) + 0.50) / frame.widthReal;
+			// Calculate each corner of the flat in world space.
+			Flat::Frame flatFrame;
+			flatFrame.bottomStart = flat.position + flatRightScaled;
+			flatFrame.bottomEnd = flat.position - flatRightScaled;
+			flatFrame.topStart = flatFrame.bottomStart + flatUpScaled;
+			flatFrame.topEnd = flatFrame.bottomEnd + flatUpScaled;
 
-		// "Right" component of the ray direction, based on current screen X.
-		const Double2 rightComp = rightAspected * ((2.0 * xPercent) - 1.0);
+			// Now project two of the flat's opposing corner points into camera space.
+			// The Z value is used with flat sorting (not rendering), and the X and Y values 
+			// are used to find where the flat is on-screen.
+			Double4 projStart = camera.transform * Double4(flatFrame.topStart, 1.0);
+			Double4 projEnd = camera.transform * Double4(flatFrame.bottomEnd, 1.0);
 
-		// Calculate the ray direction through the pixel.
-		// - If un-normalized, it uses the Z distance, but the insides of voxels
-		//   don't look right then.
-		const Double2 direction = (forwardZoomed + rightComp).normalized();
-		const Ray ray(direction.x, direction.y);
+			// Normalize coordinates.
+			projStart = projStart / projStart.w;
+			projEnd = projEnd / projEnd.w;
 
-		// Cast the 2D ray and fill in the column's pixels with color.
-		SoftwareRenderer::rayCast2D(x, camera, ray, shadingInfo, ceilingHeight, openDoors,
-			voxelGrid, voxelTextures, occlusion.at(x), frame);
+			// Assign each screen value to the flat frame data.
+			flatFrame.startX = 0.50 + (projStart.x * 0.50);
+			flatFrame.endX = 0.50 + (projEnd.x * 0.50);
+			flatFrame.startY = (0.50 + camera.yShear) - (projStart.y * 0.50);
+			flatFrame.endY = (0.50 + camera.yShear) - (projEnd.y * 0.50);
+			flatFrame.z = projStart.z;
+
+			// Check that the Z value is within the clipping planes.
+			const bool inPlanes = (flatFrame.z >= SoftwareRenderer::NEAR_PLANE) &&
+				(flatFrame.z <= SoftwareRenderer::FAR_PLANE);
+
+			if (inPlanes)
+			{
+				// Add the flat data to the draw list.
+				visibleFlats.push_back(VisibleFlat(flat, std::move(flatFrame)));
+			}
+		}
 	}
 }
 
@@ -5853,148 +9367,214 @@ void SoftwareRenderer::drawFlats(int startX, int endX, const Camera &camera,
 	}
 }
 
-void SoftwareRenderer::renderThreadLoop(RenderThreadData &threadData, int threadIndex, int startX,
-	int endX, int startY, int endY)
+void SoftwareRenderer::reconstructColumns(int startX, int endX, bool useHistory,
+	uint32_t *columnHistory, const FrameView &frame)
+{
+	for (int y = 0; y < frame.height; y++)
+	{
+		uint32_t *colors = frame.colorBuffer + (y * frame.width);
+		uint32_t *historyColors = columnHistory + (y * frame.width);
+
+		for (int x = startX; x < endX; x++)
+		{
+			if (frame.isColumnDrawn(x))
+			{
+				historyColors[x] = colors[x];
+			}
+			else if (useHistory)
+			{
+				colors[x] = historyColors[x];
+			}
+			else
+			{
+				// Average the two neighboring columns, which were both drawn. Each channel
+				// is halved first so they can't overflow into each other.
+				const uint32_t left = colors[(x > 0) ? (x - 1) : (x + 1)];
+				const uint32_t right = colors[((x + 1) < frame.width) ? (x + 1) : (x - 1)];
+				colors[x] = (((left & 0xFEFEFEFE) >> 1) + ((right & 0xFEFEFEFE) >> 1)) |
+					(left & 0xFF000000);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::renderThreadLoop(RenderThreadData &threadData, int threadIndex)
 {
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Gets seconds elapsed since the given time point.
+	auto getSecondsSince = [](const Clock::time_point &start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	};
+
+	// Only the first render thread records when phases start. All threads leave a barrier
+	// at nearly the same time, so one is enough.
+	auto recordPhaseStart = [&threadData, threadIndex](int phase)
+	{
+		if (threadIndex == 0)
+		{
+			threadData.phaseStarts[phase] = Clock::now();
+		}
+	};
+
 	while (true)
 	{
-		// Initial wait condition. The lock must be unlocked after wait() so other threads can
-		// lock it.
-		std::unique_lock<std::mutex> lk(threadData.mutex);
-		threadData.condVar.wait(lk, [&threadData]() { return threadData.go; });
-		lk.unlock();
+		// Wait for the main thread to start a frame.
+		threadData.frameBarrier.wait();
 
-		// Received a go signal. Check if the renderer is being destroyed before doing anything.
+		// Check if the renderer is being destroyed before doing anything.
 		if (threadData.isDestructing)
 		{
 			break;
 		}
 
-		// Draw this thread's portion of the sky gradient.
-		RenderThreadData::SkyGradient &skyGradient = threadData.skyGradient;
-		SoftwareRenderer::drawSkyGradient(startY, endY, *threadData.camera,
-			*threadData.shadingInfo, *threadData.frame);
+		recordPhaseStart(0);
 
-		// This thread is done with the sky gradient.
-		lk.lock();
-		skyGradient.threadsDone++;
+		// Time spent drawing this frame. Time spent waiting is derived from it afterwards.
+		double busySeconds = 0.0;
 
-		// If this was the last thread on the sky gradient, notify all to continue.
-		if (skyGradient.threadsDone == threadData.totalThreads)
+		// Draw chunks of the sky gradient until there are none left.
+		RenderThreadData::SkyGradient &skyGradient = threadData.skyGradient;
+		Clock::time_point busyStart = Clock::now();
+		int startY, endY;
+		while (skyGradient.rows.claim(threadIndex, &startY, &endY))
 		{
-			lk.unlock();
-			threadData.condVar.notify_all();
+			SoftwareRenderer::drawSkyGradient(startY, endY, *threadData.camera,
+				*threadData.shadingInfo, *threadData.frame);
 		}
-		else
-		{
-			// Wait for other threads to finish.
-			threadData.condVar.wait(lk, [&threadData, &skyGradient]()
-			{
-				return skyGradient.threadsDone == threadData.totalThreads;
-			});
 
-			lk.unlock();
-		}
+		busySeconds += getSecondsSince(busyStart);
+
+		// Wait for the other threads to finish the sky gradient, and for the main thread to
+		// finish visible distant object testing.
+		threadData.frameBarrier.wait();
+		recordPhaseStart(1);
 
-		// Wait for the visible distant object testing to finish.
+		// Draw chunks of distant sky objects.
 		RenderThreadData::DistantSky &distantSky = threadData.distantSky;
-		lk.lock();
-		threadData.condVar.wait(lk, [&distantSky]() { return distantSky.doneVisTesting; });
-		lk.unlock();
+		busyStart = Clock::now();
+		int startX, endX;
+		while (distantSky.columns.claim(threadIndex, &startX, &endX))
+		{
+			// The sun is behind everything else.
+			SoftwareRenderer::drawDistantSky(startX, endX, distantSky.parallaxSky,
+				*distantSky.visDistantObjs, *threadData.camera, *distantSky.skyTextures,
+				*threadData.shadingInfo, *threadData.frame);
+			SoftwareRenderer::drawSkyPanorama(startX, endX, *distantSky.skyPanorama,
+				*threadData.camera, *threadData.shadingInfo, *threadData.frame);
+		}
 
-		// Draw this thread's portion of distant sky objects.
-		SoftwareRenderer::drawDistantSky(startX, endX, distantSky.parallaxSky,
-			*distantSky.visDistantObjs, *threadData.camera, *distantSky.skyTextures,
-			*threadData.shadingInfo, *threadData.frame);
+		busySeconds += getSecondsSince(busyStart);
 
-		// This thread is done with distant sky objects.
-		lk.lock();
-		distantSky.threadsDone++;
+		// Wait for the other threads to finish distant sky objects.
+		threadData.threadBarrier.wait();
+		recordPhaseStart(2);
 
-		// If this was the last thread on distant sky, notify all to continue.
-		if (distantSky.threadsDone == threadData.totalThreads)
-		{
-			lk.unlock();
-			threadData.condVar.notify_all();
-		}
-		else
+		// Draw chunks of voxels. Some areas of the screen are much more expensive than others
+		// (i.e., looking down a long corridor), so stealing chunks keeps threads busy.
+		RenderThreadData::Voxels &voxels = threadData.voxels;
+		busyStart = Clock::now();
+		while (voxels.columns.claim(threadIndex, &startX, &endX))
 		{
-			// Wait for other threads to finish.
-			threadData.condVar.wait(lk, [&threadData, &distantSky]()
-			{
-				return distantSky.threadsDone == threadData.totalThreads;
-			});
+			SoftwareRenderer::drawVoxels(startX, endX, *threadData.camera,
+				voxels.ceilingHeight, *voxels.openDoors, *voxels.voxelGrid,
+				*voxels.renderVoxelGrid, *voxels.visibility, *voxels.voxelTextures,
+				*voxels.occlusion,
+				*threadData.shadingInfo, *threadData.frame);
+
+			// Floors and ceilings in those columns are drawn a row at a time afterwards.
+			SoftwareRenderer::drawPlaneSpans(startX, endX, *threadData.camera,
+				voxels.ceilingHeight, *voxels.voxelTextures, *threadData.shadingInfo,
+				*threadData.frame);
 
-			lk.unlock();
+			// Summarize the finished columns for hiding flats behind walls.
+			SoftwareRenderer::updateDepthTiles(startX, endX, *threadData.frame);
 		}
 
-		// Number of columns to skip per ray cast (for interleaved ray casting as a means of
-		// load-balancing).
-		const int strideX = threadData.totalThreads;
+		// Help the main thread find visible flats.
+		RenderThreadData::Flats &flats = threadData.flats;
+		int startCell, endCell;
+		while (flats.cells.claim(threadIndex, &startCell, &endCell))
+		{
+			SoftwareRenderer::findVisibleFlats(startCell, endCell, *threadData.camera,
+				threadData.shadingInfo->fogDistance, *flats.visibility, *flats.flats,
+				*flats.flatCells, flats.threadVisibleFlats[threadIndex]);
+		}
 
-		// Draw this thread's portion of voxels.
-		RenderThreadData::Voxels &voxels = threadData.voxels;
-		SoftwareRenderer::drawVoxels(threadIndex, strideX, *threadData.camera,
-			voxels.ceilingHeight, *voxels.openDoors, *voxels.voxelGrid, *voxels.voxelTextures,
-			*voxels.occlusion, *threadData.shadingInfo, *threadData.frame);
+		busySeconds += getSecondsSince(busyStart);
 
-		// This thread is done with voxels.
-		lk.lock();
-		voxels.threadsDone++;
+		// Wait for every thread to finish voxels and visible flats, and then for the main thread
+		// to sort the visible flats.
+		threadData.frameBarrier.wait();
+		threadData.frameBarrier.wait();
+		recordPhaseStart(3);
 
-		// If this was the last thread on voxels, notify all to continue.
-		if (voxels.threadsDone == threadData.totalThreads)
+		// Draw chunks of flats.
+		busyStart = Clock::now();
+		while (flats.columns.claim(threadIndex, &startX, &endX))
 		{
-			lk.unlock();
-			threadData.condVar.notify_all();
+			SoftwareRenderer::drawFlats(startX, endX, *threadData.camera, *flats.flatNormal,
+				*flats.visibleFlats, *flats.flatTextures, *threadData.shadingInfo,
+				*threadData.frame);
 		}
-		else
+
+		busySeconds += getSecondsSince(busyStart);
+
+		// If only every other column was drawn, fill in the rest once all the drawn ones are
+		// finished, since skipped columns might be blended from other threads' chunks.
+		if (threadData.frame->columnStep > 1)
 		{
-			// Wait for other threads to finish.
-			threadData.condVar.wait(lk, [&threadData, &voxels]()
+			threadData.threadBarrier.wait();
+
+			RenderThreadData::Reconstruction &reconstruction = threadData.reconstruction;
+			busyStart = Clock::now();
+			while (reconstruction.columns.claim(threadIndex, &startX, &endX))
 			{
-				return voxels.threadsDone == threadData.totalThreads;
-			});
+				SoftwareRenderer::reconstructColumns(startX, endX, reconstruction.useHistory,
+					reconstruction.columnHistory, *threadData.frame);
+			}
 
-			lk.unlock();
+			busySeconds += getSecondsSince(busyStart);
 		}
 
-		// Wait for the visible flat sorting to finish.
-		RenderThreadData::Flats &flats = threadData.flats;
-		lk.lock();
-		threadData.condVar.wait(lk, [&flats]() { return flats.doneSorting; });
-		lk.unlock();
+		// This thread is done with flats. Its busy time is saved before arriving so the main
+		// thread can read it once every thread is done.
+		threadData.busySeconds[threadIndex] = busySeconds;
+		threadData.frameBarrier.wait();
+	}
+}
 
-		// Draw this thread's portion of flats.
-		SoftwareRenderer::drawFlats(startX, endX, *threadData.camera, *flats.flatNormal,
-			*flats.visibleFlats, *flats.flatTextures, *threadData.shadingInfo, *threadData.frame);
+void SoftwareRenderer::frameThreadLoop()
+{
+	PipelinedFrame &pipelinedFrame = this->pipelinedFrame;
 
-		// This thread is done with flats.
-		lk.lock();
-		flats.threadsDone++;
+	while (true)
+	{
+		// Wait for the main thread to start a frame.
+		pipelinedFrame.startBarrier.wait();
 
-		// If this was the last thread on flats, notify all to continue.
-		if (flats.threadsDone == threadData.totalThreads)
+		if (pipelinedFrame.isDestructing)
 		{
-			lk.unlock();
-			threadData.condVar.notify_all();
+			break;
 		}
-		else
-		{
-			// Wait for other threads to finish.
-			threadData.condVar.wait(lk, [&threadData, &flats]()
-			{
-				return flats.threadsDone == threadData.totalThreads;
-			});
 
-			lk.unlock();
-		}
+		this->renderFrame(pipelinedFrame.eye, pipelinedFrame.direction, pipelinedFrame.fovY,
+			pipelinedFrame.ambient, pipelinedFrame.daytimePercent, pipelinedFrame.parallaxSky,
+			pipelinedFrame.paletteShading, pipelinedFrame.mipmapping,
+			pipelinedFrame.interleavedColumns, pipelinedFrame.ceilingHeight,
+			*pipelinedFrame.openDoors, *pipelinedFrame.voxelGrid,
+			pipelinedFrame.colorBuffer.data());
+
+		// Wait for the main thread to take the frame.
+		pipelinedFrame.doneBarrier.wait();
 	}
 }
 
-void SoftwareRenderer::render(const Double3 &eye, const Double3 &direction, double fovY,
-	double ambient, double daytimePercent, bool parallaxSky, double ceilingHeight,
-	const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
+void SoftwareRenderer::renderFrame(const Double3 &eye, const Double3 &direction, double fovY,
+	double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
 	uint32_t *colorBuffer)
 {
 	// Constants for screen dimensions.
@@ -6013,67 +9593,279 @@ void SoftwareRenderer::render(const Double3 &eye, const Double3 &direction, doub
 
 	// Calculate shading information for this frame. Create some helper structs to keep similar
 	// values together.
-	const ShadingInfo shadingInfo(this->skyPalette, daytimePercent, ambient, this->fogDistance);
-	const FrameView frame(colorBuffer, this->depthBuffer.data(), this->width, this->height);
+	const ShadingInfo shadingInfo(this->skyPalette, daytimePercent, ambient, this->fogDistance,
+		paletteShading ? &this->colormap : nullptr, mipmapping, this->lights, this->lightGrid,
+		this->lightmap);
+
+	// When interleaving, each frame draws the columns the previous one skipped. The skipped
+	// ones can be taken from the previous frame if the camera has barely moved or turned.
+	// Otherwise they are blended from their neighbors.
+	const bool interleaved = interleavedColumns && (this->width > 1);
+	const int columnStep = interleaved ? 2 : 1;
+	const int columnParity = interleaved ? (this->historyColumnParity ^ 1) : 0;
+	bool useColumnHistory = false;
+	if (interleaved)
+	{
+		if (this->columnHistoryValid)
+		{
+			const double columnAngle = (2.0 * camera.aspect / camera.zoom) / widthReal;
+			const double turnAngle = std::acos(std::min(
+				camera.direction.normalized().dot(this->historyDirection), 1.0));
+			const double moveDistance = (eye - this->historyEye).length();
+			useColumnHistory = (turnAngle <= columnAngle) &&
+				(moveDistance <= SoftwareRenderer::COLUMN_HISTORY_MAX_DISTANCE);
+		}
+
+		this->columnHistory.resize(this->width * this->height);
+		this->historyEye = eye;
+		this->historyDirection = camera.direction.normalized();
+		this->historyColumnParity = columnParity;
+	}
+
+	this->columnHistoryValid = interleaved;
+
+	const FrameView frame(colorBuffer, this->depthBuffer.data(), this->depthTiles.data(),
+		this->planeIDs.data(), this->width, this->height, columnStep, columnParity);
+
+	// Refresh the palette colors for this frame's light and fog if they are being used.
+	if (paletteShading)
+	{
+		this->colormap.update(this->texturePalette, shadingInfo.ambient, shadingInfo.sunColor,
+			shadingInfo.getFogColor());
+	}
+
+	// The voxel grid is normally baked when its level becomes active. If it wasn't, bake it
+	// now so the voxel drawers never read past the end of the render voxels.
+	if (!this->renderVoxelGrid.matches(voxelGrid))
+	{
+		this->renderVoxelGrid.init(voxelGrid);
+		this->lightGrid.init(voxelGrid.getWidth(), voxelGrid.getDepth(), this->lights);
+	}
+
+	// See which parts of the level the camera could see from where it is, if the level has
+	// a visible set.
+	this->visibility.update(eye, this->fogDistance, voxelGrid, openDoors, this->voxelTextures);
 
 	// Set all the render-thread-specific shared data for this frame.
-	this->threadData.init(static_cast<int>(this->renderThreads.size()),
-		camera, shadingInfo, frame);
-	this->threadData.skyGradient.init();
-	this->threadData.distantSky.init(parallaxSky, this->visDistantObjs, this->skyTextures);
-	this->threadData.voxels.init(ceilingHeight, openDoors, voxelGrid,
-		this->voxelTextures, this->occlusion);
-	this->threadData.flats.init(flatNormal, this->visibleFlats, this->flatTextures);
-
-	// Give the render threads the go signal. They can work on the sky and voxels while this thread
-	// does things like resetting occlusion and doing visible flat determination.
-	// - Note about locks: they must always be locked before wait(), and stay locked after wait().
-	std::unique_lock<std::mutex> lk(this->threadData.mutex);
-	this->threadData.go = true;
-	lk.unlock();
-	this->threadData.condVar.notify_all();
+	const int threadCount = static_cast<int>(this->renderThreads.size());
+	this->threadData.init(threadCount, camera, shadingInfo, frame);
+	this->threadData.skyGradient.init(threadCount, this->height);
+	this->threadData.distantSky.init(threadCount, this->width, parallaxSky,
+		this->visDistantObjs, this->skyTextures, this->skyPanorama);
+	this->threadData.voxels.init(threadCount, this->width, ceilingHeight, openDoors,
+		voxelGrid, this->renderVoxelGrid, this->visibility, this->voxelTextures, this->occlusion);
+	this->threadData.flats.init(threadCount, this->width, flatNormal, this->visibility,
+		this->flats, this->flatCells, this->visibleFlats, this->flatTextures);
+	this->threadData.reconstruction.init(threadCount, this->width, this->columnHistory.data(),
+		useColumnHistory);
+
+	// Start timing the render threads' work so their idle time can be found.
+	const auto frameStart = std::chrono::high_resolution_clock::now();
+
+	// Start the render threads. They can work on the sky and voxels while this thread does
+	// things like resetting occlusion and doing visible flat determination.
+	this->threadData.frameBarrier.wait();
 
 	// Reset occlusion.
 	std::fill(this->occlusion.begin(), this->occlusion.end(), OcclusionData(0, this->height));
 
 	// Refresh the visible distant objects.
+	const auto visibleDistantObjectsStart = std::chrono::high_resolution_clock::now();
 	this->updateVisibleDistantObjects(parallaxSky, shadingInfo.sunDirection, camera, frame);
+	this->updateSkyPanorama(parallaxSky, camera, frame);
+	const auto visibleDistantObjectsEnd = std::chrono::high_resolution_clock::now();
+
+	// Let the render threads start drawing distant objects once the sky gradient is done.
+	this->threadData.frameBarrier.wait();
+
+	// Find visible flats in chunks of flat grid cells. Render threads help with any that are
+	// left once they finish voxels.
+	RenderThreadData::Flats &flatsData = this->threadData.flats;
+	const auto visibleFlatsStart = std::chrono::high_resolution_clock::now();
+	int startCell, endCell;
+	while (flatsData.cells.claim(threadCount, &startCell, &endCell))
+	{
+		SoftwareRenderer::findVisibleFlats(startCell, endCell, camera, shadingInfo.fogDistance,
+			this->visibility, this->flats, this->flatCells,
+			flatsData.threadVisibleFlats[threadCount]);
+	}
+
+	const auto visibleFlatsEnd = std::chrono::high_resolution_clock::now();
 
-	lk.lock();
-	this->threadData.condVar.wait(lk, [this]()
+	// Wait for the render threads to finish voxels and their visible flat chunks.
+	this->threadData.frameBarrier.wait();
+
+	// Gather and sort the visible flats.
+	const auto sortFlatsStart = std::chrono::high_resolution_clock::now();
+	this->updateVisibleFlats();
+	const auto sortFlatsEnd = std::chrono::high_resolution_clock::now();
+
+	// Let the render threads start drawing flats.
+	this->threadData.frameBarrier.wait();
+
+	// Wait until render threads are done drawing flats.
+	this->threadData.frameBarrier.wait();
+
+	// Any time a render thread wasn't drawing, it was waiting on other threads or on this
+	// thread's visibility work.
+	const auto frameEnd = std::chrono::high_resolution_clock::now();
+	const double frameSeconds = std::chrono::duration<double>(frameEnd - frameStart).count();
+
+	for (size_t i = 0; i < this->frameThreadStats.size(); i++)
 	{
-		return this->threadData.skyGradient.threadsDone == this->threadData.totalThreads;
-	});
+		RenderThreadStats &stats = this->frameThreadStats[i];
+		stats.busySeconds = this->threadData.busySeconds[i];
+		stats.idleSeconds = std::max(frameSeconds - stats.busySeconds, 0.0);
+	}
 
-	// Keep the render threads from getting the go signal again before the next frame.
-	this->threadData.go = false;
+	// Each phase ends when the next one starts.
+	const auto &phaseStarts = this->threadData.phaseStarts;
+	auto getPhaseSeconds = [](const std::chrono::high_resolution_clock::time_point &start,
+		const std::chrono::high_resolution_clock::time_point &end)
+	{
+		return std::chrono::duration<double>(end - start).count();
+	};
 
-	// Let the render threads know that they can start drawing distant objects.
-	this->threadData.distantSky.doneVisTesting = true;
+	PhaseTimings &timings = this->framePhaseTimings;
+	timings.skyGradient = getPhaseSeconds(phaseStarts[0], phaseStarts[1]);
+	timings.distantSky = getPhaseSeconds(phaseStarts[1], phaseStarts[2]);
+	timings.voxels = getPhaseSeconds(phaseStarts[2], phaseStarts[3]);
+	timings.flats = getPhaseSeconds(phaseStarts[3], frameEnd);
+	timings.visibleDistantObjects = getPhaseSeconds(
+		visibleDistantObjectsStart, visibleDistantObjectsEnd);
+	timings.visibleFlats = getPhaseSeconds(visibleFlatsStart, visibleFlatsEnd) +
+		getPhaseSeconds(sortFlatsStart, sortFlatsEnd);
+}
 
-	lk.unlock();
-	this->threadData.condVar.notify_all();
+void SoftwareRenderer::render(const Double3 &eye, const Double3 &direction, double fovY,
+	double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+	uint32_t *colorBuffer)
+{
+	// A pipelined frame would be out of date by the time it's taken, so throw it away.
+	this->waitForFrame();
+	this->pipelinedFrame.isFinished = false;
+	this->takeBuiltVisibility();
+	this->updateLightmapDoors(openDoors);
+	this->takeBakedLightmap();
+	this->updateLastFrame(eye, direction, fovY, ambient, daytimePercent, parallaxSky,
+		paletteShading, mipmapping, interleavedColumns, ceilingHeight, openDoors);
+
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->renderFrame(eye, direction, fovY, ambient, daytimePercent, parallaxSky,
+		paletteShading, mipmapping, interleavedColumns, ceilingHeight, openDoors, voxelGrid,
+		colorBuffer);
+
+	this->renderThreadStats = this->frameThreadStats;
+	this->phaseTimings = this->framePhaseTimings;
+	this->frameLatency = std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now() - startTime).count();
+}
 
-	// Refresh the visible flats. This should erase the old list, calculate a new list, and sort
-	// it by depth.
-	this->updateVisibleFlats(camera);
+void SoftwareRenderer::beginFrame(const Double3 &eye, const Double3 &direction, double fovY,
+	double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid)
+{
+	PipelinedFrame &pipelinedFrame = this->pipelinedFrame;
+	DebugAssertMsg(!pipelinedFrame.isDrawing, "A pipelined frame is already being drawn.");
+	this->takeBuiltVisibility();
+	this->updateLightmapDoors(openDoors);
+	this->takeBakedLightmap();
+	this->updateLastFrame(eye, direction, fovY, ambient, daytimePercent, parallaxSky,
+		paletteShading, mipmapping, interleavedColumns, ceilingHeight, openDoors);
+
+	// Copy the world state so the caller can change it while the frame is drawn. Assigning
+	// reuses the existing allocations after the first frame.
+	if (pipelinedFrame.openDoors == nullptr)
+	{
+		pipelinedFrame.openDoors = std::make_unique<LevelData::OpenDoors>(openDoors);
+	}
+	else
+	{
+		*pipelinedFrame.openDoors = openDoors;
+	}
 
-	lk.lock();
-	this->threadData.condVar.wait(lk, [this]()
+	if (pipelinedFrame.voxelGrid == nullptr)
 	{
-		return this->threadData.voxels.threadsDone == this->threadData.totalThreads;
-	});
+		pipelinedFrame.voxelGrid = std::make_unique<VoxelGrid>(voxelGrid);
+	}
+	else
+	{
+		*pipelinedFrame.voxelGrid = voxelGrid;
+	}
 
-	// Let the render threads know that they can start drawing flats.
-	this->threadData.flats.doneSorting = true;
+	pipelinedFrame.colorBuffer.resize(this->width * this->height);
+	pipelinedFrame.eye = eye;
+	pipelinedFrame.direction = direction;
+	pipelinedFrame.fovY = fovY;
+	pipelinedFrame.ambient = ambient;
+	pipelinedFrame.daytimePercent = daytimePercent;
+	pipelinedFrame.ceilingHeight = ceilingHeight;
+	pipelinedFrame.parallaxSky = parallaxSky;
+	pipelinedFrame.paletteShading = paletteShading;
+	pipelinedFrame.mipmapping = mipmapping;
+	pipelinedFrame.interleavedColumns = interleavedColumns;
+	pipelinedFrame.startTime = std::chrono::high_resolution_clock::now();
+	pipelinedFrame.isDrawing = true;
+	pipelinedFrame.isFinished = false;
+
+	// Start the frame thread if this is the first pipelined frame.
+	if (!this->frameThread.joinable())
+	{
+		this->frameThread = std::thread(&SoftwareRenderer::frameThreadLoop, this);
+	}
 
-	lk.unlock();
-	this->threadData.condVar.notify_all();
+	pipelinedFrame.startBarrier.wait();
+}
 
-	// Wait until render threads are done drawing flats.
-	lk.lock();
-	this->threadData.condVar.wait(lk, [this]()
+const uint32_t *SoftwareRenderer::finishFrame()
+{
+	PipelinedFrame &pipelinedFrame = this->pipelinedFrame;
+	DebugAssertMsg(this->isFramePending(), "No pipelined frame to finish.");
+
+	this->waitForFrame();
+	pipelinedFrame.isFinished = false;
+	return pipelinedFrame.colorBuffer.data();
+}
+
+bool SoftwareRenderer::reuseFrame(const Double3 &eye, const Double3 &direction, double fovY,
+	double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+	bool mipmapping, bool interleavedColumns, double ceilingHeight,
+	const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid)
+{
+	// A pipelined frame might still be reading the voxels and the last frame's state.
+	this->waitForFrame();
+
+	const ShadingInfo shadingInfo(this->skyPalette, daytimePercent, ambient, this->fogDistance,
+		nullptr, mipmapping, this->lights, this->lightGrid, this->lightmap);
+
+	// Interleaved frames fill in the other half of their columns on the next frame. A baked
+	// lightmap waiting to be used changes the frame too.
+	const int requiredDrawnCount = interleavedColumns ? 2 : 1;
+	const LightmapBuild &lightmapBuild = this->lightmapBuild;
+	const bool isLightmapWaiting = (lightmapBuild.lightmap != nullptr) &&
+		(lightmapBuild.remainingThreads == 0);
+	const bool isSame = (this->lastFrame.drawnCount >= requiredDrawnCount) &&
+		!isLightmapWaiting &&
+		this->renderVoxelGrid.matches(voxelGrid) &&
+		this->matchesLastFrame(eye, direction, fovY, shadingInfo, parallaxSky, paletteShading,
+			mipmapping, interleavedColumns, ceilingHeight, openDoors);
+
+	if (!isSame)
 	{
-		return this->threadData.flats.threadsDone == this->threadData.totalThreads;
-	});
+		return false;
+	}
+
+	// Nothing was drawn for this frame. A finished pipelined frame is still shown, so its
+	// timings are kept.
+	this->skippedFrameCount++;
+	if (!this->isFramePending())
+	{
+		this->phaseTimings = PhaseTimings();
+	}
+
+	return true;
 }
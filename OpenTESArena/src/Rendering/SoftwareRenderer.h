@@ -2,9 +2,10 @@
 #define SOFTWARE_RENDERER_H
 
 #include <array>
-#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
-#include <mutex>
+#include <memory>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -13,57 +14,113 @@
 #include "../Math/Vector2.h"
 #include "../Math/Vector3.h"
 #include "../Math/Vector4.h"
+#include "../Utilities/Barrier.h"
 #include "../World/DistantSky.h"
 #include "../World/LevelData.h"
 #include "../World/VoxelData.h"
+#include "../World/VoxelGrid.h"
 
 // This class runs the CPU-based 3D rendering for the application.
 
-class VoxelGrid;
-
 class SoftwareRenderer
 {
+public:
+	// How long a render thread spent drawing versus waiting on other threads in a frame.
+	struct RenderThreadStats
+	{
+		double busySeconds, idleSeconds;
+
+		RenderThreadStats();
+	};
+
+	// Seconds each phase of a frame took, from when the render threads started it until they
+	// all finished it. The sky gradient and voxel phases include waiting for the visible
+	// distant objects and visible flats, respectively, which are also timed on their own.
+	struct PhaseTimings
+	{
+		double skyGradient, distantSky, voxels, flats;
+		double visibleDistantObjects, visibleFlats;
+
+		PhaseTimings();
+	};
 private:
+	// Texels are stored as packed 8-bit channels so the whole texture set stays small
+	// enough to remain in cache. They are converted to floating-point during shading.
 	struct VoxelTexel
 	{
-		double r, g, b, emission;
-		bool transparent; // Voxel texels only support alpha testing, not alpha blending.
+		static const uint8_t FLAG_EMISSIVE = 1 << 0;
+		static const uint8_t FLAG_TRANSPARENT = 1 << 1; // Voxel texels only support alpha testing.
+
+		uint8_t r, g, b;
+		uint8_t flags;
 
 		VoxelTexel();
+		VoxelTexel(uint8_t r, uint8_t g, uint8_t b, uint8_t flags);
+
+		// Emission is either fully on or off (i.e., for night lights).
+		bool isEmissive() const;
+		bool isTransparent() const;
 	};
 
 	struct FlatTexel
 	{
-		double r, g, b, a;
+		uint8_t r, g, b, a;
 
 		FlatTexel();
+		FlatTexel(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 	};
 
 	// For distant sky objects (mountains, clouds, etc.).
 	struct SkyTexel
 	{
-		double r, g, b;
+		uint8_t r, g, b;
 		bool transparent;
 
 		SkyTexel();
+		SkyTexel(uint8_t r, uint8_t g, uint8_t b, bool transparent);
 	};
 
+	// Voxel and flat texels are stored column by column (index = y + (x * height)), since
+	// both are drawn one screen column at a time down a single texel column. Each texture
+	// is followed by its mip levels, each half the size of the one before, down to 1x1.
 	struct VoxelTexture
 	{
 		static const int WIDTH = 64;
 		static const int HEIGHT = VoxelTexture::WIDTH;
 		static const int TEXEL_COUNT = VoxelTexture::WIDTH * VoxelTexture::HEIGHT;
+		static const int MIP_LEVEL_COUNT = 7;
+		static const int MIP_TEXEL_COUNT = (VoxelTexture::TEXEL_COUNT * 4) / 3; // All levels.
 
-		std::array<VoxelTexel, VoxelTexture::TEXEL_COUNT> texels;
+		std::array<VoxelTexel, VoxelTexture::MIP_TEXEL_COUNT> texels;
+		std::array<uint8_t, VoxelTexture::MIP_TEXEL_COUNT> indexedTexels; // For palette shading.
 		std::vector<Int2> lightTexels; // Black during the day, yellow at night.
+		bool hasTransparentTexels; // Whether anything behind it can be seen through it.
+
+		// Gets the index of the first texel in the given mip level.
+		static int getMipOffset(int level);
+
+		// Recalculates every mip level after the first from the full-size texels.
+		void updateMips();
 	};
 
 	struct FlatTexture
 	{
 		std::vector<FlatTexel> texels;
+		std::vector<uint8_t> indexedTexels; // For palette shading.
+		std::vector<int> mipOffsets; // Index of the first texel in each mip level.
 		int width, height;
 
 		FlatTexture();
+
+		// Gets the dimensions of the given mip level.
+		int getMipWidth(int level) const;
+		int getMipHeight(int level) const;
+
+		// Resizes the texels for a texture of the given size and all of its mip levels.
+		void init(int width, int height);
+
+		// Recalculates every mip level after the first from the full-size texels.
+		void updateMips();
 	};
 
 	struct SkyTexture
@@ -74,6 +131,58 @@ private:
 		SkyTexture();
 	};
 
+	// Palette of every color used by voxel and flat textures, for palette-indexed shading.
+	// Colors are added as textures are set, so Arena's 8-bit art fits without loss.
+	struct TexturePalette
+	{
+		static const int COLOR_COUNT = 256;
+		static const uint8_t TRANSPARENT_INDEX = 0; // Alpha-tested texels.
+		static const uint8_t NIGHT_LIGHT_INDEX = 1; // Always fully bright.
+
+		std::vector<Double3> colors;
+		std::unordered_map<uint32_t, uint8_t> indices; // RGB color to palette index.
+		int version; // Incremented whenever the colors change.
+
+		TexturePalette();
+
+		// Gets the palette index of the given RGB color, adding it to the palette if there
+		// is room. Otherwise, the closest existing color is used.
+		uint8_t getIndex(uint32_t rgb);
+
+		// Removes all colors except the reserved ones.
+		void clear();
+	};
+
+	// Shaded and fogged ARGB colors for every texture palette index at some number of light
+	// and fog levels, so shading a palette-indexed texel is a single look-up.
+	struct Colormap
+	{
+		static const int LIGHT_LEVELS = 16;
+		static const int FOG_LEVELS = 32;
+
+		std::vector<uint32_t> colors;
+
+		// Values the colors were last calculated with.
+		Double3 sunColor, fogColor;
+		double ambient;
+		int paletteVersion;
+
+		Colormap();
+
+		// Gets the light level closest to the given sun contribution (0 to 1).
+		static int getLightLevel(double lightNormalDot);
+
+		// Gets the fog level closest to the given fog percent (0 to 1).
+		static int getFogLevel(double fogPercent);
+
+		// Gets the row of palette colors for some light and fog level.
+		const uint32_t *getColors(int lightLevel, int fogLevel) const;
+
+		// Recalculates the colors if the palette or any of the shading values changed.
+		void update(const TexturePalette &palette, double ambient, const Double3 &sunColor,
+			const Double3 &fogColor);
+	};
+
 	// Camera for 2.5D ray casting (with some pre-calculated values to avoid duplicating work).
 	struct Camera
 	{
@@ -114,10 +223,12 @@ private:
 	// define in screen space.
 	struct DrawRange
 	{
+		Double3 startPoint, endPoint; // World points that were projected, for lighting.
 		double yProjStart, yProjEnd;
 		int yStart, yEnd;
 
-		DrawRange(double yProjStart, double yProjEnd, int yStart, int yEnd);
+		DrawRange(const Double3 &startPoint, const Double3 &endPoint, double yProjStart,
+			double yProjEnd, int yStart, int yEnd);
 	};
 
 	// Occlusion defines a "drawing window" that shrinks as opaque pixels are drawn in each 
@@ -150,6 +261,228 @@ private:
 		Double3 normal;
 	};
 
+	// Compact copy of a voxel's data with only what the voxel drawers need. Voxel textures
+	// are limited to a few dozen, so their IDs fit in a byte.
+	struct RenderVoxel
+	{
+		static const uint8_t FLAG_DIAGONAL_TYPE1 = 1 << 0; // Diagonal is '/'.
+		static const uint8_t FLAG_EDGE_FLIPPED = 1 << 1;
+		static const uint8_t FLAG_CHASM_NORTH = 1 << 2;
+		static const uint8_t FLAG_CHASM_EAST = 1 << 3;
+		static const uint8_t FLAG_CHASM_SOUTH = 1 << 4;
+		static const uint8_t FLAG_CHASM_WEST = 1 << 5;
+
+		VoxelDataType dataType;
+		uint8_t textureID; // Side texture of walls and raised platforms, or the only texture.
+		uint8_t floorID, ceilingID; // Top and bottom textures of walls and raised platforms.
+		uint8_t subtype; // Edge facing, chasm type, or door type.
+		uint8_t flags;
+		uint16_t shapeIndex; // Raised platform or edge heights in the render voxel shapes.
+
+		RenderVoxel();
+
+		// Creates a render voxel from a voxel's data. Shapes are looked up by the voxel's ID.
+		static RenderVoxel make(const VoxelData &voxelData, uint16_t voxelID);
+
+		VoxelData::Facing getEdgeFacing() const;
+		VoxelData::ChasmData::Type getChasmType() const;
+		VoxelData::DoorData::Type getDoorType() const;
+		bool chasmFaceIsVisible(VoxelData::Facing facing) const;
+	};
+
+	// Heights of raised platforms and edges, which are too big to keep in every render voxel.
+	struct RenderVoxelShape
+	{
+		double yOffset, ySize, vTop, vBottom;
+
+		RenderVoxelShape();
+	};
+
+	// The voxel grid baked into render voxels when a level becomes active, and kept up to
+	// date as voxels change. Each XZ column's voxels are next to each other from bottom to
+	// top, so drawing a column reads one small run of memory instead of going through each
+	// voxel's ID into the voxel data.
+	struct RenderVoxelGrid
+	{
+		std::vector<RenderVoxel> voxels;
+		std::vector<RenderVoxelShape> shapes; // Indexed by voxel ID.
+		const VoxelGrid *voxelGrid; // Grid the voxels were baked from.
+		int width, height, depth;
+
+		RenderVoxelGrid();
+
+		// Bakes every voxel in the given grid.
+		void init(const VoxelGrid &voxelGrid);
+
+		// Bakes one voxel again after it changed in the given grid.
+		void update(int x, int y, int z, const VoxelGrid &voxelGrid);
+
+		// Returns whether the voxels were baked from the given grid and it still has the same
+		// dimensions.
+		bool matches(const VoxelGrid &voxelGrid) const;
+
+		// Gets the bottom voxel of an XZ column. The rest of the column follows it.
+		const RenderVoxel *getColumn(int x, int z) const;
+	};
+
+	// Potentially visible set for levels that are mostly walls, like interiors. The level is
+	// split into blocks the size of the voxel grid's blocks, and each block has a bit for
+	// every block that might be seen from somewhere inside it. Doors count as open in those
+	// bits. Closed doors are handled each frame with rooms, which are areas of voxel columns
+	// that can only see each other through doors. Each door is a room of its own.
+	struct VisibilityGrid
+	{
+		// A room that's a door. The rooms past it are hidden while it's closed, unless its
+		// texture can be seen through.
+		struct Door
+		{
+			int x, z, textureID;
+		};
+
+		static const int NO_ROOM;
+
+		std::vector<uint32_t> blockBits; // Bits of the blocks visible from each block.
+		std::vector<int> rooms; // Room of each voxel column, or NO_ROOM if it's solid.
+		std::vector<std::vector<int>> roomNeighbors; // Rooms next to each room.
+		std::vector<int> roomDoors; // Index into doors for each room, or -1 if it's not a door.
+		std::vector<Door> doors;
+		std::vector<bool> visibleRooms; // Rooms that might be visible in the current frame.
+		std::vector<int> roomQueue; // Rooms waiting to be searched when finding visible rooms.
+		double maxDistance; // Fog distance it was built for.
+		int width, depth; // Voxel columns.
+		int blockWidth, blockDepth, blockRowSize; // Blocks, and words of bits per block.
+		int cameraBlock; // Block the camera is in for the current frame.
+		bool isActive; // Whether anything is culled in the current frame.
+
+		VisibilityGrid();
+
+		// Finds the rooms and visible blocks of the given voxels, looking no farther than the
+		// given distance. Returns false if it was cancelled before finishing.
+		bool init(const RenderVoxelGrid &voxelGrid, double maxDistance,
+			const std::atomic<bool> &isCancelled);
+
+		// Finds the rooms the camera might see through open doors for a new frame. Nothing is
+		// culled if the camera is outside the grid or the fog is farther than it was built for.
+		void update(const Double3 &eye, double fogDistance, const VoxelGrid &voxelGrid,
+			const LevelData::OpenDoors &openDoors, const std::vector<VoxelTexture> &voxelTextures);
+
+		// Returns whether anything in the given voxel column might be visible in the current
+		// frame. The column must be in the grid.
+		bool isColumnVisible(int x, int z) const;
+
+		// Returns whether any part of the given XZ circle might be visible in the current frame.
+		bool isCircleVisible(const Double2 &center, double radius) const;
+	};
+
+	// A point light, like a torch or a spell. Its color fades smoothly with distance and is
+	// gone at its intensity, in world units.
+	struct Light
+	{
+		Double3 point, color;
+		double intensity;
+		int id;
+
+		Light(int id, const Double3 &point, const Double3 &color, double intensity);
+
+		// Gets the voxel columns the light reaches, clamped to a grid of the given size.
+		// Returns false if it doesn't reach any of them. End values are exclusive.
+		bool getVoxelRange(int gridWidth, int gridDepth, int *startX, int *endX,
+			int *startZ, int *endZ) const;
+	};
+
+	// Lists of the lights reaching each voxel column, so shading a pixel only goes through
+	// the few lights near it. When a light changes, it's only taken out of and put into the
+	// columns it reaches instead of rebuilding the whole grid.
+	struct LightGrid
+	{
+		std::vector<std::vector<int>> cells; // Indices into the lights list for each column.
+		int width, depth;
+
+		LightGrid();
+
+		// Sets the grid to the given size and adds every light to it.
+		void init(int width, int depth, const std::vector<Light> &lights);
+
+		// Adds a light to every column it reaches.
+		void addLight(int lightIndex, const Light &light);
+
+		// Removes a light from every column it reached.
+		void removeLight(int lightIndex, const Light &light);
+
+		// Changes a light's index in every column it reaches, for when the lights list is
+		// packed after a removal.
+		void moveLight(int oldIndex, int newIndex, const Light &light);
+
+		// Gets the lights reaching the voxel column with the given XZ point, or null if
+		// there are none.
+		const std::vector<int> *getLights(const Double2 &point) const;
+	};
+
+	// Light from a level's static lights (torches, candles, etc.), baked when the level
+	// becomes active so drawing only has to look it up. Each face of a voxel is lit from
+	// inside the voxel, so a wall gets its light from the empty voxel in front of it, and
+	// solid voxels and closed doors block light. Faces have a few samples per side to interpolate between,
+	// and only voxels in columns that a static light reaches have any.
+	struct Lightmap
+	{
+		// Samples along each side of a face, including both corners.
+		static const int SAMPLES_PER_SIDE;
+
+		// Faces are ordered +X, -X, +Y, -Y, +Z, -Z by the normal of the surfaces they light.
+		static const int FACE_COUNT;
+
+		static const int NO_SAMPLES;
+
+		// Distance a surface point is moved along its normal to be in the voxel in front of
+		// the surface, in voxel units.
+		static const double SURFACE_OFFSET;
+
+		std::vector<int> voxelOffsets; // Start of each voxel's samples, or NO_SAMPLES.
+		std::vector<float> samples; // RGB light of each sample.
+		std::vector<int> openDoorColumns; // Sorted XZ voxel indices of doors that aren't closed.
+		double ceilingHeight; // Height of each voxel in world units.
+		int width, height, depth;
+
+		Lightmap();
+
+		// Sets aside samples for each voxel that isn't solid in the columns the given lights
+		// reach. The samples are black until baked. Door voxels in the open door columns
+		// aren't solid.
+		void init(const RenderVoxelGrid &voxelGrid, const LightGrid &lightGrid,
+			const std::vector<int> &openDoorColumns, double ceilingHeight);
+
+		// Bakes the samples of every voxel column from the start X to the end of the grid,
+		// stepping by some number of columns so each thread can bake its own. Stops early if
+		// cancelled.
+		void bake(const RenderVoxelGrid &voxelGrid, const std::vector<Light> &lights,
+			const LightGrid &lightGrid, int startX, int stepX,
+			const std::atomic<bool> &isCancelled);
+
+		// Returns whether any voxel has samples in the column in front of the surface at the
+		// given XZ point with the given normal.
+		bool hasLight(const Double2 &point, const Double3 &normal) const;
+
+		// Gets the baked light at a point on a surface with the given normal.
+		Double3 getLight(const Double3 &point, const Double3 &normal) const;
+
+		// Returns whether the voxel of the given type in the given XZ column is solid, so it
+		// blocks light and has no inside to be lit. Doors are solid while they're closed.
+		bool isSolid(VoxelDataType dataType, int x, int z) const;
+	};
+
+	// Lights reaching a voxel column, looked up once for each column or span drawn instead
+	// of for every pixel.
+	struct ColumnLights
+	{
+		const std::vector<int> *lightIndices; // Point lights, or null if none reach it.
+		bool isBaked; // Whether the lightmap has light in the column.
+
+		ColumnLights();
+
+		// Returns whether any light reaches the column, so its pixels need light added.
+		bool isLit() const;
+	};
+
 	// Helper struct for keeping shading data organized in the renderer. These values are
 	// computed once per frame.
 	struct ShadingInfo
@@ -175,10 +508,57 @@ private:
 		// Returns whether the current clock time is before noon.
 		bool isAM;
 
+		// Color look-ups for palette-indexed shading, or null if shading in true color.
+		const Colormap *colormap;
+
+		// Whether voxels and flats are sampled from the mip level closest to one texel
+		// per pixel instead of always from the full-size texture.
+		bool mipmapping;
+
+		// Point lights and the voxel columns they reach.
+		const std::vector<Light> *lights;
+		const LightGrid *lightGrid;
+
+		// Light baked from static lights, or null if there isn't any.
+		const Lightmap *lightmap;
+
 		ShadingInfo(const std::vector<Double3> &skyPalette, double daytimePercent,
-			double ambient, double fogDistance);
+			double ambient, double fogDistance, const Colormap *colormap, bool mipmapping,
+			const std::vector<Light> &lights, const LightGrid &lightGrid,
+			const Lightmap *lightmap);
 
 		const Double3 &getFogColor() const;
+
+		// Returns whether there are any lights, for skipping look-ups when there aren't.
+		bool hasLights() const;
+
+		// Gets the lights reaching the voxel column with the given XZ point, on a surface
+		// with the given normal.
+		ColumnLights getLights(const Double2 &point, const Double3 &normal) const;
+
+		// Adds up the color of a column's lights at a point on a surface with the given
+		// normal.
+		Double3 getLightColor(const Double3 &point, const Double3 &normal,
+			const ColumnLights &columnLights) const;
+	};
+
+	// Values the last frame was drawn with, for telling whether the next frame would look
+	// the same so the last one can be shown again.
+	struct LastFrame
+	{
+		std::vector<LevelData::DoorState> doors; // Copies of the open doors.
+		std::vector<int> animIndices; // Frame of each animated distant land object.
+		std::array<Double3, ShadingInfo::SKY_COLOR_COUNT> skyColors;
+		Double3 eye, direction, sunColor, sunDirection;
+		double fovY, ambient, ceilingHeight;
+		int drawnCount; // Frames in a row drawn with about these values, or 0 if reset.
+		bool parallaxSky, paletteShading, mipmapping, interleavedColumns;
+
+		LastFrame();
+
+		// Forgets the last frame so the next one is drawn. Anything that changes the scene
+		// must do this.
+		void reset();
 	};
 
 	// Helper struct for values related to the frame buffer. The pointers are owned
@@ -187,10 +567,56 @@ private:
 	{
 		uint32_t *colorBuffer;
 		double *depthBuffer;
-		int width, height;
+		double *depthTiles; // Max depth of each tile, one column wide, after voxels are drawn.
+		uint16_t *planeIDs; // Floor and ceiling pixels waiting to be drawn in rows, or 0.
+		int width, height, depthTileRows;
+		int columnStep; // 2 if only every other column is drawn, otherwise 1.
+		int columnParity; // Parity of the columns that are drawn if the step is 2.
 		double widthReal, heightReal;
 
-		FrameView(uint32_t *colorBuffer, double *depthBuffer, int width, int height);
+		FrameView(uint32_t *colorBuffer, double *depthBuffer, double *depthTiles,
+			uint16_t *planeIDs, int width, int height, int columnStep, int columnParity);
+
+		// Returns whether the given column is drawn this frame.
+		bool isColumnDrawn(int x) const;
+
+		// Gets the first column drawn this frame at or after the given column.
+		int getFirstDrawnColumn(int x) const;
+
+		// Gets the max depth in a column over the given rows, according to the depth tiles.
+		// Anything farther than this is hidden in those rows. The end Y value is exclusive.
+		double getMaxTileDepth(int x, int startY, int endY) const;
+	};
+
+	// Helper struct for gathering visible texels so they can be shaded several at a time by
+	// the vectorized shading kernels. Light and fog color are constant for the batch, except
+	// for point lights, which are added to each texel they reach.
+	struct ShadingBatch
+	{
+		static const int MAX_COUNT = 64;
+
+		std::array<uint32_t, MAX_COUNT> texels; // Packed with ShadingKernels::packTexel().
+		std::array<double, MAX_COUNT> fogPercents;
+		// Point light color by channel, only used once a lit texel is added.
+		std::array<double, MAX_COUNT> lightR, lightG, lightB;
+		std::array<int, MAX_COUNT> indices; // Color buffer indices.
+		std::array<uint32_t, MAX_COUNT> colors;
+		const Double3 &shading, &fogColor;
+		uint32_t *colorBuffer;
+		int count;
+		bool isLit; // Whether any texel in the batch has light from point lights.
+
+		ShadingBatch(const Double3 &shading, const Double3 &fogColor, uint32_t *colorBuffer);
+
+		// Adds a texel to be drawn at the given color buffer index. The batch is flushed
+		// when it fills up.
+		void add(uint32_t texel, double fogPercent, int index);
+
+		// Same as add() but for a texel that point lights reach.
+		void addLit(uint32_t texel, double fogPercent, int index, const Double3 &lightColor);
+
+		// Shades any remaining texels and writes them to the color buffer.
+		void flush();
 	};
 
 	// A flat is a 2D surface always facing perpendicular to the Y axis, and opposite to
@@ -199,7 +625,8 @@ private:
 	{
 		Double3 position; // Center of bottom edge.
 		double width, height;
-		int textureID;
+		int id, textureID;
+		int cellIndex; // Flat grid cell the flat's position is in.
 		bool flipped;
 
 		// A flat's frame consists of their four corner points in world space, and some
@@ -233,6 +660,17 @@ private:
 		const Flat::Frame &getFrame() const;
 	};
 
+	// A square of a uniform grid over the XZ plane, holding the flats whose positions are
+	// in it. Cells outside the view frustum are skipped without looking at their flats.
+	struct FlatCell
+	{
+		std::vector<int> flatIndices; // Indices into the flats list.
+		Double2 center;
+		double maxHalfWidth; // Half the width of the widest flat that has been in the cell.
+
+		FlatCell(const Double2 &center);
+	};
+
 	// Pairs together a distant sky object with its render texture index. If it's an animation,
 	// then the index points to the start of its textures.
 	struct DistantObject
@@ -283,66 +721,161 @@ private:
 			double xProjEnd, int xStart, int xEnd, bool emissive);
 	};
 
+	// Distant objects (except the sun) drawn once into a cylinder around the camera, so each
+	// frame only copies the visible part instead of sampling every mountain and cloud again.
+	// Columns are evenly spaced XZ angles, and rows are pixels relative to the horizon since
+	// looking up or down only moves the horizon. Texels are stored by column and aren't
+	// shaded, so the time of day can change without rebuilding it.
+	struct SkyPanorama
+	{
+		struct Texel
+		{
+			uint8_t r, g, b;
+			bool opaque, emissive;
+
+			Texel();
+			Texel(uint8_t r, uint8_t g, uint8_t b, bool emissive);
+		};
+
+		std::vector<Texel> texels;
+		std::vector<int> rowStarts, rowEnds; // Rows with opaque texels in each column.
+		std::vector<int> animIndices; // Animated land frames it was drawn with.
+		double columnAngle; // Radians per column.
+		double fovY, aspect; // Camera values it was drawn with.
+		int width, height; // Columns around the cylinder and rows covered by objects.
+		int rowOrigin; // Pixels from the horizon to the top of the first row.
+		int frameWidth, frameHeight; // Frame dimensions it was drawn with.
+		bool parallaxSky;
+		bool dirty; // True if the distant objects changed since it was drawn.
+
+		SkyPanorama();
+	};
+
+	// Hands out chunks of a render phase's rows or columns to render threads. Each thread
+	// starts with its own contiguous range of chunks and steals from other threads' ranges
+	// once its own is empty, so a thread that gets a cheap area of the screen helps with
+	// the expensive ones instead of sitting idle.
+	struct ChunkQueue
+	{
+		// Each thread's range fills its own cache line so claiming a chunk doesn't
+		// invalidate other threads' counters.
+		struct alignas(64) ThreadRange
+		{
+			std::atomic<int> next; // Next unclaimed chunk.
+			int end; // One past the thread's last chunk.
+		};
+
+		// C++14 allocations aren't aligned past std::max_align_t, so the ranges are placed
+		// at the first cache line boundary in this storage.
+		std::unique_ptr<uint8_t[]> rangeStorage;
+		ThreadRange *ranges;
+		int threadCount, chunkSize, size;
+
+		ChunkQueue();
+
+		// Splits the given number of rows or columns into chunks and spreads them evenly
+		// across the threads. This must be done before render threads start the frame.
+		void init(int size, int chunkSize, int threadCount);
+
+		// Gets the start (inclusive) and end (exclusive) of the next chunk for a thread,
+		// taking from its own range first. Returns false when every chunk is claimed.
+		bool claim(int threadIndex, int *start, int *end);
+	};
+
 	// Data owned by the main thread that is referenced by render threads.
 	struct RenderThreadData
 	{
 		struct SkyGradient
 		{
-			int threadsDone;
+			ChunkQueue rows;
 
-			void init();
+			void init(int threadCount, int height);
 		};
 
 		struct DistantSky
 		{
-			int threadsDone;
+			ChunkQueue columns;
 			const std::vector<VisDistantObject> *visDistantObjs;
 			const std::vector<SkyTexture> *skyTextures;
+			const SkyPanorama *skyPanorama;
 			bool parallaxSky;
-			bool doneVisTesting; // True when render threads can start rendering distant sky.
 
-			void init(bool parallaxSky, const std::vector<VisDistantObject> &visDistantObjs,
-				const std::vector<SkyTexture> &skyTextures);
+			void init(int threadCount, int width, bool parallaxSky,
+				const std::vector<VisDistantObject> &visDistantObjs,
+				const std::vector<SkyTexture> &skyTextures, const SkyPanorama &skyPanorama);
 		};
 
 		struct Voxels
 		{
-			int threadsDone;
-			const std::vector<LevelData::DoorState> *openDoors;
+			ChunkQueue columns;
+			const LevelData::OpenDoors *openDoors;
 			const VoxelGrid *voxelGrid;
+			const RenderVoxelGrid *renderVoxelGrid;
+			const VisibilityGrid *visibility;
 			const std::vector<VoxelTexture> *voxelTextures;
 			std::vector<OcclusionData> *occlusion;
 			double ceilingHeight;
 
-			void init(double ceilingHeight, const std::vector<LevelData::DoorState> &openDoors,
-				const VoxelGrid &voxelGrid, const std::vector<VoxelTexture> &voxelTextures,
+			void init(int threadCount, int width, double ceilingHeight,
+				const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+				const RenderVoxelGrid &renderVoxelGrid, const VisibilityGrid &visibility,
+				const std::vector<VoxelTexture> &voxelTextures,
 				std::vector<OcclusionData> &occlusion);
 		};
 
 		struct Flats
 		{
-			int threadsDone;
+			// Flat grid cells are tested for visibility by the main thread during the distant
+			// sky and voxel phases, and by render threads once they finish voxels. The main
+			// thread claims cells with the index after the last render thread.
+			ChunkQueue cells;
+			std::vector<std::vector<VisibleFlat>> threadVisibleFlats;
+			const VisibilityGrid *visibility;
+			const std::vector<Flat> *flats;
+			const std::vector<FlatCell> *flatCells;
+
+			ChunkQueue columns;
 			const Double3 *flatNormal;
 			const std::vector<VisibleFlat> *visibleFlats;
 			const std::vector<FlatTexture> *flatTextures;
-			bool doneSorting; // True when render threads can start rendering flats.
 
-			void init(const Double3 &flatNormal, const std::vector<VisibleFlat> &visibleFlats,
+			void init(int threadCount, int width, const Double3 &flatNormal,
+				const VisibilityGrid &visibility, const std::vector<Flat> &flats,
+				const std::vector<FlatCell> &flatCells, const std::vector<VisibleFlat> &visibleFlats,
 				const std::vector<FlatTexture> &flatTextures);
 		};
 
+		struct Reconstruction
+		{
+			// Columns that weren't drawn this frame are filled in once all the others are done.
+			ChunkQueue columns;
+			uint32_t *columnHistory;
+			bool useHistory;
+
+			void init(int threadCount, int width, uint32_t *columnHistory, bool useHistory);
+		};
+
 		SkyGradient skyGradient;
 		DistantSky distantSky;
 		Voxels voxels;
 		Flats flats;
+		Reconstruction reconstruction;
 		const Camera *camera;
 		const ShadingInfo *shadingInfo;
 		const FrameView *frame;
 
-		std::condition_variable condVar;
-		std::mutex mutex;
+		// Seconds each render thread spent drawing in the current frame. Written by render
+		// threads before they finish their last phase.
+		std::vector<double> busySeconds;
+
+		// When each phase started in the current frame. Written by the first render thread.
+		std::array<std::chrono::high_resolution_clock::time_point, 4> phaseStarts;
+
+		// Phase boundaries. The frame barrier also includes the main thread so it can hand
+		// off visibility results, and the thread barrier is only between render threads.
+		Barrier frameBarrier, threadBarrier;
+
 		int totalThreads;
-		bool go; // Initial go signal to start work each frame.
 		bool isDestructing; // Helps shut down threads in the renderer destructor.
 
 		RenderThreadData();
@@ -351,6 +884,73 @@ private:
 			const FrameView &frame);
 	};
 
+	// A frame drawn by the frame thread while the main thread does other work, like drawing
+	// the UI and presenting the previous frame. The world state is copied when the frame is
+	// started so the caller is free to change it in the meantime.
+	struct PipelinedFrame
+	{
+		std::unique_ptr<LevelData::OpenDoors> openDoors;
+		std::unique_ptr<VoxelGrid> voxelGrid;
+		std::vector<uint32_t> colorBuffer;
+		Double3 eye, direction;
+		double fovY, ambient, daytimePercent, ceilingHeight;
+		bool parallaxSky, paletteShading, mipmapping, interleavedColumns;
+
+		// When the world state was copied, for measuring latency.
+		std::chrono::high_resolution_clock::time_point startTime;
+
+		// The frame thread waits at the start barrier for a new frame, and at the done barrier
+		// until the main thread takes the frame.
+		Barrier startBarrier, doneBarrier;
+
+		bool isDrawing; // True until the main thread has waited for the frame thread.
+		bool isFinished; // True if a finished frame is ready to be taken.
+		bool isDestructing; // Helps shut down the frame thread in the renderer destructor.
+
+		PipelinedFrame();
+	};
+
+	// Builds the visibility grid of the active level on its own thread so entering the level
+	// doesn't wait for it. The main thread takes the grid between frames once it's finished.
+	struct VisibilityBuild
+	{
+		std::thread thread;
+		std::unique_ptr<VisibilityGrid> grid; // Being built, or finished and waiting.
+		std::atomic<bool> isFinished, isCancelled;
+		double maxDistance; // Fog distance it's being built for.
+		bool isRequested; // True if the active level should have a visibility grid.
+
+		VisibilityBuild();
+	};
+
+	// Bakes the lightmap of the active level on worker threads so entering the level doesn't
+	// wait for it. The main thread takes the lightmap between frames once every worker is
+	// done with their columns.
+	struct LightmapBuild
+	{
+		std::vector<std::thread> threads;
+		std::unique_ptr<Lightmap> lightmap; // Being baked, or finished and waiting.
+		RenderVoxelGrid voxelGrid; // Copies of what's being baked, so the level can change.
+		std::vector<Light> lights;
+		LightGrid lightGrid;
+		std::atomic<int> remainingThreads; // Workers still baking.
+		std::atomic<bool> isCancelled;
+		uint64_t key; // Identifies the voxels and lights being baked in the lightmap cache.
+		double ceilingHeight;
+		bool isRequested; // True if the active level's static lights should be baked.
+
+		LightmapBuild();
+	};
+
+	// A baked lightmap kept for when its level is entered again.
+	struct CachedLightmap
+	{
+		Lightmap lightmap;
+		int lastUse; // Lightmap use count when it was last made the active one.
+
+		CachedLightmap();
+	};
+
 	// Clipping planes for Z coordinates.
 	static const double NEAR_PLANE;
 	static const double FAR_PLANE;
@@ -371,18 +971,76 @@ private:
 	// Max angle of distant clouds above the horizon, in degrees.
 	static const double DISTANT_CLOUDS_MAX_ANGLE;
 
+	// Rows and columns per render thread work chunk. Column chunks are wide so neighbouring
+	// threads only share color and depth buffer cache lines at the edges of their chunks.
+	static const int ROW_CHUNK_SIZE;
+	static const int COLUMN_CHUNK_SIZE;
+
+	// Width of flat grid cells in world units, and how many cells are tested for visible
+	// flats at a time by a thread.
+	static const double FLAT_CELL_SIZE;
+	static const int FLAT_CELL_CHUNK_SIZE;
+
+	// Rows per depth tile. Tiles are one column wide so each render thread only touches the
+	// tiles of its own columns.
+	static const int DEPTH_TILE_HEIGHT;
+
+	// How far the camera can move between interleaved frames and still reuse the previous
+	// frame's columns. It can also turn by up to about one column.
+	static const double COLUMN_HISTORY_MAX_DISTANCE;
+
+	// Largest change in a color or light percent that can't be seen in an 8-bit color
+	// channel. Smaller changes in the time of day don't need a new frame.
+	static const double COLOR_PRECISION;
+
+	// Most lightmaps kept for levels that might be entered again.
+	static const int LIGHTMAP_CACHE_SIZE;
+
 	std::vector<double> depthBuffer; // 2D buffer, mostly consists of depth in the XZ plane.
+	std::vector<double> depthTiles; // Max depth of depth buffer tiles for hiding flats.
+	std::vector<uint16_t> planeIDs; // Floor and ceiling pixels waiting to be drawn in rows.
 	std::vector<OcclusionData> occlusion; // Min and max Y for each column.
-	std::unordered_map<int, Flat> flats; // All flats in world.
+	RenderVoxelGrid renderVoxelGrid; // Compact copy of the active level's voxels.
+	VisibilityGrid visibility; // Potentially visible set of the active level, if it has one.
+	std::vector<Flat> flats; // All flats in world, packed together for fast iteration.
+	std::unordered_map<int, int> flatIndices; // Flat IDs mapped to indices in the flats list.
+	std::vector<FlatCell> flatCells; // Flat grid cells that have had a flat in them.
+	std::unordered_map<int64_t, int> flatCellIndices; // Cell coordinates to flat cell indices.
+	std::vector<Light> lights; // All point lights, packed together like flats.
+	std::unordered_map<int, int> lightIndices; // Light IDs mapped to indices in the lights list.
+	LightGrid lightGrid; // Lights reaching each voxel column of the active level.
+	std::vector<Light> staticLights; // Active level's lights that are baked instead.
+	std::vector<int> lightmapDoorColumns; // Sorted XZ voxel indices of open doors when baked.
+	std::unordered_map<uint64_t, CachedLightmap> lightmaps; // Baked lightmaps by key.
+	int lightmapUseCount; // Times a lightmap in the cache has been made the active one.
+	const Lightmap *lightmap; // Active level's lightmap in the cache, or null if not baked.
 	std::vector<VisibleFlat> visibleFlats; // Flats to be drawn.
 	std::vector<DistantObject> distantObjects; // Distant sky objects (mountains, clouds, etc.).
 	std::vector<VisDistantObject> visDistantObjs; // Visible distant sky objects.
+	SkyPanorama skyPanorama; // Distant objects other than the sun, drawn ahead of time.
 	std::vector<VoxelTexture> voxelTextures; // Max 64 voxel textures in original engine.
 	std::vector<FlatTexture> flatTextures; // Max 256 flat textures in original engine.
 	std::vector<SkyTexture> skyTextures; // Distant object textures. Size is managed internally.
 	std::vector<Double3> skyPalette; // Colors for each time of day.
+	TexturePalette texturePalette; // Colors used by voxel and flat textures.
+	Colormap colormap; // Shaded texture palette colors for the current frame.
 	std::vector<std::thread> renderThreads; // Threads used for rendering the world.
 	RenderThreadData threadData; // Managed by main thread, used by render threads.
+	std::vector<RenderThreadStats> renderThreadStats; // Load balance in the last frame.
+	std::vector<RenderThreadStats> frameThreadStats; // Load balance in the frame being drawn.
+	std::vector<uint32_t> columnHistory; // Colors from when each column was last drawn.
+	Double3 historyEye, historyDirection; // Camera of the last interleaved frame.
+	int historyColumnParity; // Parity of the columns drawn in the last interleaved frame.
+	bool columnHistoryValid; // Whether the last frame was interleaved at the current size.
+	PhaseTimings phaseTimings; // Phase durations in the last frame.
+	PhaseTimings framePhaseTimings; // Phase durations in the frame being drawn.
+	std::thread frameThread; // Started on the first pipelined frame.
+	PipelinedFrame pipelinedFrame; // Managed by main thread, used by the frame thread.
+	VisibilityBuild visibilityBuild; // Managed by main thread, used by the build thread.
+	LightmapBuild lightmapBuild; // Managed by main thread, used by the bake threads.
+	LastFrame lastFrame; // For skipping frames that would look the same as the last one.
+	int skippedFrameCount; // Frames not drawn because nothing in them changed.
+	double frameLatency; // Seconds from world state to finished frame in the last frame.
 	double fogDistance; // Distance at which fog is maximum.
 	int sunTextureIndex; // Points into skyTextures if the sun exists, or -1 if it doesn't.
 	int width, height; // Dimensions of frame buffer.
@@ -392,19 +1050,78 @@ private:
 	static int getRenderThreadsFromMode(int mode);
 
 	// Initializes render threads that run in the background for the duration of the renderer's
-	// lifetime. This can also be used to reset threads after a screen resize.
-	void initRenderThreads(int width, int height, int threadCount);
+	// lifetime. This can also be used to reset threads after changing the thread count.
+	void initRenderThreads(int threadCount);
 
 	// Turns off each thread in the render threads list peacefully. The render threads are expected
-	// to be at their initial wait condition before being given the go + destruct signals.
+	// to be waiting at the start of a frame before being given the destruct signal.
 	void resetRenderThreads();
 
-	// Refreshes the list of distant objects to be drawn.
+	// Waits for the frame thread to finish any frame it's drawing. This must be done before
+	// changing anything the frame thread might be reading.
+	void waitForFrame();
+
+	// Starts building the visibility grid for the active level's voxels and the current fog
+	// distance, cancelling any build that's already going.
+	void startVisibilityBuild();
+
+	// Stops the visibility grid build thread, throwing away any grid it was building.
+	void cancelVisibilityBuild();
+
+	// Replaces the visibility grid with the built one if the build thread is finished.
+	void takeBuiltVisibility();
+
+	// Gets the key of the active level's voxels, open doors, and static lights in the
+	// lightmap cache.
+	uint64_t getLightmapKey(double ceilingHeight) const;
+
+	// Bakes the lightmap again if a door has opened or closed since it was baked, since
+	// closed doors block static light.
+	void updateLightmapDoors(const LevelData::OpenDoors &openDoors);
+
+	// Starts baking the active level's static lights on worker threads, cancelling any bake
+	// that's already going. A lightmap in the cache is used right away instead.
+	void startLightmapBake();
+
+	// Stops the lightmap bake threads, throwing away any lightmap they were baking.
+	void cancelLightmapBake();
+
+	// Puts the baked lightmap in the cache and starts using it if every bake thread is done.
+	void takeBakedLightmap();
+
+	// Refreshes the list of distant objects to be drawn each frame. Only the sun is in it
+	// since it moves with the time of day; everything else is in the sky panorama.
 	void updateVisibleDistantObjects(bool parallaxSky, const Double3 &sunDirection,
 		const Camera &camera, const FrameView &frame);
 
-	// Refreshes the list of flats to be drawn.
-	void updateVisibleFlats(const Camera &camera);
+	// Redraws the sky panorama if the distant objects, animated land frames, or camera
+	// settings it depends on have changed.
+	void updateSkyPanorama(bool parallaxSky, const Camera &camera, const FrameView &frame);
+
+	// Gets the frame of each animated distant land object, in distant object order.
+	void getAnimIndices(std::vector<int> *animIndices) const;
+
+	// Returns whether a frame drawn with the given values would look the same as the last
+	// one, to within what a pixel or an 8-bit color channel can show.
+	bool matchesLastFrame(const Double3 &eye, const Double3 &direction, double fovY,
+		const ShadingInfo &shadingInfo, bool parallaxSky, bool paletteShading, bool mipmapping,
+		bool interleavedColumns, double ceilingHeight, const LevelData::OpenDoors &openDoors) const;
+
+	// Remembers the values a frame is being drawn with.
+	void updateLastFrame(const Double3 &eye, const Double3 &direction, double fovY,
+		double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+		bool mipmapping, bool interleavedColumns, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors);
+
+	// Puts a flat in the grid cell its position is in, creating the cell if needed.
+	void addFlatToCell(int flatIndex);
+
+	// Takes a flat out of its grid cell.
+	void removeFlatFromCell(int flatIndex);
+
+	// Refreshes the list of flats to be drawn from each thread's visible flats, sorting them
+	// by depth.
+	void updateVisibleFlats();
 	
 	// Gets the facing value for the far side of a chasm.
 	static VoxelData::Facing getInitialChasmFarFacing(int voxelX, int voxelZ,
@@ -412,10 +1129,6 @@ private:
 	static VoxelData::Facing getChasmFarFacing(int voxelX, int voxelZ,
 		VoxelData::Facing nearFacing, const Camera &camera, const Ray &ray);
 
-	// Gets the percent open of a door, or zero if there's no open door at the given voxel.
-	static double getDoorPercentOpen(int voxelX, int voxelZ,
-		const std::vector<LevelData::DoorState> &openDoors);
-
 	// Calculates the projected Y coordinate of a 3D point given a transform and Y-shear value.
 	static double getProjectedY(const Double3 &point, const Matrix4d &transform, double yShear);
 
@@ -425,6 +1138,13 @@ private:
 	static int getLowerBoundedPixel(double projected, int frameDim);
 	static int getUpperBoundedPixel(double projected, int frameDim);
 
+	// Gets the number of rows of depth tiles needed for the given frame height.
+	static int getDepthTileRows(int frameHeight);
+
+	// Gets the mip level with the closest to one texel per pixel, given how many texels of
+	// the full-size texture a pixel covers.
+	static int getMipLevel(double texelsPerPixel, int levelCount);
+
 	// Generates a vertical draw range on-screen from two vertices in world space.
 	static DrawRange makeDrawRange(const Double3 &startPoint, const Double3 &endPoint,
 		const Camera &camera, const FrameView &frame);
@@ -506,6 +1226,13 @@ private:
 		const VoxelTexture &texture, const ShadingInfo &shadingInfo, OcclusionData &occlusion,
 		const FrameView &frame);
 
+	// Marks a column of pixels on a horizontal plane at the given voxel boundary (Y level
+	// times ceiling height) for drawing later in rows by drawPlaneSpans(). Pixels already
+	// marked by nearer planes are kept. Only full-height floors and ceilings go through here;
+	// raised platforms and chasms are drawn with drawPerspectivePixels().
+	static void drawPlanePixels(int x, const DrawRange &drawRange, int planeY, int textureID,
+		OcclusionData &occlusion, const FrameView &frame);
+
 	// Draws a column of pixels with transparency but no perspective.
 	static void drawTransparentPixels(int x, const DrawRange &drawRange, double depth, double u,
 		double vStart, double vEnd, const Double3 &normal, const VoxelTexture &texture,
@@ -521,17 +1248,19 @@ private:
 	static void drawInitialVoxelColumn(int x, int voxelX, int voxelZ, const Camera &camera,
 		const Ray &ray, VoxelData::Facing facing, const Double2 &nearPoint,
 		const Double2 &farPoint, double nearZ, double farZ, const ShadingInfo &shadingInfo,
-		double ceilingHeight, const std::vector<LevelData::DoorState> &openDoors,
-		const VoxelGrid &voxelGrid, const std::vector<VoxelTexture> &textures,
-		OcclusionData &occlusion, const FrameView &frame);
+		double ceilingHeight, const LevelData::OpenDoors &openDoors,
+		const VoxelGrid &voxelGrid, const RenderVoxelGrid &renderVoxelGrid,
+		const std::vector<VoxelTexture> &textures, OcclusionData &occlusion,
+		const FrameView &frame);
 
 	// Manages drawing voxels in the column of the given XZ coordinate in the voxel grid.
 	static void drawVoxelColumn(int x, int voxelX, int voxelZ, const Camera &camera,
 		const Ray &ray, VoxelData::Facing facing, const Double2 &nearPoint,
 		const Double2 &farPoint, double nearZ, double farZ, const ShadingInfo &shadingInfo,
-		double ceilingHeight, const std::vector<LevelData::DoorState> &openDoors,
-		const VoxelGrid &voxelGrid, const std::vector<VoxelTexture> &textures,
-		OcclusionData &occlusion, const FrameView &frame);
+		double ceilingHeight, const LevelData::OpenDoors &openDoors,
+		const VoxelGrid &voxelGrid, const RenderVoxelGrid &renderVoxelGrid,
+		const std::vector<VoxelTexture> &textures, OcclusionData &occlusion,
+		const FrameView &frame);
 
 	// Draws the portion of a flat contained within the given X range of the screen. The end
 	// X value is exclusive.
@@ -546,40 +1275,81 @@ private:
 	// in the XZ column of each voxel.
 	static void rayCast2D(int x, const Camera &camera, const Ray &ray,
 		const ShadingInfo &shadingInfo, double ceilingHeight,
-		const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+		const RenderVoxelGrid &renderVoxelGrid, const VisibilityGrid &visibility,
 		const std::vector<VoxelTexture> &textures, OcclusionData &occlusion,
 		const FrameView &frame);
 
-	// Draws a portion of the sky gradient. The start and end Y are determined from current
-	// threading settings.
+	// Draws some rows of the sky gradient.
 	static void drawSkyGradient(int startY, int endY, const Camera &camera, 
 		const ShadingInfo &shadingInfo, const FrameView &frame);
 
-	// Draws some columns of distant sky objects (mountains, clouds, etc.). The start and end X
-	// are determined from current threading settings.
+	// Copies the visible part of the sky panorama into some columns, shading it for the
+	// current time of day.
+	static void drawSkyPanorama(int startX, int endX, const SkyPanorama &skyPanorama,
+		const Camera &camera, const ShadingInfo &shadingInfo, const FrameView &frame);
+
+	// Draws some columns of distant sky objects (mountains, clouds, etc.).
 	static void drawDistantSky(int startX, int endX, bool parallaxSky,
 		const std::vector<VisDistantObject> &visDistantObjs, const Camera &camera,
 		const std::vector<SkyTexture> &skyTextures, const ShadingInfo &shadingInfo,
 		const FrameView &frame);
 
-	// Handles drawing all voxels for the current frame.
-	static void drawVoxels(int startX, int stride, const Camera &camera, double ceilingHeight,
-		const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
+	// Draws some columns of voxels.
+	static void drawVoxels(int startX, int endX, const Camera &camera, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+		const RenderVoxelGrid &renderVoxelGrid, const VisibilityGrid &visibility,
 		const std::vector<VoxelTexture> &voxelTextures, std::vector<OcclusionData> &occlusion,
 		const ShadingInfo &shadingInfo, const FrameView &frame);
 
-	// Handles drawing all flats for the current frame.
+	// Draws the floor and ceiling pixels marked by drawPlanePixels() in some columns one row
+	// at a time. The distance to a plane is constant along a row, so texture coordinates are
+	// stepped linearly across each span of pixels with the same plane and texture.
+	static void drawPlaneSpans(int startX, int endX, const Camera &camera, double ceilingHeight,
+		const std::vector<VoxelTexture> &voxelTextures, const ShadingInfo &shadingInfo,
+		const FrameView &frame);
+
+	// Updates the depth tiles of some columns from the depth buffer. Flats only make the
+	// depth buffer nearer, so the tiles stay valid while flats are drawn.
+	static void updateDepthTiles(int startX, int endX, const FrameView &frame);
+
+	// Adds the flats in some flat grid cells that are in the camera's view to the given list.
+	// Flats entirely past the fog distance or in parts of the level that can't be seen are
+	// left out like voxels are.
+	static void findVisibleFlats(int startCell, int endCell, const Camera &camera,
+		double fogDistance, const VisibilityGrid &visibility, const std::vector<Flat> &flats,
+		const std::vector<FlatCell> &flatCells, std::vector<VisibleFlat> &visibleFlats);
+
+	// Draws some columns of flats.
 	static void drawFlats(int startX, int endX, const Camera &camera, const Double3 &flatNormal,
 		const std::vector<VisibleFlat> &visibleFlats, const std::vector<FlatTexture> &flatTextures,
 		const ShadingInfo &shadingInfo, const FrameView &frame);
 
+	// Fills in some columns that weren't drawn this frame, either from the column history
+	// or by blending their neighbors, and saves the ones that were drawn to the history.
+	static void reconstructColumns(int startX, int endX, bool useHistory,
+		uint32_t *columnHistory, const FrameView &frame);
+
 	// Thread loop for each render thread. All threads are initialized in the constructor and
-	// wait for a go signal at the beginning of each render(). If the renderer is destructing,
-	// then each render thread still gets a go signal, but they immediately leave their loop
-	// and terminate. Non-thread-data parameters are for start/end column/row for each thread.
-	static void renderThreadLoop(RenderThreadData &threadData, int threadIndex, int startX,
-		int endX, int startY, int endY);
+	// wait at the frame barrier at the beginning of each render(). If the renderer is
+	// destructing, then each render thread still passes the barrier, but they immediately
+	// leave their loop and terminate. Each phase's rows or columns are claimed in chunks from
+	// the thread data.
+	static void renderThreadLoop(RenderThreadData &threadData, int threadIndex);
+
+	// Thread loop for the frame thread, which draws pipelined frames with the render threads
+	// on behalf of the main thread.
+	void frameThreadLoop();
+
+	// Draws the scene to the output color buffer. Called by the main thread for regular
+	// frames and by the frame thread for pipelined frames.
+	void renderFrame(const Double3 &eye, const Double3 &direction, double fovY,
+		double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+		bool mipmapping, bool interleavedColumns, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
+		uint32_t *colorBuffer);
 public:
+
 	SoftwareRenderer();
 	~SoftwareRenderer();
 
@@ -588,15 +1358,42 @@ public:
 
 	bool isInited() const;
 
+	// Gets the busy and idle time of each render thread in the last frame.
+	const std::vector<RenderThreadStats> &getRenderThreadStats() const;
+
+	// Gets how long each phase took in the last frame.
+	const PhaseTimings &getPhaseTimings() const;
+
+	// Gets the seconds between the world state being given to the renderer and the frame
+	// being finished, for the last frame. Pipelined frames add the time the frame waits to
+	// be taken.
+	double getFrameLatency() const;
+
+	// Returns whether a pipelined frame has been started and not yet taken.
+	bool isFramePending() const;
+
+	// Gets how many frames reuseFrame() has let the caller skip.
+	int getSkippedFrameCount() const;
+
 	// Sets the render threads mode to use (low, medium, high, etc.).
 	void setRenderThreadsMode(int mode);
 
+	// Sets an exact number of render threads instead of deriving it from the render threads
+	// mode. Intended for benchmarking.
+	void setRenderThreadCount(int threadCount);
+
 	// Adds a flat. Causes an error if the ID exists.
 	void addFlat(int id, const Double3 &position, double width, double height, int textureID);
 
-	// Adds a light. Causes an error if the ID exists.
+	// Adds a point light that reaches as far as its intensity, in world units. Causes an
+	// error if the ID exists.
 	void addLight(int id, const Double3 &point, const Double3 &color, double intensity);
 
+	// Adds a light that never changes to the active level, like a torch. It's baked into the
+	// lightmap by bakeLightmap() instead of being added to each pixel. Static lights are
+	// cleared when the voxel grid is set.
+	void addStaticLight(const Double3 &point, const Double3 &color, double intensity);
+
 	// Updates various data for a flat. If a value doesn't need updating, pass null.
 	// Causes an error if no ID matches.
 	void updateFlat(int id, const Double3 *position, const double *width, 
@@ -610,6 +1407,32 @@ public:
 	// Sets the distance at which the fog is maximum.
 	void setFogDistance(double fogDistance);
 
+	// Bakes the voxel grid of the level becoming active. Voxels that change in it afterwards
+	// must be given to updateVoxel().
+	void setVoxelGrid(const VoxelGrid &voxelGrid);
+
+	// Bakes a voxel again after it changed in the active level's voxel grid. Does nothing
+	// for other grids, since they're baked when their level becomes active.
+	void updateVoxel(int x, int y, int z, const VoxelGrid &voxelGrid);
+
+	// Starts building a potentially visible set of the active level's voxels in the
+	// background, for culling parts of the level hidden behind walls and closed doors. It's
+	// meant for interiors, which are mostly walls. It's used once it's finished, and built
+	// again if the fog distance or a voxel changes.
+	void buildVisibility();
+
+	// Waits for the potentially visible set to finish building and starts using it.
+	void waitForVisibility();
+
+	// Starts baking the active level's static lights into its voxel faces on a few worker
+	// threads. The lightmap is used once it's finished, and baked again if a voxel changes or
+	// a door opens or closes. A level baked before with the same voxels, open doors, and
+	// lights reuses its lightmap.
+	void bakeLightmap(double ceilingHeight);
+
+	// Waits for the lightmap to finish baking and starts using it.
+	void waitForLightmap();
+
 	// Sets textures for the distant sky (mountains, clouds, etc.).
 	void setDistantSky(const DistantSky &distantSky);
 
@@ -647,11 +1470,39 @@ public:
 	// Resizes the frame buffer and related values.
 	void resize(int width, int height);
 
-	// Draws the scene to the output color buffer in ARGB8888 format.
+	// Draws the scene to the output color buffer in ARGB8888 format. If palette shading is
+	// true, voxels and flats are shaded with precomputed palette colors instead. If mipmapping
+	// is true, distant voxels and flats are sampled from smaller textures. If interleaved
+	// columns is true, only every other column is drawn each frame, and the rest come from
+	// the previous frame if the camera is still, or from their neighbors otherwise.
 	void render(const Double3 &eye, const Double3 &direction, double fovY,
-		double ambient, double daytimePercent, bool parallaxSky, double ceilingHeight,
-		const std::vector<LevelData::DoorState> &openDoors, const VoxelGrid &voxelGrid,
+		double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+		bool mipmapping, bool interleavedColumns, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid,
 		uint32_t *colorBuffer);
+
+	// Starts drawing a pipelined frame on the frame thread from a copy of the given state,
+	// and returns immediately. Any pending frame must have been taken with finishFrame().
+	void beginFrame(const Double3 &eye, const Double3 &direction, double fovY,
+		double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+		bool mipmapping, bool interleavedColumns, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid);
+
+	// Waits for the pipelined frame to finish and returns its pixels in ARGB8888 format. They
+	// are valid until the next call to beginFrame() or resize().
+	const uint32_t *finishFrame();
+
+	// Returns whether a frame drawn from the given state would look the same as the last
+	// frame given to render() or beginFrame(), in which case the caller can show that frame
+	// again instead of drawing a new one, and it's counted as skipped. The camera, open doors,
+	// voxels, and animated distant objects must be the same. Changes in the time of day and
+	// ambient light too small to show are allowed. Interleaved frames are only reused once
+	// both halves of their columns have been drawn from the same state. Waits for any
+	// pipelined frame to finish first.
+	bool reuseFrame(const Double3 &eye, const Double3 &direction, double fovY,
+		double ambient, double daytimePercent, bool parallaxSky, bool paletteShading,
+		bool mipmapping, bool interleavedColumns, double ceilingHeight,
+		const LevelData::OpenDoors &openDoors, const VoxelGrid &voxelGrid);
 };
 
 #endif
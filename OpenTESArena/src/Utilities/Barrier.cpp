@@ -0,0 +1,87 @@
+#include <cassert>
+#include <thread>
+
+#include "Barrier.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Tells the CPU the current thread is in a spin loop, so it can save power and give
+	// more resources to a sibling hyper-thread.
+	void pause()
+	{
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+		_mm_pause();
+#endif
+	}
+}
+
+const int Barrier::SPIN_COUNT = 4096;
+
+Barrier::Barrier()
+	: Barrier(1) { }
+
+Barrier::Barrier(int threadCount)
+{
+	this->init(threadCount);
+}
+
+void Barrier::init(int threadCount)
+{
+	assert(threadCount > 0);
+
+	this->threadCount = threadCount;
+	this->remaining.store(threadCount);
+	this->generation.store(0);
+
+	// Spinning only helps if every thread can be running at once. Otherwise it takes CPU
+	// time away from the threads that haven't arrived yet.
+	const int coreCount = static_cast<int>(std::thread::hardware_concurrency());
+	this->spinCount = ((coreCount > 0) && (threadCount <= coreCount)) ? Barrier::SPIN_COUNT : 0;
+}
+
+int Barrier::getThreadCount() const
+{
+	return this->threadCount;
+}
+
+void Barrier::wait()
+{
+	const int currentGeneration = this->generation.load(std::memory_order_acquire);
+
+	if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// Last thread to arrive. Reset the count for the next generation before releasing
+		// the others, because they might call wait() again immediately.
+		this->remaining.store(this->threadCount, std::memory_order_relaxed);
+
+		// The generation changes while locked so a thread that is about to sleep can't miss
+		// the notification.
+		std::unique_lock<std::mutex> lk(this->mutex);
+		this->generation.fetch_add(1, std::memory_order_release);
+		lk.unlock();
+		this->condVar.notify_all();
+		return;
+	}
+
+	// Spin for a short time, hoping the other threads arrive soon.
+	for (int i = 0; i < this->spinCount; i++)
+	{
+		if (this->generation.load(std::memory_order_acquire) != currentGeneration)
+		{
+			return;
+		}
+
+		pause();
+	}
+
+	// Sleep until the last thread arrives.
+	std::unique_lock<std::mutex> lk(this->mutex);
+	this->condVar.wait(lk, [this, currentGeneration]()
+	{
+		return this->generation.load(std::memory_order_acquire) != currentGeneration;
+	});
+}
@@ -0,0 +1,41 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Synchronization point for a fixed number of threads. Each thread that arrives waits until
+// every thread has arrived, and then they all continue. The barrier can be waited on again
+// right away, so a group of threads can step through several phases of work with it.
+
+// Waiting threads spin briefly before sleeping, since phases of parallel work usually end
+// close together and waking a sleeping thread is much slower than noticing a flag change.
+
+class Barrier
+{
+private:
+	// Number of checks a waiting thread makes before going to sleep.
+	static const int SPIN_COUNT;
+
+	std::mutex mutex;
+	std::condition_variable condVar;
+	std::atomic<int> remaining; // Threads yet to arrive in the current generation.
+	std::atomic<int> generation; // Incremented each time every thread has arrived.
+	int threadCount;
+	int spinCount;
+public:
+	Barrier();
+	Barrier(int threadCount);
+
+	// Sets the number of threads the barrier waits for. Must not be called while any
+	// threads are waiting.
+	void init(int threadCount);
+
+	int getThreadCount() const;
+
+	// Blocks until every thread has called wait() for the current generation.
+	void wait();
+};
+
+#endif
@@ -480,6 +480,26 @@ void DistantSky::init(int localCityID, int provinceID, WeatherType weatherType,
 	this->sunSurface = &textureManager.getSurface(String::toUppercase(sunFilename));
 }
 
+void DistantSky::addLandObject(const LandObject &landObject)
+{
+	this->landObjects.push_back(landObject);
+}
+
+void DistantSky::addAnimatedLandObject(AnimatedLandObject &&animLandObject)
+{
+	this->animLandObjects.push_back(std::move(animLandObject));
+}
+
+void DistantSky::addAirObject(const AirObject &airObject)
+{
+	this->airObjects.push_back(airObject);
+}
+
+void DistantSky::setSunSurface(const Surface &surface)
+{
+	this->sunSurface = &surface;
+}
+
 void DistantSky::tick(double dt)
 {
 	// Only animated distant land needs updating.
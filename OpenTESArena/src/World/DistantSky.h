@@ -111,6 +111,13 @@ public:
 	void init(int localCityID, int provinceID, WeatherType weatherType, int currentDay,
 		const MiscAssets &miscAssets, TextureManager &textureManager);
 
+	// Methods for building a distant sky without game data (i.e., for benchmarks). Each
+	// object's surface must outlive the distant sky.
+	void addLandObject(const LandObject &landObject);
+	void addAnimatedLandObject(AnimatedLandObject &&animLandObject);
+	void addAirObject(const AirObject &airObject);
+	void setSunSurface(const Surface &surface);
+
 	void tick(double dt);
 };
 
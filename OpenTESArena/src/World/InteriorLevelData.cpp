@@ -232,4 +232,7 @@ void InteriorLevelData::setActive(TextureManager &textureManager, Renderer &rend
 
 	// Set interior sky color.
 	renderer.setSkyPalette(&this->skyColor, 1);
+
+	// Interiors are mostly walls, so it's worth culling what's behind them.
+	renderer.buildVisibility();
 }
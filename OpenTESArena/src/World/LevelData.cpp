@@ -58,6 +58,22 @@ void LevelData::TextTrigger::setPreviouslyDisplayed(bool previouslyDisplayed)
 	this->previouslyDisplayed = previouslyDisplayed;
 }
 
+LevelData::StaticLight::StaticLight(const Int2 &voxel, int intensity)
+	: voxel(voxel)
+{
+	this->intensity = intensity;
+}
+
+const Int2 &LevelData::StaticLight::getVoxel() const
+{
+	return this->voxel;
+}
+
+int LevelData::StaticLight::getIntensity() const
+{
+	return this->intensity;
+}
+
 LevelData::DoorState::DoorState(const Int2 &voxel, double percentOpen,
 	DoorState::Direction direction)
 	: voxel(voxel)
@@ -120,9 +136,101 @@ void LevelData::DoorState::update(double dt)
 	}
 }
 
+LevelData::OpenDoors::OpenDoors(int width, int depth)
+	: doorIndices(width * depth, -1)
+{
+	this->width = width;
+	this->depth = depth;
+}
+
+int LevelData::OpenDoors::getVoxelIndex(int x, int z) const
+{
+	return x + (z * this->width);
+}
+
+int LevelData::OpenDoors::getCount() const
+{
+	return static_cast<int>(this->doors.size());
+}
+
+LevelData::DoorState &LevelData::OpenDoors::get(int index)
+{
+	return this->doors.at(index);
+}
+
+const LevelData::DoorState &LevelData::OpenDoors::get(int index) const
+{
+	return this->doors.at(index);
+}
+
+LevelData::DoorState *LevelData::OpenDoors::find(const Int2 &voxel)
+{
+	const int doorIndex = this->doorIndices[this->getVoxelIndex(voxel.x, voxel.y)];
+	return (doorIndex >= 0) ? &this->doors[doorIndex] : nullptr;
+}
+
+const LevelData::DoorState *LevelData::OpenDoors::find(const Int2 &voxel) const
+{
+	const int doorIndex = this->doorIndices[this->getVoxelIndex(voxel.x, voxel.y)];
+	return (doorIndex >= 0) ? &this->doors[doorIndex] : nullptr;
+}
+
+double LevelData::OpenDoors::getPercentOpen(int x, int z) const
+{
+	const int doorIndex = this->doorIndices[this->getVoxelIndex(x, z)];
+	return (doorIndex >= 0) ? this->doors[doorIndex].getPercentOpen() : 0.0;
+}
+
+void LevelData::OpenDoors::add(const DoorState &door)
+{
+	const Int2 &voxel = door.getVoxel();
+	DebugAssertMsg((voxel.x >= 0) && (voxel.x < this->width) && (voxel.y >= 0) &&
+		(voxel.y < this->depth), "Door voxel (" + voxel.toString() + ") out of range.");
+
+	int &doorIndex = this->doorIndices[this->getVoxelIndex(voxel.x, voxel.y)];
+	DebugAssertMsg(doorIndex < 0, "Door at (" + voxel.toString() + ") is already open.");
+
+	doorIndex = static_cast<int>(this->doors.size());
+	this->doors.push_back(door);
+}
+
+void LevelData::OpenDoors::remove(int index)
+{
+	const Int2 &voxel = this->doors.at(index).getVoxel();
+	this->doorIndices[this->getVoxelIndex(voxel.x, voxel.y)] = -1;
+
+	// Move the last door into the removed one's place so the list stays packed.
+	const int lastIndex = static_cast<int>(this->doors.size()) - 1;
+	if (index != lastIndex)
+	{
+		const DoorState &lastDoor = this->doors[lastIndex];
+		const Int2 &lastVoxel = lastDoor.getVoxel();
+		this->doorIndices[this->getVoxelIndex(lastVoxel.x, lastVoxel.y)] = index;
+		this->doors[index] = lastDoor;
+	}
+
+	this->doors.pop_back();
+}
+
+void LevelData::OpenDoors::clear()
+{
+	// Only the voxels with open doors need resetting.
+	for (const DoorState &door : this->doors)
+	{
+		const Int2 &voxel = door.getVoxel();
+		this->doorIndices[this->getVoxelIndex(voxel.x, voxel.y)] = -1;
+	}
+
+	this->doors.clear();
+}
+
 LevelData::LevelData(int gridWidth, int gridHeight, int gridDepth, const std::string &infName,
 	const std::string &name)
-	: voxelGrid(gridWidth, gridHeight, gridDepth), inf(infName), name(name) { }
+	: voxelGrid(gridWidth, gridHeight, gridDepth), inf(infName),
+	openDoors(gridWidth, gridDepth), name(name)
+{
+	this->renderer = nullptr;
+}
 
 LevelData::~LevelData()
 {
@@ -139,12 +247,12 @@ double LevelData::getCeilingHeight() const
 	return static_cast<double>(this->inf.getCeiling().height) / MIFFile::ARENA_UNITS;
 }
 
-std::vector<LevelData::DoorState> &LevelData::getOpenDoors()
+LevelData::OpenDoors &LevelData::getOpenDoors()
 {
 	return this->openDoors;
 }
 
-const std::vector<LevelData::DoorState> &LevelData::getOpenDoors() const
+const LevelData::OpenDoors &LevelData::getOpenDoors() const
 {
 	return this->openDoors;
 }
@@ -173,6 +281,12 @@ const LevelData::Lock *LevelData::getLock(const Int2 &voxel) const
 void LevelData::setVoxel(int x, int y, int z, uint16_t id)
 {
 	this->voxelGrid.setVoxel(x, y, z, id);
+
+	// The renderer ignores the change if another level has been set active since.
+	if (this->renderer != nullptr)
+	{
+		this->renderer->updateVoxel(x, y, z, this->voxelGrid);
+	}
 }
 
 void LevelData::readFLOR(const uint16_t *flor, const INFFile &inf, int gridWidth, int gridDepth)
@@ -589,7 +703,23 @@ void LevelData::readMAP1(const uint16_t *map1, const INFFile &inf, WorldType wor
 				{
 					// The lower byte determines the index of a FLAT for an object.
 					const uint8_t flatIndex = map1Voxel & 0x00FF;
-					// @todo.
+
+					// Some flats give off light, like torches and candles.
+					if (flatIndex < inf.getFlatCount())
+					{
+						const int *lightIntensity = inf.getFlat(flatIndex).lightIntensity.get();
+						if (lightIntensity != nullptr)
+						{
+							this->staticLights.push_back(
+								LevelData::StaticLight(Int2(x, z), *lightIntensity));
+						}
+					}
+					else
+					{
+						DebugWarning("Invalid FLAT index \"" + std::to_string(flatIndex) + "\".");
+					}
+
+					// @todo: the flat itself.
 				}
 				else if (mostSigNibble == 0x9)
 				{
@@ -848,6 +978,28 @@ void LevelData::setActive(TextureManager &textureManager, Renderer &renderer)
 	renderer.clearTextures();
 	renderer.clearDistantSky();
 
+	// Bake the voxel grid into the renderer's compact copy of it.
+	renderer.setVoxelGrid(this->voxelGrid);
+	this->renderer = &renderer;
+
+	// Bake the light from torches and other static lights into the voxels. It happens in the
+	// background, and a level entered again reuses its lightmap. Lights are in the middle
+	// of the voxel above the floor, and they're all the color of firelight.
+	const double ceilingHeight = this->getCeilingHeight();
+	const Double3 staticLightColor(1.0, 0.85, 0.60);
+	for (const StaticLight &light : this->staticLights)
+	{
+		const Int2 &voxel = light.getVoxel();
+		const Double3 point(
+			static_cast<double>(voxel.x) + 0.50,
+			ceilingHeight * 1.50,
+			static_cast<double>(voxel.y) + 0.50);
+		renderer.addStaticLight(point, staticLightColor,
+			static_cast<double>(light.getIntensity()));
+	}
+
+	renderer.bakeLightmap(ceilingHeight);
+
 	// Load .INF voxel textures into the renderer.
 	const int voxelTextureCount = static_cast<int>(this->inf.getVoxelTextures().size());
 	for (int i = 0; i < voxelTextureCount; i++)
@@ -113,8 +113,58 @@ public:
 		void setDirection(DoorState::Direction direction);
 		void update(double dt);
 	};
+
+	// The doors in a level that aren't closed. Each voxel column has the index of its open
+	// door so the renderer, collision, and clicking can check a door voxel without searching
+	// the list.
+	class OpenDoors
+	{
+	private:
+		std::vector<DoorState> doors;
+		std::vector<int> doorIndices; // Index in the door list for each XZ voxel, or -1.
+		int width, depth;
+
+		int getVoxelIndex(int x, int z) const;
+	public:
+		OpenDoors(int width, int depth);
+
+		int getCount() const;
+		DoorState &get(int index);
+		const DoorState &get(int index) const;
+
+		// Returns a pointer to the open door at the given voxel, or null if it's closed.
+		DoorState *find(const Int2 &voxel);
+		const DoorState *find(const Int2 &voxel) const;
+
+		// Gets the percent open of the door at the given voxel, or zero if it's closed.
+		double getPercentOpen(int x, int z) const;
+
+		// Adds a door that was closed. Its voxel must not have another open door.
+		void add(const DoorState &door);
+
+		// Removes the door at the given index. The last door is moved into its place, so
+		// removing while iterating backwards visits every door once.
+		void remove(int index);
+
+		void clear();
+	};
+
+	// A light given off by a flat, like a torch or candle. It never moves, so its light is
+	// baked into the renderer's lightmap when the level becomes active.
+	class StaticLight
+	{
+	private:
+		Int2 voxel;
+		int intensity; // Light range in voxels.
+	public:
+		StaticLight(const Int2 &voxel, int intensity);
+
+		const Int2 &getVoxel() const;
+		int getIntensity() const;
+	};
 private:
 	std::unordered_map<Int2, Lock> locks;
+	std::vector<StaticLight> staticLights;
 
 	// Mappings of IDs to voxel data indices. Chasms are treated separately since their voxel
 	// data index is also a function of the four adjacent voxels. These maps are stored here
@@ -124,14 +174,19 @@ private:
 
 	VoxelGrid voxelGrid;
 	INFFile inf;
-	std::vector<DoorState> openDoors;
+	OpenDoors openDoors;
 	std::string name;
+
+	// Renderer this level was last set active in, so voxel changes can be given to it.
+	Renderer *renderer;
 protected:
 	// Used by derived LevelData load methods.
 	LevelData(int gridWidth, int gridHeight, int gridDepth, const std::string &infName,
 		const std::string &name);
 
+	// Sets a voxel's ID. If the level is active, the renderer's copy of the voxel is updated.
 	void setVoxel(int x, int y, int z, uint16_t id);
+
 	void readFLOR(const uint16_t *flor, const INFFile &inf, int gridWidth, int gridDepth);
 	void readMAP1(const uint16_t *map1, const INFFile &inf, WorldType worldType,
 		int gridWidth, int gridDepth, const ExeData &exeData);
@@ -144,8 +199,8 @@ public:
 
 	const std::string &getName() const;
 	double getCeilingHeight() const;
-	std::vector<DoorState> &getOpenDoors();
-	const std::vector<DoorState> &getOpenDoors() const;
+	OpenDoors &getOpenDoors();
+	const OpenDoors &getOpenDoors() const;
 	const INFFile &getInfFile() const;
 	VoxelGrid &getVoxelGrid();
 	const VoxelGrid &getVoxelGrid() const;
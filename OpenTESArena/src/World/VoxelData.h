@@ -1,6 +1,8 @@
 #ifndef VOXEL_DATA_H
 #define VOXEL_DATA_H
 
+#include <cstdint>
+
 #include "../Math/Vector3.h"
 
 // Voxel data is the definition of a voxel that a voxel ID points to. Since there will 
@@ -10,7 +12,7 @@
 // A voxel's data is used for multiple things, such as rendering, collision detection,
 // and color-coding on the automap.
 
-enum class VoxelDataType;
+enum class VoxelDataType : uint8_t;
 
 class VoxelData
 {
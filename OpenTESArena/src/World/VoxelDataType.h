@@ -1,6 +1,8 @@
 #ifndef VOXEL_RENDER_TYPE_H
 #define VOXEL_RENDER_TYPE_H
 
+#include <cstdint>
+
 // A unique identifier for each type of voxel data. These are mostly used with rendering, 
 // but also for determining how to interpret the voxel data itself.
 
@@ -9,7 +11,9 @@
 
 // If the type is "None", then the voxel is empty and there is nothing to render.
 
-enum class VoxelDataType
+// The type is a byte so the renderer can keep it in its compact copies of voxels.
+
+enum class VoxelDataType : uint8_t
 {
 	None,
 	Wall,
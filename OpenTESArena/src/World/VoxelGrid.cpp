@@ -1,5 +1,6 @@
 #include <algorithm>
 
+#include "VoxelDataType.h"
 #include "VoxelGrid.h"
 
 VoxelGrid::VoxelGrid(int width, int height, int depth)
@@ -10,6 +11,26 @@ VoxelGrid::VoxelGrid(int width, int height, int depth)
 	this->width = width;
 	this->height = height;
 	this->depth = depth;
+	this->blockWidth = (width + VoxelGrid::BLOCK_SIZE - 1) / VoxelGrid::BLOCK_SIZE;
+	this->blockDepth = (depth + VoxelGrid::BLOCK_SIZE - 1) / VoxelGrid::BLOCK_SIZE;
+
+	// There's no voxel data yet, so every voxel counts as non-empty.
+	this->columnYStarts = std::vector<uint16_t>(width * depth, 0);
+	this->columnYEnds = std::vector<uint16_t>(width * depth, static_cast<uint16_t>(height));
+	this->blockColumnCounts = std::vector<int>(this->blockWidth * this->blockDepth, 0);
+
+	if (height > 0)
+	{
+		for (int z = 0; z < depth; z++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const int blockIndex = (x / VoxelGrid::BLOCK_SIZE) +
+					((z / VoxelGrid::BLOCK_SIZE) * this->blockWidth);
+				this->blockColumnCounts[blockIndex]++;
+			}
+		}
+	}
 }
 
 int VoxelGrid::getIndex(int x, int y, int z) const
@@ -17,6 +38,39 @@ int VoxelGrid::getIndex(int x, int y, int z) const
 	return x + (y * this->width) + (z * this->width * this->height);
 }
 
+bool VoxelGrid::isEmptyID(uint16_t id) const
+{
+	return (id < this->voxelData.size()) &&
+		(this->voxelData[id].dataType == VoxelDataType::None);
+}
+
+void VoxelGrid::updateColumn(int x, int z)
+{
+	int yStart = this->height;
+	int yEnd = 0;
+	for (int y = 0; y < this->height; y++)
+	{
+		if (!this->isEmptyID(this->getVoxel(x, y, z)))
+		{
+			yStart = std::min(yStart, y);
+			yEnd = y + 1;
+		}
+	}
+
+	const int columnIndex = x + (z * this->width);
+	const bool wasEmpty = this->columnYStarts[columnIndex] >= this->columnYEnds[columnIndex];
+	const bool isEmpty = yStart >= yEnd;
+	this->columnYStarts[columnIndex] = static_cast<uint16_t>(yStart);
+	this->columnYEnds[columnIndex] = static_cast<uint16_t>(yEnd);
+
+	if (wasEmpty != isEmpty)
+	{
+		const int blockIndex = (x / VoxelGrid::BLOCK_SIZE) +
+			((z / VoxelGrid::BLOCK_SIZE) * this->blockWidth);
+		this->blockColumnCounts[blockIndex] += isEmpty ? -1 : 1;
+	}
+}
+
 Int2 VoxelGrid::getTransformedCoordinate(const Int2 &voxel, int gridWidth, int gridDepth)
 {
 	// These have a -1 whereas the Double2 version does not since all .MIF start points
@@ -75,15 +129,47 @@ const VoxelData &VoxelGrid::getVoxelData(uint16_t id) const
 	return this->voxelData.at(id);
 }
 
+void VoxelGrid::getColumnYRange(int x, int z, int *yStart, int *yEnd) const
+{
+	const int columnIndex = x + (z * this->width);
+	*yStart = this->columnYStarts[columnIndex];
+	*yEnd = this->columnYEnds[columnIndex];
+}
+
+bool VoxelGrid::isBlockEmpty(int blockX, int blockZ) const
+{
+	return this->blockColumnCounts[blockX + (blockZ * this->blockWidth)] == 0;
+}
+
 uint16_t VoxelGrid::addVoxelData(const VoxelData &voxelData)
 {
 	this->voxelData.push_back(voxelData);
-
-	return static_cast<uint16_t>(this->voxelData.size() - 1);
+	const uint16_t id = static_cast<uint16_t>(this->voxelData.size() - 1);
+
+	// Voxels might already be using this ID (i.e., air is usually ID 0, which the grid
+	// starts with), so if it's empty then the columns need to be looked at again.
+	if (voxelData.dataType == VoxelDataType::None)
+	{
+		for (int z = 0; z < this->depth; z++)
+		{
+			for (int x = 0; x < this->width; x++)
+			{
+				this->updateColumn(x, z);
+			}
+		}
+	}
+
+	return id;
 }
 
 void VoxelGrid::setVoxel(int x, int y, int z, uint16_t id)
 {
 	const int index = this->getIndex(x, y, z);
+	const uint16_t oldID = this->voxels.data()[index];
 	this->voxels.data()[index] = id;
+
+	if (this->isEmptyID(oldID) != this->isEmptyID(id))
+	{
+		this->updateColumn(x, z);
+	}
 }
@@ -13,15 +13,34 @@
 // there are over a few hundred unique voxel data definitions, which mandates that the voxel
 // type itself be at least unsigned 16-bit.
 
+// The grid also keeps track of where its empty space is so ray casting can skip over it.
+// Each XZ column knows the Y range its non-empty voxels are in, and the XZ plane is split
+// into square blocks that know how many of their columns have any voxels at all. These
+// are kept up to date whenever a voxel is set.
+
 class VoxelGrid
 {
+public:
+	// Width and depth of the blocks that non-empty columns are counted in.
+	static const int BLOCK_SIZE = 8;
 private:
 	std::vector<uint16_t> voxels;
 	std::vector<VoxelData> voxelData;
+	std::vector<uint16_t> columnYStarts, columnYEnds; // Y range of non-empty voxels.
+	std::vector<int> blockColumnCounts; // Number of non-empty columns in each block.
 	int width, height, depth;
+	int blockWidth, blockDepth;
 
 	// Converts XYZ coordinate to index.
 	int getIndex(int x, int y, int z) const;
+
+	// Returns whether voxels with the given ID have nothing in them. IDs without voxel
+	// data yet are treated as non-empty until it's added.
+	bool isEmptyID(uint16_t id) const;
+
+	// Recalculates the Y range of a column's non-empty voxels, updating its block's
+	// count if the column became empty or non-empty.
+	void updateColumn(int x, int z);
 public:
 	VoxelGrid(int width, int height, int depth);
 
@@ -47,6 +66,13 @@ public:
 	VoxelData &getVoxelData(uint16_t id);
 	const VoxelData &getVoxelData(uint16_t id) const;
 
+	// Gets the Y range of the non-empty voxels in an XZ column. The end is exclusive, and
+	// the range is empty if the column has nothing in it.
+	void getColumnYRange(int x, int z, int *yStart, int *yEnd) const;
+
+	// Returns whether every column in the block with the given block coordinates is empty.
+	bool isBlockEmpty(int blockX, int blockZ) const;
+
 	// Adds a voxel data object and returns its assigned ID.
 	uint16_t addVoxelData(const VoxelData &voxelData);
 
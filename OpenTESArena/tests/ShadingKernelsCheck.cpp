@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/Rendering/ShadingKernels.h"
+
+// Checks that the vector shading kernels give the same output as the scalar kernel bit for
+// bit. Random texels, fog percents, shading, and point light values are shaded with every
+// instruction set the CPU supports, with and without lights, at counts that exercise the
+// leftover texels after the last full vector. Returns non-zero if any pixel differs.
+
+// Usage: ShadingKernelsCheck [iterations]
+
+namespace
+{
+	using InstructionSet = ShadingKernels::InstructionSet;
+
+	// Gets the instruction sets this CPU can run, from narrowest to widest.
+	std::vector<InstructionSet> getSupportedInstructionSets()
+	{
+		const InstructionSet best = ShadingKernels::getInstructionSet();
+		std::vector<InstructionSet> instructionSets = { InstructionSet::Scalar };
+
+		if ((best == InstructionSet::SSE2) || (best == InstructionSet::AVX2))
+		{
+			instructionSets.push_back(InstructionSet::SSE2);
+		}
+
+		if (best == InstructionSet::AVX2)
+		{
+			instructionSets.push_back(InstructionSet::AVX2);
+		}
+
+		return instructionSets;
+	}
+
+	// Gets how many pixels differ between the reference and the given output.
+	int countMismatches(const std::vector<uint32_t> &reference,
+		const std::vector<uint32_t> &output)
+	{
+		int mismatches = 0;
+		for (size_t i = 0; i < reference.size(); i++)
+		{
+			if (reference[i] != output[i])
+			{
+				mismatches++;
+			}
+		}
+
+		return mismatches;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const int iterations = (argc > 1) ? std::max(std::atoi(argv[1]), 1) : 2000;
+	const int maxCount = 67;
+
+	const std::vector<InstructionSet> instructionSets = getSupportedInstructionSets();
+
+	std::cout << "Instruction sets:";
+	for (const InstructionSet instructionSet : instructionSets)
+	{
+		std::cout << ' ' << ShadingKernels::getInstructionSetName(instructionSet);
+	}
+
+	std::cout << '\n';
+
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<double> unitDist(0.0, 1.0);
+	std::uniform_real_distribution<double> shadingDist(0.0, 1.25);
+	std::uniform_real_distribution<double> lightDist(0.0, 2.0);
+
+	int failures = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		const int count = 1 + static_cast<int>(random() % maxCount);
+
+		std::vector<uint32_t> texels(count);
+		std::vector<double> fogPercents(count), lightR(count), lightG(count), lightB(count);
+		for (int j = 0; j < count; j++)
+		{
+			const uint32_t bits = random();
+			texels[j] = ShadingKernels::packTexel(bits & 0xFF, (bits >> 8) & 0xFF,
+				(bits >> 16) & 0xFF, (bits >> 24) < 32);
+
+			// Fog is often exactly none or all.
+			const uint32_t fogChoice = random() % 8;
+			fogPercents[j] = (fogChoice == 0) ? 0.0 : ((fogChoice == 1) ? 1.0 : unitDist(random));
+
+			lightR[j] = lightDist(random);
+			lightG[j] = lightDist(random);
+			lightB[j] = lightDist(random);
+		}
+
+		const Double3 shading(shadingDist(random), shadingDist(random), shadingDist(random));
+		const Double3 fogColor(unitDist(random), unitDist(random), unitDist(random));
+		const ShadingKernels::TexelLights lights = { lightR.data(), lightG.data(), lightB.data() };
+
+		std::vector<uint32_t> reference(count), referenceLit(count);
+		ShadingKernels::shadeWith(InstructionSet::Scalar, texels.data(), fogPercents.data(),
+			count, shading, fogColor, reference.data());
+		ShadingKernels::shadeLitWith(InstructionSet::Scalar, texels.data(), fogPercents.data(),
+			lights, count, shading, fogColor, referenceLit.data());
+
+		for (const InstructionSet instructionSet : instructionSets)
+		{
+			const char *name = ShadingKernels::getInstructionSetName(instructionSet);
+
+			std::vector<uint32_t> output(count), outputLit(count);
+			ShadingKernels::shadeWith(instructionSet, texels.data(), fogPercents.data(), count,
+				shading, fogColor, output.data());
+			ShadingKernels::shadeLitWith(instructionSet, texels.data(), fogPercents.data(),
+				lights, count, shading, fogColor, outputLit.data());
+
+			const int mismatches = countMismatches(reference, output);
+			const int litMismatches = countMismatches(referenceLit, outputLit);
+			if (mismatches > 0)
+			{
+				std::cout << name << ": " << mismatches << " of " << count <<
+					" pixels differ (iteration " << i << ").\n";
+				failures++;
+			}
+
+			if (litMismatches > 0)
+			{
+				std::cout << name << " lit: " << litMismatches << " of " << count <<
+					" pixels differ (iteration " << i << ").\n";
+				failures++;
+			}
+		}
+	}
+
+	if (failures > 0)
+	{
+		std::cout << "FAILED: " << failures << " mismatching runs.\n";
+		return 1;
+	}
+
+	std::cout << "Passed " << iterations << " iterations.\n";
+	return 0;
+}